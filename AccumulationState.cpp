@@ -0,0 +1,73 @@
+#include "AccumulationState.h"
+
+#include <string.h>
+
+using namespace DirectX;
+
+AccumulationState::AccumulationState(unsigned int maxFrames) :
+	resetPending(true),
+	accumulatedFrames(0),
+	maxFrames(maxFrames < 1 ? 1 : maxFrames),
+	cameraPosition(),
+	view(),
+	projection()
+{
+}
+
+
+// --------------------------------------------------------
+// Any change at all to the camera starts over - the sum
+// is only valid for exactly the view it was traced from
+// --------------------------------------------------------
+bool AccumulationState::BeginFrame(
+	const XMFLOAT3& newCameraPosition,
+	const XMFLOAT4X4& newView,
+	const XMFLOAT4X4& newProjection,
+	unsigned int* frameIndex)
+{
+	bool cameraChanged =
+		memcmp(&cameraPosition, &newCameraPosition, sizeof(XMFLOAT3)) != 0 ||
+		memcmp(&view, &newView, sizeof(XMFLOAT4X4)) != 0 ||
+		memcmp(&projection, &newProjection, sizeof(XMFLOAT4X4)) != 0;
+
+	if (resetPending || cameraChanged)
+	{
+		resetPending = false;
+		accumulatedFrames = 0;
+		cameraPosition = newCameraPosition;
+		view = newView;
+		projection = newProjection;
+	}
+
+	*frameIndex = accumulatedFrames;
+	if (IsConverged())
+		return false;
+
+	accumulatedFrames++;
+	return true;
+}
+
+void AccumulationState::Reset()
+{
+	resetPending = true;
+}
+
+bool AccumulationState::IsConverged()
+{
+	return !resetPending && accumulatedFrames >= maxFrames;
+}
+
+unsigned int AccumulationState::GetAccumulatedFrames()
+{
+	return accumulatedFrames;
+}
+
+unsigned int AccumulationState::GetMaxFrames()
+{
+	return maxFrames;
+}
+
+void AccumulationState::SetMaxFrames(unsigned int frames)
+{
+	maxFrames = frames < 1 ? 1 : frames;
+}
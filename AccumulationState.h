@@ -0,0 +1,54 @@
+#pragma once
+
+// Keeps track of progressive accumulation: how many frames' worth of
+// samples have been summed into an accumulation buffer, and when that
+// sum has to be thrown away because what it's a picture of changed
+// (the camera moved, something in the scene changed, the buffer was
+// resized).  While nothing changes, each frame only adds a few samples
+// to the running sum, so a still image keeps converging, and once it
+// reaches the frame limit there's nothing left to trace at all.
+//
+// Shared by the GPU (RaytracingHelper) and CPU (CpuRaytracer) tracers
+// so both reset under exactly the same conditions.
+
+#include <DirectXMath.h>
+
+class AccumulationState
+{
+public:
+	AccumulationState(unsigned int maxFrames = 4096);
+
+	/// <summary>
+	/// Works out whether this frame adds to the existing sum or starts over
+	/// </summary>
+	/// <param name="cameraPosition">Where the camera is this frame</param>
+	/// <param name="view">Camera's view matrix this frame</param>
+	/// <param name="projection">Camera's projection matrix this frame</param>
+	/// <param name="frameIndex">How many frames are already summed (0 means start over)</param>
+	/// <returns>False if the image has converged and there's nothing to trace</returns>
+	bool BeginFrame(
+		const DirectX::XMFLOAT3& cameraPosition,
+		const DirectX::XMFLOAT4X4& view,
+		const DirectX::XMFLOAT4X4& projection,
+		unsigned int* frameIndex);
+
+	/// <summary>
+	/// Throws the sum away at the start of the next frame (the scene changed, the buffer was resized, etc.)
+	/// </summary>
+	void Reset();
+
+	bool IsConverged();
+	unsigned int GetAccumulatedFrames();
+	unsigned int GetMaxFrames();
+	void SetMaxFrames(unsigned int frames);
+
+private:
+	bool resetPending;
+	unsigned int accumulatedFrames;
+	unsigned int maxFrames;
+
+	// The camera the current sum was traced from
+	DirectX::XMFLOAT3 cameraPosition;
+	DirectX::XMFLOAT4X4 view;
+	DirectX::XMFLOAT4X4 projection;
+};
@@ -0,0 +1,226 @@
+#include "AllocationTracker.h"
+
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+// Note: None of the tracking state below may allocate, since it's
+//       touched from inside operator new itself.  Everything is a
+//       plain (constant-initialized) array so it's also safe to use
+//       before main() and during static destruction.
+
+static const int tagCount = (int)AllocationTag::Count;
+
+struct AtomicStats
+{
+	std::atomic<unsigned long long> allocations;
+	std::atomic<unsigned long long> frees;
+	std::atomic<unsigned long long> bytesAllocated;
+};
+
+static AtomicStats currentFrame[tagCount];
+static AtomicStats totals[tagCount];
+static AllocationStats lastFrame[tagCount];
+static bool hasFrameBudget[tagCount] = {};
+static unsigned long long frameBudgets[tagCount] = {};
+static bool budgetEnforced = false;
+
+static thread_local AllocationTag currentTag = AllocationTag::Untagged;
+
+AllocationTag AllocationTracker::GetCurrentTag()
+{
+	return currentTag;
+}
+
+void AllocationTracker::SetCurrentTag(AllocationTag tag)
+{
+	currentTag = tag;
+}
+
+void AllocationTracker::RecordAllocation(size_t sizeInBytes)
+{
+	int t = (int)currentTag;
+	currentFrame[t].allocations.fetch_add(1, std::memory_order_relaxed);
+	currentFrame[t].bytesAllocated.fetch_add(sizeInBytes, std::memory_order_relaxed);
+	totals[t].allocations.fetch_add(1, std::memory_order_relaxed);
+	totals[t].bytesAllocated.fetch_add(sizeInBytes, std::memory_order_relaxed);
+}
+
+void AllocationTracker::RecordFree()
+{
+	int t = (int)currentTag;
+	currentFrame[t].frees.fetch_add(1, std::memory_order_relaxed);
+	totals[t].frees.fetch_add(1, std::memory_order_relaxed);
+}
+
+// --------------------------------------------------------
+// Moves the in-progress counts over to "last frame", resets
+// them and checks every tag against its budget
+// --------------------------------------------------------
+bool AllocationTracker::EndFrame()
+{
+	bool withinBudget = true;
+	for (int t = 0; t < tagCount; t++)
+	{
+		lastFrame[t].allocations = currentFrame[t].allocations.exchange(0, std::memory_order_relaxed);
+		lastFrame[t].frees = currentFrame[t].frees.exchange(0, std::memory_order_relaxed);
+		lastFrame[t].bytesAllocated = currentFrame[t].bytesAllocated.exchange(0, std::memory_order_relaxed);
+
+		if (hasFrameBudget[t] && lastFrame[t].allocations > frameBudgets[t])
+			withinBudget = false;
+	}
+
+	if (!withinBudget && budgetEnforced)
+	{
+		PrintLastFrameReport();
+		assert(!"Per-frame allocation budget exceeded - see report above");
+	}
+
+	return withinBudget;
+}
+
+AllocationStats AllocationTracker::GetLastFrameStats(AllocationTag tag)
+{
+	return lastFrame[(int)tag];
+}
+
+AllocationStats AllocationTracker::GetCurrentFrameStats(AllocationTag tag)
+{
+	int t = (int)tag;
+	AllocationStats stats = {};
+	stats.allocations = currentFrame[t].allocations.load(std::memory_order_relaxed);
+	stats.frees = currentFrame[t].frees.load(std::memory_order_relaxed);
+	stats.bytesAllocated = currentFrame[t].bytesAllocated.load(std::memory_order_relaxed);
+	return stats;
+}
+
+AllocationStats AllocationTracker::GetTotalStats(AllocationTag tag)
+{
+	int t = (int)tag;
+	AllocationStats stats = {};
+	stats.allocations = totals[t].allocations.load(std::memory_order_relaxed);
+	stats.frees = totals[t].frees.load(std::memory_order_relaxed);
+	stats.bytesAllocated = totals[t].bytesAllocated.load(std::memory_order_relaxed);
+	return stats;
+}
+
+void AllocationTracker::SetFrameBudget(AllocationTag tag, long long maxAllocationsPerFrame)
+{
+	hasFrameBudget[(int)tag] = maxAllocationsPerFrame >= 0;
+	frameBudgets[(int)tag] = hasFrameBudget[(int)tag] ? (unsigned long long)maxAllocationsPerFrame : 0;
+}
+
+void AllocationTracker::SetBudgetEnforcement(bool enforce)
+{
+	budgetEnforced = enforce;
+}
+
+const char* AllocationTracker::GetTagName(AllocationTag tag)
+{
+	switch (tag)
+	{
+	case AllocationTag::Untagged:	return "Untagged";
+	case AllocationTag::Update:		return "Update";
+	case AllocationTag::Input:		return "Input";
+	case AllocationTag::Raytracing:	return "Raytracing";
+	case AllocationTag::Rendering:	return "Rendering";
+	default:						return "???";
+	}
+}
+
+void AllocationTracker::PrintLastFrameReport()
+{
+	printf("Heap allocations last frame:\n");
+	for (int t = 0; t < tagCount; t++)
+	{
+		printf("  %-12s %6llu allocs  %6llu frees  %10llu bytes%s\n",
+			GetTagName((AllocationTag)t),
+			lastFrame[t].allocations,
+			lastFrame[t].frees,
+			lastFrame[t].bytesAllocated,
+			(hasFrameBudget[t] && lastFrame[t].allocations > frameBudgets[t]) ? "  OVER BUDGET" : "");
+	}
+}
+
+
+// --------------------------------------------------------
+// Global operator new/delete replacements.  These forward to
+// the CRT heap and record every call with the tracker.
+// --------------------------------------------------------
+static void* TrackedAlloc(size_t size)
+{
+	AllocationTracker::RecordAllocation(size);
+	return malloc(size ? size : 1);
+}
+
+static void* TrackedAlignedAlloc(size_t size, size_t alignment)
+{
+	AllocationTracker::RecordAllocation(size);
+#ifdef _MSC_VER
+	return _aligned_malloc(size ? size : 1, alignment);
+#else
+	return aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+#endif
+}
+
+static void TrackedFree(void* p)
+{
+	if (!p) return;
+	AllocationTracker::RecordFree();
+	free(p);
+}
+
+static void TrackedAlignedFree(void* p)
+{
+	if (!p) return;
+	AllocationTracker::RecordFree();
+#ifdef _MSC_VER
+	_aligned_free(p);
+#else
+	free(p);
+#endif
+}
+
+void* operator new(size_t size)
+{
+	void* p = TrackedAlloc(size);
+	if (!p) throw std::bad_alloc();
+	return p;
+}
+
+void* operator new[](size_t size)
+{
+	void* p = TrackedAlloc(size);
+	if (!p) throw std::bad_alloc();
+	return p;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return TrackedAlloc(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return TrackedAlloc(size); }
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	void* p = TrackedAlignedAlloc(size, (size_t)alignment);
+	if (!p) throw std::bad_alloc();
+	return p;
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+	void* p = TrackedAlignedAlloc(size, (size_t)alignment);
+	if (!p) throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void* p) noexcept { TrackedFree(p); }
+void operator delete[](void* p) noexcept { TrackedFree(p); }
+void operator delete(void* p, size_t) noexcept { TrackedFree(p); }
+void operator delete[](void* p, size_t) noexcept { TrackedFree(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { TrackedFree(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { TrackedFree(p); }
+void operator delete(void* p, std::align_val_t) noexcept { TrackedAlignedFree(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { TrackedAlignedFree(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { TrackedAlignedFree(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { TrackedAlignedFree(p); }
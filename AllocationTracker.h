@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+
+// Subsystems that heap allocations can be attributed to.
+// Keep Count last - it's used to size the tracking arrays.
+enum class AllocationTag
+{
+	Untagged,
+	Update,
+	Input,
+	Raytracing,
+	Rendering,
+	Count
+};
+
+struct AllocationStats
+{
+	unsigned long long allocations;	// Calls to operator new
+	unsigned long long frees;		// Calls to operator delete (counted against the tag active when freed)
+	unsigned long long bytesAllocated;
+};
+
+// --------------------------------------------------------
+// Counts every heap allocation and free made through the
+// global operator new/delete, attributing each one to the
+// subsystem tag active on the calling thread.  Counts are
+// gathered per frame so hot paths that quietly allocate
+// show up immediately.
+//
+// The global operator new/delete replacements live in
+// AllocationTracker.cpp, so this works without any changes
+// to the code being measured; just wrap that code in an
+// AllocationScope to attribute it to a subsystem.
+// --------------------------------------------------------
+class AllocationTracker
+{
+public:
+	// Tag used for allocations on the calling thread
+	static AllocationTag GetCurrentTag();
+	static void SetCurrentTag(AllocationTag tag);
+
+	// Called by the global operator new/delete replacements
+	static void RecordAllocation(size_t sizeInBytes);
+	static void RecordFree();
+
+	/// <summary>
+	/// Closes out the current frame: its counts become the "last frame" stats and counting starts over.
+	/// </summary>
+	/// <returns>False if any tag went over its per-frame budget this frame</returns>
+	static bool EndFrame();
+
+	// Stats for the most recently completed frame, the current
+	// (in progress) frame, and the lifetime of the program
+	static AllocationStats GetLastFrameStats(AllocationTag tag);
+	static AllocationStats GetCurrentFrameStats(AllocationTag tag);
+	static AllocationStats GetTotalStats(AllocationTag tag);
+
+	/// <summary>
+	/// Sets the maximum number of allocations a tag may make in a single frame (-1 for no limit, which is the default)
+	/// </summary>
+	static void SetFrameBudget(AllocationTag tag, long long maxAllocationsPerFrame);
+
+	/// <summary>
+	/// When enabled, a frame that goes over budget prints a report and fails an assert in debug builds
+	/// </summary>
+	static void SetBudgetEnforcement(bool enforce);
+
+	static const char* GetTagName(AllocationTag tag);
+	static void PrintLastFrameReport();
+};
+
+// --------------------------------------------------------
+// Attributes all allocations on this thread to the given tag
+// for as long as the scope is alive (restoring the old tag
+// afterwards, so scopes can be nested)
+// --------------------------------------------------------
+class AllocationScope
+{
+public:
+	AllocationScope(AllocationTag tag) : previousTag(AllocationTracker::GetCurrentTag())
+	{
+		AllocationTracker::SetCurrentTag(tag);
+	}
+
+	~AllocationScope()
+	{
+		AllocationTracker::SetCurrentTag(previousTag);
+	}
+
+	AllocationScope(AllocationScope const&) = delete;
+	void operator=(AllocationScope const&) = delete;
+
+private:
+	AllocationTag previousTag;
+};
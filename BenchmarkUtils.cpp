@@ -0,0 +1,167 @@
+#include "BenchmarkUtils.h"
+#include "CpuRaytracer.h"
+#include "Material.h"
+#include "Mesh.h"
+#include "TransformSystem.h"
+
+#include <math.h>
+
+using namespace DirectX;
+
+namespace
+{
+	// A 2x2x2 cube centered on the origin, four vertices per face so
+	// each face gets its own normal
+	std::shared_ptr<Mesh> CreateCube()
+	{
+		const XMFLOAT3 normals[6] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+		const float corners[4][2] = { { -1, -1 }, { -1, 1 }, { 1, 1 }, { 1, -1 } };
+		const unsigned int faceIndices[6] = { 0, 1, 2, 0, 2, 3 };
+
+		std::vector<Vertex> vertices;
+		std::vector<unsigned int> indices;
+		for (const XMFLOAT3& normal : normals)
+		{
+			// Two axes across the face
+			XMVECTOR n = XMLoadFloat3(&normal);
+			XMVECTOR up = fabsf(normal.y) > 0.5f ? XMVectorSet(1, 0, 0, 0) : XMVectorSet(0, 1, 0, 0);
+			XMVECTOR across = XMVector3Cross(n, up);
+			XMVECTOR down = XMVector3Cross(n, across);
+
+			unsigned int first = (unsigned int)vertices.size();
+			for (const float* corner : corners)
+			{
+				Vertex vertex = {};
+				XMStoreFloat3(&vertex.Position, n + across * corner[0] + down * corner[1]);
+				vertex.Normal = normal;
+				vertex.UV = XMFLOAT2((corner[0] + 1) * 0.5f, (corner[1] + 1) * 0.5f);
+				vertices.push_back(vertex);
+			}
+
+			for (unsigned int index : faceIndices)
+				indices.push_back(first + index);
+		}
+
+		return std::make_shared<Mesh>(vertices.data(), (int)vertices.size(), indices.data(), (int)indices.size(), true);
+	}
+}
+
+
+// --------------------------------------------------------
+// A wide, flat box as the floor, with seven boxes standing
+// on it in a staggered row
+// --------------------------------------------------------
+void BenchmarkUtils::CreateScene(Scene* scene, float aspectRatio)
+{
+	std::shared_ptr<Mesh> cube = CreateCube();
+	std::shared_ptr<Material> materials[3] =
+	{
+		std::make_shared<Material>(nullptr, XMFLOAT3(0.8f, 0.8f, 0.8f), XMFLOAT2(1, 1), XMFLOAT2(0, 0)),
+		std::make_shared<Material>(nullptr, XMFLOAT3(0.9f, 0.3f, 0.3f), XMFLOAT2(1, 1), XMFLOAT2(0, 0)),
+		std::make_shared<Material>(nullptr, XMFLOAT3(0.3f, 0.9f, 0.3f), XMFLOAT2(1, 1), XMFLOAT2(0, 0)),
+	};
+
+	scene->entities.clear();
+	for (int i = 0; i < 8; i++)
+	{
+		std::shared_ptr<Entity> entity = std::make_shared<Entity>(cube, materials[i % 3]);
+		if (i == 0)
+		{
+			entity->GetTransform()->SetPosition(0, -1.5f, 0);
+			entity->GetTransform()->SetScale(20, 0.5f, 20);
+		}
+		else
+		{
+			entity->GetTransform()->SetPosition((i - 4) * 2.5f, 0, 3.0f + (i % 2) * 2.0f);
+		}
+		scene->entities.push_back(entity);
+	}
+
+	// Same two directional lights the starting scene uses
+	scene->snapshot = {};
+	scene->snapshot.lightCount = 2;
+	scene->snapshot.lights[0].Type = LIGHT_TYPE_DIRECTIONAL;
+	scene->snapshot.lights[0].Direction = XMFLOAT3(-1, -1, 0.1f);
+	scene->snapshot.lights[0].Color = XMFLOAT3(1.0f, 0.3f, 0.3f);
+	scene->snapshot.lights[0].Intensity = 1.0f;
+	scene->snapshot.lights[1].Type = LIGHT_TYPE_DIRECTIONAL;
+	scene->snapshot.lights[1].Direction = XMFLOAT3(1, -1, -0.1f);
+	scene->snapshot.lights[1].Color = XMFLOAT3(0.5f, 0.15f, 0.15f);
+	scene->snapshot.lights[1].Intensity = 1.0f;
+
+	// Up and back, looking slightly down at the row
+	XMVECTOR rotation = XMQuaternionRotationRollPitchYaw(atanf(0.25f), 0, 0);
+	scene->cameraPosition = XMFLOAT3(0, 3, -10);
+	scene->snapshot.camera.position = scene->cameraPosition;
+	XMStoreFloat4(&scene->snapshot.camera.rotation, rotation);
+
+	XMVECTOR forward = XMVector3Rotate(XMVectorSet(0, 0, 1, 0), rotation);
+	XMStoreFloat4x4(&scene->view, XMMatrixLookToLH(XMLoadFloat3(&scene->cameraPosition), forward, XMVectorSet(0, 1, 0, 0)));
+	XMStoreFloat4x4(&scene->projection, XMMatrixPerspectiveFovLH(XM_PIDIV4, aspectRatio, 0.01f, 100.0f));
+
+	CaptureSnapshot(scene);
+}
+
+// --------------------------------------------------------
+// Brings every matrix up to date first, so each instance's
+// transform version matches its matrices
+// --------------------------------------------------------
+void BenchmarkUtils::CaptureSnapshot(Scene* scene)
+{
+	TransformSystem::GetInstance().UpdateAllMatrices();
+
+	SceneSnapshot& snapshot = scene->snapshot;
+	snapshot.tick++;
+	snapshot.instances.resize(scene->entities.size());
+	for (unsigned int i = 0; i < scene->entities.size(); i++)
+	{
+		Entity* entity = scene->entities[i].get();
+		SnapshotInstance& instance = snapshot.instances[i];
+		instance.entity = entity;
+		instance.mesh = entity->GetMesh().get();
+		instance.material = entity->GetMaterial().get();
+		instance.transformVersion = entity->GetTransform()->GetVersion();
+		instance.worldMatrix = entity->GetTransform()->GetWorldMatrix();
+		instance.worldInverseTransposeMatrix = entity->GetTransform()->GetWorldInverseTransposeMatrix();
+	}
+}
+
+void BenchmarkUtils::GetImage(const CpuRaytracer& tracer, std::vector<XMFLOAT3>* image)
+{
+	image->resize(tracer.GetWidth() * tracer.GetHeight());
+	for (unsigned int y = 0; y < tracer.GetHeight(); y++)
+		for (unsigned int x = 0; x < tracer.GetWidth(); x++)
+			(*image)[y * tracer.GetWidth() + x] = tracer.GetPixel(x, y);
+}
+
+// --------------------------------------------------------
+// One frame with every sample at once, so the timing is
+// just the tracing
+// --------------------------------------------------------
+double BenchmarkUtils::RenderReference(
+	const SceneSnapshot& snapshot,
+	XMFLOAT3 cameraPosition,
+	const XMFLOAT4X4& view,
+	const XMFLOAT4X4& projection,
+	unsigned int width, unsigned int height,
+	unsigned int samplesPerPixel,
+	std::vector<XMFLOAT3>* image)
+{
+	CpuRaytracer reference;
+	reference.Resize(width, height);
+	reference.SetSamplesPerPixel(samplesPerPixel);
+	reference.SetRussianRoulette(false);
+	reference.SetSeed(1);
+
+	Clock::time_point start = Clock::now();
+	reference.Render(snapshot, cameraPosition, view, projection);
+	double time = MillisecondsSince(start);
+
+	GetImage(reference, image);
+	return time;
+}
+
+double BenchmarkUtils::RenderReference(const Scene& scene, unsigned int width, unsigned int height, unsigned int samplesPerPixel, std::vector<XMFLOAT3>* image)
+{
+	return RenderReference(scene.snapshot, scene.cameraPosition, scene.view, scene.projection, width, height, samplesPerPixel, image);
+}
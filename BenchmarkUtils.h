@@ -0,0 +1,118 @@
+#pragma once
+
+// Helpers every benchmark (the *Benchmark.h namespaces) and headless
+// check (HeadlessTests.h) shares, so they all time, judge and compare
+// images the same way, on the same scene.
+
+#include <DirectXMath.h>
+#include <chrono>
+#include <memory>
+#include <stdio.h>
+#include <vector>
+
+#include "Entity.h"
+#include "SceneSnapshot.h"
+
+class CpuRaytracer;
+
+namespace BenchmarkUtils
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	// Wall clock time since start, in milliseconds
+	inline double MillisecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	inline const char* Verdict(bool passed)
+	{
+		return passed ? "PASS" : "FAIL";
+	}
+
+	// For rows where only some entries are checked: nothing if this one
+	// isn't, otherwise the verdict after a gap
+	inline const char* Verdict(bool checked, bool passed)
+	{
+		return !checked ? "" : passed ? "  PASS" : "  FAIL";
+	}
+
+	// Says what was expected when a check fails, so a failing run explains itself
+	inline bool Expect(bool passed, const char* what)
+	{
+		if (!passed)
+			printf("    expected %s\n", what);
+		return passed;
+	}
+
+	// Mean squared error of every pixel's linear color
+	inline double MeanSquaredError(const std::vector<DirectX::XMFLOAT3>& image, const std::vector<DirectX::XMFLOAT3>& reference)
+	{
+		double total = 0;
+		for (size_t i = 0; i < image.size(); i++)
+		{
+			const DirectX::XMFLOAT3& a = image[i];
+			const DirectX::XMFLOAT3& b = reference[i];
+			total += (a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y) + (a.z - b.z) * (a.z - b.z);
+		}
+		return image.empty() ? 0.0 : total / (3.0 * image.size());
+	}
+
+	// A small scene built entirely on the CPU (no device needed): a floor
+	// with a row of boxes in three colors, two directional lights like the
+	// starting scene's, and a camera looking down at the boxes
+	struct Scene
+	{
+		std::vector<std::shared_ptr<Entity>> entities;
+		SceneSnapshot snapshot;		// Of the entities, as of the last CaptureSnapshot()
+		DirectX::XMFLOAT3 cameraPosition;
+		DirectX::XMFLOAT4X4 view;
+		DirectX::XMFLOAT4X4 projection;
+	};
+
+	/// <summary>
+	/// Builds the scene above and captures its first snapshot
+	/// </summary>
+	/// <param name="scene">Scene to fill in</param>
+	/// <param name="aspectRatio">Width over height of the images it'll be rendered to</param>
+	void CreateScene(Scene* scene, float aspectRatio = 16.0f / 9.0f);
+
+	/// <summary>
+	/// Copies the entities (after moving them) into the scene's snapshot, the way
+	/// Game::CaptureSnapshot() does
+	/// </summary>
+	/// <param name="scene">Scene to capture</param>
+	void CaptureSnapshot(Scene* scene);
+
+	/// <summary>
+	/// Copies every pixel a tracer has accumulated (linear color), row by row
+	/// </summary>
+	/// <param name="tracer">Tracer to read</param>
+	/// <param name="image">Resized to the tracer's output and filled in</param>
+	void GetImage(const CpuRaytracer& tracer, std::vector<DirectX::XMFLOAT3>* image);
+
+	/// <summary>
+	/// Traces what the benchmarks judge against: many samples a pixel, no Russian
+	/// roulette, and a different seed so it never shares the samples being judged
+	/// </summary>
+	/// <param name="snapshot">What to trace</param>
+	/// <param name="cameraPosition">Where the camera is</param>
+	/// <param name="view">Camera's view matrix</param>
+	/// <param name="projection">Camera's projection matrix</param>
+	/// <param name="width">Image width in pixels</param>
+	/// <param name="height">Image height in pixels</param>
+	/// <param name="samplesPerPixel">Samples for every pixel</param>
+	/// <param name="image">Resized and filled in with the result</param>
+	/// <returns>How long it took, in milliseconds</returns>
+	double RenderReference(
+		const SceneSnapshot& snapshot,
+		DirectX::XMFLOAT3 cameraPosition,
+		const DirectX::XMFLOAT4X4& view,
+		const DirectX::XMFLOAT4X4& projection,
+		unsigned int width, unsigned int height,
+		unsigned int samplesPerPixel,
+		std::vector<DirectX::XMFLOAT3>* image);
+
+	// The same, from the scene's own camera
+	double RenderReference(const Scene& scene, unsigned int width, unsigned int height, unsigned int samplesPerPixel, std::vector<DirectX::XMFLOAT3>* image);
+}
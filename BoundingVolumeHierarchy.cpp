@@ -0,0 +1,347 @@
+#include "BoundingVolumeHierarchy.h"
+
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+using namespace DirectX;
+
+namespace
+{
+	// How many candidate split positions are tried along each axis
+	const unsigned int SplitBins = 12;
+
+	// Deeper than this, nodes just become (possibly large) leaves, which
+	// keeps the traversal stack a fixed size
+	const unsigned int MaxDepth = 60;
+
+	AABB Union(const AABB& a, const AABB& b)
+	{
+		AABB box = {};
+		XMStoreFloat3(&box.minCorner, XMVectorMin(XMLoadFloat3(&a.minCorner), XMLoadFloat3(&b.minCorner)));
+		XMStoreFloat3(&box.maxCorner, XMVectorMax(XMLoadFloat3(&a.maxCorner), XMLoadFloat3(&b.maxCorner)));
+		return box;
+	}
+
+	// Half the surface area, which is all the heuristic needs (it only compares ratios)
+	float HalfArea(const AABB& box)
+	{
+		if (Bounds::IsEmpty(box))
+			return 0.0f;
+
+		float x = box.maxCorner.x - box.minCorner.x;
+		float y = box.maxCorner.y - box.minCorner.y;
+		float z = box.maxCorner.z - box.minCorner.z;
+		return x * y + y * z + z * x;
+	}
+
+	// Slab test against a precomputed inverse direction (infinities
+	// from zero components fall out correctly)
+	bool IntersectsNode(const AABB& box, const float* origin, const float* inverseDirection, float maxDistance, float* entry)
+	{
+		float tMin = 0.0f;
+		float tMax = maxDistance;
+		const float* boxMin = &box.minCorner.x;
+		const float* boxMax = &box.maxCorner.x;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float t0 = (boxMin[axis] - origin[axis]) * inverseDirection[axis];
+			float t1 = (boxMax[axis] - origin[axis]) * inverseDirection[axis];
+			tMin = fmaxf(tMin, fminf(t0, t1));
+			tMax = fminf(tMax, fmaxf(t0, t1));
+		}
+
+		*entry = tMin;
+		return tMin <= tMax;
+	}
+}
+
+BoundingVolumeHierarchy::BoundingVolumeHierarchy() :
+	centroids(0)
+{
+}
+
+
+// --------------------------------------------------------
+// Starts with everything in one leaf at the root and
+// splits from there
+// --------------------------------------------------------
+void BoundingVolumeHierarchy::Build(const AABB* primitiveBounds, unsigned int primitiveCount, unsigned int maxLeafSize, XMFLOAT3* centroidScratch)
+{
+	nodes.clear();
+	primitiveOrder.resize(primitiveCount);
+	if (primitiveCount == 0)
+		return;
+
+	if (!centroidScratch)
+	{
+		ownCentroids.resize(primitiveCount);
+		centroidScratch = ownCentroids.data();
+	}
+	centroids = centroidScratch;
+
+	Node root = {};
+	root.bounds = Bounds::Empty();
+	root.first = 0;
+	root.count = primitiveCount;
+	for (unsigned int i = 0; i < primitiveCount; i++)
+	{
+		primitiveOrder[i] = i;
+		centroids[i] = Bounds::GetCenter(primitiveBounds[i]);
+		root.bounds = Union(root.bounds, primitiveBounds[i]);
+	}
+
+	// A binary tree with one primitive per leaf has 2n - 1 nodes,
+	// so this never needs to grow while building
+	nodes.reserve(2 * primitiveCount - 1);
+	nodes.push_back(root);
+	Subdivide(0, primitiveBounds, maxLeafSize < 1 ? 1 : maxLeafSize);
+	centroids = 0;
+}
+
+// --------------------------------------------------------
+// Children always come after their parents, so walking
+// backwards updates every child before its parent
+// --------------------------------------------------------
+void BoundingVolumeHierarchy::Refit(const AABB* primitiveBounds)
+{
+	for (unsigned int i = (unsigned int)nodes.size(); i-- > 0;)
+	{
+		Node& node = nodes[i];
+		if (node.count > 0)
+		{
+			node.bounds = Bounds::Empty();
+			for (unsigned int p = node.first; p < node.first + node.count; p++)
+				node.bounds = Union(node.bounds, primitiveBounds[primitiveOrder[p]]);
+		}
+		else
+		{
+			node.bounds = Union(nodes[node.first].bounds, nodes[node.first + 1].bounds);
+		}
+	}
+}
+
+const AABB& BoundingVolumeHierarchy::GetBounds() const
+{
+	static const AABB empty = Bounds::Empty();
+	return nodes.empty() ? empty : nodes[0].bounds;
+}
+
+
+// --------------------------------------------------------
+// Splits a leaf in two where the surface area heuristic
+// says it's cheapest, unless keeping it whole is cheaper
+// (falling back to splitting at the median if it's too
+// big to keep but there's no useful split)
+// --------------------------------------------------------
+void BoundingVolumeHierarchy::Subdivide(unsigned int nodeIndex, const AABB* primitiveBounds, unsigned int maxLeafSize)
+{
+	// Depth of each node waiting to be split, alongside its index
+	struct Pending { unsigned int node; unsigned int depth; };
+	Pending stack[MaxDepth + 2];
+	unsigned int stackSize = 0;
+	stack[stackSize++] = { nodeIndex, 0 };
+
+	while (stackSize > 0)
+	{
+		Pending pending = stack[--stackSize];
+		Node node = nodes[pending.node];
+		if (node.count <= 1 || pending.depth >= MaxDepth)
+			continue;
+
+		unsigned int axis = 0;
+		float position = 0.0f;
+		float splitCost = FindSplit(node, primitiveBounds, &axis, &position);
+		float leafCost = (float)node.count;
+		if (node.count <= maxLeafSize && splitCost >= leafCost)
+			continue;
+
+		// Partition the primitives around the split
+		unsigned int* first = &primitiveOrder[node.first];
+		unsigned int* last = first + node.count;
+		unsigned int* middle = std::partition(first, last,
+			[&](unsigned int p) { return (&centroids[p].x)[axis] < position; });
+
+		if (middle == first || middle == last || splitCost >= leafCost)
+		{
+			// Every centroid landed on one side (or the split doesn't help), but
+			// this leaf is too big to keep - split at the median of the widest axis
+			XMFLOAT3 extents = Bounds::GetHalfExtents(node.bounds);
+			axis = extents.x > extents.y ? (extents.x > extents.z ? 0 : 2) : (extents.y > extents.z ? 1 : 2);
+			middle = first + node.count / 2;
+			std::nth_element(first, middle, last,
+				[&](unsigned int a, unsigned int b) { return (&centroids[a].x)[axis] < (&centroids[b].x)[axis]; });
+		}
+
+		Node children[2] = {};
+		children[0].first = node.first;
+		children[0].count = (unsigned int)(middle - first);
+		children[1].first = node.first + children[0].count;
+		children[1].count = node.count - children[0].count;
+		for (Node& child : children)
+		{
+			child.bounds = Bounds::Empty();
+			for (unsigned int p = child.first; p < child.first + child.count; p++)
+				child.bounds = Union(child.bounds, primitiveBounds[primitiveOrder[p]]);
+		}
+
+		unsigned int childIndex = (unsigned int)nodes.size();
+		nodes[pending.node].first = childIndex;
+		nodes[pending.node].count = 0;
+		nodes.push_back(children[0]);
+		nodes.push_back(children[1]);
+
+		stack[stackSize++] = { childIndex, pending.depth + 1 };
+		stack[stackSize++] = { childIndex + 1, pending.depth + 1 };
+	}
+}
+
+// --------------------------------------------------------
+// Bins the node's primitives by centroid along each axis
+// and finds the bin boundary with the lowest estimated
+// cost, relative to simply testing every primitive
+// --------------------------------------------------------
+float BoundingVolumeHierarchy::FindSplit(const Node& node, const AABB* primitiveBounds, unsigned int* bestAxis, float* bestPosition)
+{
+	// Bin by centroid, not bounds, so every primitive lands in exactly one bin
+	AABB centroidBounds = Bounds::Empty();
+	for (unsigned int p = node.first; p < node.first + node.count; p++)
+		Bounds::Expand(centroidBounds, centroids[primitiveOrder[p]]);
+
+	float bestCost = FLT_MAX;
+	float parentArea = HalfArea(node.bounds);
+	for (unsigned int axis = 0; axis < 3; axis++)
+	{
+		float axisMin = (&centroidBounds.minCorner.x)[axis];
+		float axisMax = (&centroidBounds.maxCorner.x)[axis];
+		if (axisMax <= axisMin)
+			continue;
+
+		struct Bin { AABB bounds; unsigned int count; };
+		Bin bins[SplitBins];
+		for (Bin& bin : bins)
+		{
+			bin.bounds = Bounds::Empty();
+			bin.count = 0;
+		}
+
+		float scale = SplitBins / (axisMax - axisMin);
+		for (unsigned int p = node.first; p < node.first + node.count; p++)
+		{
+			unsigned int primitive = primitiveOrder[p];
+			unsigned int b = (unsigned int)(((&centroids[primitive].x)[axis] - axisMin) * scale);
+			b = b < SplitBins ? b : SplitBins - 1;
+			bins[b].bounds = Union(bins[b].bounds, primitiveBounds[primitive]);
+			bins[b].count++;
+		}
+
+		// Sweep from the right to get the cost of everything past each boundary,
+		// then from the left to combine it with everything before
+		float rightArea[SplitBins - 1];
+		unsigned int rightCount[SplitBins - 1];
+		AABB right = Bounds::Empty();
+		unsigned int count = 0;
+		for (unsigned int b = SplitBins - 1; b > 0; b--)
+		{
+			right = Union(right, bins[b].bounds);
+			count += bins[b].count;
+			rightArea[b - 1] = HalfArea(right);
+			rightCount[b - 1] = count;
+		}
+
+		AABB left = Bounds::Empty();
+		count = 0;
+		for (unsigned int b = 0; b < SplitBins - 1; b++)
+		{
+			left = Union(left, bins[b].bounds);
+			count += bins[b].count;
+
+			// One traversal step, plus testing each side's primitives as often as a ray would reach it
+			float cost = parentArea > 0.0f ?
+				1.0f + (HalfArea(left) * count + rightArea[b] * rightCount[b]) / parentArea :
+				(float)node.count;
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				*bestAxis = axis;
+				*bestPosition = axisMin + (b + 1) / scale;
+			}
+		}
+	}
+
+	return bestCost;
+}
+
+// --------------------------------------------------------
+// Iterative, front to back: the nearer child is visited
+// first, and anything further than the closest hit so far
+// is skipped when it comes off the stack
+// --------------------------------------------------------
+bool BoundingVolumeHierarchy::Raycast(const Ray& ray, HitFunction hitFunction, const void* context) const
+{
+	if (nodes.empty())
+		return false;
+
+	Ray current = ray;
+	float inverseDirection[3] = { 1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z };
+	const float* origin = &ray.origin.x;
+
+	unsigned int nodeStack[MaxDepth + 2];
+	float entryStack[MaxDepth + 2];
+	unsigned int stackSize = 0;
+
+	float entry;
+	if (!IntersectsNode(nodes[0].bounds, origin, inverseDirection, current.maxDistance, &entry))
+		return false;
+	nodeStack[stackSize] = 0;
+	entryStack[stackSize++] = entry;
+
+	bool hit = false;
+	while (stackSize > 0)
+	{
+		stackSize--;
+		if (entryStack[stackSize] > current.maxDistance)
+			continue;
+
+		const Node& node = nodes[nodeStack[stackSize]];
+		if (node.count > 0)
+		{
+			for (unsigned int p = node.first; p < node.first + node.count; p++)
+				hit |= hitFunction(context, p, current);
+			continue;
+		}
+
+		float nearEntry, farEntry;
+		unsigned int nearChild = node.first;
+		unsigned int farChild = node.first + 1;
+		bool hitNear = IntersectsNode(nodes[nearChild].bounds, origin, inverseDirection, current.maxDistance, &nearEntry);
+		bool hitFar = IntersectsNode(nodes[farChild].bounds, origin, inverseDirection, current.maxDistance, &farEntry);
+		if (hitNear && hitFar && farEntry < nearEntry)
+		{
+			std::swap(nearChild, farChild);
+			std::swap(nearEntry, farEntry);
+		}
+		else if (!hitNear)
+		{
+			// Only the far one (if either) needs visiting
+			nearChild = farChild;
+			nearEntry = farEntry;
+			hitNear = hitFar;
+			hitFar = false;
+		}
+
+		// Far first, so the near child comes off the stack next
+		if (hitFar)
+		{
+			nodeStack[stackSize] = farChild;
+			entryStack[stackSize++] = farEntry;
+		}
+		if (hitNear)
+		{
+			nodeStack[stackSize] = nearChild;
+			entryStack[stackSize++] = nearEntry;
+		}
+	}
+
+	return hit;
+}
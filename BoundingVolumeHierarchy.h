@@ -0,0 +1,88 @@
+#pragma once
+
+// A binary bounding volume hierarchy over a fixed set of boxes - the
+// CPU-side equivalent of a DXR acceleration structure.  It's generic:
+// MeshBVH builds one over a mesh's triangles (like a BLAS), and
+// ScenePicker builds one over the scene's instances (like a TLAS).
+//
+// Built top-down with a binned surface area heuristic.  Nodes live in
+// a single flat array with each pair of siblings next to each other and
+// always after their parent, so refitting (after the boxes move, but
+// before they've moved far enough to be worth a rebuild) is a single
+// backwards pass with no recursion.
+
+#include <vector>
+
+#include "Bounds.h"
+
+class BoundingVolumeHierarchy
+{
+public:
+	BoundingVolumeHierarchy();
+
+	/// <summary>
+	/// Builds the hierarchy from scratch
+	/// </summary>
+	/// <param name="primitiveBounds">Box around each primitive</param>
+	/// <param name="primitiveCount">How many primitives there are</param>
+	/// <param name="maxLeafSize">Most primitives a leaf may hold</param>
+	/// <param name="centroidScratch">Room for primitiveCount centroids to build with, or null to use the hierarchy's own (which it keeps)</param>
+	void Build(const AABB* primitiveBounds, unsigned int primitiveCount, unsigned int maxLeafSize = 4, DirectX::XMFLOAT3* centroidScratch = 0);
+
+	/// <summary>
+	/// Updates every node's bounds for primitives that have moved, keeping the
+	/// same tree.  Needs the same number of primitives as the last Build().
+	/// </summary>
+	void Refit(const AABB* primitiveBounds);
+
+	/// <summary>
+	/// Walks every leaf the ray reaches, nearest first, handing each primitive to
+	/// hitTest(primitive, ray).  The hit test shortens ray.maxDistance when it finds
+	/// something closer, which prunes the rest of the walk.
+	/// </summary>
+	/// <param name="ray">Ray to trace</param>
+	/// <param name="hitTest">Called as bool hitTest(unsigned int primitive, Ray& ray)</param>
+	/// <returns>True if any hit test returned true</returns>
+	template<typename HitTest>
+	bool Raycast(const Ray& ray, HitTest& hitTest) const;
+
+	// Primitives are stored in leaf order, so the primitive index handed to a
+	// hit test is its position in this order (GetPrimitive() maps it back)
+	unsigned int GetPrimitive(unsigned int orderedIndex) const { return primitiveOrder[orderedIndex]; }
+	unsigned int GetPrimitiveCount() const { return (unsigned int)primitiveOrder.size(); }
+	unsigned int GetNodeCount() const { return (unsigned int)nodes.size(); }
+	const AABB& GetBounds() const;
+
+private:
+	struct Node
+	{
+		AABB bounds;
+		unsigned int first;	// First child (interior nodes) or first primitive (leaves)
+		unsigned int count;	// Primitives in a leaf, or 0 for interior nodes
+	};
+
+	std::vector<Node> nodes;
+	std::vector<unsigned int> primitiveOrder;
+
+	// Scratch space for building: the caller's, or our own (kept to avoid
+	// reallocating on rebuilds).  Only points anywhere during Build().
+	std::vector<DirectX::XMFLOAT3> ownCentroids;
+	DirectX::XMFLOAT3* centroids;
+
+	void Subdivide(unsigned int node, const AABB* primitiveBounds, unsigned int maxLeafSize);
+	float FindSplit(const Node& node, const AABB* primitiveBounds, unsigned int* axis, float* position);
+
+	typedef bool (*HitFunction)(const void* context, unsigned int primitive, Ray& ray);
+	bool Raycast(const Ray& ray, HitFunction hitFunction, const void* context) const;
+};
+
+template<typename HitTest>
+bool BoundingVolumeHierarchy::Raycast(const Ray& ray, HitTest& hitTest) const
+{
+	return Raycast(ray,
+		[](const void* context, unsigned int primitive, Ray& currentRay)
+		{
+			return (*(HitTest*)context)(primitive, currentRay);
+		},
+		&hitTest);
+}
@@ -0,0 +1,164 @@
+#include "Bounds.h"
+
+#include <float.h>
+
+using namespace DirectX;
+
+AABB Bounds::Empty()
+{
+	AABB box = {};
+	box.minCorner = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+	box.maxCorner = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	return box;
+}
+
+void Bounds::Expand(AABB& box, const XMFLOAT3& point)
+{
+	XMStoreFloat3(&box.minCorner, XMVectorMin(XMLoadFloat3(&box.minCorner), XMLoadFloat3(&point)));
+	XMStoreFloat3(&box.maxCorner, XMVectorMax(XMLoadFloat3(&box.maxCorner), XMLoadFloat3(&point)));
+}
+
+bool Bounds::IsEmpty(const AABB& box)
+{
+	return box.minCorner.x > box.maxCorner.x || box.minCorner.y > box.maxCorner.y || box.minCorner.z > box.maxCorner.z;
+}
+
+XMFLOAT3 Bounds::GetCenter(const AABB& box)
+{
+	XMFLOAT3 center;
+	XMStoreFloat3(&center, (XMLoadFloat3(&box.minCorner) + XMLoadFloat3(&box.maxCorner)) * 0.5f);
+	return center;
+}
+
+XMFLOAT3 Bounds::GetHalfExtents(const AABB& box)
+{
+	XMFLOAT3 halfExtents;
+	XMStoreFloat3(&halfExtents, (XMLoadFloat3(&box.maxCorner) - XMLoadFloat3(&box.minCorner)) * 0.5f);
+	return halfExtents;
+}
+
+// --------------------------------------------------------
+// Transforms the center, and works out the new extents from
+// the absolute values of the matrix (Arvo's method), rather
+// than transforming all eight corners
+// --------------------------------------------------------
+AABB Bounds::Transform(const AABB& localBox, const XMFLOAT4X4& worldMatrix)
+{
+	XMMATRIX world = XMLoadFloat4x4(&worldMatrix);
+	XMFLOAT3 localCenter = GetCenter(localBox);
+	XMFLOAT3 localHalfExtents = GetHalfExtents(localBox);
+
+	XMVECTOR center = XMVector3Transform(XMLoadFloat3(&localCenter), world);
+	XMVECTOR halfExtents =
+		XMVectorAbs(world.r[0]) * localHalfExtents.x +
+		XMVectorAbs(world.r[1]) * localHalfExtents.y +
+		XMVectorAbs(world.r[2]) * localHalfExtents.z;
+
+	AABB box = {};
+	XMStoreFloat3(&box.minCorner, center - halfExtents);
+	XMStoreFloat3(&box.maxCorner, center + halfExtents);
+	return box;
+}
+
+// --------------------------------------------------------
+// Pulls the planes out of the columns of the matrix
+// (Gribb & Hartmann), with D3D's 0-1 depth range
+// --------------------------------------------------------
+Frustum Bounds::FrustumFromViewProjection(const XMFLOAT4X4& m)
+{
+	XMVECTOR column1 = XMVectorSet(m._11, m._21, m._31, m._41);
+	XMVECTOR column2 = XMVectorSet(m._12, m._22, m._32, m._42);
+	XMVECTOR column3 = XMVectorSet(m._13, m._23, m._33, m._43);
+	XMVECTOR column4 = XMVectorSet(m._14, m._24, m._34, m._44);
+
+	Frustum frustum = {};
+	XMStoreFloat4(&frustum.planes[0], XMPlaneNormalize(column4 + column1)); // Left
+	XMStoreFloat4(&frustum.planes[1], XMPlaneNormalize(column4 - column1)); // Right
+	XMStoreFloat4(&frustum.planes[2], XMPlaneNormalize(column4 + column2)); // Bottom
+	XMStoreFloat4(&frustum.planes[3], XMPlaneNormalize(column4 - column2)); // Top
+	XMStoreFloat4(&frustum.planes[4], XMPlaneNormalize(column3));           // Near
+	XMStoreFloat4(&frustum.planes[5], XMPlaneNormalize(column4 - column3)); // Far
+	return frustum;
+}
+
+bool Bounds::Overlaps(const AABB& a, const AABB& b)
+{
+	return
+		a.minCorner.x <= b.maxCorner.x && a.maxCorner.x >= b.minCorner.x &&
+		a.minCorner.y <= b.maxCorner.y && a.maxCorner.y >= b.minCorner.y &&
+		a.minCorner.z <= b.maxCorner.z && a.maxCorner.z >= b.minCorner.z;
+}
+
+bool Bounds::Contains(const AABB& outer, const AABB& inner)
+{
+	return
+		inner.minCorner.x >= outer.minCorner.x && inner.maxCorner.x <= outer.maxCorner.x &&
+		inner.minCorner.y >= outer.minCorner.y && inner.maxCorner.y <= outer.maxCorner.y &&
+		inner.minCorner.z >= outer.minCorner.z && inner.maxCorner.z <= outer.maxCorner.z;
+}
+
+bool Bounds::OverlapsSphere(const AABB& box, const XMFLOAT3& center, float radius)
+{
+	// Distance from the center to the closest point in the box
+	XMVECTOR c = XMLoadFloat3(&center);
+	XMVECTOR closest = XMVectorMin(XMVectorMax(c, XMLoadFloat3(&box.minCorner)), XMLoadFloat3(&box.maxCorner));
+	return XMVectorGetX(XMVector3LengthSq(closest - c)) <= radius * radius;
+}
+
+// --------------------------------------------------------
+// Checks the corner of the box furthest along each plane's
+// normal; if even that's behind a plane, the box is out
+// --------------------------------------------------------
+bool Bounds::OverlapsFrustum(const AABB& box, const Frustum& frustum)
+{
+	for (int i = 0; i < 6; i++)
+	{
+		const XMFLOAT4& plane = frustum.planes[i];
+		float x = plane.x >= 0 ? box.maxCorner.x : box.minCorner.x;
+		float y = plane.y >= 0 ? box.maxCorner.y : box.minCorner.y;
+		float z = plane.z >= 0 ? box.maxCorner.z : box.minCorner.z;
+		if (plane.x * x + plane.y * y + plane.z * z + plane.w < 0)
+			return false;
+	}
+	return true;
+}
+
+bool Bounds::IntersectsRay(const AABB& box, const Ray& ray, float* distance)
+{
+	float tMin = 0.0f;
+	float tMax = ray.maxDistance;
+
+	const float* origin = &ray.origin.x;
+	const float* direction = &ray.direction.x;
+	const float* boxMin = &box.minCorner.x;
+	const float* boxMax = &box.maxCorner.x;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (direction[axis] == 0.0f)
+		{
+			// Parallel to this slab, so it has to start inside it
+			if (origin[axis] < boxMin[axis] || origin[axis] > boxMax[axis])
+				return false;
+			continue;
+		}
+
+		float inverse = 1.0f / direction[axis];
+		float t0 = (boxMin[axis] - origin[axis]) * inverse;
+		float t1 = (boxMax[axis] - origin[axis]) * inverse;
+		if (t0 > t1)
+		{
+			float temp = t0;
+			t0 = t1;
+			t1 = temp;
+		}
+
+		tMin = t0 > tMin ? t0 : tMin;
+		tMax = t1 < tMax ? t1 : tMax;
+		if (tMin > tMax)
+			return false;
+	}
+
+	if (distance)
+		*distance = tMin;
+	return true;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+// Simple bounding volumes and the overlap tests used by spatial queries
+// (culling, picking, "what's near here?")
+
+#include <DirectXMath.h>
+
+// Axis-aligned bounding box
+struct AABB
+{
+	DirectX::XMFLOAT3 minCorner;
+	DirectX::XMFLOAT3 maxCorner;
+};
+
+// A ray, only considered up to maxDistance along its direction
+struct Ray
+{
+	DirectX::XMFLOAT3 origin;
+	DirectX::XMFLOAT3 direction;	// Doesn't need to be normalized, but distances are measured in multiples of it
+	float maxDistance;
+};
+
+// Six planes (left, right, bottom, top, near, far) facing inwards,
+// so a point p is inside when dot(plane.xyz, p) + plane.w >= 0 for all of them
+struct Frustum
+{
+	DirectX::XMFLOAT4 planes[6];
+};
+
+namespace Bounds
+{
+	/// <summary>
+	/// A box containing nothing, ready to be expanded
+	/// </summary>
+	AABB Empty();
+	void Expand(AABB& box, const DirectX::XMFLOAT3& point);
+	bool IsEmpty(const AABB& box);
+
+	DirectX::XMFLOAT3 GetCenter(const AABB& box);
+	DirectX::XMFLOAT3 GetHalfExtents(const AABB& box);
+
+	/// <summary>
+	/// The box (in world space) around a local space box that's been transformed by a world matrix
+	/// </summary>
+	AABB Transform(const AABB& localBox, const DirectX::XMFLOAT4X4& worldMatrix);
+
+	/// <summary>
+	/// Builds a frustum from a combined view * projection matrix
+	/// </summary>
+	Frustum FrustumFromViewProjection(const DirectX::XMFLOAT4X4& viewProjection);
+
+	// Overlap tests (touching counts as overlapping)
+	bool Overlaps(const AABB& a, const AABB& b);
+	bool Contains(const AABB& outer, const AABB& inner);
+	bool OverlapsSphere(const AABB& box, const DirectX::XMFLOAT3& center, float radius);
+	bool OverlapsFrustum(const AABB& box, const Frustum& frustum); // Conservative: may say yes to boxes just outside a corner
+
+	/// <summary>
+	/// Slab test between a ray and a box
+	/// </summary>
+	/// <param name="distance">Where the ray enters the box (0 if it starts inside)</param>
+	/// <returns>True if the ray hits the box within its max distance</returns>
+	bool IntersectsRay(const AABB& box, const Ray& ray, float* distance);
+}
@@ -18,11 +18,20 @@ struct PixelShaderExternalData {
 	Light lights[5];
 };
 
+// Lights the raytracer samples directly (matches MAX_LIGHTS in Raytracing.hlsl)
+#define MAX_RAYTRACING_LIGHTS 5
+
 // Overall scene data for raytracing
 struct RaytracingSceneData
 {
 	DirectX::XMFLOAT4X4 inverseViewProjection;
 	DirectX::XMFLOAT3 cameraPosition;
+	unsigned int frameIndex;		// How many frames are already accumulated (0 = start over)
+	unsigned int samplesPerPixel;	// New samples per pixel this frame
+	DirectX::XMFLOAT3 pad;
+	Light lights[MAX_RAYTRACING_LIGHTS];
+	unsigned int lightCount;
+	DirectX::XMFLOAT3 pad1;
 };
 
 struct RaytracingMaterialData
@@ -34,10 +43,23 @@ struct RaytracingMaterialData
 	int metalIndex;
 };
 
-// Ensure this matches Raytracing shader define!
-#define MAX_INSTANCES_PER_BLAS 100
-struct RaytracingEntityData
+// Per-instance data for raytracing.  There is one of these for every
+// instance in the TLAS, stored in a single scene-wide structured buffer
+// and indexed by InstanceID() in the shaders.
+// Ensure this matches the Raytracing shader's InstanceData struct!
+struct RaytracingInstanceData
+{
+	DirectX::XMFLOAT4X4 worldInvTranspose;
+	RaytracingMaterialData materialData;
+};
+
+// What a pixel's primary ray found, as written by the CPU tracers for the
+// passes that follow them (resampling, denoising) - laid out to become a
+// structured buffer once those run on the GPU
+struct GBufferPixel
 {
-	DirectX::XMFLOAT4X4 worldInvTranspose[MAX_INSTANCES_PER_BLAS];
-	RaytracingMaterialData materialData[MAX_INSTANCES_PER_BLAS];
+	DirectX::XMFLOAT3 normal;		// World space, facing the camera
+	float distance;					// Along the ray from the camera (negative on a miss)
+	DirectX::XMFLOAT3 albedo;		// Surface's color
+	float padding;					// In order to make this a multiple of 16 bytes
 };
@@ -33,7 +33,21 @@ DirectX::XMFLOAT4X4 Camera::GetProjectionMatrix()
 	return projectionMatrix;
 }
 
-std::shared_ptr<Transform> Camera::GetTransform()
+DirectX::XMFLOAT4X4 Camera::GetViewMatrix(DirectX::XMFLOAT3 position, DirectX::XMFLOAT4 rotation)
+{
+	XMVECTOR forward = XMVector3Rotate(XMVectorSet(0, 0, 1, 0), XMLoadFloat4(&rotation));
+
+	XMFLOAT4X4 view;
+	if (leftHanded) {
+		XMStoreFloat4x4(&view, XMMatrixLookToLH(XMLoadFloat3(&position), forward, XMLoadFloat3(&worldUp)));
+	}
+	else {
+		XMStoreFloat4x4(&view, XMMatrixLookToRH(XMLoadFloat3(&position), forward, XMLoadFloat3(&worldUp)));
+	}
+	return view;
+}
+
+const std::shared_ptr<Transform>& Camera::GetTransform()
 {
 	return transform;
 }
@@ -45,38 +59,61 @@ bool Camera::IsLeftHanded()
 
 void Camera::Update(float dt)
 {
-	Input& input = Input::GetInstance();
+	Update(dt, ReadControls());
+}
+
+void Camera::Update(float dt, const CameraControls& controls)
+{
 	int sprintSpeed = 1;
 	int handedness = leftHanded ? 1 : -1;
 
 	// Keyboard data
-	if (input.KeyDown(VK_SHIFT)) { sprintSpeed = 2; }; // When shift is held down, forward/back speed is doubled
+	if (controls.sprint) { sprintSpeed = 2; }; // When shift is held down, forward/back speed is doubled
 
-	if (input.KeyDown('W')) { transform->LocalMoveBy(XMFLOAT3(0, 0, dt * moveSpeed * sprintSpeed)); }
-	if (input.KeyDown('S')) { transform->LocalMoveBy(XMFLOAT3(0, 0, -dt * moveSpeed * sprintSpeed)); }
-	if (input.KeyDown('A')) { transform->LocalMoveBy(XMFLOAT3(- dt * moveSpeed * handedness, 0, 0)); }
-	if (input.KeyDown('D')) { transform->LocalMoveBy(XMFLOAT3(dt * moveSpeed * handedness, 0, 0)); }
+	if (controls.forward) { transform->LocalMoveBy(XMFLOAT3(0, 0, dt * moveSpeed * sprintSpeed)); }
+	if (controls.back) { transform->LocalMoveBy(XMFLOAT3(0, 0, -dt * moveSpeed * sprintSpeed)); }
+	if (controls.left) { transform->LocalMoveBy(XMFLOAT3(- dt * moveSpeed * handedness, 0, 0)); }
+	if (controls.right) { transform->LocalMoveBy(XMFLOAT3(dt * moveSpeed * handedness, 0, 0)); }
 
-	if (input.KeyDown(VK_SPACE)) { transform->MoveBy(XMFLOAT3(0, dt * moveSpeed, 0)); }
-	if (input.KeyDown('X')) { transform->MoveBy(XMFLOAT3(0, -dt * moveSpeed, 0)); }
+	if (controls.up) { transform->MoveBy(XMFLOAT3(0, dt * moveSpeed, 0)); }
+	if (controls.down) { transform->MoveBy(XMFLOAT3(0, -dt * moveSpeed, 0)); }
 	
 	
 	// Mouse data
-	if (input.MouseLeftDown())
+	if (controls.looking)
 	{
-		int cursorMovementX = input.GetMouseXDelta();
-		int cursorMovementY = input.GetMouseYDelta();
-
 		float maxPitch = XM_PIDIV2 - FLT_EPSILON;
 		float minPitch = -XM_PIDIV2 + FLT_EPSILON;
-		transform->SetRotation(min(max(minPitch, transform->GetPitch() + cursorMovementY * mouseLookSpeed), maxPitch), transform->GetYaw() + cursorMovementX * mouseLookSpeed * handedness, 0);
+		transform->SetRotation(min(max(minPitch, transform->GetPitch() + controls.lookY * mouseLookSpeed), maxPitch), transform->GetYaw() + controls.lookX * mouseLookSpeed * handedness, 0);
 	}
 
-	if (input.KeyDown('P')) { transform->SetRotation(XMFLOAT3(0, 0, 0)); }
+	if (controls.reset) { transform->SetRotation(XMFLOAT3(0, 0, 0)); }
 
 	UpdateViewMatrix();
 }
 
+CameraControls Camera::ReadControls()
+{
+	Input& input = Input::GetInstance();
+
+	CameraControls controls = {};
+	controls.forward = input.KeyDown('W');
+	controls.back = input.KeyDown('S');
+	controls.left = input.KeyDown('A');
+	controls.right = input.KeyDown('D');
+	controls.up = input.KeyDown(VK_SPACE);
+	controls.down = input.KeyDown('X');
+	controls.sprint = input.KeyDown(VK_SHIFT);
+	controls.reset = input.KeyDown('P');
+	controls.looking = input.MouseLeftDown();
+	if (controls.looking)
+	{
+		controls.lookX = input.GetMouseXDelta();
+		controls.lookY = input.GetMouseYDelta();
+	}
+	return controls;
+}
+
 void Camera::UpdateProjectionMatrix(float aspectRatio)
 {
 	if (leftHanded) {
@@ -4,6 +4,23 @@
 #include <DirectXMath.h>
 #include <memory>
 
+// Everything the camera responds to, captured from the input manager
+// so the camera can be updated somewhere that can't touch input directly
+struct CameraControls
+{
+	bool forward;
+	bool back;
+	bool left;
+	bool right;
+	bool up;
+	bool down;
+	bool sprint;
+	bool reset;
+	bool looking;	// Is the mouse being used to look around?
+	int lookX;		// Mouse movement while looking
+	int lookY;
+};
+
 class Camera
 {
 public:
@@ -13,13 +30,17 @@ public:
 	// Getters
 	DirectX::XMFLOAT4X4 GetViewMatrix();
 	DirectX::XMFLOAT4X4 GetProjectionMatrix();
-	std::shared_ptr<Transform> GetTransform();
+	DirectX::XMFLOAT4X4 GetViewMatrix(DirectX::XMFLOAT3 position, DirectX::XMFLOAT4 rotation); // For a camera at some other position/rotation (doesn't touch the transform)
+	const std::shared_ptr<Transform>& GetTransform();
 	bool IsLeftHanded();
 
 	// Update functions
 	void Update(float dt);
+	void Update(float dt, const CameraControls& controls);
 	void UpdateProjectionMatrix(float aspectRatio);
 
+	static CameraControls ReadControls(); // Grabs the current state of the controls from the input manager
+
 private:
 	std::shared_ptr<Transform> transform;
 	DirectX::XMFLOAT4X4 viewMatrix;
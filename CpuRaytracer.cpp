@@ -0,0 +1,712 @@
+#include "CpuRaytracer.h"
+#include "JobSystem.h"
+#include "Material.h"
+#include "Mesh.h"
+#include "Sampler.h"
+
+#include <algorithm>
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+
+using namespace DirectX;
+
+namespace
+{
+	// Same as the shader's
+	XMVECTOR RandomCosineWeightedHemisphere(float u0, float u1, FXMVECTOR unitNormal)
+	{
+		float a = u0 * 2 - 1;
+		float b = sqrtf(1 - a * a);
+		float phi = 2.0f * XM_PI * u1;
+		return unitNormal + XMVectorSet(b * cosf(phi), b * sinf(phi), a, 0);
+	}
+
+	XMVECTOR RandomHemisphere(float u0, float u1, FXMVECTOR unitNormal)
+	{
+		float z = u0 * 2 - 1;
+		float r = sqrtf(fmaxf(0.0f, 1 - z * z));
+		float phi = 2.0f * XM_PI * u1;
+		XMVECTOR direction = XMVectorSet(r * cosf(phi), r * sinf(phi), z, 0);
+		return XMVectorGetX(XMVector3Dot(direction, unitNormal)) < 0 ? -direction : direction;
+	}
+
+	float PowerHeuristic(float pdf, float otherPdf)
+	{
+		return pdf * pdf / (pdf * pdf + otherPdf * otherPdf);
+	}
+
+	// Miss shader's sky
+	XMVECTOR SkyColor(FXMVECTOR direction)
+	{
+		XMVECTOR upColor = XMVectorSet(0.3f, 0.5f, 0.95f, 0);
+		XMVECTOR downColor = XMVectorSet(1, 1, 1, 0);
+		float interpolation = XMVectorGetY(XMVector3Normalize(direction)) * 0.5f + 0.5f;
+		return XMVectorLerp(downColor, upColor, interpolation);
+	}
+
+	unsigned int PackColor(XMFLOAT3 linear)
+	{
+		float channels[3] = { linear.x, linear.y, linear.z };
+		unsigned int packed = 0xFF000000;
+		for (int c = 0; c < 3; c++)
+		{
+			float gamma = powf(fminf(fmaxf(channels[c], 0.0f), 1.0f), 1.0f / 2.2f);
+			packed |= (unsigned int)(gamma * 255.0f + 0.5f) << (c * 8);
+		}
+		return packed;
+	}
+}
+
+CpuRaytracer::CpuRaytracer() :
+	width(0),
+	height(0),
+	samplesPerPixel(4),
+	seed(0),
+	tilesX(0),
+	tilesY(0),
+	raysTraced(0),
+	russianRoulette(true),
+	raysCast(0),
+	wavefront(false),
+	wavefrontStats{},
+	lights{},
+	lightCount(0),
+	scene(0),
+	inverseViewProjection(),
+	cameraPosition(),
+	frameIndex(0)
+{
+}
+
+
+void CpuRaytracer::Resize(unsigned int newWidth, unsigned int newHeight)
+{
+	width = newWidth;
+	height = newHeight;
+	accumulationBuffer.assign(width * height, XMFLOAT4(0, 0, 0, 0));
+	output.assign(width * height, 0);
+	frameRadiance.assign(width * height, XMFLOAT3(0, 0, 0));
+	gBuffer.assign(width * height, GBufferPixel{});
+	pixelVariance.assign(width * height, PixelVariance{});
+	rowSampleStart.assign(height, 0);
+
+	tilesX = (width + CPU_RAYTRACER_TILE_SIZE - 1) / CPU_RAYTRACER_TILE_SIZE;
+	tilesY = (height + CPU_RAYTRACER_TILE_SIZE - 1) / CPU_RAYTRACER_TILE_SIZE;
+	tiles.assign(tilesX * tilesY, SampleTile{});
+	tileSamples.assign(tilesX * tilesY, 0);
+	staleTiles.assign(tilesX * tilesY, true);
+	for (unsigned int ty = 0; ty < tilesY; ty++)
+	{
+		for (unsigned int tx = 0; tx < tilesX; tx++)
+		{
+			unsigned int tileWidth = width - tx * CPU_RAYTRACER_TILE_SIZE;
+			unsigned int tileHeight = height - ty * CPU_RAYTRACER_TILE_SIZE;
+			tileWidth = tileWidth < CPU_RAYTRACER_TILE_SIZE ? tileWidth : CPU_RAYTRACER_TILE_SIZE;
+			tileHeight = tileHeight < CPU_RAYTRACER_TILE_SIZE ? tileHeight : CPU_RAYTRACER_TILE_SIZE;
+			tiles[ty * tilesX + tx].pixelCount = tileWidth * tileHeight;
+		}
+	}
+
+	accumulation.Reset();
+}
+
+// --------------------------------------------------------
+// Brings the acceleration structures up to date, decides
+// whether to keep accumulating, then traces every row
+// --------------------------------------------------------
+bool CpuRaytracer::Render(
+	const SceneSnapshot& newScene,
+	XMFLOAT3 newCameraPosition,
+	const XMFLOAT4X4& view,
+	const XMFLOAT4X4& projection)
+{
+	if (width == 0 || height == 0)
+		return false;
+
+	// Anything that changed (even just a material) invalidates the accumulated image
+	TlasFrameChanges changes = sceneBVH.Update(newScene);
+	bool sceneChanged = changes.instancesMoved > 0 || changes.instancesReassigned > 0 || materials.size() != newScene.instances.size();
+	materials.resize(newScene.instances.size());
+	for (unsigned int i = 0; i < newScene.instances.size(); i++)
+	{
+		sceneChanged |= materials[i] != newScene.instances[i].material;
+		materials[i] = newScene.instances[i].material;
+	}
+
+	if (lightCount != newScene.lightCount || memcmp(lights, newScene.lights, sizeof(Light) * lightCount) != 0)
+	{
+		sceneChanged = true;
+		lightCount = newScene.lightCount;
+		memcpy(lights, newScene.lights, sizeof(Light) * lightCount);
+	}
+
+	if (sceneChanged)
+		accumulation.Reset();
+
+	if (!accumulation.BeginFrame(newCameraPosition, view, projection, &frameIndex))
+		return false;
+
+	scene = &newScene;
+	cameraPosition = newCameraPosition;
+	XMMATRIX viewProjection = XMMatrixMultiply(XMLoadFloat4x4(&view), XMLoadFloat4x4(&projection));
+	XMStoreFloat4x4(&inverseViewProjection, XMMatrixInverse(0, viewProjection));
+
+	AllocateSamples();
+	raysCast = 0;
+	if (wavefront)
+	{
+		RenderWavefront();
+	}
+	else
+	{
+		JobSystem::GetInstance().ParallelFor(height, 4,
+			[&](unsigned int start, unsigned int end)
+			{
+				RenderRows(start, end, false);
+			});
+	}
+
+	// Tiles span several rows, so they're only summed up once every row is done
+	JobSystem::GetInstance().ParallelFor(tilesY, 1,
+		[&](unsigned int start, unsigned int end)
+		{
+			UpdateTiles(start, end);
+		});
+
+	// Whatever was traced has started over now
+	for (unsigned int t = 0; t < tiles.size(); t++)
+		staleTiles[t] = staleTiles[t] && tileSamples[t] == 0;
+
+	scene = 0;
+	return true;
+}
+
+XMFLOAT3 CpuRaytracer::GetPixel(unsigned int x, unsigned int y) const
+{
+	const XMFLOAT4& sum = accumulationBuffer[y * width + x];
+	return sum.w > 0 ? XMFLOAT3(sum.x / sum.w, sum.y / sum.w, sum.z / sum.w) : XMFLOAT3(0, 0, 0);
+}
+
+const std::vector<XMFLOAT4>& CpuRaytracer::GetAccumulation() const
+{
+	return accumulationBuffer;
+}
+
+const std::vector<unsigned int>& CpuRaytracer::GetOutput() const
+{
+	return output;
+}
+
+const std::vector<XMFLOAT3>& CpuRaytracer::GetFrameRadiance() const
+{
+	return frameRadiance;
+}
+
+const std::vector<GBufferPixel>& CpuRaytracer::GetGBuffer() const
+{
+	return gBuffer;
+}
+
+AccumulationState& CpuRaytracer::GetAccumulationState()
+{
+	return accumulation;
+}
+
+unsigned int CpuRaytracer::GetSamplesPerPixel()
+{
+	return samplesPerPixel;
+}
+
+void CpuRaytracer::SetSamplesPerPixel(unsigned int samples)
+{
+	samplesPerPixel = samples < 1 ? 1 : samples;
+	accumulation.Reset(); // Keeps the sample numbering consistent
+}
+
+unsigned int CpuRaytracer::GetSeed()
+{
+	return seed;
+}
+
+void CpuRaytracer::SetSeed(unsigned int newSeed)
+{
+	seed = newSeed;
+	accumulation.Reset();
+}
+
+SampleBudgetAllocator& CpuRaytracer::GetSampleBudget()
+{
+	return sampleBudget;
+}
+
+unsigned int CpuRaytracer::GetRaysTraced()
+{
+	return raysTraced;
+}
+
+bool CpuRaytracer::GetRussianRoulette()
+{
+	return russianRoulette;
+}
+
+void CpuRaytracer::SetRussianRoulette(bool enabled)
+{
+	russianRoulette = enabled;
+}
+
+bool CpuRaytracer::GetWavefront()
+{
+	return wavefront;
+}
+
+void CpuRaytracer::SetWavefront(bool enabled)
+{
+	wavefront = enabled;
+}
+
+WavefrontStats CpuRaytracer::GetWavefrontStats()
+{
+	return wavefrontStats;
+}
+
+unsigned long long CpuRaytracer::GetRaysCast()
+{
+	return raysCast;
+}
+
+unsigned int CpuRaytracer::GetWidth() const
+{
+	return width;
+}
+
+unsigned int CpuRaytracer::GetHeight() const
+{
+	return height;
+}
+
+// --------------------------------------------------------
+// Same as the shader's, so intensities include the diffuse
+// 1/PI, as they do when rasterizing
+// --------------------------------------------------------
+XMVECTOR CpuRaytracer::IlluminationFromLight(const Light& light, FXMVECTOR position, XMVECTOR* directionToLight, float* distanceToLight)
+{
+	XMVECTOR color = XMLoadFloat3(&light.Color) * light.Intensity;
+	if (light.Type == LIGHT_TYPE_DIRECTIONAL)
+	{
+		*directionToLight = -XMVector3Normalize(XMLoadFloat3(&light.Direction));
+		*distanceToLight = 1000.0f;
+		return color;
+	}
+
+	XMVECTOR toLight = XMLoadFloat3(&light.Position) - position;
+	*distanceToLight = XMVectorGetX(XMVector3Length(toLight));
+	*directionToLight = toLight / XMVectorReplicate(*distanceToLight);
+
+	float falloff = fminf(fmaxf(1.0f - *distanceToLight * *distanceToLight / (light.Range * light.Range), 0.0f), 1.0f);
+	falloff *= falloff;
+	if (light.Type == LIGHT_TYPE_SPOT)
+	{
+		float spot = XMVectorGetX(XMVector3Dot(-*directionToLight, XMVector3Normalize(XMLoadFloat3(&light.Direction))));
+		falloff *= powf(fminf(fmaxf(spot, 0.0f), 1.0f), light.SpotFalloff);
+	}
+
+	return color * falloff;
+}
+
+
+// --------------------------------------------------------
+// Picks each tile's samples per pixel for this frame:
+// the same everywhere, or whatever the budget allows
+// --------------------------------------------------------
+void CpuRaytracer::AllocateSamples()
+{
+	// Starting over, so every tile is back to having nothing.  The
+	// budget covers a sample per pixel of as many tiles as it can
+	// before anything else, and the rest wait their turn (each
+	// keeping its old image until it gets one)
+	if (frameIndex == 0)
+	{
+		for (SampleTile& tile : tiles)
+		{
+			tile.samplesPerPixel = 0;
+			tile.error = 0;
+		}
+		std::fill(staleTiles.begin(), staleTiles.end(), true);
+	}
+
+	if (sampleBudget.GetSettings().raysPerFrame == 0)
+	{
+		std::fill(tileSamples.begin(), tileSamples.end(), samplesPerPixel);
+		raysTraced = width * height * samplesPerPixel;
+		return;
+	}
+
+	sampleBudget.Allocate(tiles.data(), (unsigned int)tiles.size(), tileSamples.data());
+	raysTraced = sampleBudget.GetStats().raysAllocated;
+}
+
+// --------------------------------------------------------
+// Hands the wavefront tracer bands of whole rows, each as
+// many as fit in its queues (but at least one), then adds
+// up each band's samples as RenderRows() would have traced
+// them
+// --------------------------------------------------------
+void CpuRaytracer::RenderWavefront()
+{
+	WavefrontFrame frame = {};
+	frame.scene = scene;
+	frame.sceneBVH = &sceneBVH;
+	frame.lights = lights;
+	frame.lightCount = lightCount;
+	frame.cameraPosition = cameraPosition;
+	frame.inverseViewProjection = inverseViewProjection;
+	frame.width = width;
+	frame.height = height;
+	frame.seed = seed;
+	frame.russianRoulette = russianRoulette;
+
+	wavefrontStats = {};
+	unsigned int startRow = 0;
+	while (startRow < height)
+	{
+		wavefrontSamples.clear();
+		unsigned int endRow = startRow;
+		for (; endRow < height; endRow++)
+		{
+			unsigned int rowSamples = 0;
+			for (unsigned int tx = 0; tx < tilesX; tx++)
+			{
+				unsigned int tileWidth = width - tx * CPU_RAYTRACER_TILE_SIZE;
+				tileWidth = tileWidth < CPU_RAYTRACER_TILE_SIZE ? tileWidth : CPU_RAYTRACER_TILE_SIZE;
+				rowSamples += tileSamples[(endRow / CPU_RAYTRACER_TILE_SIZE) * tilesX + tx] * tileWidth;
+			}
+
+			if (endRow > startRow && wavefrontSamples.size() + rowSamples > WAVEFRONT_MAX_SAMPLES)
+				break;
+
+			// Numbered on from what's accumulated, as RenderRows() does
+			rowSampleStart[endRow] = (unsigned int)wavefrontSamples.size();
+			for (unsigned int x = 0; x < width; x++)
+			{
+				unsigned int tileIndex = (endRow / CPU_RAYTRACER_TILE_SIZE) * tilesX + x / CPU_RAYTRACER_TILE_SIZE;
+				unsigned int samples = tileSamples[tileIndex];
+				unsigned int firstSample = staleTiles[tileIndex] ? 0 : (unsigned int)accumulationBuffer[endRow * width + x].w;
+				for (unsigned int r = 0; r < samples; r++)
+					wavefrontSamples.push_back({ x, endRow, firstSample + r });
+			}
+		}
+
+		wavefrontTracer.Trace(frame, wavefrontSamples.data(), (unsigned int)wavefrontSamples.size());
+		JobSystem::GetInstance().ParallelFor(endRow - startRow, 4,
+			[&](unsigned int start, unsigned int end)
+			{
+				RenderRows(startRow + start, startRow + end, true);
+			});
+
+		WavefrontStats stats = wavefrontTracer.GetStats();
+		wavefrontStats.paths += stats.paths;
+		wavefrontStats.bounces = stats.bounces > wavefrontStats.bounces ? stats.bounces : wavefrontStats.bounces;
+		wavefrontStats.pathRays += stats.pathRays;
+		wavefrontStats.shadowRays += stats.shadowRays;
+		wavefrontStats.lanesRun += stats.lanesRun;
+		raysCast += stats.pathRays + stats.shadowRays;
+		startRow = endRow;
+	}
+}
+
+// --------------------------------------------------------
+// RayGen for a range of rows: new samples are added to the
+// running sum and statistics (or replace them, the first
+// time a tile is traced after starting over).  Samples are numbered per pixel, so a pixel gets
+// the same sequence however they're spread over frames.
+// With traced set, the samples come from the wavefront
+// tracer's last band instead.
+// --------------------------------------------------------
+void CpuRaytracer::RenderRows(unsigned int startRow, unsigned int endRow, bool traced)
+{
+	unsigned int rowRaysCast = 0;
+	for (unsigned int y = startRow; y < endRow; y++)
+	{
+		unsigned int tracedSample = traced ? rowSampleStart[y] : 0;
+		for (unsigned int x = 0; x < width; x++)
+		{
+			unsigned int pixel = y * width + x;
+			XMFLOAT4& sum = accumulationBuffer[pixel];
+			PixelVariance& variance = pixelVariance[pixel];
+			unsigned int tileIndex = (y / CPU_RAYTRACER_TILE_SIZE) * tilesX + x / CPU_RAYTRACER_TILE_SIZE;
+			unsigned int samples = tileSamples[tileIndex];
+			if (staleTiles[tileIndex] && samples > 0)
+			{
+				sum = XMFLOAT4(0, 0, 0, 0);
+				variance = {};
+			}
+
+			unsigned int firstSample = (unsigned int)sum.w;
+			XMVECTOR totalColor = XMVectorZero();
+			XMVECTOR totalNormal = XMVectorZero();
+			XMVECTOR totalAlbedo = XMVectorZero();
+			float totalDistance = 0.0f;
+			unsigned int hits = 0;
+			for (unsigned int r = 0; r < samples; r++)
+			{
+				GBufferPixel primaryHit;
+				XMFLOAT3 sample;
+				if (traced)
+				{
+					sample = wavefrontTracer.GetRadiance()[tracedSample];
+					primaryHit = wavefrontTracer.GetPrimaryHits()[tracedSample];
+					tracedSample++;
+				}
+				else
+				{
+					sample = TraceSample(x, y, firstSample + r, &rowRaysCast, &primaryHit);
+				}
+				totalColor += XMLoadFloat3(&sample);
+				totalAlbedo += XMLoadFloat3(&primaryHit.albedo);
+				if (primaryHit.distance > 0.0f)
+				{
+					totalNormal += XMLoadFloat3(&primaryHit.normal);
+					totalDistance += primaryHit.distance;
+					hits++;
+				}
+
+				float luminance = 0.2126f * sample.x + 0.7152f * sample.y + 0.0722f * sample.z;
+				float delta = luminance - variance.mean;
+				variance.mean += delta / (firstSample + r + 1);
+				variance.squaredDifferences += delta * (luminance - variance.mean);
+			}
+
+			XMStoreFloat4(&sum, XMLoadFloat4(&sum) + XMVectorSetW(totalColor, (float)samples));
+			if (samples > 0)
+			{
+				// Features are averaged like the color, so a pixel on an edge
+				// gets a blend of both sides rather than just one of them
+				GBufferPixel& features = gBuffer[pixel];
+				XMStoreFloat3(&frameRadiance[pixel], totalColor / (float)samples);
+				XMStoreFloat3(&features.albedo, totalAlbedo / (float)samples);
+				XMStoreFloat3(&features.normal, hits > 0 ? XMVector3Normalize(totalNormal) : XMVectorZero());
+				features.distance = hits > 0 ? totalDistance / hits : -1.0f;
+				features.padding = 0;
+			}
+			else
+			{
+				frameRadiance[pixel] = GetPixel(x, y); // Converged (or stale), so this is as good as it gets
+			}
+			output[pixel] = PackColor(GetPixel(x, y));
+		}
+	}
+
+	raysCast += rowRaysCast;
+}
+
+// --------------------------------------------------------
+// Sums up each tile's pixels for the next allocation
+// --------------------------------------------------------
+void CpuRaytracer::UpdateTiles(unsigned int startTileRow, unsigned int endTileRow)
+{
+	for (unsigned int ty = startTileRow; ty < endTileRow; ty++)
+	{
+		for (unsigned int tx = 0; tx < tilesX; tx++)
+		{
+			// Nothing changed unless it was traced (a stale tile
+			// was already put back to nothing when it started over)
+			unsigned int tileIndex = ty * tilesX + tx;
+			if (tileSamples[tileIndex] == 0)
+				continue;
+
+			unsigned int fewestSamples = UINT_MAX;
+			float squaredErrors = 0;
+			unsigned int endX = (tx + 1) * CPU_RAYTRACER_TILE_SIZE;
+			unsigned int endY = (ty + 1) * CPU_RAYTRACER_TILE_SIZE;
+			endX = endX < width ? endX : width;
+			endY = endY < height ? endY : height;
+			for (unsigned int y = ty * CPU_RAYTRACER_TILE_SIZE; y < endY; y++)
+			{
+				for (unsigned int x = tx * CPU_RAYTRACER_TILE_SIZE; x < endX; x++)
+				{
+					unsigned int pixel = y * width + x;
+					unsigned int sampleCount = (unsigned int)accumulationBuffer[pixel].w;
+					float error = SampleBudgetAllocator::RelativeError(sampleCount, pixelVariance[pixel].mean, pixelVariance[pixel].squaredDifferences);
+					fewestSamples = sampleCount < fewestSamples ? sampleCount : fewestSamples;
+					squaredErrors += error * error;
+				}
+			}
+
+			SampleTile& tile = tiles[tileIndex];
+			tile.samplesPerPixel = fewestSamples;
+			tile.error = sqrtf(squaredErrors / tile.pixelCount);
+		}
+	}
+}
+
+// --------------------------------------------------------
+// A single path, bounced in a loop the same way RayGen
+// does: each diffuse surface samples a light (or the sky)
+// directly, and the sky a bounce finds is weighed against
+// the sky sample that could have found it too.  Also
+// records what the camera ray hit (albedo is white and
+// distance negative on a miss).
+// --------------------------------------------------------
+XMFLOAT3 CpuRaytracer::TraceSample(unsigned int x, unsigned int y, unsigned int sampleIndex, unsigned int* raysCast, GBufferPixel* primaryHit) const
+{
+	// Jittered ray through the pixel (CalcRayFromCamera)
+	unsigned int pixelSeed = Sampler::PixelSeed(x, y) ^ seed;
+	XMFLOAT2 jitter = Sampler::Sample2D(pixelSeed, sampleIndex, SAMPLER_DIMENSION_JITTER);
+	float screenX = (x + jitter.x) / width * 2.0f - 1.0f;
+	float screenY = -((y + jitter.y) / height * 2.0f - 1.0f);
+	XMVECTOR worldPosition = XMVector4Transform(XMVectorSet(screenX, screenY, 0, 1), XMLoadFloat4x4(&inverseViewProjection));
+	worldPosition /= XMVectorSplatW(worldPosition);
+
+	Ray ray = {};
+	ray.origin = cameraPosition;
+	XMStoreFloat3(&ray.direction, XMVector3Normalize(worldPosition - XMLoadFloat3(&cameraPosition)));
+	ray.maxDistance = PICK_MAX_DISTANCE;
+
+	XMVECTOR throughput = XMVectorSet(1, 1, 1, 0);
+	XMVECTOR totalColor = XMVectorZero();
+	XMFLOAT3 result;
+	float bouncePdf = 0;
+	float skyPdf = 1.0f / (2.0f * XM_PI * (lightCount + 1));
+	for (unsigned int depth = 0;; depth++)
+	{
+		PickResult hit = sceneBVH.Pick(ray);
+		(*raysCast)++;
+
+		XMVECTOR direction = XMLoadFloat3(&ray.direction);
+		if (!hit.hit)
+		{
+			if (depth == 0)
+			{
+				*primaryHit = {};
+				primaryHit->distance = -1.0f;
+				primaryHit->albedo = XMFLOAT3(1, 1, 1);
+			}
+
+			float weight = bouncePdf > 0 ? PowerHeuristic(bouncePdf, skyPdf) : 1.0f;
+			XMStoreFloat3(&result, totalColor + throughput * SkyColor(direction) * weight);
+			return result;
+		}
+
+		if (depth >= CPU_RAYTRACER_MAX_PATH_DEPTH)
+			break;
+
+		// Tint by the material, with the same "roughness" TlasInstancePacker gives each instance
+		const SnapshotInstance& instance = scene->instances[hit.instance];
+		XMFLOAT3 tint = instance.material ? instance.material->GetColorTint() : XMFLOAT3(1, 1, 1);
+		float roughness = (float)((hit.instance + 1) % 2);
+		throughput *= XMLoadFloat3(&tint);
+
+		XMFLOAT3 localNormal = instance.mesh->GetCpuBVH().InterpolateNormal(hit.triangle, hit.barycentrics);
+		XMVECTOR normal = XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&localNormal), XMLoadFloat4x4(&instance.worldInverseTransposeMatrix)));
+		if (XMVectorGetX(XMVector3Dot(normal, direction)) > 0)
+			normal = -normal;
+
+		if (depth == 0)
+		{
+			XMStoreFloat3(&primaryHit->normal, normal);
+			primaryHit->distance = hit.distance;
+			primaryHit->albedo = tint;
+			primaryHit->padding = 0;
+		}
+
+		bool diffuseSurface = roughness >= 1.0f;
+		if (diffuseSurface)
+			totalColor += throughput * DirectLight(hit.position, normal, pixelSeed, sampleIndex, depth, raysCast);
+
+		XMVECTOR reflection = XMVector3Reflect(direction, normal);
+
+		XMFLOAT2 bounce = Sampler::Sample2D(pixelSeed, sampleIndex, SAMPLER_DIMENSION_BOUNCE_DIRECTION(depth));
+		XMVECTOR diffuse = RandomCosineWeightedHemisphere(bounce.x, bounce.y, normal);
+
+		// Russian roulette - dim paths probably end here, and the
+		// survivors are brightened to make up for those that did
+		if (russianRoulette && depth >= CPU_RAYTRACER_ROULETTE_MIN_DEPTH)
+		{
+			XMFLOAT3 t;
+			XMStoreFloat3(&t, throughput);
+			float survival = fminf(fmaxf(t.x, fmaxf(t.y, t.z)), CPU_RAYTRACER_ROULETTE_MAX_SURVIVAL);
+			if (Sampler::Sample1D(pixelSeed, sampleIndex, SAMPLER_DIMENSION_ROULETTE(depth)) >= survival)
+				break;
+
+			throughput /= XMVectorReplicate(survival);
+		}
+
+		ray.origin = hit.position;
+		XMStoreFloat3(&ray.direction, XMVector3Normalize(XMVectorLerp(reflection, diffuse, roughness)));
+		ray.maxDistance = PICK_MAX_DISTANCE;
+		bouncePdf = diffuseSurface ? fmaxf(XMVectorGetX(XMVector3Dot(normal, XMLoadFloat3(&ray.direction))), 0.0f) / XM_PI : 0;
+	}
+
+	XMStoreFloat3(&result, totalColor);
+	return result;
+}
+
+// --------------------------------------------------------
+// Next event estimation, as DirectLight() in the shader:
+// one light (or the sky) chosen at random, with a shadow
+// ray to see whether anything's in the way
+// --------------------------------------------------------
+XMVECTOR CpuRaytracer::DirectLight(XMFLOAT3 position, FXMVECTOR normal, unsigned int pixelSeed, unsigned int sampleIndex, unsigned int depth, unsigned int* raysCast) const
+{
+	Ray shadowRay;
+	XMVECTOR light;
+	if (!SampleDirectLight(lights, lightCount, position, normal, pixelSeed, sampleIndex, depth, &shadowRay, &light))
+		return XMVectorZero();
+
+	(*raysCast)++;
+	return sceneBVH.IsOccluded(shadowRay) ? XMVectorZero() : light;
+}
+
+// --------------------------------------------------------
+// Lights are points, so a bounce can never find them and
+// their sample needs no weighing; the sky is weighed
+// against the bounce
+// --------------------------------------------------------
+bool CpuRaytracer::SampleDirectLight(
+	const Light* lights,
+	unsigned int lightCount,
+	XMFLOAT3 position,
+	FXMVECTOR normal,
+	unsigned int pixelSeed,
+	unsigned int sampleIndex,
+	unsigned int depth,
+	Ray* shadowRay,
+	XMVECTOR* light)
+{
+	unsigned int lightChoices = lightCount + 1;
+	float skyPdf = 1.0f / (2.0f * XM_PI * lightChoices);
+	unsigned int choice = (unsigned int)(Sampler::Sample1D(pixelSeed, sampleIndex, SAMPLER_DIMENSION_LIGHT_CHOICE(depth)) * lightChoices);
+	choice = choice < lightChoices - 1 ? choice : lightChoices - 1;
+
+	*shadowRay = {};
+	shadowRay->origin = position;
+
+	if (choice < lightCount)
+	{
+		XMVECTOR directionToLight;
+		float distanceToLight;
+		XMVECTOR illumination = IlluminationFromLight(lights[choice], XMLoadFloat3(&position), &directionToLight, &distanceToLight);
+		float cosine = XMVectorGetX(XMVector3Dot(normal, directionToLight));
+		if (cosine <= 0 || XMVector3LessOrEqual(illumination, XMVectorZero()))
+			return false;
+
+		XMStoreFloat3(&shadowRay->direction, directionToLight);
+		shadowRay->maxDistance = distanceToLight * 0.999f;
+		*light = illumination * (cosine * lightChoices);
+		return true;
+	}
+
+	XMFLOAT2 u = Sampler::Sample2D(pixelSeed, sampleIndex, SAMPLER_DIMENSION_LIGHT_SAMPLE(depth));
+	XMVECTOR direction = RandomHemisphere(u.x, u.y, normal);
+	float cosine = XMVectorGetX(XMVector3Dot(normal, direction));
+	if (cosine <= 0)
+		return false;
+
+	XMStoreFloat3(&shadowRay->direction, direction);
+	shadowRay->maxDistance = PICK_MAX_DISTANCE;
+
+	float bouncePdf = cosine / XM_PI;
+	*light = SkyColor(direction) * (bouncePdf / skyPdf * PowerHeuristic(skyPdf, bouncePdf));
+	return true;
+}
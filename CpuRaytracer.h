@@ -0,0 +1,213 @@
+#pragma once
+
+// A CPU version of the raytracing shaders in Raytracing.hlsl, tracing the
+// same scene through a ScenePicker (TLAS) and each mesh's MeshBVH (BLAS)
+// rather than DXR.  It follows RayGen, Miss and ClosestHit step by step,
+// random numbers included (both use Sampler.h), and accumulates under the
+// same AccumulationState rules as the GPU, so it's a reference the GPU
+// output can be compared against - statistically, not bit for bit, since
+// the GPU's floating point math isn't the CPU's.
+//
+// Rows are spread across the job system.  Every sample depends only on
+// its pixel and sample index, so images don't depend on the thread count.
+//
+// Every diffuse surface a path reaches also samples one of the scene's
+// lights or the sky directly (next event estimation), with the sky's
+// samples weighed against the bounces that find it (MIS), as on the GPU.
+//
+// Each pixel also keeps a running mean and variance of its luminance
+// (Welford's method).  Given a rays-per-frame budget, a
+// SampleBudgetAllocator uses those to give noisy tiles more samples and
+// stop tracing tiles that have converged; without one every pixel gets
+// samplesPerPixel each frame, exactly like the GPU.
+//
+// For passes that work on single frames (denoising), each frame's samples
+// are also kept on their own, along with the average of what its camera
+// rays hit (a G-buffer).
+//
+// Paths can also be traced a bounce at a time through a WavefrontTracer
+// (see WavefrontTracer.h), a band of rows at a time, instead of one after
+// another - the same samples, with the shading math run across SIMD lanes.
+
+#include <DirectXMath.h>
+#include <atomic>
+#include <vector>
+
+#include "AccumulationState.h"
+#include "BufferStructs.h"
+#include "SampleBudgetAllocator.h"
+#include "SceneSnapshot.h"
+#include "ScenePicker.h"
+#include "WavefrontTracer.h"
+
+// Match MAX_PATH_DEPTH, ROULETTE_MIN_DEPTH and ROULETTE_MAX_SURVIVAL in Raytracing.hlsl
+#define CPU_RAYTRACER_MAX_PATH_DEPTH 10
+#define CPU_RAYTRACER_ROULETTE_MIN_DEPTH 3
+#define CPU_RAYTRACER_ROULETTE_MAX_SURVIVAL 0.95f
+
+// Width and height of the tiles adaptive sampling allocates samples to
+#define CPU_RAYTRACER_TILE_SIZE 8
+
+class CpuRaytracer
+{
+public:
+	CpuRaytracer();
+
+	/// <summary>
+	/// Resizes the output (which starts the accumulated image over)
+	/// </summary>
+	void Resize(unsigned int width, unsigned int height);
+
+	/// <summary>
+	/// Traces one frame: adds samples to every pixel (or starts over if the
+	/// camera or scene changed) and updates the output
+	/// </summary>
+	/// <param name="scene">What to trace - must stay alive and unchanged during the call</param>
+	/// <param name="cameraPosition">Where the camera is</param>
+	/// <param name="view">Camera's view matrix</param>
+	/// <param name="projection">Camera's projection matrix</param>
+	/// <returns>False if the image had already converged, so nothing was traced</returns>
+	bool Render(
+		const SceneSnapshot& scene,
+		DirectX::XMFLOAT3 cameraPosition,
+		const DirectX::XMFLOAT4X4& view,
+		const DirectX::XMFLOAT4X4& projection);
+
+	/// <summary>
+	/// The average of every sample accumulated for a pixel, in linear color
+	/// </summary>
+	DirectX::XMFLOAT3 GetPixel(unsigned int x, unsigned int y) const;
+
+	// Linear running sums (rgb) and sample counts (a), like the GPU's accumulation buffer
+	const std::vector<DirectX::XMFLOAT4>& GetAccumulation() const;
+
+	// Gamma corrected RGBA8 (red in the lowest byte), like the GPU's output texture
+	const std::vector<unsigned int>& GetOutput() const;
+
+	// Average of only the last Render()'s samples (or everything, where adaptive
+	// sampling skipped a pixel), and of what their camera rays hit
+	const std::vector<DirectX::XMFLOAT3>& GetFrameRadiance() const;
+	const std::vector<GBufferPixel>& GetGBuffer() const;
+
+	AccumulationState& GetAccumulationState();
+	unsigned int GetSamplesPerPixel();
+	void SetSamplesPerPixel(unsigned int samples);
+
+	// Changes every pixel's random numbers (0, the default, matches the GPU)
+	unsigned int GetSeed();
+	void SetSeed(unsigned int newSeed);
+
+	// Adaptive sampling (set its raysPerFrame to turn it on)
+	SampleBudgetAllocator& GetSampleBudget();
+	unsigned int GetRaysTraced();		// Camera rays traced by the last Render()
+
+	// Ending dim paths early (on by default, like the GPU)
+	bool GetRussianRoulette();
+	void SetRussianRoulette(bool enabled);
+
+	// Tracing a bounce of every path at a time (off by default, so each path runs start to finish like the GPU's)
+	bool GetWavefront();
+	void SetWavefront(bool enabled);
+	WavefrontStats GetWavefrontStats();	// Summed over the last Render()'s bands
+	unsigned long long GetRaysCast();	// Every ray cast by the last Render(), bounces included
+	unsigned int GetWidth() const;
+	unsigned int GetHeight() const;
+
+	/// <summary>
+	/// How much of a light reaches a point (before the surface's cosine), exactly as IlluminationFromLight() in Raytracing.hlsl
+	/// </summary>
+	/// <param name="light">Light to evaluate</param>
+	/// <param name="position">World space point being lit</param>
+	/// <param name="directionToLight">Set to the unit direction from the point toward the light</param>
+	/// <param name="distanceToLight">Set to how far away the light is (far past the scene, for directional lights)</param>
+	static DirectX::XMVECTOR IlluminationFromLight(const Light& light, DirectX::FXMVECTOR position, DirectX::XMVECTOR* directionToLight, float* distanceToLight);
+
+	/// <summary>
+	/// Next event estimation up to its shadow ray, exactly as DirectLight() in Raytracing.hlsl: picks a light
+	/// (or the sky) and works out what it adds if the shadow ray gets through
+	/// </summary>
+	/// <param name="lights">Lights to choose from (the sky is one more choice)</param>
+	/// <param name="lightCount">How many lights there are</param>
+	/// <param name="position">World space point being lit</param>
+	/// <param name="normal">Unit normal there, facing the way the path came from</param>
+	/// <param name="pixelSeed">Pixel's random seed (its seed from Sampler.h, mixed with the tracer's own)</param>
+	/// <param name="sampleIndex">Which of the pixel's samples this is</param>
+	/// <param name="depth">Which bounce of the path this is (0 at the camera ray's hit)</param>
+	/// <param name="shadowRay">Set to the ray to trace toward the light</param>
+	/// <param name="light">Set to what the light adds if nothing's in the way</param>
+	/// <returns>False if the light can't add anything, so there's no ray to trace</returns>
+	static bool SampleDirectLight(
+		const Light* lights,
+		unsigned int lightCount,
+		DirectX::XMFLOAT3 position,
+		DirectX::FXMVECTOR normal,
+		unsigned int pixelSeed,
+		unsigned int sampleIndex,
+		unsigned int depth,
+		Ray* shadowRay,
+		DirectX::XMVECTOR* light);
+
+private:
+	unsigned int width;
+	unsigned int height;
+	unsigned int samplesPerPixel;
+	unsigned int seed;
+
+	std::vector<DirectX::XMFLOAT4> accumulationBuffer;
+	std::vector<unsigned int> output;
+	std::vector<DirectX::XMFLOAT3> frameRadiance;
+	std::vector<GBufferPixel> gBuffer;
+	AccumulationState accumulation;
+
+	// Welford running statistics of each pixel's luminance (the sample count is in the accumulation)
+	struct PixelVariance
+	{
+		float mean;
+		float squaredDifferences;
+	};
+	std::vector<PixelVariance> pixelVariance;
+
+	// Adaptive sampling, a tile at a time
+	SampleBudgetAllocator sampleBudget;
+	unsigned int tilesX;
+	unsigned int tilesY;
+	std::vector<SampleTile> tiles;
+	std::vector<unsigned int> tileSamples;
+	unsigned int raysTraced;
+
+	// Tiles that started over but haven't had a sample since, so
+	// they keep showing the old image rather than going black
+	std::vector<bool> staleTiles;
+
+	bool russianRoulette;
+	std::atomic<unsigned long long> raysCast;
+
+	// Wavefront tracing, and where each row's samples start in the band being traced
+	bool wavefront;
+	WavefrontTracer wavefrontTracer;
+	WavefrontStats wavefrontStats;
+	std::vector<WavefrontSample> wavefrontSamples;
+	std::vector<unsigned int> rowSampleStart;
+
+	// The scene's lights as of the last frame (light changes reset too)
+	Light lights[SNAPSHOT_MAX_LIGHTS];
+	unsigned int lightCount;
+
+	// CPU copy of the scene's acceleration structures, and the
+	// materials each instance had (material changes reset too)
+	ScenePicker sceneBVH;
+	std::vector<Material*> materials;
+
+	// Set up for the frame being rendered (read-only while the rows are traced)
+	const SceneSnapshot* scene;
+	DirectX::XMFLOAT4X4 inverseViewProjection;
+	DirectX::XMFLOAT3 cameraPosition;
+	unsigned int frameIndex;
+
+	void AllocateSamples();
+	void RenderWavefront();
+	void RenderRows(unsigned int startRow, unsigned int endRow, bool traced);
+	void UpdateTiles(unsigned int startTileRow, unsigned int endTileRow);
+	DirectX::XMFLOAT3 TraceSample(unsigned int x, unsigned int y, unsigned int sampleIndex, unsigned int* raysCast, GBufferPixel* primaryHit) const;
+	DirectX::XMVECTOR DirectLight(DirectX::XMFLOAT3 position, DirectX::FXMVECTOR normal, unsigned int pixelSeed, unsigned int sampleIndex, unsigned int depth, unsigned int* raysCast) const;
+};
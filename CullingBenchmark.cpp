@@ -0,0 +1,69 @@
+#include "CullingBenchmark.h"
+#include "BenchmarkUtils.h"
+#include "VisibilityCuller.h"
+
+#include <random>
+#include <stdio.h>
+#include <vector>
+
+using namespace DirectX;
+using namespace BenchmarkUtils;
+
+bool CullingBenchmark::Run()
+{
+	bool passed = true;
+	passed &= Run(10000, 100);
+	passed &= Run(100000, 20);
+	passed &= Run(1000000, 5);
+	return passed;
+}
+
+// --------------------------------------------------------
+// Scatters boxes all around a camera at the origin looking
+// down +Z, then culls them in batches and one at a time
+// --------------------------------------------------------
+bool CullingBenchmark::Run(unsigned int boxCount, unsigned int repeats)
+{
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> position(-60.0f, 60.0f);
+	std::uniform_real_distribution<float> size(0.1f, 1.0f);
+
+	std::vector<AABB> boxes(boxCount);
+	for (AABB& box : boxes)
+	{
+		XMFLOAT3 center(position(random), position(random) * 0.5f, position(random));
+		float halfExtent = size(random);
+		box.minCorner = XMFLOAT3(center.x - halfExtent, center.y - halfExtent, center.z - halfExtent);
+		box.maxCorner = XMFLOAT3(center.x + halfExtent, center.y + halfExtent, center.z + halfExtent);
+	}
+
+	XMFLOAT4X4 viewProjection;
+	XMMATRIX vp = XMMatrixMultiply(
+		XMMatrixLookToLH(XMVectorSet(0, 0, 0, 1), XMVectorSet(0, 0, 1, 0), XMVectorSet(0, 1, 0, 0)),
+		XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, 100.0f));
+	XMStoreFloat4x4(&viewProjection, vp);
+
+	VisibilityCuller culler;
+	culler.SetBounds(boxes.data(), boxCount);
+	printf("Culling benchmark: %u boxes\n", boxCount);
+
+	// Batched vs one at a time
+	std::vector<unsigned int> visible;
+	std::vector<unsigned int> reference;
+	Clock::time_point start = Clock::now();
+	for (unsigned int r = 0; r < repeats; r++)
+		culler.Cull(viewProjection, visible);
+	double batchedMs = MillisecondsSince(start) / repeats;
+
+	start = Clock::now();
+	for (unsigned int r = 0; r < repeats; r++)
+		culler.CullFrustumReference(viewProjection, reference);
+	double referenceMs = MillisecondsSince(start) / repeats;
+
+	// Batching has to find exactly the same boxes, and sooner
+	bool passed = visible == reference && batchedMs < referenceMs;
+	printf("  frustum   batched %8.3f ms   one at a time %8.3f ms   (%5.1fx)   visible %u%s   %s\n",
+		batchedMs, referenceMs, referenceMs / (batchedMs > 0.001 ? batchedMs : 0.001), culler.GetStats().visible,
+		visible == reference ? "" : "   MISMATCH!", Verdict(passed));
+	return passed;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+// Times the VisibilityCuller on randomly generated scenes and checks its
+// results: the batched frustum test has to match the one-box-at-a-time
+// version exactly.  Start the program with -benchmark to run it (see
+// HeadlessTests.h); it fails if the two disagree, or batching isn't faster.
+
+namespace CullingBenchmark
+{
+	/// <summary>
+	/// Runs the benchmark at 10k, 100k and 1M boxes
+	/// </summary>
+	/// <returns>Whether every batched cull matched culling one box at a time, and beat it</returns>
+	bool Run();
+
+	/// <summary>
+	/// Runs the benchmark for a single scene size
+	/// </summary>
+	/// <param name="boxCount">How many boxes to scatter in front of the camera</param>
+	/// <param name="repeats">How many times to cull the scene (times are averaged)</param>
+	/// <returns>Whether the batched cull matched culling one box at a time, and beat it</returns>
+	bool Run(unsigned int boxCount, unsigned int repeats);
+}
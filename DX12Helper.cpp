@@ -9,6 +9,47 @@ using namespace DirectX;
 // Singleton requirement
 DX12Helper* DX12Helper::instance;
 
+// --------------------------------------------------------
+// Tiny COM object that is attached to a tracked resource as
+// private data.  D3D12 releases private data interfaces when
+// the resource itself is destroyed, which is our cue to
+// release the matching entry in the GPU memory registry.
+// --------------------------------------------------------
+class GpuMemoryReleaseNotifier : public IUnknown
+{
+public:
+	GpuMemoryReleaseNotifier(uint64_t allocationID) : allocationID(allocationID), refCount(1) {}
+
+	HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** object) override
+	{
+		if (!object) return E_POINTER;
+		if (riid == __uuidof(IUnknown)) { *object = this; AddRef(); return S_OK; }
+		*object = 0;
+		return E_NOINTERFACE;
+	}
+
+	ULONG STDMETHODCALLTYPE AddRef() override { return InterlockedIncrement(&refCount); }
+
+	ULONG STDMETHODCALLTYPE Release() override
+	{
+		ULONG count = InterlockedDecrement(&refCount);
+		if (count == 0)
+		{
+			GpuMemoryRegistry::GetInstance().ReleaseAllocation(allocationID);
+			delete this;
+		}
+		return count;
+	}
+
+private:
+	uint64_t allocationID;
+	ULONG refCount;
+};
+
+// Private data slot used for the notifier above {5B7A1E0C-3D2F-4C8B-9E61-2A4F0D7C9B13}
+static const GUID GpuMemoryReleaseNotifierGUID =
+	{ 0x5b7a1e0c, 0x3d2f, 0x4c8b, { 0x9e, 0x61, 0x2a, 0x4f, 0x0d, 0x7c, 0x9b, 0x13 } };
+
 DX12Helper::~DX12Helper()
 {
 
@@ -34,10 +75,36 @@ void DX12Helper::Initialize(
 	waitFenceEvent = CreateEventEx(0, 0, 0, EVENT_ALL_ACCESS);
 	waitFenceCounter = 0;
 
+	// No CPU-side staging blocks yet; the first allocation will create one
+	cpuSideDescriptorBlockCapacity = 0;
+	cpuSideDescriptorBlockOffset = 0;
+
 	CreateConstantBufferUploadHeap();
 	CreateCBVSRVDescriptorHeap();
 }
 
+// --------------------------------------------------------
+// Registers a resource with the GPU memory registry, using
+// the device's idea of how much memory it actually takes up
+// (including alignment/padding).  The registry entry lives
+// exactly as long as the resource does.
+// --------------------------------------------------------
+void DX12Helper::TrackResource(ID3D12Resource* resource, GpuMemoryCategory category, const char* debugName)
+{
+	if (!resource)
+		return;
+
+	D3D12_RESOURCE_DESC desc = resource->GetDesc();
+	D3D12_RESOURCE_ALLOCATION_INFO info = device->GetResourceAllocationInfo(0, 1, &desc);
+
+	uint64_t id = GpuMemoryRegistry::GetInstance().RegisterAllocation(category, info.SizeInBytes, debugName);
+
+	// Hand ownership of the notifier to the resource
+	GpuMemoryReleaseNotifier* notifier = new GpuMemoryReleaseNotifier(id);
+	resource->SetPrivateDataInterface(GpuMemoryReleaseNotifierGUID, notifier);
+	notifier->Release();
+}
+
 // --------------------------------------------------------
 // Closes the current command list and tells the GPU to start executing those commands.  
 // We also wait for the GPU to finish this work so we can reset the command allocator 
@@ -157,9 +224,10 @@ D3D12_GPU_DESCRIPTOR_HANDLE DX12Helper::FillNextConstantBufferAndGetGPUDescripto
 // dataStride - The size of one piece of data in the buffer (like a vertex)
 // dataCount - How many pieces of data (like how many vertices)
 // data - Pointer to the data itself
+// category - What the buffer is used for (for memory tracking)
 // --------------------------------------------------------
 Microsoft::WRL::ComPtr<ID3D12Resource> DX12Helper::CreateStaticBuffer(
-	unsigned int dataStride, unsigned int dataCount, void* data)
+	unsigned int dataStride, unsigned int dataCount, void* data, GpuMemoryCategory category)
 {
 	// The overall buffer we'll be creating
 	Microsoft::WRL::ComPtr<ID3D12Resource> buffer;
@@ -192,6 +260,7 @@ Microsoft::WRL::ComPtr<ID3D12Resource> DX12Helper::CreateStaticBuffer(
 		D3D12_RESOURCE_STATE_COPY_DEST, // Will eventually be "common", but we're copying first
 		0,
 		IID_PPV_ARGS(buffer.GetAddressOf()));
+	TrackResource(buffer.Get(), category, "Static buffer");
 
 	// Now create an intermediate upload heap for copying initial data
 	D3D12_HEAP_PROPERTIES uploadProps = {};
@@ -209,6 +278,7 @@ Microsoft::WRL::ComPtr<ID3D12Resource> DX12Helper::CreateStaticBuffer(
 		D3D12_RESOURCE_STATE_GENERIC_READ,
 		0,
 		IID_PPV_ARGS(uploadHeap.GetAddressOf()));
+	TrackResource(uploadHeap.Get(), GpuMemoryCategory::UploadStaging, "Static buffer upload heap");
 
 	// Do a straight map/memcpy/unmap
 	void* gpuAddress = 0;
@@ -281,6 +351,7 @@ void DX12Helper::CreateConstantBufferUploadHeap()
 		D3D12_RESOURCE_STATE_GENERIC_READ,
 		0,
 		IID_PPV_ARGS(cbUploadHeap.GetAddressOf()));
+	TrackResource(cbUploadHeap.Get(), GpuMemoryCategory::ConstantBufferUpload, "Constant buffer upload heap");
 
 	// Keep mapped!
 	D3D12_RANGE range{ 0, 0 };
@@ -325,31 +396,19 @@ D3D12_CPU_DESCRIPTOR_HANDLE DX12Helper::LoadTexture(const wchar_t* file, bool ge
 	// Attempt to create the texture
 	Microsoft::WRL::ComPtr<ID3D12Resource> texture;
 	CreateWICTextureFromFile(device.Get(), upload, file, texture.GetAddressOf(), generateMips);
+	TrackResource(texture.Get(), GpuMemoryCategory::Texture, "Texture");
 
 	// Perform the upload and wait for it to finish before returning the texture
 	auto finish = upload.End(commandQueue.Get());
 	finish.wait();
 
-	// Now that we have the texture, add to our list and make a CPU-side descriptor heap
-	// just for this texture's SRV.  Note that it would probably be better to put all 
-	// texture SRVs into the same descriptor heap, but we don't know how many we'll need
-	// until they're all loaded and this is a quick and dirty implementation!
+	// Now that we have the texture, add to our list and grab a slot for its SRV
+	// in the CPU-side staging arena (which is shared by all textures)
 	textures.push_back(texture);
+	D3D12_CPU_DESCRIPTOR_HANDLE cpuHandle = AllocateCPUSideDescriptors(1);
 
-	// Create the CPU-SIDE descriptor heap for our descriptor ("baby heap")
-	D3D12_DESCRIPTOR_HEAP_DESC dhDesc = {};
-	dhDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE; // Make it not shader visible; it's a CPU-side-only desc heap
-	dhDesc.NodeMask = 0;
-	dhDesc.NumDescriptors = 1;
-	dhDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-
-	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> descHeap;
-	device->CreateDescriptorHeap(&dhDesc, IID_PPV_ARGS(descHeap.GetAddressOf()));
-	cpuSideTextureDescriptorHeaps.push_back(descHeap);
-
-	// Create the SRV on this descriptor heap
+	// Create the SRV in the staging arena
 	// Note: Using a null description results in the "default" SRV (same format, all mips, all array slices, etc.)
-	D3D12_CPU_DESCRIPTOR_HANDLE cpuHandle = descHeap->GetCPUDescriptorHandleForHeapStart();
 	device->CreateShaderResourceView(texture.Get(), 0, cpuHandle);
 
 	// Return the CPU descriptor handle, which can be used to
@@ -383,6 +442,75 @@ D3D12_GPU_DESCRIPTOR_HANDLE DX12Helper::CopySRVsToDescriptorHeapAndGetGPUDescrip
 
 }
 
+// --------------------------------------------------------
+// Gathers several CPU-side descriptors, which don't need to be
+// next to each other (or even in the same staging block), into
+// one contiguous table in the shader-visible heap.  This is done
+// with a single CopyDescriptors() call rather than one copy per
+// descriptor.
+//
+// descriptorsToCopy    - Array of CPU handles, in table order
+// numDescriptorsToCopy - How many handles are in the array
+// --------------------------------------------------------
+D3D12_GPU_DESCRIPTOR_HANDLE DX12Helper::CopySRVsToDescriptorHeapAndGetGPUDescriptorHandle(const D3D12_CPU_DESCRIPTOR_HANDLE* descriptorsToCopy, unsigned int numDescriptorsToCopy)
+{
+	// Grab the actual heap start on both sides and offset to the next open SRV portion
+	D3D12_CPU_DESCRIPTOR_HANDLE cpuHandle =
+		cbvSrvDescriptorHeap->GetCPUDescriptorHandleForHeapStart();
+	D3D12_GPU_DESCRIPTOR_HANDLE gpuHandle =
+		cbvSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart();
+
+	cpuHandle.ptr += (SIZE_T)srvDescriptorOffset * cbvSrvDescriptorHeapIncrementSize;
+	gpuHandle.ptr += (SIZE_T)srvDescriptorOffset * cbvSrvDescriptorHeapIncrementSize;
+
+	// One destination range covering the whole table, and one single-descriptor
+	// source range per handle (the sources may live anywhere in the staging arena)
+	std::vector<UINT> sourceRangeSizes(numDescriptorsToCopy, 1);
+	device->CopyDescriptors(
+		1, &cpuHandle, &numDescriptorsToCopy,
+		numDescriptorsToCopy, descriptorsToCopy, sourceRangeSizes.data(),
+		D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+	srvDescriptorOffset += numDescriptorsToCopy;
+
+	return gpuHandle;
+}
+
+// --------------------------------------------------------
+// Hands out a contiguous range of descriptors from the
+// CPU-side staging arena.  Blocks are never freed or
+// compacted; when the current block can't fit the request
+// a new one is created and becomes the current block.
+//
+// numDescriptors - How many contiguous descriptors are needed
+// --------------------------------------------------------
+D3D12_CPU_DESCRIPTOR_HANDLE DX12Helper::AllocateCPUSideDescriptors(unsigned int numDescriptors)
+{
+	// Do we need a new block?
+	if (cpuSideDescriptorBlocks.empty() || cpuSideDescriptorBlockOffset + numDescriptors > cpuSideDescriptorBlockCapacity)
+	{
+		// Create the CPU-SIDE descriptor heap for this block (big enough for oversized requests, too)
+		D3D12_DESCRIPTOR_HEAP_DESC dhDesc = {};
+		dhDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE; // Make it not shader visible; it's a CPU-side-only desc heap
+		dhDesc.NodeMask = 0;
+		dhDesc.NumDescriptors = max(cpuSideDescriptorBlockSize, numDescriptors);
+		dhDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+
+		Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> block;
+		device->CreateDescriptorHeap(&dhDesc, IID_PPV_ARGS(block.GetAddressOf()));
+		cpuSideDescriptorBlocks.push_back(block);
+
+		cpuSideDescriptorBlockCapacity = dhDesc.NumDescriptors;
+		cpuSideDescriptorBlockOffset = 0;
+	}
+
+	// Offset into the current block and bump the offset
+	D3D12_CPU_DESCRIPTOR_HANDLE cpuHandle = cpuSideDescriptorBlocks.back()->GetCPUDescriptorHandleForHeapStart();
+	cpuHandle.ptr += (SIZE_T)cpuSideDescriptorBlockOffset * cbvSrvDescriptorHeapIncrementSize;
+	cpuSideDescriptorBlockOffset += numDescriptors;
+
+	return cpuHandle;
+}
+
 // --------------------------------------------------------
 // Helper for creating a basic buffer
 // 
@@ -391,13 +519,15 @@ D3D12_GPU_DESCRIPTOR_HANDLE DX12Helper::CopySRVsToDescriptorHeapAndGetGPUDescrip
 // state     - What state should the resulting resource be in?  Default is D3D12_RESOURCE_STATE_COMMON
 // flags     - Any special flags?  Default is D3D12_RESOURCE_FLAG_NONE
 // alignment - What's the buffer alignment?  Default is 0
+// category  - What is the buffer for?  Used for memory tracking
 // --------------------------------------------------------
 Microsoft::WRL::ComPtr<ID3D12Resource> DX12Helper::CreateBuffer(
 	UINT64 size,
 	D3D12_HEAP_TYPE heapType,
 	D3D12_RESOURCE_STATES state,
 	D3D12_RESOURCE_FLAGS flags,
-	UINT64 alignment)
+	UINT64 alignment,
+	GpuMemoryCategory category)
 {
 	Microsoft::WRL::ComPtr<ID3D12Resource> buffer;
 
@@ -425,6 +555,7 @@ Microsoft::WRL::ComPtr<ID3D12Resource> DX12Helper::CreateBuffer(
 
 	// Create the buffer
 	device->CreateCommittedResource(&heapDesc, D3D12_HEAP_FLAG_NONE, &desc, state, 0, IID_PPV_ARGS(buffer.GetAddressOf()));
+	TrackResource(buffer.Get(), category, GpuMemoryRegistry::GetCategoryName(category));
 	return buffer;
 }
 
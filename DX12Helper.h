@@ -3,6 +3,8 @@
 #include <wrl/client.h>
 #include <vector>
 
+#include "GpuMemoryRegistry.h"
+
 class DX12Helper
 {
 #pragma region Singleton
@@ -37,6 +39,15 @@ public:
 	D3D12_GPU_DESCRIPTOR_HANDLE CopySRVsToDescriptorHeapAndGetGPUDescriptorHandle(
 		D3D12_CPU_DESCRIPTOR_HANDLE firstDescriptorToCopy,
 		unsigned int numDescriptorsToCopy);
+	/// <summary>
+	/// Gathers a set of (possibly scattered) CPU-side SRVs into one contiguous table in the CBV/SRV descriptor heap on the GPU using a single copy. Returns a GPU handle to the start of that table.
+	/// </summary>
+	/// <param name="descriptorsToCopy">Array of CPU handles for the SRVs to copy over, in table order</param>
+	/// <param name="numDescriptorsToCopy">The number of SRVs to copy over</param>
+	/// <returns>A GPU handle that points to the first SRV uploaded</returns>
+	D3D12_GPU_DESCRIPTOR_HANDLE CopySRVsToDescriptorHeapAndGetGPUDescriptorHandle(
+		const D3D12_CPU_DESCRIPTOR_HANDLE* descriptorsToCopy,
+		unsigned int numDescriptorsToCopy);
 private:
 	static DX12Helper* instance;
 	DX12Helper() {};
@@ -56,7 +67,8 @@ public:
 	Microsoft::WRL::ComPtr<ID3D12Resource> CreateStaticBuffer(
 		unsigned int dataStride,
 		unsigned int dataCount,
-		void* data);
+		void* data,
+		GpuMemoryCategory category = GpuMemoryCategory::Uncategorized);
 
 	// Command list & synchronization
 	void CloseExecuteAndResetCommandList();
@@ -71,20 +83,30 @@ public:
 	D3D12_GPU_DESCRIPTOR_HANDLE FillNextConstantBufferAndGetGPUDescriptorHandle(void* data, unsigned int dataSizeInBytes);
 
 	/// <summary>
-	/// 
+	/// Creates a basic buffer and registers it with the GPU memory registry
 	/// </summary>
-	/// <param name="size"></param>
-	/// <param name="heapType"></param>
-	/// <param name="state"></param>
-	/// <param name="flags"></param>
-	/// <param name="alignment"></param>
-	/// <returns></returns>
+	/// <param name="size">Size of the buffer in bytes</param>
+	/// <param name="heapType">Which kind of heap the buffer lives in</param>
+	/// <param name="state">Initial resource state</param>
+	/// <param name="flags">Any special resource flags</param>
+	/// <param name="alignment">Buffer alignment</param>
+	/// <param name="category">What the buffer is used for (for memory tracking)</param>
+	/// <returns>The new buffer</returns>
 	Microsoft::WRL::ComPtr<ID3D12Resource> CreateBuffer(
 		UINT64 size,
 		D3D12_HEAP_TYPE heapType = D3D12_HEAP_TYPE_DEFAULT,
 		D3D12_RESOURCE_STATES state = D3D12_RESOURCE_STATE_COMMON,
 		D3D12_RESOURCE_FLAGS flags = D3D12_RESOURCE_FLAG_NONE,
-		UINT64 alignment = 0);
+		UINT64 alignment = 0,
+		GpuMemoryCategory category = GpuMemoryCategory::Uncategorized);
+
+	/// <summary>
+	/// Registers a resource with the GPU memory registry.  The registry entry is released automatically when the resource is destroyed.
+	/// </summary>
+	/// <param name="resource">The resource to track</param>
+	/// <param name="category">What the resource is used for</param>
+	/// <param name="debugName">Optional name for reports</param>
+	void TrackResource(ID3D12Resource* resource, GpuMemoryCategory category, const char* debugName = 0);
 
 	void ReserveSrvUavDescriptorHeapSlot(
 		D3D12_CPU_DESCRIPTOR_HANDLE* reservedCPUHandle,
@@ -135,7 +157,21 @@ private:
 
 	// Texture resources we need to keep alive
 	std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> textures; // All textures we've created, stored as C++ objects (isn't this slow??)
-	std::vector<Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>> cpuSideTextureDescriptorHeaps; // Holds the "baby heaps" on the CPU as they're created
+
+	// CPU-side (non-shader-visible) staging arena for texture SRVs.  Descriptors are
+	// handed out linearly from fixed-size blocks, and a new block is only created once
+	// the current one is full, so thousands of textures only need a handful of heaps
+	const unsigned int cpuSideDescriptorBlockSize = 256;
+	std::vector<Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>> cpuSideDescriptorBlocks;
+	unsigned int cpuSideDescriptorBlockCapacity; // How many descriptors fit in the current (last) block
+	unsigned int cpuSideDescriptorBlockOffset; // How many descriptors in the current block have been handed out
+
+	/// <summary>
+	/// Reserves a contiguous range of descriptors in the CPU-side staging arena, growing the arena by a block if necessary
+	/// </summary>
+	/// <param name="numDescriptors">How many contiguous descriptors are needed</param>
+	/// <returns>The CPU handle of the first reserved descriptor</returns>
+	D3D12_CPU_DESCRIPTOR_HANDLE AllocateCPUSideDescriptors(unsigned int numDescriptors);
 	
 	/// <summary>
 	/// Creates the program's CB upload heap during initialization
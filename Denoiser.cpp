@@ -0,0 +1,476 @@
+#include "Denoiser.h"
+#include "JobSystem.h"
+#include "SimdLanes.h"
+
+#include <math.h>
+
+using namespace DirectX;
+
+namespace
+{
+	// Frames of history before a pixel's own moments are trusted for its variance
+	const float MinHistoryForVariance = 4.0f;
+
+	// Keeps dark albedo from blowing lighting up when it's divided out
+	const float MinAlbedo = 0.001f;
+
+	float Luminance(const XMFLOAT3& color)
+	{
+		return 0.2126f * color.x + 0.7152f * color.y + 0.0722f * color.z;
+	}
+
+	// Lighting alone, with the surface's color divided out
+	XMFLOAT3 Demodulate(const XMFLOAT3& radiance, const XMFLOAT3& albedo)
+	{
+		return XMFLOAT3(
+			radiance.x / fmaxf(albedo.x, MinAlbedo),
+			radiance.y / fmaxf(albedo.y, MinAlbedo),
+			radiance.z / fmaxf(albedo.z, MinAlbedo));
+	}
+
+	XMFLOAT3 Lerp(const XMFLOAT3& a, const XMFLOAT3& b, float t)
+	{
+		return XMFLOAT3(a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t);
+	}
+}
+
+DenoiserSettings::DenoiserSettings() :
+	iterations(5),
+	colorAlpha(0.2f),
+	momentsAlpha(0.2f),
+	colorSigma(4.0f),
+	normalSigma(128.0f),
+	depthSigma(1.0f)
+{
+}
+
+Denoiser::Denoiser() :
+	width(0),
+	height(0),
+	border(0),
+	stride(0),
+	paddedHeight(0)
+{
+}
+
+
+// --------------------------------------------------------
+// Sizes the planes with a border as wide as the widest
+// pass reaches (two taps at 2^(passes - 1) pixels apart),
+// all of it zero, so it's never valid
+// --------------------------------------------------------
+void Denoiser::Resize(unsigned int newWidth, unsigned int newHeight)
+{
+	width = newWidth;
+	height = newHeight;
+	border = 2u << (DENOISER_MAX_ITERATIONS - 1);
+	unsigned int laneWidth = (width + SimdLanes::LaneCount - 1) / SimdLanes::LaneCount * SimdLanes::LaneCount;
+	stride = border + laneWidth + border;
+	paddedHeight = border + height + border;
+
+	size_t planeSize = (size_t)stride * paddedHeight;
+	depth.assign(planeSize, 0.0f);
+	depthSlope.assign(planeSize, 0.0f);
+	normalX.assign(planeSize, 0.0f);
+	normalY.assign(planeSize, 0.0f);
+	normalZ.assign(planeSize, 0.0f);
+	valid.assign(planeSize, 0.0f);
+	for (ColorPlanes& color : planes)
+	{
+		color.red.assign(planeSize, 0.0f);
+		color.green.assign(planeSize, 0.0f);
+		color.blue.assign(planeSize, 0.0f);
+		color.variance.assign(planeSize, 0.0f);
+	}
+
+	historyColor.assign(width * height, XMFLOAT3(0, 0, 0));
+	historyMoments.assign(width * height, XMFLOAT2(0, 0));
+	historyLength.assign(width * height, 0.0f);
+	integratedColor.assign(width * height, XMFLOAT3(0, 0, 0));
+	integratedMoments.assign(width * height, XMFLOAT2(0, 0));
+	integratedLength.assign(width * height, 0.0f);
+	output.assign(width * height, XMFLOAT3(0, 0, 0));
+	reprojection.Resize(width, height);
+}
+
+// --------------------------------------------------------
+// Accumulates, estimates variance, then filters - each
+// step over the whole image before the next, as each one
+// reads its neighbours' results from the one before
+// --------------------------------------------------------
+void Denoiser::Denoise(
+	const XMFLOAT3* radiance,
+	const GBufferPixel* gBuffer,
+	XMFLOAT3 cameraPosition,
+	const XMFLOAT4X4& view,
+	const XMFLOAT4X4& projection)
+{
+	if (width == 0 || height == 0)
+		return;
+
+	reprojection.SetCamera(cameraPosition, view, projection);
+	reprojection.Update(gBuffer);
+
+	JobSystem& jobs = JobSystem::GetInstance();
+	jobs.ParallelFor(height, 4, [&](unsigned int start, unsigned int end) { AccumulateRows(radiance, gBuffer, start, end); });
+	jobs.ParallelFor(height, 4, [&](unsigned int start, unsigned int end) { EstimateVarianceRows(gBuffer, start, end); });
+
+	// The first pass is also what the next frame blends with (filtered
+	// just enough to keep noise from piling up in the history)
+	unsigned int iterations = settings.iterations < DENOISER_MAX_ITERATIONS ? settings.iterations : DENOISER_MAX_ITERATIONS;
+	unsigned int tilesX = (width + DENOISER_TILE_WIDTH - 1) / DENOISER_TILE_WIDTH;
+	unsigned int tilesY = (height + DENOISER_TILE_HEIGHT - 1) / DENOISER_TILE_HEIGHT;
+	for (unsigned int i = 0; i < iterations; i++)
+	{
+		const ColorPlanes& source = planes[i % 2];
+		ColorPlanes& destination = planes[(i + 1) % 2];
+		jobs.ParallelFor(tilesX * tilesY, 1, [&](unsigned int start, unsigned int end)
+			{
+				for (unsigned int tile = start; tile < end; tile++)
+					FilterTile(tile, 1u << i, source, destination);
+			});
+
+		if (i == 0)
+		{
+			for (unsigned int y = 0; y < height; y++)
+			{
+				for (unsigned int x = 0; x < width; x++)
+				{
+					unsigned int p = PlaneIndex(x, y);
+					historyColor[y * width + x] = XMFLOAT3(destination.red[p], destination.green[p], destination.blue[p]);
+				}
+			}
+		}
+	}
+
+	if (iterations == 0)
+		historyColor = integratedColor;
+
+	// Surface color back in, except where nothing was hit
+	const ColorPlanes& filtered = planes[iterations % 2];
+	for (unsigned int y = 0; y < height; y++)
+	{
+		for (unsigned int x = 0; x < width; x++)
+		{
+			unsigned int i = y * width + x;
+			unsigned int p = PlaneIndex(x, y);
+			const XMFLOAT3& albedo = gBuffer[i].albedo;
+			output[i] = valid[p] > 0.0f ?
+				XMFLOAT3(filtered.red[p] * fmaxf(albedo.x, MinAlbedo), filtered.green[p] * fmaxf(albedo.y, MinAlbedo), filtered.blue[p] * fmaxf(albedo.z, MinAlbedo)) :
+				radiance[i];
+		}
+	}
+
+	historyMoments.swap(integratedMoments);
+	historyLength.swap(integratedLength);
+}
+
+void Denoiser::ResetHistory()
+{
+	reprojection.Reset();
+}
+
+const std::vector<XMFLOAT3>& Denoiser::GetOutput() const
+{
+	return output;
+}
+
+DenoiserSettings& Denoiser::GetSettings()
+{
+	return settings;
+}
+
+unsigned int Denoiser::GetWidth() const
+{
+	return width;
+}
+
+unsigned int Denoiser::GetHeight() const
+{
+	return height;
+}
+
+
+// --------------------------------------------------------
+// Fills in this frame's features, and blends each pixel's
+// lighting (and its luminance moments) with last frame's
+// at the same surface, if it was visible then
+// --------------------------------------------------------
+void Denoiser::AccumulateRows(const XMFLOAT3* radiance, const GBufferPixel* gBuffer, unsigned int startRow, unsigned int endRow)
+{
+	for (unsigned int y = startRow; y < endRow; y++)
+	{
+		for (unsigned int x = 0; x < width; x++)
+		{
+			unsigned int i = y * width + x;
+			unsigned int p = PlaneIndex(x, y);
+			const GBufferPixel& pixel = gBuffer[i];
+			if (pixel.distance <= 0.0f)
+			{
+				depth[p] = 0.0f;
+				depthSlope[p] = 0.0f;
+				normalX[p] = normalY[p] = normalZ[p] = 0.0f;
+				valid[p] = 0.0f;
+				integratedColor[i] = XMFLOAT3(0, 0, 0);
+				integratedMoments[i] = XMFLOAT2(0, 0);
+				integratedLength[i] = 0.0f;
+				continue;
+			}
+
+			depth[p] = pixel.distance;
+			normalX[p] = pixel.normal.x;
+			normalY[p] = pixel.normal.y;
+			normalZ[p] = pixel.normal.z;
+			valid[p] = 1.0f;
+
+			// Steepest change in depth toward a neighbour on the same surface side
+			float slope = 0.0f;
+			const int offsets[4][2] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+			for (const int* offset : offsets)
+			{
+				int neighbourX = (int)x + offset[0];
+				int neighbourY = (int)y + offset[1];
+				if (neighbourX < 0 || neighbourY < 0 || neighbourX >= (int)width || neighbourY >= (int)height)
+					continue;
+
+				const GBufferPixel& neighbour = gBuffer[neighbourY * width + neighbourX];
+				if (neighbour.distance > 0.0f)
+					slope = fmaxf(slope, fabsf(neighbour.distance - pixel.distance));
+			}
+			depthSlope[p] = slope;
+
+			XMFLOAT3 lighting = Demodulate(radiance[i], pixel.albedo);
+			float luminance = Luminance(lighting);
+			XMFLOAT3 color = lighting;
+			XMFLOAT2 moments(luminance, luminance * luminance);
+			float length = 1.0f;
+
+			// Where the surface was last frame, blended from the (up to)
+			// four nearest pixels that look like it
+			const ReprojectionTaps& taps = reprojection.GetTaps()[i];
+			XMFLOAT3 previousColor(0, 0, 0);
+			XMFLOAT2 previousMoments(0, 0);
+			float previousLength = 0.0f;
+			for (unsigned int tap = 0; tap < 4; tap++)
+			{
+				unsigned int q = taps.pixels[tap];
+				float weight = taps.weights[tap];
+				previousColor.x += historyColor[q].x * weight;
+				previousColor.y += historyColor[q].y * weight;
+				previousColor.z += historyColor[q].z * weight;
+				previousMoments.x += historyMoments[q].x * weight;
+				previousMoments.y += historyMoments[q].y * weight;
+				previousLength += historyLength[q] * weight;
+			}
+
+			if (previousLength > 0.0f)
+			{
+				// A plain average until there's enough history, then an exponential one
+				length = previousLength + 1.0f;
+				float colorWeight = fmaxf(settings.colorAlpha, 1.0f / length);
+				float momentsWeight = fmaxf(settings.momentsAlpha, 1.0f / length);
+				color = Lerp(previousColor, lighting, colorWeight);
+				moments.x = previousMoments.x + (moments.x - previousMoments.x) * momentsWeight;
+				moments.y = previousMoments.y + (moments.y - previousMoments.y) * momentsWeight;
+			}
+
+			integratedColor[i] = color;
+			integratedMoments[i] = moments;
+			integratedLength[i] = length;
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Variance of each pixel's luminance from its moments - or
+// with too little history for those to mean much, from the
+// moments of the 7x7 pixels around it on similar surfaces
+// (inflated, as that's still a guess)
+// --------------------------------------------------------
+void Denoiser::EstimateVarianceRows(const GBufferPixel* gBuffer, unsigned int startRow, unsigned int endRow)
+{
+	ColorPlanes& color = planes[0];
+	for (unsigned int y = startRow; y < endRow; y++)
+	{
+		for (unsigned int x = 0; x < width; x++)
+		{
+			unsigned int i = y * width + x;
+			unsigned int p = PlaneIndex(x, y);
+			const XMFLOAT3& lighting = integratedColor[i];
+			color.red[p] = lighting.x;
+			color.green[p] = lighting.y;
+			color.blue[p] = lighting.z;
+			if (valid[p] == 0.0f)
+			{
+				color.variance[p] = 0.0f;
+				continue;
+			}
+
+			XMFLOAT2 moments = integratedMoments[i];
+			float length = integratedLength[i];
+			if (length < MinHistoryForVariance)
+			{
+				const GBufferPixel& pixel = gBuffer[i];
+				XMVECTOR normal = XMLoadFloat3(&pixel.normal);
+				float totalWeight = 0.0f;
+				moments = XMFLOAT2(0, 0);
+				for (int offsetY = -3; offsetY <= 3; offsetY++)
+				{
+					for (int offsetX = -3; offsetX <= 3; offsetX++)
+					{
+						int neighbourX = (int)x + offsetX;
+						int neighbourY = (int)y + offsetY;
+						if (neighbourX < 0 || neighbourY < 0 || neighbourX >= (int)width || neighbourY >= (int)height)
+							continue;
+
+						unsigned int q = neighbourY * width + neighbourX;
+						const GBufferPixel& neighbour = gBuffer[q];
+						if (neighbour.distance <= 0.0f)
+							continue;
+
+						float normalWeight = powf(fmaxf(XMVectorGetX(XMVector3Dot(XMLoadFloat3(&neighbour.normal), normal)), 0.0f), settings.normalSigma);
+						float distance = sqrtf((float)(offsetX * offsetX + offsetY * offsetY));
+						float depthWeight = expf(-fabsf(neighbour.distance - pixel.distance) / (settings.depthSigma * depthSlope[p] * distance + 1e-5f));
+						float weight = normalWeight * depthWeight;
+						moments.x += integratedMoments[q].x * weight;
+						moments.y += integratedMoments[q].y * weight;
+						totalWeight += weight;
+					}
+				}
+
+				moments = XMFLOAT2(moments.x / totalWeight, moments.y / totalWeight);
+				color.variance[p] = fmaxf(moments.y - moments.x * moments.x, 0.0f) * (MinHistoryForVariance / length);
+				continue;
+			}
+
+			// That's the variance of a single frame - the blended history
+			// averages a few frames' worth (all of them, at first, then as
+			// many as an exponential average with this weight holds)
+			float averagedFrames = (2.0f - settings.colorAlpha) / settings.colorAlpha;
+			averagedFrames = length < averagedFrames ? length : averagedFrames;
+			color.variance[p] = fmaxf(moments.y - moments.x * moments.x, 0.0f) / averagedFrames;
+		}
+	}
+}
+
+// --------------------------------------------------------
+// One à-trous pass over a tile, a row of lanes at a time:
+// every pixel is a weighted average of 5x5 taps, step
+// pixels apart, weighed by the B3 spline kernel and how
+// alike each tap's normal, depth and luminance are to the
+// pixel's own.  Variance is filtered along with the color
+// (with squared weights, as it's a variance of the sum).
+// --------------------------------------------------------
+void Denoiser::FilterTile(unsigned int tile, unsigned int step, const ColorPlanes& source, ColorPlanes& destination) const
+{
+	using namespace SimdLanes;
+
+	unsigned int tilesX = (width + DENOISER_TILE_WIDTH - 1) / DENOISER_TILE_WIDTH;
+	unsigned int startX = (tile % tilesX) * DENOISER_TILE_WIDTH;
+	unsigned int startY = (tile / tilesX) * DENOISER_TILE_HEIGHT;
+	unsigned int endX = startX + DENOISER_TILE_WIDTH < width ? startX + DENOISER_TILE_WIDTH : width;
+	unsigned int endY = startY + DENOISER_TILE_HEIGHT < height ? startY + DENOISER_TILE_HEIGHT : height;
+
+	// Kernel weight, plane offset and inverse length (in pixels) of every tap
+	const float spline[5] = { 1.0f / 16.0f, 1.0f / 4.0f, 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f };
+	float tapWeights[25];
+	int tapOffsets[25];
+	float tapInverseLengths[25];
+	for (int ty = 0; ty < 5; ty++)
+	{
+		for (int tx = 0; tx < 5; tx++)
+		{
+			int offsetX = (tx - 2) * (int)step;
+			int offsetY = (ty - 2) * (int)step;
+			tapWeights[ty * 5 + tx] = spline[tx] * spline[ty];
+			tapOffsets[ty * 5 + tx] = offsetY * (int)stride + offsetX;
+			tapInverseLengths[ty * 5 + tx] = offsetX || offsetY ? 1.0f / sqrtf((float)(offsetX * offsetX + offsetY * offsetY)) : 0.0f;
+		}
+	}
+
+	// Variance the luminance test compares against is blurred a little first (3x3 Gaussian)
+	const float gaussian[3] = { 0.25f, 0.5f, 0.25f };
+
+	Lanes zero = Splat(0.0f);
+	Lanes one = Splat(1.0f);
+	Lanes lumaRed = Splat(0.2126f), lumaGreen = Splat(0.7152f), lumaBlue = Splat(0.0722f);
+	Lanes colorSigma = Splat(settings.colorSigma);
+	Lanes normalSigma = Splat(settings.normalSigma);
+	Lanes depthSigma = Splat(settings.depthSigma);
+	Lanes epsilon = Splat(1e-5f);
+
+	// Tiles are a whole number of lane groups wide, so only the last
+	// tile in a row runs over (into padding, where nothing is valid)
+	for (unsigned int y = startY; y < endY; y++)
+	{
+		for (unsigned int x = startX; x < endX; x += LaneCount)
+		{
+			unsigned int p = PlaneIndex(x, y);
+			Lanes centerRed = LoadUnaligned(&source.red[p]);
+			Lanes centerGreen = LoadUnaligned(&source.green[p]);
+			Lanes centerBlue = LoadUnaligned(&source.blue[p]);
+			Lanes centerVariance = LoadUnaligned(&source.variance[p]);
+			Lanes centerDepth = LoadUnaligned(&depth[p]);
+			Lanes centerNormalX = LoadUnaligned(&normalX[p]);
+			Lanes centerNormalY = LoadUnaligned(&normalY[p]);
+			Lanes centerNormalZ = LoadUnaligned(&normalZ[p]);
+			Lanes centerValid = LoadUnaligned(&valid[p]);
+			Lanes centerLuminance = Add(Add(Mul(centerRed, lumaRed), Mul(centerGreen, lumaGreen)), Mul(centerBlue, lumaBlue));
+			Lanes inverseSlope = Div(one, Add(Mul(LoadUnaligned(&depthSlope[p]), depthSigma), epsilon));
+
+			Lanes blurredVariance = zero;
+			for (int gy = -1; gy <= 1; gy++)
+			{
+				for (int gx = -1; gx <= 1; gx++)
+				{
+					Lanes weight = Splat(gaussian[gx + 1] * gaussian[gy + 1]);
+					blurredVariance = Add(blurredVariance, Mul(weight, LoadUnaligned(&source.variance[p + gy * (int)stride + gx])));
+				}
+			}
+			Lanes luminanceScale = Div(one, Add(Mul(colorSigma, Sqrt(Max(blurredVariance, zero))), epsilon));
+
+			Lanes totalWeight = zero;
+			Lanes totalRed = zero, totalGreen = zero, totalBlue = zero, totalVariance = zero;
+			for (unsigned int t = 0; t < 25; t++)
+			{
+				unsigned int q = p + tapOffsets[t];
+				Lanes red = LoadUnaligned(&source.red[q]);
+				Lanes green = LoadUnaligned(&source.green[q]);
+				Lanes blue = LoadUnaligned(&source.blue[q]);
+				Lanes luminance = Add(Add(Mul(red, lumaRed), Mul(green, lumaGreen)), Mul(blue, lumaBlue));
+				Lanes normalDot = Add(Add(
+					Mul(centerNormalX, LoadUnaligned(&normalX[q])),
+					Mul(centerNormalY, LoadUnaligned(&normalY[q]))),
+					Mul(centerNormalZ, LoadUnaligned(&normalZ[q])));
+
+				// One exponential for all three tests (normals as e^(-sigma (1 - cos)),
+				// which falls off like SVGF's cos^sigma)
+				Lanes depthTerm = Mul(Mul(Abs(Sub(LoadUnaligned(&depth[q]), centerDepth)), inverseSlope), Splat(tapInverseLengths[t]));
+				Lanes luminanceTerm = Mul(Abs(Sub(luminance, centerLuminance)), luminanceScale);
+				Lanes normalTerm = Mul(normalSigma, Sub(one, normalDot));
+				Lanes weight = Mul(
+					Mul(Splat(tapWeights[t]), LoadUnaligned(&valid[q])),
+					Exp(Sub(zero, Add(Add(depthTerm, luminanceTerm), normalTerm))));
+
+				totalWeight = Add(totalWeight, weight);
+				totalRed = Add(totalRed, Mul(weight, red));
+				totalGreen = Add(totalGreen, Mul(weight, green));
+				totalBlue = Add(totalBlue, Mul(weight, blue));
+				totalVariance = Add(totalVariance, Mul(Mul(weight, weight), LoadUnaligned(&source.variance[q])));
+			}
+
+			// Missing pixels keep what they had (their own weight is zero)
+			totalWeight = Max(totalWeight, Splat(1e-12f));
+			Lanes inverseWeight = Div(one, totalWeight);
+			StoreUnaligned(&destination.red[p], Add(centerRed, Mul(centerValid, Sub(Mul(totalRed, inverseWeight), centerRed))));
+			StoreUnaligned(&destination.green[p], Add(centerGreen, Mul(centerValid, Sub(Mul(totalGreen, inverseWeight), centerGreen))));
+			StoreUnaligned(&destination.blue[p], Add(centerBlue, Mul(centerValid, Sub(Mul(totalBlue, inverseWeight), centerBlue))));
+			StoreUnaligned(&destination.variance[p], Add(centerVariance, Mul(centerValid, Sub(Mul(totalVariance, Mul(inverseWeight, inverseWeight)), centerVariance))));
+		}
+	}
+}
+
+unsigned int Denoiser::PlaneIndex(unsigned int x, unsigned int y) const
+{
+	return (y + border) * stride + x + border;
+}
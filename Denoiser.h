@@ -0,0 +1,136 @@
+#pragma once
+
+// Spatiotemporal variance-guided filtering (Schied et al., "Spatiotemporal
+// variance-guided filtering: real-time reconstruction for path-traced
+// global illumination", 2017 - SVGF) of a noisy frame, on the CPU.
+//
+// Takes a frame's radiance along with its G-buffer (normal, distance and
+// albedo of what each pixel's camera ray hit, as CpuRaytracer writes it):
+//  - albedo is divided out first, so the filters only blur lighting, not
+//    texture, and multiplied back in at the end
+//  - temporal accumulation: each pixel's surface is reprojected into the
+//    last frame (see ReprojectionCache.h) and blended with what was
+//    there, along with the first two moments of its luminance
+//  - variance: from those moments, or (for the first few frames of a
+//    pixel's history) from its neighbours' moments instead
+//  - a few à-trous wavelet passes, each a 5x5 B3 spline kernel with its
+//    taps twice as far apart as the last, stopped at edges by normal,
+//    depth and luminance (against the variance, so noisy pixels blur
+//    more) - the first pass's result is what the next frame reprojects
+// Pixels whose camera ray missed pass straight through.
+//
+// Filtering runs on padded structure-of-arrays planes (a border wide
+// enough for the widest pass's taps, marked as missing so they never
+// count), several pixels at a time - one per SIMD lane (see SimdLanes.h)
+// - over tiles spread across the job system.
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "BufferStructs.h"
+#include "ReprojectionCache.h"
+
+// Width and height of the tiles each filtering pass is split into (the
+// width has to be a whole number of SIMD lane groups)
+#define DENOISER_TILE_WIDTH 64
+#define DENOISER_TILE_HEIGHT 16
+
+// Most à-trous passes (so the image border can be sized once)
+#define DENOISER_MAX_ITERATIONS 5
+
+struct DenoiserSettings
+{
+	DenoiserSettings();
+
+	unsigned int iterations;	// À-trous passes (at most DENOISER_MAX_ITERATIONS)
+	float colorAlpha;			// Least weight a new frame gets against its history
+	float momentsAlpha;			// Same, for the luminance moments behind the variance
+	float colorSigma;			// How many standard deviations apart luminance can be and still blur
+	float normalSigma;			// How quickly weight falls as normals turn apart
+	float depthSigma;			// How far off the local depth slope neighbours can be and still blur
+};
+
+class Denoiser
+{
+public:
+	Denoiser();
+
+	/// <summary>
+	/// Resizes the image (which drops any history)
+	/// </summary>
+	void Resize(unsigned int width, unsigned int height);
+
+	/// <summary>
+	/// Filters one frame, reusing the last one's where the surfaces still match
+	/// </summary>
+	/// <param name="radiance">Noisy linear color, one per pixel</param>
+	/// <param name="gBuffer">What each pixel's camera ray hit (through the pixel's center, or close to it)</param>
+	/// <param name="cameraPosition">Where the camera was</param>
+	/// <param name="view">Camera's view matrix</param>
+	/// <param name="projection">Camera's projection matrix</param>
+	void Denoise(
+		const DirectX::XMFLOAT3* radiance,
+		const GBufferPixel* gBuffer,
+		DirectX::XMFLOAT3 cameraPosition,
+		const DirectX::XMFLOAT4X4& view,
+		const DirectX::XMFLOAT4X4& projection);
+
+	/// <summary>
+	/// Forgets the last frame, so the next one is filtered on its own
+	/// </summary>
+	void ResetHistory();
+
+	// Filtered linear color of the last frame, one per pixel
+	const std::vector<DirectX::XMFLOAT3>& GetOutput() const;
+
+	DenoiserSettings& GetSettings();
+	unsigned int GetWidth() const;
+	unsigned int GetHeight() const;
+
+private:
+	unsigned int width;
+	unsigned int height;
+	DenoiserSettings settings;
+
+	// Padded planes: the image sits a border in from the top left, and
+	// each row is long enough for the last group of lanes to run over
+	unsigned int border;
+	unsigned int stride;
+	unsigned int paddedHeight;
+
+	// Features of this frame (constant while filtering)
+	std::vector<float> depth;			// Distance from the camera
+	std::vector<float> depthSlope;		// How fast depth changes from one pixel to the next
+	std::vector<float> normalX;
+	std::vector<float> normalY;
+	std::vector<float> normalZ;
+	std::vector<float> valid;			// 1 where the camera ray hit something, 0 elsewhere (border included)
+
+	// Demodulated lighting and its variance, filtered back and forth between two sets
+	struct ColorPlanes
+	{
+		std::vector<float> red;
+		std::vector<float> green;
+		std::vector<float> blue;
+		std::vector<float> variance;
+	};
+	ColorPlanes planes[2];
+
+	// What the next frame reprojects (unpadded)
+	std::vector<DirectX::XMFLOAT3> historyColor;
+	std::vector<DirectX::XMFLOAT2> historyMoments;
+	std::vector<float> historyLength;
+	std::vector<DirectX::XMFLOAT3> integratedColor;
+	std::vector<DirectX::XMFLOAT2> integratedMoments;
+	std::vector<float> integratedLength;
+
+	std::vector<DirectX::XMFLOAT3> output;
+
+	// Where each pixel was last frame
+	ReprojectionCache reprojection;
+
+	void AccumulateRows(const DirectX::XMFLOAT3* radiance, const GBufferPixel* gBuffer, unsigned int startRow, unsigned int endRow);
+	void EstimateVarianceRows(const GBufferPixel* gBuffer, unsigned int startRow, unsigned int endRow);
+	void FilterTile(unsigned int tile, unsigned int step, const ColorPlanes& source, ColorPlanes& destination) const;
+	unsigned int PlaneIndex(unsigned int x, unsigned int y) const;
+};
@@ -0,0 +1,95 @@
+#include "DenoiserBenchmark.h"
+#include "BenchmarkUtils.h"
+#include "CpuRaytracer.h"
+#include "Denoiser.h"
+
+#include <stdio.h>
+#include <vector>
+
+using namespace DirectX;
+using namespace BenchmarkUtils;
+
+bool DenoiserBenchmark::Run()
+{
+	return Run(320, 180, 16);
+}
+
+// --------------------------------------------------------
+// Renders a reference and a raw 25 sample frame, then for
+// each low sample count traces and denoises frame after
+// frame from the same view, reporting the error of the
+// first frame (nothing to reuse yet) and of the last
+// --------------------------------------------------------
+bool DenoiserBenchmark::Run(unsigned int width, unsigned int height, unsigned int frames)
+{
+	printf("Denoiser benchmark: %ux%u, %u frames\n", width, height, frames);
+
+	Scene scene;
+	CreateScene(&scene, (float)width / height);
+	XMFLOAT3 cameraPosition = scene.cameraPosition;
+	const XMFLOAT4X4& view = scene.view;
+	const XMFLOAT4X4& projection = scene.projection;
+
+	std::vector<XMFLOAT3> referenceImage;
+	const unsigned int referenceSamples = 1024;
+	double referenceTime = RenderReference(scene, width, height, referenceSamples, &referenceImage);
+	printf("  reference: %u samples per pixel in %.1f ms\n", referenceSamples, referenceTime);
+
+	// What every frame looks like today
+	CpuRaytracer current;
+	current.Resize(width, height);
+	current.SetSamplesPerPixel(25);
+	current.Render(scene.snapshot, cameraPosition, view, projection);
+	double currentError = MeanSquaredError(current.GetFrameRadiance(), referenceImage);
+	printf("  25 spp raw              MSE %.6f\n", currentError);
+
+	// One sample per pixel is shown too, but edges seen through a single
+	// sample hold it back, so only two and up have to beat today's frames
+	bool passed = true;
+	const unsigned int sampleCounts[] = { 1, 2, 4 };
+	const unsigned int fewestCheckedSamples = 2;
+	for (unsigned int samplesPerPixel : sampleCounts)
+	{
+		bool checked = samplesPerPixel >= fewestCheckedSamples;
+		CpuRaytracer tracer;
+		tracer.Resize(width, height);
+		tracer.SetSamplesPerPixel(samplesPerPixel);
+
+		Denoiser denoiser;
+		denoiser.Resize(width, height);
+
+		double rawError = 0;
+		double firstError = 0;
+		double lastError = 0;
+		double denoiseTime = 0;
+		for (unsigned int frame = 0; frame < frames; frame++)
+		{
+			tracer.Render(scene.snapshot, cameraPosition, view, projection);
+
+			Clock::time_point start = Clock::now();
+			denoiser.Denoise(tracer.GetFrameRadiance().data(), tracer.GetGBuffer().data(), cameraPosition, view, projection);
+			denoiseTime += MillisecondsSince(start);
+
+			if (frame == 0)
+			{
+				rawError = MeanSquaredError(tracer.GetFrameRadiance(), referenceImage);
+				firstError = MeanSquaredError(denoiser.GetOutput(), referenceImage);
+			}
+			lastError = MeanSquaredError(denoiser.GetOutput(), referenceImage);
+		}
+
+		printf("  %u spp raw               MSE %.6f   denoised: first frame %.6f (%5.1fx lower)   frame %u %.6f (%5.1fx lower)%s   %.2f ms per frame\n",
+			samplesPerPixel,
+			rawError,
+			firstError, firstError > 0 ? rawError / firstError : 0.0,
+			frames, lastError, lastError > 0 ? rawError / lastError : 0.0,
+			Verdict(checked, lastError < currentError),
+			denoiseTime / frames);
+
+		passed &= Expect(firstError < rawError, "denoising to lower the error from the first frame on");
+		if (checked)
+			passed &= Expect(lastError < currentError, "the denoised frame to beat a raw 25 spp one");
+	}
+
+	return passed;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+// Measures how few samples per pixel the Denoiser lets us get away with,
+// without the GPU: traces the benchmark scene (BenchmarkUtils.h) on the
+// CPU at 1, 2 and 4 samples per pixel per frame, denoises every frame,
+// and compares the raw and denoised frames' mean squared error against a
+// converged reference - and against a raw frame at 25 samples per pixel,
+// what we trace today.  Start the program with -benchmark to run it (see
+// HeadlessTests.h); it fails if denoising doesn't lower the error from
+// the first frame on, or if 2 or 4 samples per pixel denoised end up no
+// better than the raw 25 (1 is shown too, but isn't expected to be).
+
+namespace DenoiserBenchmark
+{
+	/// <summary>
+	/// Runs the benchmark at 320x180 for 16 frames
+	/// </summary>
+	/// <returns>Whether every denoised sample count beat the raw frames</returns>
+	bool Run();
+
+	/// <summary>
+	/// Runs the benchmark with a specific image size and number of frames
+	/// </summary>
+	/// <param name="width">Image width in pixels</param>
+	/// <param name="height">Image height in pixels</param>
+	/// <param name="frames">How many frames to trace and denoise at each sample count</param>
+	/// <returns>Whether every denoised sample count beat the raw frames</returns>
+	bool Run(unsigned int width, unsigned int height, unsigned int frames);
+}
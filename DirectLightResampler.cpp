@@ -0,0 +1,571 @@
+#include "DirectLightResampler.h"
+#include "CpuRaytracer.h"
+#include "JobSystem.h"
+#include "Material.h"
+#include "Mesh.h"
+#include "Sampler.h"
+
+#include <math.h>
+#include <string.h>
+#include <utility>
+
+using namespace DirectX;
+
+namespace
+{
+	// Which of a pixel's random numbers each step uses
+	const unsigned int CandidateDimension = 0;		// Light choice and resampling, per candidate
+	const unsigned int TemporalDimension = 1;		// Whether the last frame's light wins
+	const unsigned int NeighbourDimension = 2;		// Where each neighbour is
+	const unsigned int NeighbourPickDimension = 3;	// Whether each neighbour's light wins
+
+	// How alike two surfaces have to be to share lights
+	const float SimilarNormalCosine = 0.9f;
+	const float SimilarDistanceRatio = 0.1f;
+
+	const unsigned int MaxSpatialNeighbours = 32;
+
+	const Reservoir EmptyReservoir = { LIGHT_TREE_NO_LIGHT, 0.0f, 0.0f, 0.0f };
+
+	float Luminance(FXMVECTOR color)
+	{
+		return XMVectorGetX(XMVector3Dot(color, XMVectorSet(0.2126f, 0.7152f, 0.0722f, 0)));
+	}
+
+	// Starts merging reservoirs with one's own light, whose target value is
+	// already known (candidates are weighed by target value times W times M)
+	void BeginMerge(const Reservoir& reservoir, float target, Reservoir* merged, float* mergedTarget)
+	{
+		merged->light = reservoir.light;
+		merged->weightSum = target * reservoir.contributionWeight * reservoir.sampleCount;
+		merged->sampleCount = reservoir.sampleCount;
+		merged->contributionWeight = 0.0f;
+		*mergedTarget = target;
+	}
+
+	// Another reservoir's light replaces the merged one with a chance in
+	// proportion to its weight
+	void MergeIn(const Reservoir& other, float target, float u, Reservoir* merged, float* mergedTarget)
+	{
+		float weight = target * other.contributionWeight * other.sampleCount;
+		merged->weightSum += weight;
+		merged->sampleCount += other.sampleCount;
+		if (u * merged->weightSum < weight)
+		{
+			merged->light = other.light;
+			*mergedTarget = target;
+		}
+	}
+
+	void FinishMerge(Reservoir* merged, float target)
+	{
+		merged->contributionWeight = target > 0.0f && merged->sampleCount > 0.0f ?
+			merged->weightSum / (merged->sampleCount * target) : 0.0f;
+	}
+
+	bool IsSimilarSurface(const GBufferPixel& pixel, FXMVECTOR normal, float distance)
+	{
+		return pixel.distance > 0.0f &&
+			XMVectorGetX(XMVector3Dot(XMLoadFloat3(&pixel.normal), normal)) > SimilarNormalCosine &&
+			fabsf(pixel.distance - distance) < SimilarDistanceRatio * distance;
+	}
+}
+
+ResamplerSettings::ResamplerSettings() :
+	candidateCount(8),
+	visibilityReuse(true),
+	temporalReuse(true),
+	maxHistory(20.0f),
+	spatialNeighbours(4),
+	spatialRadius(30.0f)
+{
+}
+
+DirectLightResampler::DirectLightResampler() :
+	width(0),
+	height(0),
+	raysCast(0),
+	scene(0),
+	cameraPosition(),
+	frameIndex(0)
+{
+}
+
+
+void DirectLightResampler::Resize(unsigned int newWidth, unsigned int newHeight)
+{
+	width = newWidth;
+	height = newHeight;
+	gBuffer.assign(width * height, GBufferPixel{});
+	reservoirs.assign(width * height, EmptyReservoir);
+	previousReservoirs.assign(width * height, EmptyReservoir);
+	spatialReservoirs.assign(width * height, EmptyReservoir);
+	output.assign(width * height, XMFLOAT3(0, 0, 0));
+	reprojection.Resize(width, height);
+}
+
+// --------------------------------------------------------
+// Runs each step over every row in turn - every step only
+// reads what the one before it wrote, so rows never wait
+// on each other within a step
+// --------------------------------------------------------
+void DirectLightResampler::Render(
+	const SceneSnapshot& newScene,
+	const Light* newLights,
+	unsigned int lightCount,
+	XMFLOAT3 newCameraPosition,
+	const XMFLOAT4X4& view,
+	const XMFLOAT4X4& projection)
+{
+	if (width == 0 || height == 0)
+		return;
+
+	sceneBVH.Update(newScene);
+	UpdateLights(newLights, lightCount);
+
+	// This frame's reservoirs become last frame's
+	std::swap(reservoirs, previousReservoirs);
+
+	// The reprojection cache aims every pixel's ray from here on
+	scene = &newScene;
+	cameraPosition = newCameraPosition;
+	reprojection.SetCamera(cameraPosition, view, projection);
+	raysCast = 0;
+
+	JobSystem& jobs = JobSystem::GetInstance();
+	jobs.ParallelFor(height, 4, [&](unsigned int start, unsigned int end) { TraceGBuffer(start, end); });
+	reprojection.Update(gBuffer.data());
+	jobs.ParallelFor(height, 4, [&](unsigned int start, unsigned int end) { SampleCandidates(start, end); });
+
+	if (settings.temporalReuse)
+		jobs.ParallelFor(height, 4, [&](unsigned int start, unsigned int end) { ReuseTemporal(start, end); });
+
+	if (settings.spatialNeighbours > 0)
+	{
+		jobs.ParallelFor(height, 4, [&](unsigned int start, unsigned int end) { ReuseSpatial(start, end); });
+		std::swap(reservoirs, spatialReservoirs);
+	}
+
+	jobs.ParallelFor(height, 4, [&](unsigned int start, unsigned int end) { Shade(start, end); });
+
+	scene = 0;
+	frameIndex++;
+}
+
+// --------------------------------------------------------
+// Every light at every pixel, with a shadow ray for each
+// one that reaches it
+// --------------------------------------------------------
+void DirectLightResampler::RenderReference(std::vector<XMFLOAT3>& reference) const
+{
+	reference.assign(width * height, XMFLOAT3(0, 0, 0));
+	JobSystem::GetInstance().ParallelFor(height, 1,
+		[&](unsigned int start, unsigned int end)
+		{
+			unsigned int rays = 0;
+			for (unsigned int y = start; y < end; y++)
+			{
+				for (unsigned int x = 0; x < width; x++)
+				{
+					const GBufferPixel& pixel = gBuffer[y * width + x];
+					if (pixel.distance < 0.0f)
+						continue;
+
+					XMVECTOR position = reprojection.PixelPosition(x, y, pixel.distance);
+					XMVECTOR normal = XMLoadFloat3(&pixel.normal);
+					XMVECTOR total = XMVectorZero();
+					for (unsigned int l = 0; l < lights.size(); l++)
+					{
+						XMVECTOR direction;
+						float distance;
+						XMVECTOR illumination = CpuRaytracer::IlluminationFromLight(lights[l], position, &direction, &distance);
+						float cosine = XMVectorGetX(XMVector3Dot(normal, direction));
+						if (cosine > 0.0f && Luminance(illumination) > 0.0f && IsLightVisible(l, position, normal, &rays))
+							total += illumination * cosine;
+					}
+					XMStoreFloat3(&reference[y * width + x], total * XMLoadFloat3(&pixel.albedo));
+				}
+			}
+		});
+}
+
+void DirectLightResampler::ResetHistory()
+{
+	reprojection.Reset();
+}
+
+const std::vector<XMFLOAT3>& DirectLightResampler::GetOutput() const
+{
+	return output;
+}
+
+const std::vector<GBufferPixel>& DirectLightResampler::GetGBuffer() const
+{
+	return gBuffer;
+}
+
+const std::vector<Reservoir>& DirectLightResampler::GetReservoirs() const
+{
+	return reservoirs;
+}
+
+ResamplerSettings& DirectLightResampler::GetSettings()
+{
+	return settings;
+}
+
+unsigned long long DirectLightResampler::GetRaysCast()
+{
+	return raysCast;
+}
+
+unsigned int DirectLightResampler::GetWidth() const
+{
+	return width;
+}
+
+unsigned int DirectLightResampler::GetHeight() const
+{
+	return height;
+}
+
+
+// --------------------------------------------------------
+// Refits the light tree when lights have only changed, but
+// rebuilds it (and drops history, whose light indices no
+// longer mean the same thing) when lights come or go
+// --------------------------------------------------------
+void DirectLightResampler::UpdateLights(const Light* newLights, unsigned int lightCount)
+{
+	bool sameLights = lightCount == lights.size();
+	for (unsigned int i = 0; sameLights && i < lightCount; i++)
+		sameLights = (lights[i].Type == LIGHT_TYPE_DIRECTIONAL) == (newLights[i].Type == LIGHT_TYPE_DIRECTIONAL);
+
+	if (!sameLights)
+	{
+		lights.assign(newLights, newLights + lightCount);
+		lightTree.Build(lights.data(), lightCount);
+		reprojection.Reset();
+	}
+	else if (lightCount > 0 && memcmp(lights.data(), newLights, sizeof(Light) * lightCount) != 0)
+	{
+		lights.assign(newLights, newLights + lightCount);
+		lightTree.Refit(lights.data());
+	}
+}
+
+// --------------------------------------------------------
+// A ray through each pixel's center, recording the surface
+// it hits (the same surface every frame, unlike a jittered
+// ray, so reservoirs can follow it)
+// --------------------------------------------------------
+void DirectLightResampler::TraceGBuffer(unsigned int startRow, unsigned int endRow)
+{
+	for (unsigned int y = startRow; y < endRow; y++)
+	{
+		for (unsigned int x = 0; x < width; x++)
+		{
+			GBufferPixel& pixel = gBuffer[y * width + x];
+			pixel = {};
+			pixel.distance = -1.0f;
+
+			Ray ray = {};
+			ray.origin = cameraPosition;
+			XMStoreFloat3(&ray.direction, XMVector3Normalize(reprojection.PixelPosition(x, y, 1.0f) - XMLoadFloat3(&cameraPosition)));
+			ray.maxDistance = PICK_MAX_DISTANCE;
+
+			PickResult hit = sceneBVH.Pick(ray);
+			if (!hit.hit)
+				continue;
+
+			const SnapshotInstance& instance = scene->instances[hit.instance];
+			XMFLOAT3 localNormal = instance.mesh->GetCpuBVH().InterpolateNormal(hit.triangle, hit.barycentrics);
+			XMVECTOR normal = XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&localNormal), XMLoadFloat4x4(&instance.worldInverseTransposeMatrix)));
+			if (XMVectorGetX(XMVector3Dot(normal, XMLoadFloat3(&ray.direction))) > 0)
+				normal = -normal;
+
+			XMStoreFloat3(&pixel.normal, normal);
+			pixel.distance = hit.distance;
+			pixel.albedo = instance.material ? instance.material->GetColorTint() : XMFLOAT3(1, 1, 1);
+		}
+	}
+
+	raysCast += (endRow - startRow) * width;
+}
+
+// --------------------------------------------------------
+// Resampled importance sampling: several lights from the
+// tree, streamed through a reservoir that keeps one with a
+// chance in proportion to its target over its tree pdf
+// --------------------------------------------------------
+void DirectLightResampler::SampleCandidates(unsigned int startRow, unsigned int endRow)
+{
+	unsigned int rows = 0;
+	for (unsigned int y = startRow; y < endRow; y++)
+	{
+		for (unsigned int x = 0; x < width; x++)
+		{
+			unsigned int index = y * width + x;
+			const GBufferPixel& pixel = gBuffer[index];
+			Reservoir& reservoir = reservoirs[index];
+			reservoir = EmptyReservoir;
+			if (pixel.distance < 0.0f)
+				continue;
+
+			XMFLOAT3 position;
+			XMVECTOR p = reprojection.PixelPosition(x, y, pixel.distance);
+			XMVECTOR n = XMLoadFloat3(&pixel.normal);
+			XMStoreFloat3(&position, p);
+
+			unsigned int pixelSeed = Sampler::PixelSeed(x, y);
+			float selectedTarget = 0.0f;
+			for (unsigned int c = 0; c < settings.candidateCount; c++)
+			{
+				XMFLOAT2 u = Sampler::Sample2D(pixelSeed, frameIndex * settings.candidateCount + c, CandidateDimension);
+				reservoir.sampleCount += 1.0f;
+
+				float pdf;
+				unsigned int light = lightTree.Sample(position, pixel.normal, u.x, &pdf);
+				if (light == LIGHT_TREE_NO_LIGHT || pdf <= 0.0f)
+					continue;
+
+				float target = TargetFunction(light, p, n);
+				float weight = target / pdf;
+				reservoir.weightSum += weight;
+				if (u.y * reservoir.weightSum < weight)
+				{
+					reservoir.light = light;
+					selectedTarget = target;
+				}
+			}
+
+			FinishMerge(&reservoir, selectedTarget);
+
+			// A blocked light isn't worth sharing
+			if (settings.visibilityReuse && reservoir.contributionWeight > 0.0f && !IsLightVisible(reservoir.light, p, n, &rows))
+				reservoir.contributionWeight = 0.0f;
+		}
+	}
+
+	raysCast += rows;
+}
+
+// --------------------------------------------------------
+// Merges in the reservoir of the pixel nearest to where
+// each pixel's surface was last frame, if the surface
+// there looks like the same one (capped, so old lights
+// can't outweigh new ones forever)
+// --------------------------------------------------------
+void DirectLightResampler::ReuseTemporal(unsigned int startRow, unsigned int endRow)
+{
+	const std::vector<ReprojectionTaps>& taps = reprojection.GetTaps();
+	for (unsigned int y = startRow; y < endRow; y++)
+	{
+		for (unsigned int x = 0; x < width; x++)
+		{
+			unsigned int index = y * width + x;
+			const GBufferPixel& pixel = gBuffer[index];
+			if (pixel.distance < 0.0f)
+				continue;
+
+			// Reservoirs can't be blended, so the tap with the most weight
+			const ReprojectionTaps& pixelTaps = taps[index];
+			unsigned int nearest = 0;
+			for (unsigned int t = 1; t < 4; t++)
+				nearest = pixelTaps.weights[t] > pixelTaps.weights[nearest] ? t : nearest;
+			if (pixelTaps.weights[nearest] <= 0.0f)
+				continue;
+
+			unsigned int previousIndex = pixelTaps.pixels[nearest];
+			XMVECTOR p = reprojection.PixelPosition(x, y, pixel.distance);
+			XMVECTOR n = XMLoadFloat3(&pixel.normal);
+			Reservoir history = previousReservoirs[previousIndex];
+			Reservoir& reservoir = reservoirs[index];
+			float maxCount = settings.maxHistory * settings.candidateCount;
+			history.sampleCount = history.sampleCount < maxCount ? history.sampleCount : maxCount;
+
+			Reservoir merged;
+			float mergedTarget;
+			BeginMerge(reservoir, reservoir.light != LIGHT_TREE_NO_LIGHT ? TargetFunction(reservoir.light, p, n) : 0.0f, &merged, &mergedTarget);
+			if (history.light != LIGHT_TREE_NO_LIGHT)
+			{
+				float u = Sampler::Sample1D(Sampler::PixelSeed(x, y), frameIndex, TemporalDimension);
+				MergeIn(history, TargetFunction(history.light, p, n), u, &merged, &mergedTarget);
+			}
+			else
+			{
+				merged.sampleCount += history.sampleCount;
+			}
+
+			FinishMerge(&merged, mergedTarget);
+			reservoir = merged;
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Merges in the reservoirs of a few random pixels nearby
+// (skipping any whose surface doesn't look like this
+// one's).  Each light is weighed by this pixel's target
+// for it, and by its share of how likely every merged
+// pixel was to have chosen it (the balance heuristic), so
+// lights that only some of them could reach aren't
+// counted against the rest
+// --------------------------------------------------------
+void DirectLightResampler::ReuseSpatial(unsigned int startRow, unsigned int endRow)
+{
+	unsigned int rows = 0;
+	for (unsigned int y = startRow; y < endRow; y++)
+	{
+		for (unsigned int x = 0; x < width; x++)
+		{
+			unsigned int index = y * width + x;
+			const GBufferPixel& pixel = gBuffer[index];
+			Reservoir& merged = spatialReservoirs[index];
+			if (pixel.distance < 0.0f)
+			{
+				merged = reservoirs[index];
+				continue;
+			}
+
+			// This pixel first, then every neighbour that passes
+			XMVECTOR p = reprojection.PixelPosition(x, y, pixel.distance);
+			XMVECTOR n = XMLoadFloat3(&pixel.normal);
+			unsigned int pixels[MaxSpatialNeighbours + 1] = { index };
+			unsigned int sampleIndices[MaxSpatialNeighbours + 1] = { 0 };
+			unsigned int pixelCount = 1;
+			unsigned int pixelSeed = Sampler::PixelSeed(x, y);
+			for (unsigned int k = 0; k < settings.spatialNeighbours && k < MaxSpatialNeighbours; k++)
+			{
+				// Uniformly within a disk around the pixel
+				unsigned int sampleIndex = frameIndex * settings.spatialNeighbours + k;
+				XMFLOAT2 offset = Sampler::Sample2D(pixelSeed, sampleIndex, NeighbourDimension);
+				float radius = settings.spatialRadius * sqrtf(offset.x);
+				float angle = XM_2PI * offset.y;
+				int neighbourX = (int)x + (int)floorf(radius * cosf(angle) + 0.5f);
+				int neighbourY = (int)y + (int)floorf(radius * sinf(angle) + 0.5f);
+				if (neighbourX < 0 || neighbourY < 0 || neighbourX >= (int)width || neighbourY >= (int)height)
+					continue;
+
+				unsigned int neighbourIndex = neighbourY * width + neighbourX;
+				if (neighbourIndex == index || !IsSimilarSurface(gBuffer[neighbourIndex], n, pixel.distance))
+					continue;
+
+				pixels[pixelCount] = neighbourIndex;
+				sampleIndices[pixelCount] = sampleIndex;
+				pixelCount++;
+			}
+
+			merged = EmptyReservoir;
+			float mergedTarget = 0.0f;
+			for (unsigned int i = 0; i < pixelCount; i++)
+			{
+				const Reservoir& candidate = reservoirs[pixels[i]];
+				merged.sampleCount += candidate.sampleCount;
+				if (candidate.light == LIGHT_TREE_NO_LIGHT || candidate.contributionWeight <= 0.0f)
+					continue;
+
+				// Blocked here, it can't be worth anything (and a neighbour's
+				// light would be weighed as if nothing here could've chosen it)
+				float target = TargetFunction(candidate.light, p, n);
+				if (target <= 0.0f || (i > 0 && settings.visibilityReuse && !IsLightVisible(candidate.light, p, n, &rows)))
+					continue;
+
+				// How likely each pixel was to choose this light, from its own
+				// surface (and, where blocked lights were dropped before being
+				// shared, only if it could see it)
+				float own = 0.0f;
+				float total = 0.0f;
+				for (unsigned int j = 0; j < pixelCount; j++)
+				{
+					const GBufferPixel& other = gBuffer[pixels[j]];
+					XMVECTOR otherPosition = j == 0 ? p : reprojection.PixelPosition(pixels[j] % width, pixels[j] / width, other.distance);
+					XMVECTOR otherNormal = XMLoadFloat3(&other.normal);
+					float otherTarget = j == 0 ? target : TargetFunction(candidate.light, otherPosition, otherNormal);
+					if (j != i && j > 0 && otherTarget > 0.0f && settings.visibilityReuse && !IsLightVisible(candidate.light, otherPosition, otherNormal, &rows))
+						otherTarget = 0.0f;
+
+					float likelihood = reservoirs[pixels[j]].sampleCount * otherTarget;
+					own = j == i ? likelihood : own;
+					total += likelihood;
+				}
+
+				float weight = (total > 0.0f ? own / total : 0.0f) * target * candidate.contributionWeight;
+				merged.weightSum += weight;
+				float u = Sampler::Sample1D(pixelSeed, sampleIndices[i], NeighbourPickDimension);
+				if (u * merged.weightSum < weight)
+				{
+					merged.light = candidate.light;
+					mergedTarget = target;
+				}
+			}
+
+			// The heuristic's weights already sum to one, so no dividing by the count
+			merged.contributionWeight = mergedTarget > 0.0f ? merged.weightSum / mergedTarget : 0.0f;
+		}
+	}
+
+	raysCast += rows;
+}
+
+// --------------------------------------------------------
+// Lights each pixel with its reservoir's light, weighted
+// by W, after one last check that nothing blocks it
+// --------------------------------------------------------
+void DirectLightResampler::Shade(unsigned int startRow, unsigned int endRow)
+{
+	unsigned int rows = 0;
+	for (unsigned int y = startRow; y < endRow; y++)
+	{
+		for (unsigned int x = 0; x < width; x++)
+		{
+			unsigned int index = y * width + x;
+			const GBufferPixel& pixel = gBuffer[index];
+			const Reservoir& reservoir = reservoirs[index];
+			output[index] = XMFLOAT3(0, 0, 0);
+			if (pixel.distance < 0.0f || reservoir.light == LIGHT_TREE_NO_LIGHT || reservoir.contributionWeight <= 0.0f)
+				continue;
+
+			XMVECTOR p = reprojection.PixelPosition(x, y, pixel.distance);
+			XMVECTOR n = XMLoadFloat3(&pixel.normal);
+			if (!IsLightVisible(reservoir.light, p, n, &rows))
+				continue;
+
+			XMVECTOR direction;
+			float distance;
+			XMVECTOR illumination = CpuRaytracer::IlluminationFromLight(lights[reservoir.light], p, &direction, &distance);
+			float cosine = fmaxf(XMVectorGetX(XMVector3Dot(n, direction)), 0.0f);
+			XMStoreFloat3(&output[index], illumination * XMLoadFloat3(&pixel.albedo) * (cosine * reservoir.contributionWeight));
+		}
+	}
+
+	raysCast += rows;
+}
+
+// --------------------------------------------------------
+// What resampling aims for: the brightness a light would
+// give the point if nothing were in the way
+// --------------------------------------------------------
+float DirectLightResampler::TargetFunction(unsigned int light, FXMVECTOR position, FXMVECTOR normal) const
+{
+	XMVECTOR direction;
+	float distance;
+	XMVECTOR illumination = CpuRaytracer::IlluminationFromLight(lights[light], position, &direction, &distance);
+	return Luminance(illumination) * fmaxf(XMVectorGetX(XMVector3Dot(normal, direction)), 0.0f);
+}
+
+bool DirectLightResampler::IsLightVisible(unsigned int light, FXMVECTOR position, FXMVECTOR normal, unsigned int* rays) const
+{
+	XMVECTOR direction;
+	float distance;
+	CpuRaytracer::IlluminationFromLight(lights[light], position, &direction, &distance);
+	if (XMVectorGetX(XMVector3Dot(normal, direction)) <= 0.0f)
+		return false;
+
+	Ray shadowRay = {};
+	XMStoreFloat3(&shadowRay.origin, position);
+	XMStoreFloat3(&shadowRay.direction, direction);
+	shadowRay.maxDistance = distance * 0.999f;
+	(*rays)++;
+	return !sceneBVH.IsOccluded(shadowRay);
+}
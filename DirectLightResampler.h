@@ -0,0 +1,144 @@
+#pragma once
+
+// Direct lighting from many lights by spatiotemporal reservoir resampling
+// (Bitterli et al., "Spatiotemporal reservoir resampling for real-time ray
+// tracing with dynamic direct lighting", 2020 - ReSTIR), on the CPU.
+//
+// Each frame traces a primary ray through every pixel's center into a
+// G-buffer, then keeps a single light per pixel in a reservoir:
+//  - candidates: a few lights chosen by a LightTree, resampled down to
+//    one in proportion to their unshadowed contribution
+//  - visibility: a shadow ray toward that light, dropping it if blocked,
+//    so occluded lights aren't spread to neighbours
+//  - temporal reuse: the pixel's surface is reprojected into the last
+//    frame (see ReprojectionCache.h), and that frame's reservoir nearest
+//    to it is merged in (if the surface there looks like the same one)
+//  - spatial reuse: reservoirs of random nearby pixels on similar surfaces
+//    are merged in as well
+//  - shading: one last shadow ray re-validates the winning light
+// Temporal merging is the biased variant (the last frame's samples are
+// weighed by their count, not re-checked here), kept in check by the
+// surface similarity tests and capping history.  Spatial merging isn't:
+// every neighbour's light is weighed by this pixel's target for it, and
+// by the balance heuristic over how likely each merged pixel was to have
+// chosen it (shadow rays included), which costs a shadow ray per light
+// per merged pixel but keeps lights that only some pixels can see from
+// darkening the rest.
+//
+// Everything per pixel lives in flat arrays of small structs (G-buffer,
+// reservoirs) with no pointers, laid out so they can become structured
+// buffers on the GPU unchanged.
+
+#include <DirectXMath.h>
+#include <atomic>
+#include <vector>
+
+#include "BufferStructs.h"
+#include "LightTree.h"
+#include "ReprojectionCache.h"
+#include "SceneSnapshot.h"
+#include "ScenePicker.h"
+
+// A pixel's chosen light, with what's needed to merge it with others
+struct Reservoir
+{
+	unsigned int light;				// Index into the lights (LIGHT_TREE_NO_LIGHT if none)
+	float weightSum;				// Sum of every candidate's resampling weight
+	float sampleCount;				// How many candidates it stands for (M)
+	float contributionWeight;		// Turns the light's target value into an estimate (W)
+};
+
+struct ResamplerSettings
+{
+	ResamplerSettings();
+
+	unsigned int candidateCount;	// Lights drawn from the tree per pixel per frame
+	bool visibilityReuse;			// Shadow ray for each pixel's candidate before it's shared
+	bool temporalReuse;
+	float maxHistory;				// Most frames' worth of candidates the last frame may count for
+	unsigned int spatialNeighbours;	// Reservoirs merged in from nearby pixels (0 turns it off, at most 32)
+	float spatialRadius;			// In pixels (at 1080p - scale it with the image)
+};
+
+class DirectLightResampler
+{
+public:
+	DirectLightResampler();
+
+	/// <summary>
+	/// Resizes the image (which drops any history)
+	/// </summary>
+	void Resize(unsigned int width, unsigned int height);
+
+	/// <summary>
+	/// Traces and resamples one frame, reusing the last one's reservoirs where the surfaces still match
+	/// </summary>
+	/// <param name="scene">What to trace - must stay alive and unchanged during the call</param>
+	/// <param name="lights">Lights to choose from (any number, unlike the scene's own)</param>
+	/// <param name="lightCount">How many lights there are</param>
+	/// <param name="cameraPosition">Where the camera is</param>
+	/// <param name="view">Camera's view matrix</param>
+	/// <param name="projection">Camera's projection matrix</param>
+	void Render(
+		const SceneSnapshot& scene,
+		const Light* lights,
+		unsigned int lightCount,
+		DirectX::XMFLOAT3 cameraPosition,
+		const DirectX::XMFLOAT4X4& view,
+		const DirectX::XMFLOAT4X4& projection);
+
+	/// <summary>
+	/// Sums every light at every pixel of the last frame, each with its own shadow ray - the
+	/// exact answer Render() is estimating, for measuring its error (and slow with many lights)
+	/// </summary>
+	/// <param name="output">Filled in with one linear color per pixel</param>
+	void RenderReference(std::vector<DirectX::XMFLOAT3>& output) const;
+
+	/// <summary>
+	/// Forgets the last frame, so the next one starts without temporal reuse
+	/// </summary>
+	void ResetHistory();
+
+	// Linear direct lighting of the last frame, one per pixel
+	const std::vector<DirectX::XMFLOAT3>& GetOutput() const;
+	const std::vector<GBufferPixel>& GetGBuffer() const;
+	const std::vector<Reservoir>& GetReservoirs() const;
+
+	ResamplerSettings& GetSettings();
+	unsigned long long GetRaysCast();	// Every ray cast by the last Render()
+	unsigned int GetWidth() const;
+	unsigned int GetHeight() const;
+
+private:
+	unsigned int width;
+	unsigned int height;
+	ResamplerSettings settings;
+	std::atomic<unsigned long long> raysCast;
+
+	ScenePicker sceneBVH;
+	LightTree lightTree;
+	std::vector<Light> lights;
+
+	// This frame's G-buffer, and its reservoirs and the last frame's (swapped each frame)
+	std::vector<GBufferPixel> gBuffer;
+	std::vector<Reservoir> reservoirs;
+	std::vector<Reservoir> previousReservoirs;
+	std::vector<Reservoir> spatialReservoirs;	// Spatial reuse reads one array and writes this one
+	std::vector<DirectX::XMFLOAT3> output;
+
+	// What and where from this frame traces, and where each pixel was last frame
+	const SceneSnapshot* scene;
+	DirectX::XMFLOAT3 cameraPosition;
+	ReprojectionCache reprojection;
+	unsigned int frameIndex;
+
+	void UpdateLights(const Light* newLights, unsigned int lightCount);
+	void TraceGBuffer(unsigned int startRow, unsigned int endRow);
+	void SampleCandidates(unsigned int startRow, unsigned int endRow);
+	void ReuseTemporal(unsigned int startRow, unsigned int endRow);
+	void ReuseSpatial(unsigned int startRow, unsigned int endRow);
+	void Shade(unsigned int startRow, unsigned int endRow);
+
+	float TargetFunction(unsigned int light, DirectX::FXMVECTOR position, DirectX::FXMVECTOR normal) const;
+	bool IsLightVisible(unsigned int light, DirectX::FXMVECTOR position, DirectX::FXMVECTOR normal, unsigned int* rays) const;
+};
@@ -3,24 +3,30 @@
 Entity::Entity(std::shared_ptr<Mesh> mesh, std::shared_ptr<Material> material)
     : mesh(mesh), material(material)
 {
-    transform = std::make_shared<Transform>(Transform()); // The entity starts at (0, 0, 0) by default
+    // The transform starts at (0, 0, 0) by default
+}
+
+Entity::Entity(std::shared_ptr<Mesh> mesh, std::shared_ptr<Material> material, Entity* parent)
+    : Entity(mesh, material)
+{
+    transform.SetParent(parent ? parent->GetTransform() : 0);
 }
 
 Entity::~Entity()
 {
 }
 
-std::shared_ptr<Mesh> Entity::GetMesh()
+const std::shared_ptr<Mesh>& Entity::GetMesh()
 {
     return mesh;
 }
 
-std::shared_ptr<Transform> Entity::GetTransform()
+Transform* Entity::GetTransform()
 {
-    return transform;
+    return &transform;
 }
 
-std::shared_ptr<Material> Entity::GetMaterial()
+const std::shared_ptr<Material>& Entity::GetMaterial()
 {
     return material;
 }
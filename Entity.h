@@ -10,13 +10,14 @@
 
 class Entity {
 public:
-	Entity(std::shared_ptr<Mesh> mesh, std::shared_ptr<Material> material); // add constructor that takes transform or one that takes parent?
+	Entity(std::shared_ptr<Mesh> mesh, std::shared_ptr<Material> material);
+	Entity(std::shared_ptr<Mesh> mesh, std::shared_ptr<Material> material, Entity* parent); // Transform will be relative to the parent's
 	~Entity();
 
-	// Getters
-	std::shared_ptr<Mesh> GetMesh();
-	std::shared_ptr<Transform> GetTransform();
-	std::shared_ptr<Material> GetMaterial();
+	// Getters (returned by reference to avoid refcount traffic on hot paths)
+	const std::shared_ptr<Mesh>& GetMesh();
+	Transform* GetTransform();
+	const std::shared_ptr<Material>& GetMaterial();
 
 
 	// Setters
@@ -24,7 +25,7 @@ public:
 	void SetMaterial(std::shared_ptr<Material> newMaterial);
 
 private:
-	std::shared_ptr<Transform> transform;
+	Transform transform; // Just a handle - the data lives in the TransformSystem
 	std::shared_ptr<Mesh> mesh;
 	std::shared_ptr<Material> material;
 };
\ No newline at end of file
@@ -0,0 +1,140 @@
+#include "FrameArena.h"
+
+#include <cstdlib>
+#include <cstdint>
+
+// Singleton requirement
+FrameArena* FrameArena::instance;
+
+// --------------------------------------------------------
+// Clean up all of the blocks the arena owns
+// --------------------------------------------------------
+FrameArena::~FrameArena()
+{
+	FreeAllBlocks();
+}
+
+// --------------------------------------------------------
+// Sets up the arena with a single block of the given size
+// --------------------------------------------------------
+void FrameArena::Initialize(size_t initialSizeInBytes)
+{
+	FreeAllBlocks();
+	AddBlock(initialSizeInBytes);
+	currentBlock = 0;
+	currentOffset = 0;
+	bytesUsedThisFrame = 0;
+}
+
+// --------------------------------------------------------
+// Bumps through the current block, moving on to the next
+// block (or creating a new one) when the request won't fit
+//
+// sizeInBytes - How many bytes are needed
+// alignment   - Required alignment (must be a power of two)
+// --------------------------------------------------------
+void* FrameArena::Allocate(size_t sizeInBytes, size_t alignment)
+{
+	if (blocks.empty())
+		AddBlock(sizeInBytes + alignment);
+
+	while (true)
+	{
+		Block& block = blocks[currentBlock];
+
+		// Align the actual address, not just the offset, since
+		// the block itself may not be aligned to "alignment"
+		uintptr_t start = (uintptr_t)block.memory + currentOffset;
+		uintptr_t aligned = (start + alignment - 1) & ~(uintptr_t)(alignment - 1);
+		size_t newOffset = (size_t)(aligned - (uintptr_t)block.memory) + sizeInBytes;
+
+		// Does it fit?
+		if (newOffset <= block.sizeInBytes)
+		{
+			bytesUsedThisFrame += newOffset - currentOffset;
+			currentOffset = newOffset;
+			return (void*)aligned;
+		}
+
+		// Nope, so move on to the next block, creating one if necessary.
+		// New blocks at least double the arena so we converge quickly.
+		if (currentBlock + 1 >= blocks.size())
+		{
+			size_t doubled = block.sizeInBytes * 2;
+			size_t needed = sizeInBytes + alignment;
+			AddBlock(doubled > needed ? doubled : needed);
+		}
+		currentBlock++;
+		currentOffset = 0;
+	}
+}
+
+// --------------------------------------------------------
+// Rewinds the arena to the start of the first block.  If the
+// frame spilled into more than one block, all blocks are
+// merged into a single one big enough for the whole frame so
+// that the next frame doesn't need to hit the heap at all.
+// --------------------------------------------------------
+void FrameArena::Reset()
+{
+	if (bytesUsedThisFrame > highWaterMarkInBytes)
+		highWaterMarkInBytes = bytesUsedThisFrame;
+
+	if (blocks.size() > 1)
+	{
+		size_t totalSize = 0;
+		for (Block& b : blocks)
+			totalSize += b.sizeInBytes;
+
+		FreeAllBlocks();
+		AddBlock(totalSize);
+	}
+
+	currentBlock = 0;
+	currentOffset = 0;
+	bytesUsedThisFrame = 0;
+
+	heapAllocationsLastFrame = heapAllocationsThisFrame;
+	heapAllocationsThisFrame = 0;
+}
+
+size_t FrameArena::GetBytesUsedThisFrame()
+{
+	return bytesUsedThisFrame;
+}
+
+size_t FrameArena::GetHighWaterMarkInBytes()
+{
+	return highWaterMarkInBytes;
+}
+
+unsigned int FrameArena::GetHeapAllocationCount()
+{
+	return heapAllocationCount;
+}
+
+unsigned int FrameArena::GetHeapAllocationsLastFrame()
+{
+	return heapAllocationsLastFrame;
+}
+
+// --------------------------------------------------------
+// Allocates a new block from the heap (and counts it)
+// --------------------------------------------------------
+void FrameArena::AddBlock(size_t sizeInBytes)
+{
+	Block block = {};
+	block.memory = (char*)malloc(sizeInBytes);
+	block.sizeInBytes = sizeInBytes;
+	blocks.push_back(block);
+
+	heapAllocationCount++;
+	heapAllocationsThisFrame++;
+}
+
+void FrameArena::FreeAllBlocks()
+{
+	for (Block& b : blocks)
+		free(b.memory);
+	blocks.clear();
+}
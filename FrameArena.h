@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// A bump allocator for transient, per-frame CPU data.  Allocations are
+// just a pointer increment into a big block that is "freed" all at once
+// when the frame ends, so per-frame paths (like rebuilding the picker's
+// instance hierarchy) don't need to touch the heap at all once the arena
+// is warmed up.  Not thread safe: only the render thread, which resets it
+// at the end of each frame, should allocate from it.
+class FrameArena
+{
+#pragma region Singleton
+public:
+	// Gets the one and only instance of this class
+	static FrameArena& GetInstance()
+	{
+		if (!instance)
+		{
+			instance = new FrameArena();
+		}
+
+		return *instance;
+	}
+
+	// Remove these functions (C++ 11 version)
+	FrameArena(FrameArena const&) = delete;
+	void operator=(FrameArena const&) = delete;
+
+private:
+	static FrameArena* instance;
+	FrameArena() :
+		currentBlock(0),
+		currentOffset(0),
+		bytesUsedThisFrame(0),
+		highWaterMarkInBytes(0),
+		heapAllocationCount(0),
+		heapAllocationsThisFrame(0),
+		heapAllocationsLastFrame(0)
+	{};
+#pragma endregion
+
+public:
+	~FrameArena();
+
+	/// <summary>
+	/// Creates the arena's initial block.  Should be big enough for a typical frame; the arena will grow if it isn't.
+	/// </summary>
+	/// <param name="initialSizeInBytes">How many bytes to reserve up front</param>
+	void Initialize(size_t initialSizeInBytes);
+
+	/// <summary>
+	/// Grabs a chunk of memory that stays valid until the next call to Reset()
+	/// </summary>
+	/// <param name="sizeInBytes">How many bytes are needed</param>
+	/// <param name="alignment">Required alignment of the returned address (power of two)</param>
+	/// <returns>Pointer to the (uninitialized) memory</returns>
+	void* Allocate(size_t sizeInBytes, size_t alignment = alignof(std::max_align_t));
+
+	/// <summary>
+	/// Releases everything allocated this frame.  Call once at the very end of each frame.
+	/// </summary>
+	void Reset();
+
+	// Stats
+	size_t GetBytesUsedThisFrame();
+	size_t GetHighWaterMarkInBytes();
+	unsigned int GetHeapAllocationCount(); // Total number of times the arena itself has gone to the heap
+	unsigned int GetHeapAllocationsLastFrame(); // Should be zero in steady state!
+
+private:
+	struct Block
+	{
+		char* memory;
+		size_t sizeInBytes;
+	};
+
+	std::vector<Block> blocks;
+	size_t currentBlock;	// Which block we're bumping through
+	size_t currentOffset;	// How far into that block we are
+
+	size_t bytesUsedThisFrame;
+	size_t highWaterMarkInBytes;
+
+	unsigned int heapAllocationCount;
+	unsigned int heapAllocationsThisFrame;
+	unsigned int heapAllocationsLastFrame;
+
+	void AddBlock(size_t sizeInBytes);
+	void FreeAllBlocks();
+};
+
+
+// --------------------------------------------------------
+// Standard-library-compatible allocator that pulls memory
+// from the frame arena.  Deallocation is a no-op, since the
+// whole arena is reset at the end of the frame.
+//
+// Note: Containers using this must not outlive the frame,
+//       and should reserve() up front, as every regrowth
+//       leaves the old storage behind until the reset
+// --------------------------------------------------------
+template<typename T>
+struct FrameAllocator
+{
+	typedef T value_type;
+
+	FrameAllocator() = default;
+	template<typename U> FrameAllocator(const FrameAllocator<U>&) {}
+
+	T* allocate(size_t count)
+	{
+		return static_cast<T*>(FrameArena::GetInstance().Allocate(sizeof(T) * count, alignof(T)));
+	}
+
+	void deallocate(T*, size_t) {}
+
+	template<typename U> bool operator==(const FrameAllocator<U>&) const { return true; }
+	template<typename U> bool operator!=(const FrameAllocator<U>&) const { return false; }
+};
+
+// Vector whose storage lives in the frame arena
+template<typename T>
+using FrameVector = std::vector<T, FrameAllocator<T>>;
@@ -5,6 +5,10 @@
 #include "PathHelpers.h"
 #include "DX12Helper.h"
 #include "RaytracingHelper.h"
+#include "FrameArena.h"
+#include "AllocationTracker.h"
+#include "GpuMemoryRegistry.h"
+#include "JobSystem.h"
 
 
 // Needed for a helper function to load pre-compiled shader files
@@ -30,8 +34,12 @@ Game::Game(HINSTANCE hInstance)
 		1280,				// Width of the window's client area
 		720,				// Height of the window's client area
 		false,				// Sync the framerate to the monitor refresh? (lock framerate)
-		true)				// Show extra stats (fps) in title bar?
+		true),				// Show extra stats (fps) in title bar?
+	threadedSimulation(true)	// Run the simulation on its own thread at a fixed tick?
 {
+	// Picking appends to the title, so remember what it started as
+	windowTitle = titleBarText;
+
 #if defined(DEBUG) || defined(_DEBUG)
 	// Do we want a console window?  Probably only in debug mode
 	CreateConsoleWindow(500, 120, 32, 120);
@@ -53,9 +61,24 @@ Game::~Game()
 	// Call Release() on any Direct3D objects made within this class
 	// - Note: this is unnecessary for D3D objects stored in ComPtrs
 
+	// Nothing else can be cleaned up while the simulation is still using it
+	if (simulation)
+		simulation->Stop();
+
 	// Cannot delete until the GPU is done with its work
 	DX12Helper::GetInstance().WaitForGPU();
+
+#if defined(DEBUG) || defined(_DEBUG)
+	// Leave a record of what GPU memory the program ended up using
+	GpuMemoryRegistry::GetInstance().DumpToJSONFile(FixPath(L"GpuMemoryReport.json").c_str());
+#endif
+
 	delete& RaytracingHelper::GetInstance();
+	delete& FrameArena::GetInstance();
+	delete& JobSystem::GetInstance();
+
+	// Note: The TransformSystem is deliberately not deleted here, since
+	//       entities and the camera free their transforms after this runs
 }
 
 // --------------------------------------------------------
@@ -64,6 +87,18 @@ Game::~Game()
 // --------------------------------------------------------
 void Game::Init()
 {
+	// Worker threads for splitting per-frame loops across cores
+	JobSystem::GetInstance().Initialize();
+
+	// Scratch memory for per-frame CPU work on this thread (like the
+	// picker's rebuilds) - it grows if a frame ever needs more
+	FrameArena::GetInstance().Initialize(256 * 1024);
+
+	// Per-frame work should never touch the heap once we're up and running
+	AllocationTracker::SetFrameBudget(AllocationTag::Update, 0);
+	AllocationTracker::SetFrameBudget(AllocationTag::Raytracing, 0);
+	AllocationTracker::SetFrameBudget(AllocationTag::Rendering, 0);
+
 	// Attempt to initialize DXR (DirectX Raytracing)
 	RaytracingHelper::GetInstance().Initialize(
 		windowWidth,
@@ -78,6 +113,22 @@ void Game::Init()
 	//  - You'll be expanding and/or replacing these later
 	CreateRootSigAndPipelineState();
 	CreateBasicGeometry();
+
+	// Hand the scene over to its own thread, which ticks at a fixed rate
+	// no matter how long frames take to draw (and vice versa)
+	if (threadedSimulation)
+	{
+		TransformSystem::GetInstance().UpdateAllMatrices();
+		simulation = std::make_unique<SimulationThread>(
+			60.0f,
+			[this](float deltaTime, float totalTime, const CameraControls& controls) { Simulate(deltaTime, totalTime, controls); },
+			[this](SceneSnapshot& snapshot) { CaptureSnapshot(snapshot); });
+		simulation->Start();
+
+		// Start out with the initial state as both the previous and latest snapshots
+		simulation->AcquireLatestSnapshot();
+		previousSnapshot = simulation->GetLatestSnapshot();
+	}
 }
 
 // --------------------------------------------------------
@@ -395,6 +446,11 @@ void Game::CreateBasicGeometry()
 	entities[entities.size()-1]->GetTransform()->SetScale(XMFLOAT3(500, 1, 500));
 	entities[entities.size()-1]->GetTransform()->SetPosition(XMFLOAT3(0, -10, 0));
 
+	// Index every entity by its bounds, following its transform from here on
+	spatialIndex = std::make_unique<SpatialIndex>(XMFLOAT3(0, 0, 0), 1024.0f);
+	for (unsigned int i = 0; i < entities.size(); i++)
+		spatialIndex->InsertTracked(entities[i]->GetTransform()->GetHandle(), entities[i]->GetMesh()->GetLocalBounds(), i);
+
 	// Meshes create their own BLAS's; we just need to create the TLAS for the scene here
 	RaytracingHelper::GetInstance().CreateTopLevelAccelerationStructureForScene(entities);
 }
@@ -418,19 +474,80 @@ void Game::OnResize()
 // --------------------------------------------------------
 void Game::Update(float deltaTime, float totalTime)
 {
-	for (unsigned int i = 0; i < entities.size() - 1; i++) {
-		std::shared_ptr<Entity> entity = entities[i];
-		entity->GetTransform()->RotateBy(0.0f, 0.0f, deltaTime/4);
-		entity->GetTransform()->SetPosition(entity->GetTransform()->GetPosition()->x, entity->GetTransform()->GetPosition()->y - sin(totalTime - deltaTime) + sin(totalTime), entity->GetTransform()->GetPosition()->z);
-	}
+	AllocationScope allocationScope(AllocationTag::Update);
 
-	camera->Update(deltaTime);
+	// Either hand the input over to the simulation thread, or simulate right here
+	if (simulation)
+		simulation->SubmitControls(Camera::ReadControls());
+	else
+		Simulate(deltaTime, totalTime, Camera::ReadControls());
 
 	// Example input checking: Quit if the escape key is pressed
 	if (Input::GetInstance().KeyDown(VK_ESCAPE))
 		Quit();
 }
 
+// --------------------------------------------------------
+// Advances the simulation - moves objects, the camera, etc.
+// Runs on the simulation thread (at a fixed tick) when it's
+// enabled, or from Update() otherwise.
+// --------------------------------------------------------
+void Game::Simulate(float deltaTime, float totalTime, const CameraControls& controls)
+{
+	// Animate everything but the floor, spread across every core
+	// - Each entity only touches its own transform, and the only shared
+	//   state (the frame's time and bob offset) is read-only, so the
+	//   result is the same no matter how many threads do the work
+	// - Nothing in here may create/destroy transforms or change parents
+	float bobOffset = sin(totalTime) - sin(totalTime - deltaTime);
+	JobSystem::GetInstance().ParallelFor((unsigned int)entities.size() - 1, 256,
+		[&](unsigned int start, unsigned int end)
+		{
+			for (unsigned int i = start; i < end; i++) {
+				Transform* transform = entities[i]->GetTransform();
+				transform->RotateBy(0.0f, 0.0f, deltaTime / 4);
+				transform->MoveBy(0.0f, bobOffset, 0.0f);
+			}
+		});
+
+	camera->Update(deltaTime, controls);
+
+	// Recalculate every matrix that changed this frame in one pass, rather
+	// than lazily as each one is asked for while drawing
+	TransformSystem::GetInstance().UpdateAllMatrices();
+
+	// Then move anything that changed in the spatial index
+	spatialIndex->SyncWithTransforms();
+}
+
+// --------------------------------------------------------
+// Copies everything the renderer needs out of the scene
+// (called by the simulation thread after it ticks)
+// --------------------------------------------------------
+void Game::CaptureSnapshot(SceneSnapshot& snapshot)
+{
+	// Only reallocates if the scene has grown
+	snapshot.instances.resize(entities.size());
+	for (unsigned int i = 0; i < entities.size(); i++)
+	{
+		Entity* entity = entities[i].get();
+		SnapshotInstance& instance = snapshot.instances[i];
+		instance.entity = entity;
+		instance.mesh = entity->GetMesh().get();
+		instance.material = entity->GetMaterial().get();
+		instance.transformVersion = entity->GetTransform()->GetVersion();
+		instance.worldMatrix = entity->GetTransform()->GetWorldMatrix();
+		instance.worldInverseTransposeMatrix = entity->GetTransform()->GetWorldInverseTransposeMatrix();
+	}
+
+	snapshot.camera.position = *camera->GetTransform()->GetPosition();
+	snapshot.camera.rotation = *camera->GetTransform()->GetRotation();
+
+	snapshot.lightCount = (unsigned int)min(lightsToRender.size(), (size_t)SNAPSHOT_MAX_LIGHTS);
+	for (unsigned int i = 0; i < snapshot.lightCount; i++)
+		snapshot.lights[i] = lightsToRender[i];
+}
+
 // --------------------------------------------------------
 // Clear the screen, redraw everything, present to the user
 // --------------------------------------------------------
@@ -495,19 +612,65 @@ void Game::Draw(float deltaTime, float totalTime)
 		//commandList->IASetIndexBuffer(&ibView);
 		commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
+		// Cull first, so only entities that could be visible are drawn
+		// - Frustum only: there's no depth from earlier frames to test occlusion against
+		// - When threaded, the entities and camera belong to the simulation
+		//   thread, so cull and draw from its latest snapshot instead
+		const SceneSnapshot* snapshot = simulation ? &simulation->GetLatestSnapshot() : 0;
+		XMFLOAT4X4 view;
+		XMFLOAT3 cameraPosition;
+		if (snapshot)
+		{
+			view = camera->GetViewMatrix(snapshot->camera.position, snapshot->camera.rotation);
+			cameraPosition = snapshot->camera.position;
+			visibilityCuller.SetBounds(*snapshot);
+		}
+		else
+		{
+			view = camera->GetViewMatrix();
+			cameraPosition = *camera->GetTransform()->GetPosition();
+			visibilityCuller.SetBounds(entities);
+		}
+		XMFLOAT4X4 projection = camera->GetProjectionMatrix();
+		XMFLOAT4X4 viewProjection;
+		XMStoreFloat4x4(&viewProjection, XMMatrixMultiply(XMLoadFloat4x4(&view), XMLoadFloat4x4(&projection)));
+		visibilityCuller.Cull(viewProjection, visibleEntities);
+
+		// Lights come from the same place
+		const Light* lights = snapshot ? snapshot->lights : lightsToRender.data();
+		unsigned int lightCount = snapshot ? snapshot->lightCount : (unsigned int)min(lightsToRender.size(), (size_t)SNAPSHOT_MAX_LIGHTS);
+
 		// Draw
 		//commandList->DrawIndexedInstanced(3, 1, 0, 0, 0);
-		for (unsigned int i = 0; i < entities.size(); i++) {
-			std::shared_ptr<Mesh> mesh = entities[i]->GetMesh();
-			std::shared_ptr<Material> mat = entities[i]->GetMaterial();
+		for (unsigned int i : visibleEntities) {
+			// Everything drawn comes from whatever the bounds were culled from
+			Mesh* mesh;
+			Material* mat;
+			XMFLOAT4X4 world;
+			XMFLOAT4X4 worldInvTranspose;
+			if (snapshot)
+			{
+				const SnapshotInstance& instance = snapshot->instances[i];
+				mesh = instance.mesh;
+				mat = instance.material;
+				world = instance.worldMatrix;
+				worldInvTranspose = instance.worldInverseTransposeMatrix;
+			}
+			else
+			{
+				mesh = entities[i]->GetMesh().get();
+				mat = entities[i]->GetMaterial().get();
+				world = entities[i]->GetTransform()->GetWorldMatrix();
+				worldInvTranspose = entities[i]->GetTransform()->GetWorldInverseTransposeMatrix();
+			}
 
 			// Vertex shader cbuffer setup
 			{
 				VertexShaderExternalData vsed = {};
-				vsed.world = entities[i]->GetTransform()->GetWorldMatrix();
-				vsed.worldInvTranspose = entities[i]->GetTransform()->GetWorldInverseTransposeMatrix();
-				vsed.view = camera->GetViewMatrix();
-				vsed.projection = camera->GetProjectionMatrix();
+				vsed.world = world;
+				vsed.worldInvTranspose = worldInvTranspose;
+				vsed.view = view;
+				vsed.projection = projection;
 
 				D3D12_GPU_DESCRIPTOR_HANDLE vsedHandle = DX12Helper::GetInstance().FillNextConstantBufferAndGetGPUDescriptorHandle(&vsed, 4 * sizeof(DirectX::XMFLOAT4X4));
 				commandList->SetGraphicsRootDescriptorTable(0, vsedHandle);
@@ -518,9 +681,9 @@ void Game::Draw(float deltaTime, float totalTime)
 				PixelShaderExternalData psed = {};
 				psed.uvScale = mat->GetUVScale();
 				psed.uvOffset = mat->GetUVOffset();
-				psed.cameraPosition = *camera->GetTransform()->GetPosition();
-				psed.lightCount = (int)lightsToRender.size();
-				memcpy(psed.lights, &lightsToRender[0], sizeof(Light) * (int)lightsToRender.size());
+				psed.cameraPosition = cameraPosition;
+				psed.lightCount = (int)lightCount;
+				memcpy(psed.lights, lights, sizeof(Light) * lightCount);
 
 				// Send this to a chunk of the constant buffer heap and grab the GPU handle for it so we can set it for this draw
 				D3D12_GPU_DESCRIPTOR_HANDLE cbHandlePS = DX12Helper::GetInstance().FillNextConstantBufferAndGetGPUDescriptorHandle((void*)(&psed), sizeof(PixelShaderExternalData));
@@ -554,15 +717,73 @@ void Game::Draw(float deltaTime, float totalTime)
 
 	// ============ RAYTRACING ============
 	// Update raytracing accel structure
-	RaytracingHelper::GetInstance().CreateTopLevelAccelerationStructureForScene(entities);
-	RaytracingHelper::GetInstance().Raytrace(camera, backBuffers[currentSwapBuffer]);
-	DX12Helper::GetInstance().WaitForGPU();
-	commandAllocator->Reset();
-	commandList->Reset(commandAllocator.Get(), 0);
+	Input& input = Input::GetInstance();
+	Ray mouseRay; // Through the pixel under the mouse, from wherever the camera was drawn
+	{
+		AllocationScope allocationScope(AllocationTag::Raytracing);
+		if (simulation)
+		{
+			// Grab the newest snapshot (keeping the one it replaces to blend from)
+			if (simulation->HasNewSnapshot())
+			{
+				previousSnapshot = simulation->GetLatestSnapshot();
+				simulation->AcquireLatestSnapshot();
+			}
+			const SceneSnapshot& latestSnapshot = simulation->GetLatestSnapshot();
+
+			// Draw one tick in the past, so there's always a newer snapshot to blend towards
+			double renderTime = simulation->GetTime() - simulation->GetTickSeconds();
+			double snapshotGap = latestSnapshot.time - previousSnapshot.time;
+			float alpha = snapshotGap > 0 ? (float)((renderTime - previousSnapshot.time) / snapshotGap) : 1.0f;
+			const SceneSnapshot& frame = snapshotInterpolator.Interpolate(previousSnapshot, latestSnapshot, alpha);
+
+			XMFLOAT4X4 view = camera->GetViewMatrix(frame.camera.position, frame.camera.rotation);
+			RaytracingHelper::GetInstance().CreateTopLevelAccelerationStructureForScene(frame);
+			RaytracingHelper::GetInstance().SetLights(frame.lights, frame.lightCount);
+			RaytracingHelper::GetInstance().Raytrace(
+				frame.camera.position,
+				view,
+				camera->GetProjectionMatrix(),
+				backBuffers[currentSwapBuffer]);
+
+			// Keep the CPU copy of the scene matching what's on screen
+			scenePicker.Update(frame);
+			mouseRay = ScenePicker::CalculateRayFromCamera(frame.camera.position, view, camera->GetProjectionMatrix(),
+				(float)input.GetMouseX(), (float)input.GetMouseY(), windowWidth, windowHeight);
+		}
+		else
+		{
+			RaytracingHelper::GetInstance().CreateTopLevelAccelerationStructureForScene(entities);
+			RaytracingHelper::GetInstance().SetLights(lightsToRender.data(), (unsigned int)lightsToRender.size());
+			RaytracingHelper::GetInstance().Raytrace(camera, backBuffers[currentSwapBuffer]);
+
+			scenePicker.Update(entities);
+			mouseRay = ScenePicker::CalculateRayFromCamera(camera.get(),
+				(float)input.GetMouseX(), (float)input.GetMouseY(), windowWidth, windowHeight);
+		}
+		DX12Helper::GetInstance().WaitForGPU();
+		commandAllocator->Reset();
+		commandList->Reset(commandAllocator.Get(), 0);
+	}
+
+	// Right click to see what's under the mouse (shown in the title bar
+	// with the other stats, so outside the raytracing allocation scope)
+	if (input.MouseRightPress())
+	{
+		PickResult pick = scenePicker.Pick(mouseRay);
+		wchar_t pickText[128];
+		if (pick.hit)
+			swprintf_s(pickText, L"    Picked: entity %u, triangle %u, %.2f away", pick.instance, pick.triangle, pick.distance);
+		else
+			swprintf_s(pickText, L"    Picked: nothing");
+		titleBarText = windowTitle + pickText;
+	}
 
 	// ============ PRESENTING ============
 	// Present
 	{
+		AllocationScope allocationScope(AllocationTag::Rendering);
+
 		/*
 		// Transition back to present
 		D3D12_RESOURCE_BARRIER rb = {};
@@ -589,4 +810,14 @@ void Game::Draw(float deltaTime, float totalTime)
 			currentSwapBuffer = 0;
 	}
 
+	// Everything allocated from the frame arena this frame is now dead
+	FrameArena::GetInstance().Reset();
+#if defined(DEBUG) || defined(_DEBUG)
+	// Budgets are only enforced once everything has warmed up (first-frame
+	// allocations like growing the TLAS buffers are expected)
+	AllocationTracker::SetBudgetEnforcement(totalTime > 1.0f);
+#endif
+	AllocationTracker::EndFrame();
+	GpuMemoryRegistry::GetInstance().AdvanceFrame();
+
 }
\ No newline at end of file
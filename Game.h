@@ -3,6 +3,10 @@
 #include "Entity.h"
 #include "Camera.h"
 #include "Lights.h"
+#include "ScenePicker.h"
+#include "SimulationThread.h"
+#include "SpatialIndex.h"
+#include "VisibilityCuller.h"
 
 #include <memory>
 #include <vector>
@@ -32,6 +36,10 @@ private:
 	void CreateRootSigAndPipelineState();
 	void CreateBasicGeometry();
 
+	// Simulation steps (run either here in Update() or on the simulation thread)
+	void Simulate(float deltaTime, float totalTime, const CameraControls& controls);
+	void CaptureSnapshot(SceneSnapshot& snapshot);
+
 	// Note the usage of ComPtr below
 	//  - This is a smart pointer for objects that abide by the
 	//     Component Object Model, which DirectX objects do
@@ -44,10 +52,26 @@ private:
 	// Game variables
 	std::vector<std::shared_ptr<Entity>> entities;
 	std::shared_ptr<Camera> camera;
+	std::unique_ptr<SpatialIndex> spatialIndex; // Entity bounds (userData is the index into entities) - owned by the simulation
+	ScenePicker scenePicker; // CPU copy of whatever was last drawn, for picking - owned by the renderer
+	std::wstring windowTitle; // Title bar text before anything was picked
+
+	// Culling for the raster path
+	VisibilityCuller visibilityCuller;
+	std::vector<unsigned int> visibleEntities;
 
 	// Lighting variables
 	std::unordered_map<int, std::shared_ptr<Light>> activeLights;
 	std::vector<Light> lightsToRender;
 	std::vector<std::shared_ptr<Light>> allLights;
+
+	// Simulation
+	// - When threaded, the simulation thread owns the entities, their
+	//   transforms and the camera's transform; Update() just hands it
+	//   input, and Draw() only looks at the snapshots it publishes
+	bool threadedSimulation;
+	std::unique_ptr<SimulationThread> simulation;
+	SceneSnapshot previousSnapshot; // The one before the latest, for interpolating
+	SnapshotInterpolator snapshotInterpolator;
 };
 
@@ -0,0 +1,275 @@
+#include "GpuMemoryRegistry.h"
+
+#include <cstdio>
+#include <sstream>
+
+// Singleton requirement
+GpuMemoryRegistry* GpuMemoryRegistry::instance;
+
+// Helper to write a string into a JSON document
+static void WriteJSONString(std::ostringstream& out, const std::string& str)
+{
+	out << '"';
+	for (char c : str)
+	{
+		switch (c)
+		{
+		case '"':  out << "\\\""; break;
+		case '\\': out << "\\\\"; break;
+		case '\n': out << "\\n"; break;
+		case '\r': out << "\\r"; break;
+		case '\t': out << "\\t"; break;
+		default:
+			if ((unsigned char)c < 0x20) { char buf[8]; snprintf(buf, sizeof(buf), "\\u%04x", c); out << buf; }
+			else out << c;
+		}
+	}
+	out << '"';
+}
+
+uint64_t GpuMemoryRegistry::RegisterAllocation(GpuMemoryCategory category, uint64_t sizeInBytes, const char* debugName)
+{
+	std::lock_guard<std::mutex> lock(registryMutex);
+
+	Allocation alloc = {};
+	alloc.category = category;
+	alloc.sizeInBytes = sizeInBytes;
+	alloc.createdFrame = currentFrame;
+	if (debugName) alloc.debugName = debugName;
+
+	uint64_t id = nextAllocationID++;
+	liveAllocations[id] = alloc;
+
+	// Update the category's numbers
+	GpuMemoryStats& s = stats[(int)category];
+	s.liveBytes += sizeInBytes;
+	s.liveAllocations++;
+	s.totalAllocations++;
+	if (s.liveBytes > s.highWaterMarkBytes)
+		s.highWaterMarkBytes = s.liveBytes;
+
+	// And the overall numbers
+	totalLiveBytes += sizeInBytes;
+	if (totalLiveBytes > totalHighWaterMark)
+		totalHighWaterMark = totalLiveBytes;
+
+	return id;
+}
+
+void GpuMemoryRegistry::ReleaseAllocation(uint64_t allocationID)
+{
+	std::lock_guard<std::mutex> lock(registryMutex);
+
+	auto it = liveAllocations.find(allocationID);
+	if (it == liveAllocations.end())
+		return;
+
+	const Allocation& alloc = it->second;
+	GpuMemoryStats& s = stats[(int)alloc.category];
+	s.liveBytes -= alloc.sizeInBytes;
+	s.liveAllocations--;
+	s.releasedAllocations++;
+	s.releasedLifetimeFrames += currentFrame - alloc.createdFrame;
+	totalLiveBytes -= alloc.sizeInBytes;
+
+	liveAllocations.erase(it);
+}
+
+void GpuMemoryRegistry::RecordReallocation(GpuMemoryCategory category)
+{
+	std::lock_guard<std::mutex> lock(registryMutex);
+	stats[(int)category].reallocations++;
+}
+
+void GpuMemoryRegistry::Reset()
+{
+	std::lock_guard<std::mutex> lock(registryMutex);
+
+	liveAllocations.clear();
+	nextAllocationID = 1;
+	currentFrame = 0;
+	for (int c = 0; c < (int)GpuMemoryCategory::Count; c++)
+	{
+		stats[c] = {};
+		budgets[c] = 0;
+	}
+	totalLiveBytes = 0;
+	totalHighWaterMark = 0;
+}
+
+void GpuMemoryRegistry::AdvanceFrame()
+{
+	std::lock_guard<std::mutex> lock(registryMutex);
+	currentFrame++;
+}
+
+uint64_t GpuMemoryRegistry::GetCurrentFrame()
+{
+	std::lock_guard<std::mutex> lock(registryMutex);
+	return currentFrame;
+}
+
+GpuMemoryStats GpuMemoryRegistry::GetStats(GpuMemoryCategory category)
+{
+	std::lock_guard<std::mutex> lock(registryMutex);
+	return stats[(int)category];
+}
+
+// --------------------------------------------------------
+// Sums all categories.  The high-water mark is the true peak
+// of the overall total, not the sum of per-category peaks.
+// --------------------------------------------------------
+GpuMemoryStats GpuMemoryRegistry::GetTotalStats()
+{
+	std::lock_guard<std::mutex> lock(registryMutex);
+
+	GpuMemoryStats total = {};
+	for (int c = 0; c < (int)GpuMemoryCategory::Count; c++)
+	{
+		total.liveBytes += stats[c].liveBytes;
+		total.liveAllocations += stats[c].liveAllocations;
+		total.totalAllocations += stats[c].totalAllocations;
+		total.reallocations += stats[c].reallocations;
+		total.releasedAllocations += stats[c].releasedAllocations;
+		total.releasedLifetimeFrames += stats[c].releasedLifetimeFrames;
+	}
+	total.highWaterMarkBytes = totalHighWaterMark;
+	return total;
+}
+
+uint64_t GpuMemoryRegistry::GetLiveBytes(GpuMemoryCategory category)
+{
+	return GetStats(category).liveBytes;
+}
+
+uint64_t GpuMemoryRegistry::GetTotalLiveBytes()
+{
+	std::lock_guard<std::mutex> lock(registryMutex);
+	return totalLiveBytes;
+}
+
+uint64_t GpuMemoryRegistry::GetHighWaterMark(GpuMemoryCategory category)
+{
+	return GetStats(category).highWaterMarkBytes;
+}
+
+uint64_t GpuMemoryRegistry::GetTotalHighWaterMark()
+{
+	std::lock_guard<std::mutex> lock(registryMutex);
+	return totalHighWaterMark;
+}
+
+void GpuMemoryRegistry::SetBudget(GpuMemoryCategory category, uint64_t maxLiveBytes)
+{
+	std::lock_guard<std::mutex> lock(registryMutex);
+	budgets[(int)category] = maxLiveBytes;
+}
+
+bool GpuMemoryRegistry::IsWithinBudget(GpuMemoryCategory category)
+{
+	std::lock_guard<std::mutex> lock(registryMutex);
+	uint64_t budget = budgets[(int)category];
+	return budget == 0 || stats[(int)category].liveBytes <= budget;
+}
+
+bool GpuMemoryRegistry::AreAllWithinBudget()
+{
+	for (int c = 0; c < (int)GpuMemoryCategory::Count; c++)
+	{
+		if (!IsWithinBudget((GpuMemoryCategory)c))
+			return false;
+	}
+	return true;
+}
+
+// --------------------------------------------------------
+// Builds a JSON report with the overall totals, per-category
+// stats and every allocation that is still alive
+// --------------------------------------------------------
+std::string GpuMemoryRegistry::DumpToJSON()
+{
+	GpuMemoryStats total = GetTotalStats();
+
+	std::lock_guard<std::mutex> lock(registryMutex);
+	std::ostringstream out;
+
+	out << "{\n";
+	out << "  \"frame\": " << currentFrame << ",\n";
+	out << "  \"totalLiveBytes\": " << total.liveBytes << ",\n";
+	out << "  \"totalHighWaterMarkBytes\": " << total.highWaterMarkBytes << ",\n";
+
+	// Per-category stats
+	out << "  \"categories\": {\n";
+	for (int c = 0; c < (int)GpuMemoryCategory::Count; c++)
+	{
+		const GpuMemoryStats& s = stats[c];
+		out << "    \"" << GetCategoryName((GpuMemoryCategory)c) << "\": { " <<
+			"\"liveBytes\": " << s.liveBytes << ", " <<
+			"\"highWaterMarkBytes\": " << s.highWaterMarkBytes << ", " <<
+			"\"liveAllocations\": " << s.liveAllocations << ", " <<
+			"\"totalAllocations\": " << s.totalAllocations << ", " <<
+			"\"reallocations\": " << s.reallocations << ", " <<
+			"\"releasedAllocations\": " << s.releasedAllocations << ", " <<
+			"\"averageReleasedLifetimeFrames\": " <<
+			(s.releasedAllocations ? (double)s.releasedLifetimeFrames / s.releasedAllocations : 0.0) << ", " <<
+			"\"budgetBytes\": " << budgets[c] << ", " <<
+			"\"overBudget\": " << (budgets[c] != 0 && s.liveBytes > budgets[c] ? "true" : "false") << " }" <<
+			(c + 1 < (int)GpuMemoryCategory::Count ? "," : "") << "\n";
+	}
+	out << "  },\n";
+
+	// Everything still alive
+	out << "  \"liveAllocations\": [";
+	bool first = true;
+	for (auto& pair : liveAllocations)
+	{
+		const Allocation& a = pair.second;
+		out << (first ? "\n" : ",\n");
+		out << "    { \"id\": " << pair.first <<
+			", \"category\": \"" << GetCategoryName(a.category) << "\"" <<
+			", \"sizeInBytes\": " << a.sizeInBytes <<
+			", \"createdFrame\": " << a.createdFrame <<
+			", \"ageInFrames\": " << (currentFrame - a.createdFrame) <<
+			", \"name\": ";
+		WriteJSONString(out, a.debugName);
+		out << " }";
+		first = false;
+	}
+	out << (first ? "]\n" : "\n  ]\n");
+	out << "}\n";
+
+	return out.str();
+}
+
+bool GpuMemoryRegistry::DumpToJSONFile(const wchar_t* path)
+{
+	std::string json = DumpToJSON();
+
+	FILE* file = 0;
+	if (_wfopen_s(&file, path, L"w") != 0 || !file)
+		return false;
+
+	fwrite(json.data(), 1, json.size(), file);
+	fclose(file);
+	return true;
+}
+
+const char* GpuMemoryRegistry::GetCategoryName(GpuMemoryCategory category)
+{
+	switch (category)
+	{
+	case GpuMemoryCategory::Uncategorized:			return "Uncategorized";
+	case GpuMemoryCategory::MeshGeometry:			return "MeshGeometry";
+	case GpuMemoryCategory::UploadStaging:			return "UploadStaging";
+	case GpuMemoryCategory::Texture:				return "Texture";
+	case GpuMemoryCategory::ConstantBufferUpload:	return "ConstantBufferUpload";
+	case GpuMemoryCategory::BLAS:					return "BLAS";
+	case GpuMemoryCategory::BLASScratch:			return "BLASScratch";
+	case GpuMemoryCategory::TLAS:					return "TLAS";
+	case GpuMemoryCategory::TLASScratch:			return "TLASScratch";
+	case GpuMemoryCategory::TLASInstanceData:		return "TLASInstanceData";
+	case GpuMemoryCategory::ShaderTable:			return "ShaderTable";
+	case GpuMemoryCategory::RaytracingOutput:		return "RaytracingOutput";
+	default:										return "???";
+	}
+}
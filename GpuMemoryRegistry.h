@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// What a piece of GPU memory is being used for.
+// Keep Count last - it's used to size the per-category arrays.
+enum class GpuMemoryCategory
+{
+	Uncategorized,
+	MeshGeometry,			// Vertex & index buffers
+	UploadStaging,			// Short-lived upload heaps used to fill static buffers
+	Texture,
+	ConstantBufferUpload,	// The CB ring buffer
+	BLAS,
+	BLASScratch,
+	TLAS,
+	TLASScratch,
+	TLASInstanceData,		// Instance descriptions (and other per-instance data)
+	ShaderTable,
+	RaytracingOutput,
+	Count
+};
+
+// Summary of one category (or all of them)
+struct GpuMemoryStats
+{
+	uint64_t liveBytes;
+	uint64_t highWaterMarkBytes;
+	uint64_t liveAllocations;
+	uint64_t totalAllocations;		// Over the lifetime of the program
+	uint64_t reallocations;			// Times a buffer was re-created because it was too small
+	uint64_t releasedAllocations;
+	uint64_t releasedLifetimeFrames;	// Sum of the lifetimes (in frames) of all released allocations
+};
+
+// --------------------------------------------------------
+// Records every GPU allocation made by the helpers with a
+// category, size and lifetime, and keeps live totals and
+// high-water marks per category.
+//
+// This class knows nothing about D3D12 (sizes and ids are
+// plain integers), so it works with any backend and can be
+// fed by hand, e.g. to assert memory budgets in headless
+// tests.  DX12Helper::TrackResource() is what ties real
+// D3D12 resources to it.
+// --------------------------------------------------------
+class GpuMemoryRegistry
+{
+#pragma region Singleton
+public:
+	// Gets the one and only instance of this class
+	static GpuMemoryRegistry& GetInstance()
+	{
+		if (!instance)
+		{
+			instance = new GpuMemoryRegistry();
+		}
+
+		return *instance;
+	}
+
+	// Remove these functions (C++ 11 version)
+	GpuMemoryRegistry(GpuMemoryRegistry const&) = delete;
+	void operator=(GpuMemoryRegistry const&) = delete;
+
+private:
+	static GpuMemoryRegistry* instance;
+	GpuMemoryRegistry() :
+		nextAllocationID(1),
+		currentFrame(0),
+		stats{},
+		budgets{},
+		totalLiveBytes(0),
+		totalHighWaterMark(0)
+	{};
+#pragma endregion
+
+public:
+	/// <summary>
+	/// Records a new allocation
+	/// </summary>
+	/// <param name="category">What the memory is used for</param>
+	/// <param name="sizeInBytes">How much memory the allocation actually occupies</param>
+	/// <param name="debugName">Optional name to show in reports</param>
+	/// <returns>An id used to release the allocation later</returns>
+	uint64_t RegisterAllocation(GpuMemoryCategory category, uint64_t sizeInBytes, const char* debugName = 0);
+
+	/// <summary>
+	/// Records that an allocation has been freed.  Unknown ids are ignored.
+	/// </summary>
+	void ReleaseAllocation(uint64_t allocationID);
+
+	/// <summary>
+	/// Notes that a buffer in this category is being re-created because it was too small
+	/// </summary>
+	void RecordReallocation(GpuMemoryCategory category);
+
+	/// <summary>
+	/// Forgets every allocation, stat and budget, as if nothing had been recorded
+	/// yet (so headless checks can start from a clean slate).  Doesn't free anything.
+	/// </summary>
+	void Reset();
+
+	// Frame counter used for allocation lifetimes; call once per frame
+	void AdvanceFrame();
+	uint64_t GetCurrentFrame();
+
+	// Queries
+	GpuMemoryStats GetStats(GpuMemoryCategory category);
+	GpuMemoryStats GetTotalStats();
+	uint64_t GetLiveBytes(GpuMemoryCategory category);
+	uint64_t GetTotalLiveBytes();
+	uint64_t GetHighWaterMark(GpuMemoryCategory category);
+	uint64_t GetTotalHighWaterMark();
+
+	// Budgets (0 = no budget)
+	void SetBudget(GpuMemoryCategory category, uint64_t maxLiveBytes);
+	bool IsWithinBudget(GpuMemoryCategory category);
+	bool AreAllWithinBudget();
+
+	// Reporting
+	std::string DumpToJSON();
+	bool DumpToJSONFile(const wchar_t* path);
+	static const char* GetCategoryName(GpuMemoryCategory category);
+
+private:
+	struct Allocation
+	{
+		GpuMemoryCategory category;
+		uint64_t sizeInBytes;
+		uint64_t createdFrame;
+		std::string debugName;
+	};
+
+	std::mutex registryMutex;
+	std::unordered_map<uint64_t, Allocation> liveAllocations;
+	uint64_t nextAllocationID;
+	uint64_t currentFrame;
+
+	GpuMemoryStats stats[(int)GpuMemoryCategory::Count];
+	uint64_t budgets[(int)GpuMemoryCategory::Count];
+
+	// The true overall high-water mark (not the sum of per-category marks)
+	uint64_t totalLiveBytes;
+	uint64_t totalHighWaterMark;
+};
@@ -0,0 +1,600 @@
+#include "HeadlessTests.h"
+#include "AllocationTracker.h"
+#include "BenchmarkUtils.h"
+#include "CpuRaytracer.h"
+#include "CullingBenchmark.h"
+#include "DenoiserBenchmark.h"
+#include "FrameArena.h"
+#include "GpuMemoryRegistry.h"
+#include "JobSystem.h"
+#include "LightTreeBenchmark.h"
+#include "ReprojectionBenchmark.h"
+#include "ResamplingBenchmark.h"
+#include "SamplerBenchmark.h"
+#include "SamplingBenchmark.h"
+#include "ScenePicker.h"
+#include "SceneSnapshot.h"
+#include "SpatialIndexBenchmark.h"
+#include "TlasBuildPolicy.h"
+#include "TlasInstancePacker.h"
+#include "WavefrontBenchmark.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace DirectX;
+using namespace BenchmarkUtils;
+
+// Keeps the failing condition's text for the report
+#define EXPECT(condition) Expect(condition, #condition)
+
+namespace
+{
+	// --------------------------------------------------------
+	// Runs the render thread's per-frame CPU work on a moving
+	// scene (interpolation, TLAS packing, picker updates and
+	// rebuilds) and expects none of it to touch the heap once
+	// the first few frames have warmed everything up
+	// --------------------------------------------------------
+	bool SteadyStateAllocations()
+	{
+		Scene scene;
+		CreateScene(&scene);
+		unsigned int instanceCount = (unsigned int)scene.entities.size();
+
+		// Rebuild every few frames, so rebuilds are part of the steady state too
+		ScenePicker picker;
+		picker.GetBuildPolicy().GetSettings().maxConsecutiveUpdates = 2;
+
+		TlasInstancePacker packer;
+		std::vector<D3D12_RAYTRACING_INSTANCE_DESC> instanceDescs(instanceCount);
+		std::vector<RaytracingInstanceData> instanceData(instanceCount);
+		SnapshotInterpolator interpolator;
+		SceneSnapshot previous = scene.snapshot;
+		Ray ray = ScenePicker::CalculateRayFromCamera(scene.cameraPosition, scene.view, scene.projection, 80, 45, 160, 90);
+
+		const unsigned int warmUpFrames = 4;
+		const unsigned int frames = 32;
+		bool passed = true;
+		for (unsigned int frame = 0; frame < frames; frame++)
+		{
+			// The simulation's part, which isn't being measured here
+			previous = scene.snapshot;
+			scene.entities[1 + frame % (instanceCount - 1)]->GetTransform()->MoveBy(0, 0.1f, 0);
+			CaptureSnapshot(&scene);
+
+			{
+				AllocationScope allocationScope(AllocationTag::Raytracing);
+				const SceneSnapshot& blended = interpolator.Interpolate(previous, scene.snapshot, 0.5f);
+				packer.Pack(blended, instanceDescs.data(), instanceData.data());
+				picker.Update(blended);
+				picker.Pick(ray);
+			}
+
+			FrameArena::GetInstance().Reset();
+			AllocationTracker::EndFrame();
+
+			if (frame >= warmUpFrames)
+			{
+				passed &= EXPECT(AllocationTracker::GetLastFrameStats(AllocationTag::Raytracing).allocations == 0);
+				passed &= EXPECT(FrameArena::GetInstance().GetHeapAllocationsLastFrame() == 0);
+			}
+		}
+
+		// The rebuilds really did happen, and really did use the arena
+		passed &= EXPECT(picker.GetBuildPolicy().GetModeCount(TlasBuildMode::Rebuild) >= frames / 4);
+		passed &= EXPECT(FrameArena::GetInstance().GetHighWaterMarkInBytes() >= instanceCount * sizeof(XMFLOAT3));
+		return passed;
+	}
+
+	// --------------------------------------------------------
+	// Allocates a known amount under one tag and expects the
+	// tracker to count exactly that (and nothing made outside
+	// the scope), and to report a frame as over budget only
+	// once the tag's budget is actually exceeded
+	// --------------------------------------------------------
+	bool AllocationTracking()
+	{
+		// Nothing else allocates under this tag while the checks run
+		const AllocationTag tag = AllocationTag::Input;
+		AllocationTracker::EndFrame();
+		AllocationStats totalBefore = AllocationTracker::GetTotalStats(tag);
+
+		// The volatile pointer keeps the compiler from eliding each pair
+		char* volatile block;
+		bool passed = true;
+		AllocationTracker::SetFrameBudget(tag, 3);
+		{
+			AllocationScope allocationScope(tag);
+			for (int i = 0; i < 3; i++)
+			{
+				block = new char[100];
+				delete[] block;
+			}
+		}
+		block = new char[100];
+		delete[] block;
+
+		AllocationStats current = AllocationTracker::GetCurrentFrameStats(tag);
+		passed &= EXPECT(current.allocations == 3);
+		passed &= EXPECT(current.frees == 3);
+		passed &= EXPECT(current.bytesAllocated == 300);
+
+		// Exactly at the budget is fine, and the counts move to the last frame
+		passed &= EXPECT(AllocationTracker::EndFrame());
+		passed &= EXPECT(AllocationTracker::GetLastFrameStats(tag).allocations == 3);
+		passed &= EXPECT(AllocationTracker::GetCurrentFrameStats(tag).allocations == 0);
+
+		// One more than the budget isn't
+		{
+			AllocationScope allocationScope(tag);
+			for (int i = 0; i < 4; i++)
+			{
+				block = new char[64];
+				delete[] block;
+			}
+		}
+		passed &= EXPECT(!AllocationTracker::EndFrame());
+		passed &= EXPECT(AllocationTracker::GetLastFrameStats(tag).allocations == 4);
+		passed &= EXPECT(AllocationTracker::GetLastFrameStats(tag).bytesAllocated == 256);
+
+		// Without a budget, nothing is over it
+		AllocationTracker::SetFrameBudget(tag, -1);
+		{
+			AllocationScope allocationScope(tag);
+			block = new char[16];
+			delete[] block;
+		}
+		passed &= EXPECT(AllocationTracker::EndFrame());
+
+		AllocationStats total = AllocationTracker::GetTotalStats(tag);
+		passed &= EXPECT(total.allocations - totalBefore.allocations == 8);
+		passed &= EXPECT(total.bytesAllocated - totalBefore.bytesAllocated == 572);
+		return passed;
+	}
+
+	// Whether the JSON report's line for a category says it's over budget
+	bool ReportsOverBudget(const std::string& json, GpuMemoryCategory category)
+	{
+		std::string key = std::string("\"") + GpuMemoryRegistry::GetCategoryName(category) + "\": {";
+		size_t start = json.find(key);
+		size_t end = json.find('\n', start);
+		return start != std::string::npos && json.substr(start, end - start).find("\"overBudget\": true") != std::string::npos;
+	}
+
+	// --------------------------------------------------------
+	// Feeds the registry allocations and releases by hand and
+	// expects the stats, lifetimes and budget checks (including
+	// the JSON report) to follow along
+	// --------------------------------------------------------
+	bool GpuMemoryBudgets()
+	{
+		GpuMemoryRegistry& registry = GpuMemoryRegistry::GetInstance();
+		registry.Reset();
+		registry.SetBudget(GpuMemoryCategory::TLAS, 1000);
+
+		bool passed = true;
+		uint64_t first = registry.RegisterAllocation(GpuMemoryCategory::TLAS, 600, "first");
+		registry.AdvanceFrame();
+		registry.AdvanceFrame();
+		passed &= EXPECT(registry.IsWithinBudget(GpuMemoryCategory::TLAS));
+
+		// A second one takes it over, while the unbudgeted category can grow freely
+		registry.RegisterAllocation(GpuMemoryCategory::TLAS, 600, "second");
+		registry.RegisterAllocation(GpuMemoryCategory::MeshGeometry, 5000, "unbudgeted");
+		passed &= EXPECT(!registry.IsWithinBudget(GpuMemoryCategory::TLAS));
+		passed &= EXPECT(registry.IsWithinBudget(GpuMemoryCategory::MeshGeometry));
+		passed &= EXPECT(!registry.AreAllWithinBudget());
+
+		std::string json = registry.DumpToJSON();
+		passed &= EXPECT(ReportsOverBudget(json, GpuMemoryCategory::TLAS));
+		passed &= EXPECT(!ReportsOverBudget(json, GpuMemoryCategory::MeshGeometry));
+		passed &= EXPECT(!ReportsOverBudget(json, GpuMemoryCategory::TLASScratch));
+
+		// Releasing the first brings it back under (releasing it twice does nothing)
+		registry.ReleaseAllocation(first);
+		registry.ReleaseAllocation(first);
+		passed &= EXPECT(registry.AreAllWithinBudget());
+		passed &= EXPECT(!ReportsOverBudget(registry.DumpToJSON(), GpuMemoryCategory::TLAS));
+
+		GpuMemoryStats tlas = registry.GetStats(GpuMemoryCategory::TLAS);
+		passed &= EXPECT(tlas.liveBytes == 600);
+		passed &= EXPECT(tlas.highWaterMarkBytes == 1200);
+		passed &= EXPECT(tlas.liveAllocations == 1);
+		passed &= EXPECT(tlas.totalAllocations == 2);
+		passed &= EXPECT(tlas.releasedAllocations == 1);
+		passed &= EXPECT(tlas.releasedLifetimeFrames == 2);
+		passed &= EXPECT(registry.GetTotalLiveBytes() == 5600);
+		passed &= EXPECT(registry.GetTotalHighWaterMark() == 6200);
+
+		// And a reset forgets all of it, budgets included
+		registry.Reset();
+		passed &= EXPECT(registry.GetTotalStats().totalAllocations == 0);
+		passed &= EXPECT(registry.GetTotalHighWaterMark() == 0);
+		passed &= EXPECT(registry.GetCurrentFrame() == 0);
+		registry.RegisterAllocation(GpuMemoryCategory::TLAS, 2000);
+		passed &= EXPECT(registry.IsWithinBudget(GpuMemoryCategory::TLAS));
+
+		registry.Reset();
+		return passed;
+	}
+
+	// Whether a packed instance is exactly what the packer should make of its source
+	bool MatchesSource(const D3D12_RAYTRACING_INSTANCE_DESC& desc, const RaytracingInstanceData& data, unsigned int index, const SnapshotInstance& source)
+	{
+		// DXR takes the top three rows of the transposed (column major) world
+		// matrix, so the translation lands in the last column
+		bool transformMatches = true;
+		for (int row = 0; row < 3; row++)
+			for (int column = 0; column < 4; column++)
+				transformMatches &= desc.Transform[row][column] == source.worldMatrix.m[column][row];
+
+		// CPU-only meshes have no BLAS, so no hit group or address either
+		XMFLOAT3 tint = source.material->GetColorTint();
+		const RaytracingMaterialData& material = data.materialData;
+		bool passed = true;
+		passed &= EXPECT(transformMatches);
+		passed &= EXPECT(desc.InstanceID == index);
+		passed &= EXPECT(desc.InstanceMask == 0xFF);
+		passed &= EXPECT(desc.InstanceContributionToHitGroupIndex == 0);
+		passed &= EXPECT(desc.AccelerationStructure == 0);
+		passed &= EXPECT(desc.Flags == D3D12_RAYTRACING_INSTANCE_FLAG_NONE);
+		passed &= EXPECT(memcmp(&data.worldInvTranspose, &source.worldInverseTransposeMatrix, sizeof(XMFLOAT4X4)) == 0);
+		passed &= EXPECT(material.color.x == tint.x && material.color.y == tint.y && material.color.z == tint.z);
+		passed &= EXPECT(material.color.w == (float)((index + 1) % 2));
+		passed &= EXPECT(material.albedoIndex == 0 && material.roughnessIndex == 1 && material.normalsIndex == 2 && material.metalIndex == 3);
+		return passed;
+	}
+
+	// Whether an instance was left alone since the arrays were filled with the given byte
+	bool IsUntouched(const D3D12_RAYTRACING_INSTANCE_DESC& desc, const RaytracingInstanceData& data, unsigned char fill)
+	{
+		const unsigned char* bytes = (const unsigned char*)&desc;
+		for (size_t i = 0; i < sizeof(desc); i++)
+			if (bytes[i] != fill) return false;
+
+		bytes = (const unsigned char*)&data;
+		for (size_t i = 0; i < sizeof(data); i++)
+			if (bytes[i] != fill) return false;
+
+		return true;
+	}
+
+	// --------------------------------------------------------
+	// Packs the scene (from a snapshot and from the entities),
+	// checks every instance against its source, then changes
+	// one thing at a time and expects exactly the affected
+	// instances to be repacked and the right change reported
+	// --------------------------------------------------------
+	bool TlasInstancePacking()
+	{
+		Scene scene;
+		CreateScene(&scene);
+		unsigned int count = (unsigned int)scene.entities.size();
+
+		// Room for one more, for when the scene grows
+		const unsigned char fill = 0xCD;
+		std::vector<D3D12_RAYTRACING_INSTANCE_DESC> descs(count + 1);
+		std::vector<RaytracingInstanceData> data(count + 1);
+		auto poison = [&]()
+		{
+			memset(descs.data(), fill, descs.size() * sizeof(descs[0]));
+			memset(data.data(), fill, data.size() * sizeof(data[0]));
+		};
+
+		// Everything, the first time
+		bool passed = true;
+		TlasInstancePacker packer;
+		poison();
+		TlasPackResult result = packer.Pack(scene.snapshot, descs.data(), data.data());
+		passed &= EXPECT(result.instancesRepacked == count);
+		passed &= EXPECT(result.instanceCountChanged);
+		passed &= EXPECT(result.changes.instanceCount == count);
+		for (unsigned int i = 0; i < count; i++)
+			passed &= MatchesSource(descs[i], data[i], i, scene.snapshot.instances[i]);
+		passed &= EXPECT(IsUntouched(descs[count], data[count], fill));
+
+		// Packing straight from the entities gives the same bytes
+		TlasInstancePacker entityPacker;
+		std::vector<D3D12_RAYTRACING_INSTANCE_DESC> entityDescs(count);
+		std::vector<RaytracingInstanceData> entityData(count);
+		entityPacker.Pack(scene.entities, entityDescs.data(), entityData.data());
+		passed &= EXPECT(memcmp(entityDescs.data(), descs.data(), count * sizeof(descs[0])) == 0);
+		passed &= EXPECT(memcmp(entityData.data(), data.data(), count * sizeof(data[0])) == 0);
+
+		// Nothing, when nothing changed
+		poison();
+		result = packer.Pack(scene.snapshot, descs.data(), data.data());
+		passed &= EXPECT(result.instancesRepacked == 0);
+		passed &= EXPECT(!result.instanceCountChanged);
+		passed &= EXPECT(result.changes.instancesMoved == 0 && result.changes.instancesReassigned == 0);
+		passed &= EXPECT(IsUntouched(descs[0], data[0], fill));
+
+		// Just the one that moved, and how far
+		scene.entities[3]->GetTransform()->MoveBy(0, 2, 0);
+		CaptureSnapshot(&scene);
+		poison();
+		result = packer.Pack(scene.snapshot, descs.data(), data.data());
+		passed &= EXPECT(result.instancesRepacked == 1);
+		passed &= EXPECT(result.changes.instancesMoved == 1);
+		passed &= EXPECT(fabsf(result.changes.totalDisplacement - 2.0f) < 0.001f);
+		passed &= EXPECT(fabsf(result.changes.maxDisplacement - 2.0f) < 0.001f);
+		passed &= MatchesSource(descs[3], data[3], 3, scene.snapshot.instances[3]);
+		passed &= EXPECT(IsUntouched(descs[2], data[2], fill) && IsUntouched(descs[4], data[4], fill));
+
+		// A new material is repacked, but doesn't concern the acceleration structure
+		scene.entities[5]->SetMaterial(scene.entities[3]->GetMaterial());
+		CaptureSnapshot(&scene);
+		poison();
+		result = packer.Pack(scene.snapshot, descs.data(), data.data());
+		passed &= EXPECT(result.instancesRepacked == 1);
+		passed &= EXPECT(result.changes.instancesMoved == 0 && result.changes.instancesReassigned == 0);
+		passed &= MatchesSource(descs[5], data[5], 5, scene.snapshot.instances[5]);
+
+		// Two entities trading places are reassignments, not motion
+		std::swap(scene.entities[1], scene.entities[2]);
+		CaptureSnapshot(&scene);
+		poison();
+		result = packer.Pack(scene.snapshot, descs.data(), data.data());
+		passed &= EXPECT(result.instancesRepacked == 2);
+		passed &= EXPECT(result.changes.instancesReassigned == 2 && result.changes.instancesMoved == 0);
+		passed &= MatchesSource(descs[1], data[1], 1, scene.snapshot.instances[1]);
+		passed &= MatchesSource(descs[2], data[2], 2, scene.snapshot.instances[2]);
+
+		// A new entity only needs its own slot packed, but the count changed
+		scene.entities.push_back(std::make_shared<Entity>(scene.entities[1]->GetMesh(), scene.entities[1]->GetMaterial()));
+		CaptureSnapshot(&scene);
+		poison();
+		result = packer.Pack(scene.snapshot, descs.data(), data.data());
+		passed &= EXPECT(result.instanceCountChanged);
+		passed &= EXPECT(result.changes.instanceCount == count + 1);
+		passed &= EXPECT(result.instancesRepacked == 1);
+		passed &= MatchesSource(descs[count], data[count], count, scene.snapshot.instances[count]);
+
+		// And everything again once invalidated
+		packer.Invalidate();
+		result = packer.Pack(scene.snapshot, descs.data(), data.data());
+		passed &= EXPECT(result.instancesRepacked == count + 1);
+		passed &= EXPECT(result.instanceCountChanged);
+		return passed;
+	}
+
+	// One frame's worth of scripted changes: every moved instance travels the same distance
+	TlasFrameChanges Changes(unsigned int instanceCount, unsigned int moved, float distance, unsigned int reassigned = 0)
+	{
+		TlasFrameChanges changes = {};
+		changes.instanceCount = instanceCount;
+		changes.instancesMoved = moved;
+		changes.instancesReassigned = reassigned;
+		changes.totalDisplacement = moved * distance;
+		changes.maxDisplacement = moved > 0 ? distance : 0;
+		return changes;
+	}
+
+	// Whether the policy decides (and records) the given mode for the given reason
+	bool Decides(TlasBuildPolicy& policy, const TlasFrameChanges& changes, TlasBuildMode mode, TlasBuildReason reason)
+	{
+		TlasBuildMode decided = policy.Decide(changes);
+		const TlasBuildRecord& record = policy.GetRecord(0);
+		if (decided == mode && record.mode == mode && record.reason == reason)
+			return true;
+
+		printf("    expected %s (%s), got %s (%s)\n",
+			TlasBuildPolicy::GetModeName(mode), TlasBuildPolicy::GetReasonName(reason),
+			TlasBuildPolicy::GetModeName(decided), TlasBuildPolicy::GetReasonName(record.reason));
+		return false;
+	}
+
+	// --------------------------------------------------------
+	// Scripts a run of frames that reaches every reason the
+	// policy has, in turn, then checks the decision history
+	// (which has wrapped around its ring by then)
+	// --------------------------------------------------------
+	bool TlasBuildDecisions()
+	{
+		TlasBuildPolicy policy(4);
+		TlasBuildPolicySettings& settings = policy.GetSettings();
+		settings.maxConsecutiveUpdates = 3;
+		settings.maxFrameDisplacement = 1.0f;
+		settings.maxDegradation = 0.5f;
+
+		bool passed = true;
+		passed &= Decides(policy, Changes(10, 0, 0), TlasBuildMode::Rebuild, TlasBuildReason::FirstBuild);
+		passed &= Decides(policy, Changes(10, 0, 0), TlasBuildMode::Skip, TlasBuildReason::NoChanges);
+		passed &= Decides(policy, Changes(10, 2, 0.5f), TlasBuildMode::Update, TlasBuildReason::Refit);
+		passed &= EXPECT(fabsf(policy.GetDegradation() - 0.1f) < 0.0001f);
+		passed &= Decides(policy, Changes(10, 1, 2.0f), TlasBuildMode::Rebuild, TlasBuildReason::LargeMotion);
+		passed &= EXPECT(policy.GetDegradation() == 0);
+
+		// Drift adds up until the next refit would take it over the limit
+		passed &= Decides(policy, Changes(10, 10, 0.3f), TlasBuildMode::Update, TlasBuildReason::Refit);
+		passed &= Decides(policy, Changes(10, 10, 0.3f), TlasBuildMode::Rebuild, TlasBuildReason::DegradationLimit);
+
+		// Small refits, until there have been too many in a row
+		for (int i = 0; i < 3; i++)
+			passed &= Decides(policy, Changes(10, 1, 0.1f), TlasBuildMode::Update, TlasBuildReason::Refit);
+		passed &= EXPECT(policy.GetConsecutiveUpdates() == 3);
+		passed &= Decides(policy, Changes(10, 1, 0.1f), TlasBuildMode::Rebuild, TlasBuildReason::UpdateLimit);
+
+		// Changes a refit can't handle
+		passed &= Decides(policy, Changes(11, 0, 0), TlasBuildMode::Rebuild, TlasBuildReason::InstanceCountChanged);
+		passed &= Decides(policy, Changes(11, 0, 0, 1), TlasBuildMode::Rebuild, TlasBuildReason::InstancesReassigned);
+		settings.allowUpdates = false;
+		passed &= Decides(policy, Changes(11, 1, 0.1f), TlasBuildMode::Rebuild, TlasBuildReason::UpdatesDisabled);
+		policy.Invalidate();
+		passed &= Decides(policy, Changes(11, 0, 0), TlasBuildMode::Rebuild, TlasBuildReason::FirstBuild);
+
+		// Only the last four of the fourteen decisions are kept, newest first
+		const TlasBuildReason lastFour[4] =
+		{
+			TlasBuildReason::FirstBuild,
+			TlasBuildReason::UpdatesDisabled,
+			TlasBuildReason::InstancesReassigned,
+			TlasBuildReason::InstanceCountChanged,
+		};
+		passed &= EXPECT(policy.GetHistoryCount() == 4);
+		for (unsigned int i = 0; i < 4; i++)
+		{
+			const TlasBuildRecord& record = policy.GetRecord(i);
+			passed &= EXPECT(record.decision == 13 - i);
+			passed &= EXPECT(record.reason == lastFour[i]);
+		}
+		passed &= EXPECT(policy.GetRecord(4).decision == 13);
+		passed &= EXPECT(policy.GetRecord(0).instanceCount == 11);
+
+		passed &= EXPECT(policy.GetModeCount(TlasBuildMode::Skip) == 1);
+		passed &= EXPECT(policy.GetModeCount(TlasBuildMode::Update) == 5);
+		passed &= EXPECT(policy.GetModeCount(TlasBuildMode::Rebuild) == 8);
+		return passed;
+	}
+
+	// --------------------------------------------------------
+	// Starts a converging image over with a budget that only
+	// covers some of the tiles, and expects the rest to keep
+	// their old image (rather than going black) until their
+	// turn comes, with every tile started over within the
+	// frames the budget needs to reach them all
+	// --------------------------------------------------------
+	bool AdaptiveRestart()
+	{
+		Scene scene;
+		CreateScene(&scene);
+		const unsigned int width = 64;
+		const unsigned int height = 36;
+
+		CpuRaytracer tracer;
+		tracer.Resize(width, height);
+		tracer.SetSamplesPerPixel(16);
+		for (int frame = 0; frame < 2; frame++)
+			tracer.Render(scene.snapshot, scene.cameraPosition, scene.view, scene.projection);
+		std::vector<XMFLOAT4> before = tracer.GetAccumulation();
+		std::vector<unsigned int> beforeOutput = tracer.GetOutput();
+
+		// A quarter of the image's worth of rays, after moving the camera a little.
+		// Fewer samples a frame than it had, so no pixel that started over can
+		// catch up with the old count within the frames being checked
+		SampleBudgetSettings settings = tracer.GetSampleBudget().GetSettings();
+		settings.raysPerFrame = width * height / 4;
+		settings.maxSamplesPerPixel = 4;
+		tracer.GetSampleBudget().SetSettings(settings);
+		XMFLOAT3 position = scene.cameraPosition;
+		position.x += 0.1f;
+		XMFLOAT4X4 view;
+		XMStoreFloat4x4(&view, XMMatrixMultiply(XMMatrixTranslation(-0.1f, 0, 0), XMLoadFloat4x4(&scene.view)));
+
+		bool passed = true;
+		const unsigned int framesToReachAll = 5;
+		unsigned int stale = 0;
+		for (unsigned int frame = 0; frame < framesToReachAll; frame++)
+		{
+			passed &= EXPECT(tracer.Render(scene.snapshot, position, view, scene.projection));
+
+			// Stale pixels are untouched, started over ones only have this run's samples
+			unsigned int black = 0;
+			unsigned int changed = 0;
+			unsigned int restartedSamples = 0;
+			stale = 0;
+			for (unsigned int i = 0; i < width * height; i++)
+			{
+				const XMFLOAT4& sum = tracer.GetAccumulation()[i];
+				if (sum.w == 0)
+					black++;
+				else if (sum.w == before[i].w)
+				{
+					stale++;
+					changed += memcmp(&sum, &before[i], sizeof(sum)) != 0 || tracer.GetOutput()[i] != beforeOutput[i];
+				}
+				else
+					restartedSamples += (unsigned int)sum.w;
+			}
+
+			passed &= EXPECT(black == 0);
+			passed &= EXPECT(changed == 0);
+			if (frame == 0)
+			{
+				passed &= EXPECT(stale > 0);
+				passed &= EXPECT(restartedSamples == tracer.GetRaysTraced());
+				passed &= EXPECT(tracer.GetRaysTraced() <= settings.raysPerFrame);
+			}
+		}
+
+		passed &= EXPECT(stale == 0);
+		return passed;
+	}
+
+	struct Check
+	{
+		const char* name;
+		bool (*run)();
+	};
+
+	const Check Checks[] =
+	{
+		{ "allocation tracking", AllocationTracking },
+		{ "steady state allocations", SteadyStateAllocations },
+		{ "GPU memory budgets", GpuMemoryBudgets },
+		{ "TLAS build decisions", TlasBuildDecisions },
+		{ "TLAS instance packing", TlasInstancePacking },
+		{ "adaptive sampling restart", AdaptiveRestart },
+		{ "sampler statistics", []() { return SamplerBenchmark::Run(); } },
+	};
+
+	const Check Benchmarks[] =
+	{
+		{ "spatial index", []() { return SpatialIndexBenchmark::Run(); } },
+		{ "culling", []() { return CullingBenchmark::Run(); } },
+		{ "light tree", []() { return LightTreeBenchmark::Run(); } },
+		{ "sampling", []() { return SamplingBenchmark::Run(); } },
+		{ "resampling", []() { return ResamplingBenchmark::Run(); } },
+		{ "denoiser", []() { return DenoiserBenchmark::Run(); } },
+		{ "reprojection", []() { return ReprojectionBenchmark::Run(); } },
+		{ "wavefront", []() { return WavefrontBenchmark::Run(); } },
+	};
+
+	// Runs each of the given checks, returning how many failed
+	template<size_t count>
+	int RunChecks(const Check (&checks)[count])
+	{
+		int failures = 0;
+		for (const Check& check : checks)
+		{
+			Clock::time_point start = Clock::now();
+			bool passed = check.run();
+			printf("  %-40s %s  (%.1f ms)\n", check.name, Verdict(passed), MillisecondsSince(start));
+			if (!passed)
+				failures++;
+
+			// Nothing a check leaves in the arena should outlive it
+			FrameArena::GetInstance().Reset();
+		}
+		return failures;
+	}
+}
+
+
+// --------------------------------------------------------
+// Runs everything on this thread (with the job system's
+// workers helping), so it needs nothing Game::Init() sets up
+// --------------------------------------------------------
+int HeadlessTests::Run(bool benchmarks)
+{
+	JobSystem::GetInstance().Initialize();
+	FrameArena::GetInstance().Initialize(256 * 1024);
+
+	printf("Checks\n");
+	int failures = RunChecks(Checks);
+	if (benchmarks)
+	{
+		printf("Benchmarks\n");
+		failures += RunChecks(Benchmarks);
+	}
+	printf("%d failed\n", failures);
+
+	delete& FrameArena::GetInstance();
+	delete& JobSystem::GetInstance();
+	return failures;
+}
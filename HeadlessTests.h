@@ -0,0 +1,18 @@
+#pragma once
+
+// Checks that need nothing but the CPU - no window, no device - so they
+// can run anywhere, including a build machine.  Start the program with
+// -test to run them instead of opening the window; the process exits
+// with the number of failures.  Start it with -benchmark to also run the
+// benchmarks (the *Benchmark.h namespaces) on the CPU-only scene from
+// BenchmarkUtils.h, each failing if what it measures stops paying off.
+
+namespace HeadlessTests
+{
+	/// <summary>
+	/// Runs every check (and optionally every benchmark), printing a verdict for each
+	/// </summary>
+	/// <param name="benchmarks">Whether to run the benchmarks too (they take much longer)</param>
+	/// <returns>How many failed (0 if everything passed)</returns>
+	int Run(bool benchmarks);
+}
@@ -0,0 +1,152 @@
+#include "JobSystem.h"
+
+// Singleton requirement
+JobSystem* JobSystem::instance;
+
+// --------------------------------------------------------
+// Tells the workers to stop and waits for them
+// --------------------------------------------------------
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(jobMutex);
+		shuttingDown = true;
+	}
+	jobStarted.notify_all();
+
+	for (std::thread& worker : workers)
+		worker.join();
+}
+
+// --------------------------------------------------------
+// Spins up the worker threads
+// --------------------------------------------------------
+void JobSystem::Initialize(unsigned int workerCount)
+{
+	if (!workers.empty())
+		return;
+
+	// Default to one worker per core, not counting the calling thread
+	if (workerCount == 0)
+	{
+		unsigned int cores = std::thread::hardware_concurrency();
+		workerCount = cores > 1 ? cores - 1 : 0;
+	}
+
+	workers.reserve(workerCount);
+	for (unsigned int i = 0; i < workerCount; i++)
+		workers.emplace_back(&JobSystem::WorkerLoop, this);
+}
+
+unsigned int JobSystem::GetThreadCount()
+{
+	return (unsigned int)workers.size() + 1;
+}
+
+// --------------------------------------------------------
+// Publishes a job, helps out with it, and waits until
+// every chunk has been processed
+// --------------------------------------------------------
+void JobSystem::Run(unsigned int count, unsigned int chunkSize, ChunkFunction function, const void* context)
+{
+	if (count == 0)
+		return;
+
+	if (chunkSize == 0)
+		chunkSize = 1;
+
+	unsigned int chunkCount = (count + chunkSize - 1) / chunkSize;
+
+	// Not worth waking anyone up?
+	if (workers.empty() || chunkCount == 1)
+	{
+		for (unsigned int start = 0; start < count; start += chunkSize)
+			function(context, start, count - start < chunkSize ? count : start + chunkSize);
+		return;
+	}
+
+	// One job at a time
+	std::lock_guard<std::mutex> runLock(runMutex);
+
+	{
+		// Workers that are late leaving the previous job still read its details
+		std::unique_lock<std::mutex> lock(jobMutex);
+		jobFinished.wait(lock, [this]() { return busyWorkers == 0; });
+
+		jobAllocationTag = AllocationTracker::GetCurrentTag();
+		jobFunction = function;
+		jobContext = context;
+		jobCount = count;
+		jobChunkSize = chunkSize;
+		jobChunkCount = chunkCount;
+		nextChunk = 0;
+		chunksRemaining = chunkCount;
+		jobGeneration++;
+	}
+	jobStarted.notify_all();
+
+	// This thread works too, rather than just waiting
+	ProcessChunks();
+
+	std::unique_lock<std::mutex> lock(jobMutex);
+	jobFinished.wait(lock, [this]() { return chunksRemaining == 0; });
+}
+
+// --------------------------------------------------------
+// Grabs chunks of the current job until there are none left
+// --------------------------------------------------------
+void JobSystem::ProcessChunks()
+{
+	while (true)
+	{
+		unsigned int chunk = nextChunk.fetch_add(1);
+		if (chunk >= jobChunkCount)
+			return;
+
+		unsigned int start = chunk * jobChunkSize;
+		unsigned int end = jobCount - start < jobChunkSize ? jobCount : start + jobChunkSize;
+		jobFunction(jobContext, start, end);
+
+		// Last one out lets the caller know
+		if (chunksRemaining.fetch_sub(1) == 1)
+		{
+			std::lock_guard<std::mutex> lock(jobMutex);
+			jobFinished.notify_all();
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Each worker sleeps until a new job shows up, then helps
+// --------------------------------------------------------
+void JobSystem::WorkerLoop()
+{
+	unsigned long long lastGeneration = 0;
+	AllocationTag jobTag = AllocationTag::Untagged;
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(jobMutex);
+			jobStarted.wait(lock, [&]() { return shuttingDown || jobGeneration != lastGeneration; });
+			if (shuttingDown)
+				return;
+
+			lastGeneration = jobGeneration;
+			jobTag = jobAllocationTag;
+			busyWorkers++;
+		}
+
+		// Allocations are charged to whatever the caller was doing
+		{
+			AllocationScope allocationScope(jobTag);
+			ProcessChunks();
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(jobMutex);
+			busyWorkers--;
+		}
+		jobFinished.notify_all();
+	}
+}
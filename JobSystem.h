@@ -0,0 +1,122 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "AllocationTracker.h"
+
+// A small pool of worker threads for splitting loops across cores.
+//
+// ParallelFor() cuts a range into fixed-size chunks and hands them out
+// to the workers and the calling thread, returning once every chunk is
+// done.  Chunk boundaries depend only on the range and chunk size - never
+// on how many threads exist - so as long as each chunk only writes data
+// belonging to its own elements, results are identical no matter how
+// many cores run it.
+//
+// The contract for the work function:
+//  - Read anything that's constant for the duration of the call
+//  - Write only to the elements in [start, end)
+//  - Don't allocate/free shared resources, call ParallelFor() again, or
+//    touch anything that's lazily updated on read (call the relevant
+//    update beforehand instead)
+//
+// Jobs run one at a time: if two threads call ParallelFor() at once,
+// the second waits for the first to finish.
+class JobSystem
+{
+#pragma region Singleton
+public:
+	// Gets the one and only instance of this class
+	static JobSystem& GetInstance()
+	{
+		if (!instance)
+		{
+			instance = new JobSystem();
+		}
+
+		return *instance;
+	}
+
+	// Remove these functions (C++ 11 version)
+	JobSystem(JobSystem const&) = delete;
+	void operator=(JobSystem const&) = delete;
+
+private:
+	static JobSystem* instance;
+	JobSystem() :
+		shuttingDown(false),
+		busyWorkers(0),
+		jobGeneration(0),
+		jobAllocationTag(AllocationTag::Untagged),
+		jobFunction(0),
+		jobContext(0),
+		jobCount(0),
+		jobChunkSize(1),
+		jobChunkCount(0),
+		nextChunk(0),
+		chunksRemaining(0)
+	{};
+#pragma endregion
+
+public:
+	~JobSystem();
+
+	/// <summary>
+	/// Starts the worker threads.  Until this is called, everything runs on the calling thread.
+	/// </summary>
+	/// <param name="workerCount">Threads to start, in addition to the calling thread (0 = one per extra core)</param>
+	void Initialize(unsigned int workerCount = 0);
+
+	/// <summary>
+	/// Calls work(start, end) for every chunk of [0, count), spread across all threads,
+	/// and waits for them all to finish.  See the contract at the top of this file.
+	/// </summary>
+	/// <param name="count">Number of elements</param>
+	/// <param name="chunkSize">Elements per chunk - big enough to outweigh the cost of handing it out</param>
+	/// <param name="work">Callable taking (unsigned int start, unsigned int end)</param>
+	template<typename Work>
+	void ParallelFor(unsigned int count, unsigned int chunkSize, const Work& work)
+	{
+		// Goes through a plain function pointer rather than std::function, so nothing is allocated
+		Run(count, chunkSize, &Invoke<Work>, &work);
+	}
+
+	unsigned int GetThreadCount(); // Workers plus the calling thread
+
+private:
+	typedef void (*ChunkFunction)(const void* context, unsigned int start, unsigned int end);
+
+	template<typename Work>
+	static void Invoke(const void* context, unsigned int start, unsigned int end)
+	{
+		(*static_cast<const Work*>(context))(start, end);
+	}
+
+	void Run(unsigned int count, unsigned int chunkSize, ChunkFunction function, const void* context);
+	void WorkerLoop();
+	void ProcessChunks();
+
+	std::vector<std::thread> workers;
+	bool shuttingDown;
+
+	// The current job (only one runs at a time)
+	std::mutex runMutex; // Held for the whole of Run()
+	std::mutex jobMutex;
+	std::condition_variable jobStarted;
+	std::condition_variable jobFinished;
+	unsigned int busyWorkers; // Workers currently inside ProcessChunks()
+	unsigned long long jobGeneration;
+	AllocationTag jobAllocationTag;
+	ChunkFunction jobFunction;
+	const void* jobContext;
+	unsigned int jobCount;
+	unsigned int jobChunkSize;
+	unsigned int jobChunkCount;
+	std::atomic<unsigned int> nextChunk;
+	std::atomic<unsigned int> chunksRemaining;
+};
+
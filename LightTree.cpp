@@ -0,0 +1,590 @@
+#include "LightTree.h"
+
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+using namespace DirectX;
+
+namespace
+{
+	// How many candidate split positions are tried along each axis
+	const unsigned int SplitBins = 12;
+
+	// Largest float below 1, for keeping rescaled random numbers in [0, 1)
+	const float OneMinusEpsilon = 0.99999994f;
+
+	// Everything the tree knows about a group of lights, while building
+	struct Cluster
+	{
+		AABB bounds;
+		float power;
+		float range;
+		XMFLOAT3 axis;
+		float thetaO;
+		float thetaE;
+		float spotFalloff;
+	};
+
+	Cluster EmptyCluster()
+	{
+		Cluster cluster = {};
+		cluster.bounds = Bounds::Empty();
+		return cluster;
+	}
+
+	float Luminance(const XMFLOAT3& color)
+	{
+		return 0.2126f * color.x + 0.7152f * color.y + 0.0722f * color.z;
+	}
+
+	// A single light as a cluster: point lights shine every way, spot lights
+	// shine down their axis and (like the shaders' spot term) fade out by 90 degrees
+	Cluster ClusterFromLight(const Light& light)
+	{
+		Cluster cluster = {};
+		cluster.bounds.minCorner = light.Position;
+		cluster.bounds.maxCorner = light.Position;
+		cluster.power = Luminance(light.Color) * light.Intensity;
+		cluster.range = light.Range;
+		cluster.thetaE = XM_PIDIV2;
+		if (light.Type == LIGHT_TYPE_SPOT)
+		{
+			XMStoreFloat3(&cluster.axis, XMVector3Normalize(XMLoadFloat3(&light.Direction)));
+			cluster.thetaO = 0.0f;
+			cluster.spotFalloff = light.SpotFalloff;
+		}
+		else
+		{
+			cluster.axis = XMFLOAT3(0, 1, 0);
+			cluster.thetaO = XM_PI;
+		}
+		return cluster;
+	}
+
+	// The smallest cone around both cones (Conty Estevez and Kulla, section 4.2)
+	void UnionCones(const Cluster& first, const Cluster& second, Cluster* result)
+	{
+		const Cluster& a = first.thetaO >= second.thetaO ? first : second;
+		const Cluster& b = first.thetaO >= second.thetaO ? second : first;
+		XMVECTOR axisA = XMLoadFloat3(&a.axis);
+		XMVECTOR axisB = XMLoadFloat3(&b.axis);
+
+		float cosThetaD = fminf(fmaxf(XMVectorGetX(XMVector3Dot(axisA, axisB)), -1.0f), 1.0f);
+		float thetaD = acosf(cosThetaD);
+		result->thetaE = fmaxf(a.thetaE, b.thetaE);
+
+		// One cone already contains the other
+		if (fminf(thetaD + b.thetaO, XM_PI) <= a.thetaO)
+		{
+			result->axis = a.axis;
+			result->thetaO = a.thetaO;
+			return;
+		}
+
+		float thetaO = (a.thetaO + thetaD + b.thetaO) * 0.5f;
+		if (thetaO >= XM_PI)
+		{
+			result->axis = a.axis;
+			result->thetaO = XM_PI;
+			return;
+		}
+
+		// Turn a's axis toward b's, by just enough to cover both
+		XMVECTOR across = axisB - axisA * cosThetaD;
+		if (XMVectorGetX(XMVector3LengthSq(across)) < 1e-12f)
+		{
+			// Opposite axes, so any perpendicular direction will do
+			across = XMVector3Cross(axisA, fabsf(a.axis.x) < 0.9f ? XMVectorSet(1, 0, 0, 0) : XMVectorSet(0, 1, 0, 0));
+		}
+
+		float turn = thetaO - a.thetaO;
+		XMStoreFloat3(&result->axis, XMVector3Normalize(axisA * cosf(turn) + XMVector3Normalize(across) * sinf(turn)));
+		result->thetaO = thetaO;
+	}
+
+	Cluster Union(const Cluster& a, const Cluster& b)
+	{
+		if (Bounds::IsEmpty(a.bounds))
+			return b;
+		if (Bounds::IsEmpty(b.bounds))
+			return a;
+
+		Cluster cluster = {};
+		XMStoreFloat3(&cluster.bounds.minCorner, XMVectorMin(XMLoadFloat3(&a.bounds.minCorner), XMLoadFloat3(&b.bounds.minCorner)));
+		XMStoreFloat3(&cluster.bounds.maxCorner, XMVectorMax(XMLoadFloat3(&a.bounds.maxCorner), XMLoadFloat3(&b.bounds.maxCorner)));
+		cluster.power = a.power + b.power;
+		cluster.range = fmaxf(a.range, b.range);
+		cluster.spotFalloff = fminf(a.spotFalloff, b.spotFalloff);
+		UnionCones(a, b, &cluster);
+		return cluster;
+	}
+
+	Cluster ClusterFromNode(const LightTreeNode& node)
+	{
+		Cluster cluster = {};
+		cluster.bounds.minCorner = node.boundsMin;
+		cluster.bounds.maxCorner = node.boundsMax;
+		cluster.power = node.power;
+		cluster.range = node.range;
+		cluster.axis = node.axis;
+		cluster.thetaO = node.thetaO;
+		cluster.thetaE = node.thetaE;
+		cluster.spotFalloff = node.spotFalloff;
+		return cluster;
+	}
+
+	void WriteCluster(const Cluster& cluster, LightTreeNode* node)
+	{
+		node->boundsMin = cluster.bounds.minCorner;
+		node->boundsMax = cluster.bounds.maxCorner;
+		node->power = cluster.power;
+		node->range = cluster.range;
+		node->axis = cluster.axis;
+		node->thetaO = cluster.thetaO;
+		node->thetaE = cluster.thetaE;
+		node->spotFalloff = cluster.spotFalloff;
+	}
+
+	// Half the surface area (lights in a line fall back to its length)
+	float SurfaceMeasure(const AABB& box)
+	{
+		if (Bounds::IsEmpty(box))
+			return 0.0f;
+
+		float x = box.maxCorner.x - box.minCorner.x;
+		float y = box.maxCorner.y - box.minCorner.y;
+		float z = box.maxCorner.z - box.minCorner.z;
+		float area = x * y + y * z + z * x;
+		return area > 0.0f ? area : x + y + z;
+	}
+
+	// How much of the sphere of directions a cone's emission covers (the paper's M_Omega)
+	float OrientationMeasure(float thetaO, float thetaE)
+	{
+		float thetaW = fminf(thetaO + thetaE, XM_PI);
+		float sinO = sinf(thetaO);
+		float cosO = cosf(thetaO);
+		return 2.0f * XM_PI * (1.0f - cosO) +
+			XM_PIDIV2 * (2.0f * thetaW * sinO - cosf(thetaO - 2.0f * thetaW) - 2.0f * thetaO * sinO + cosO);
+	}
+
+	// Splits are scored by power times area times orientation measure
+	float SplitCost(const Cluster& cluster)
+	{
+		if (Bounds::IsEmpty(cluster.bounds))
+			return 0.0f;
+		return cluster.power * SurfaceMeasure(cluster.bounds) * OrientationMeasure(cluster.thetaO, cluster.thetaE);
+	}
+
+	// A node's two children are picked between in proportion to their
+	// importance (each chance is worked out on its own, as one minus the
+	// other would round a very unlikely child's chance to zero)
+	void ChildProbabilities(float firstImportance, float secondImportance, float* firstProbability, float* secondProbability)
+	{
+		float total = firstImportance + secondImportance;
+		*firstProbability = total > 0.0f ? firstImportance / total : 0.0f;
+		*secondProbability = total > 0.0f ? secondImportance / total : 1.0f;
+	}
+}
+
+LightTree::LightTree() :
+	treeNodeCount(0)
+{
+}
+
+
+// --------------------------------------------------------
+// Puts every point and spot light in the root and splits
+// from there until each leaf holds a single light, then
+// adds the directional lights after the tree
+// --------------------------------------------------------
+void LightTree::Build(const Light* lights, unsigned int lightCount)
+{
+	nodes.clear();
+	parents.clear();
+	lightNodes.assign(lightCount, LIGHT_TREE_NO_LIGHT);
+	lightOrder.clear();
+	lightLeaves.resize(lightCount);
+
+	for (unsigned int i = 0; i < lightCount; i++)
+	{
+		if (lights[i].Type == LIGHT_TYPE_DIRECTIONAL)
+			continue;
+
+		lightOrder.push_back(i);
+		WriteCluster(ClusterFromLight(lights[i]), &lightLeaves[i]);
+	}
+
+	// One light per leaf, so a tree with n lights has 2n - 1 nodes
+	unsigned int localCount = (unsigned int)lightOrder.size();
+	nodes.reserve(localCount > 0 ? 2 * localCount - 1 + lightCount - localCount : lightCount);
+	if (localCount > 0)
+	{
+		LightTreeNode root = {};
+		nodes.push_back(root);
+		parents.push_back(LIGHT_TREE_NO_LIGHT);
+		Subdivide();
+	}
+	treeNodeCount = (unsigned int)nodes.size();
+
+	for (unsigned int i = 0; i < lightCount; i++)
+	{
+		if (lights[i].Type != LIGHT_TYPE_DIRECTIONAL)
+			continue;
+
+		lightNodes[i] = (unsigned int)nodes.size();
+		LightTreeNode node = {};
+		node.type = LIGHT_TREE_NODE_INFINITE;
+		node.index = i;
+		nodes.push_back(node);
+		parents.push_back(LIGHT_TREE_NO_LIGHT);
+	}
+
+	// Leaves know their lights, so filling in every node is just a refit
+	Refit(lights);
+}
+
+// --------------------------------------------------------
+// Children always come after their parents, so walking
+// backwards updates every child before its parent
+// --------------------------------------------------------
+void LightTree::Refit(const Light* lights)
+{
+	for (unsigned int i = (unsigned int)nodes.size(); i-- > 0;)
+	{
+		LightTreeNode& node = nodes[i];
+		switch (node.type)
+		{
+		case LIGHT_TREE_NODE_INTERIOR:
+			WriteCluster(Union(ClusterFromNode(nodes[node.index]), ClusterFromNode(nodes[node.index + 1])), &node);
+			break;
+
+		case LIGHT_TREE_NODE_LEAF:
+			WriteCluster(ClusterFromLight(lights[node.index]), &node);
+			break;
+
+		case LIGHT_TREE_NODE_INFINITE:
+		{
+			const Light& light = lights[node.index];
+			node.boundsMin = XMFLOAT3(0, 0, 0);
+			node.boundsMax = XMFLOAT3(0, 0, 0);
+			node.power = Luminance(light.Color) * light.Intensity;
+			node.range = FLT_MAX;
+			XMStoreFloat3(&node.axis, XMVector3Normalize(XMLoadFloat3(&light.Direction)));
+			node.thetaO = 0.0f;
+			node.thetaE = 0.0f;
+			node.spotFalloff = 0.0f;
+			break;
+		}
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Picks between the tree and each directional light, then
+// walks down the tree (if it won) one child at a time,
+// reusing what's left of the random number at each step
+// --------------------------------------------------------
+unsigned int LightTree::Sample(XMFLOAT3 position, XMFLOAT3 normal, float u, float* pdf) const
+{
+	*pdf = 0.0f;
+	XMVECTOR p = XMLoadFloat3(&position);
+	XMVECTOR n = XMLoadFloat3(&normal);
+
+	float total = TopLevelImportance(p, n);
+	if (total <= 0.0f)
+		return LIGHT_TREE_NO_LIGHT;
+
+	// Directional lights first, then the tree with whatever's left
+	float target = u * total;
+	for (unsigned int i = treeNodeCount; i < nodes.size(); i++)
+	{
+		float importance = Importance(nodes[i], p, n);
+		if (target < importance)
+		{
+			*pdf = importance / total;
+			return nodes[i].index;
+		}
+		target -= importance;
+	}
+
+	float rootImportance = treeNodeCount > 0 ? Importance(nodes[0], p, n) : 0.0f;
+	if (rootImportance <= 0.0f)
+		return LIGHT_TREE_NO_LIGHT;
+
+	float probability = rootImportance / total;
+	u = fminf(target / rootImportance, OneMinusEpsilon);
+
+	unsigned int index = 0;
+	while (nodes[index].type == LIGHT_TREE_NODE_INTERIOR)
+	{
+		unsigned int child = nodes[index].index;
+		float firstProbability, secondProbability;
+		ChildProbabilities(Importance(nodes[child], p, n), Importance(nodes[child + 1], p, n), &firstProbability, &secondProbability);
+		if (u < firstProbability)
+		{
+			u = fminf(u / firstProbability, OneMinusEpsilon);
+			probability *= firstProbability;
+			index = child;
+		}
+		else
+		{
+			u = fminf(fmaxf(u - firstProbability, 0.0f) / secondProbability, OneMinusEpsilon);
+			probability *= secondProbability;
+			index = child + 1;
+		}
+	}
+
+	*pdf = probability;
+	return probability > 0.0f ? nodes[index].index : LIGHT_TREE_NO_LIGHT;
+}
+
+// --------------------------------------------------------
+// Walks up from the light's node, multiplying in the
+// chance of each step Sample() would have had to take
+// --------------------------------------------------------
+float LightTree::Pdf(XMFLOAT3 position, XMFLOAT3 normal, unsigned int lightIndex) const
+{
+	if (lightIndex >= lightNodes.size())
+		return 0.0f;
+
+	XMVECTOR p = XMLoadFloat3(&position);
+	XMVECTOR n = XMLoadFloat3(&normal);
+	float total = TopLevelImportance(p, n);
+	if (total <= 0.0f)
+		return 0.0f;
+
+	unsigned int index = lightNodes[lightIndex];
+	if (nodes[index].type == LIGHT_TREE_NODE_INFINITE)
+		return Importance(nodes[index], p, n) / total;
+
+	float probability = 1.0f;
+	for (unsigned int parent = parents[index]; parent != LIGHT_TREE_NO_LIGHT; index = parent, parent = parents[index])
+	{
+		unsigned int child = nodes[parent].index;
+		float firstProbability, secondProbability;
+		ChildProbabilities(Importance(nodes[child], p, n), Importance(nodes[child + 1], p, n), &firstProbability, &secondProbability);
+		probability *= index == child ? firstProbability : secondProbability;
+	}
+
+	return probability * Importance(nodes[0], p, n) / total;
+}
+
+// --------------------------------------------------------
+// Bounds the light that could reach the point from every
+// light in the node: range falloff from the nearest point
+// of the box, times the best surface cosine and spot term
+// anywhere in the box (an upper bound, so it's only zero
+// when nothing in the node can contribute - and exact for
+// a single light)
+// --------------------------------------------------------
+float LightTree::Importance(const LightTreeNode& node, FXMVECTOR position, FXMVECTOR normal)
+{
+	if (node.power <= 0.0f)
+		return 0.0f;
+
+	XMVECTOR axis = XMLoadFloat3(&node.axis);
+	if (node.type == LIGHT_TREE_NODE_INFINITE)
+		return node.power * fmaxf(-XMVectorGetX(XMVector3Dot(normal, axis)), 0.0f);
+
+	// Same falloff as Attenuate() in ShaderIncludes.hlsli, from the closest the lights could be
+	XMVECTOR boundsMin = XMLoadFloat3(&node.boundsMin);
+	XMVECTOR boundsMax = XMLoadFloat3(&node.boundsMax);
+	float closestSquared = XMVectorGetX(XMVector3LengthSq(XMVectorClamp(position, boundsMin, boundsMax) - position));
+	float rangeSquared = node.range * node.range;
+	if (closestSquared >= rangeSquared)
+		return 0.0f;
+
+	float falloff = 1.0f - closestSquared / rangeSquared;
+	falloff *= falloff;
+
+	// Inside the box, light could come from any direction
+	XMVECTOR center = (boundsMin + boundsMax) * 0.5f;
+	XMVECTOR toCenter = center - position;
+	float distance = XMVectorGetX(XMVector3Length(toCenter));
+	float radius = XMVectorGetX(XMVector3Length(boundsMax - center));
+	if (distance <= radius)
+		return node.power * falloff;
+
+	// The box covers directions up to thetaU from its center, as seen from the point
+	XMVECTOR direction = toCenter / XMVectorReplicate(distance);
+	float thetaU = asinf(radius / distance);
+
+	float cosThetaI = fminf(fmaxf(XMVectorGetX(XMVector3Dot(normal, direction)), -1.0f), 1.0f);
+	float thetaI = fmaxf(acosf(cosThetaI) - thetaU, 0.0f);
+	if (thetaI >= XM_PIDIV2)
+		return 0.0f;
+
+	float cosTheta = fminf(fmaxf(-XMVectorGetX(XMVector3Dot(axis, direction)), -1.0f), 1.0f);
+	float theta = fmaxf(acosf(cosTheta) - node.thetaO - thetaU, 0.0f);
+	if (theta >= node.thetaE)
+		return 0.0f;
+
+	return node.power * falloff * cosf(thetaI) * powf(cosf(theta), node.spotFalloff);
+}
+
+const std::vector<LightTreeNode>& LightTree::GetNodes() const
+{
+	return nodes;
+}
+
+unsigned int LightTree::GetNodeCount() const
+{
+	return (unsigned int)nodes.size();
+}
+
+unsigned int LightTree::GetInfiniteLightCount() const
+{
+	return (unsigned int)nodes.size() - treeNodeCount;
+}
+
+
+// --------------------------------------------------------
+// Splits every node with more than one light in two, where
+// the orientation-aware surface area heuristic says is
+// best (or at the median if there's no useful split)
+// --------------------------------------------------------
+void LightTree::Subdivide()
+{
+	// The lights each node waiting to be split covers, within lightOrder
+	struct Pending { unsigned int node; unsigned int first; unsigned int count; };
+	std::vector<Pending> stack;
+	stack.push_back({ 0, 0, (unsigned int)lightOrder.size() });
+
+	while (!stack.empty())
+	{
+		Pending pending = stack.back();
+		stack.pop_back();
+
+		if (pending.count == 1)
+		{
+			unsigned int light = lightOrder[pending.first];
+			nodes[pending.node].type = LIGHT_TREE_NODE_LEAF;
+			nodes[pending.node].index = light;
+			lightNodes[light] = pending.node;
+			continue;
+		}
+
+		AABB bounds = Bounds::Empty();
+		for (unsigned int i = pending.first; i < pending.first + pending.count; i++)
+			Bounds::Expand(bounds, lightLeaves[lightOrder[i]].boundsMin);
+
+		unsigned int* first = &lightOrder[pending.first];
+		unsigned int* last = first + pending.count;
+		unsigned int* middle = first;
+
+		unsigned int axis = 0;
+		float position = 0.0f;
+		if (FindSplit(pending.first, pending.count, bounds, &axis, &position) < FLT_MAX)
+		{
+			middle = std::partition(first, last,
+				[&](unsigned int light) { return (&lightLeaves[light].boundsMin.x)[axis] < position; });
+		}
+
+		if (middle == first || middle == last)
+		{
+			// Every light landed on one side (or they're all in one spot) - split
+			// at the median of the widest axis
+			XMFLOAT3 extents = Bounds::GetHalfExtents(bounds);
+			axis = extents.x > extents.y ? (extents.x > extents.z ? 0 : 2) : (extents.y > extents.z ? 1 : 2);
+			middle = first + pending.count / 2;
+			std::nth_element(first, middle, last,
+				[&](unsigned int a, unsigned int b) { return (&lightLeaves[a].boundsMin.x)[axis] < (&lightLeaves[b].boundsMin.x)[axis]; });
+		}
+
+		unsigned int childIndex = (unsigned int)nodes.size();
+		nodes[pending.node].type = LIGHT_TREE_NODE_INTERIOR;
+		nodes[pending.node].index = childIndex;
+		nodes.push_back(LightTreeNode{});
+		nodes.push_back(LightTreeNode{});
+		parents.push_back(pending.node);
+		parents.push_back(pending.node);
+
+		unsigned int firstCount = (unsigned int)(middle - first);
+		stack.push_back({ childIndex, pending.first, firstCount });
+		stack.push_back({ childIndex + 1, pending.first + firstCount, pending.count - firstCount });
+	}
+}
+
+// --------------------------------------------------------
+// Bins the lights by position along each axis and finds
+// the bin boundary with the lowest cost: each side's power
+// times its area times how widely it shines, with long
+// thin splits penalized (returns FLT_MAX if there's none)
+// --------------------------------------------------------
+float LightTree::FindSplit(unsigned int first, unsigned int count, const AABB& bounds, unsigned int* bestAxis, float* bestPosition) const
+{
+	float bestCost = FLT_MAX;
+	XMFLOAT3 halfExtents = Bounds::GetHalfExtents(bounds);
+	float maxExtent = fmaxf(halfExtents.x, fmaxf(halfExtents.y, halfExtents.z));
+	for (unsigned int axis = 0; axis < 3; axis++)
+	{
+		float axisMin = (&bounds.minCorner.x)[axis];
+		float axisMax = (&bounds.maxCorner.x)[axis];
+		if (axisMax <= axisMin)
+			continue;
+
+		Cluster bins[SplitBins];
+		unsigned int binCounts[SplitBins] = {};
+		for (Cluster& bin : bins)
+			bin = EmptyCluster();
+
+		float scale = SplitBins / (axisMax - axisMin);
+		for (unsigned int i = first; i < first + count; i++)
+		{
+			unsigned int light = lightOrder[i];
+			unsigned int b = (unsigned int)(((&lightLeaves[light].boundsMin.x)[axis] - axisMin) * scale);
+			b = b < SplitBins ? b : SplitBins - 1;
+			bins[b] = Union(bins[b], ClusterFromNode(lightLeaves[light]));
+			binCounts[b]++;
+		}
+
+		// Sweep from the right to get the cost of everything past each boundary,
+		// then from the left to combine it with everything before
+		float rightCost[SplitBins - 1];
+		unsigned int rightCount[SplitBins - 1];
+		Cluster right = EmptyCluster();
+		unsigned int sideCount = 0;
+		for (unsigned int b = SplitBins - 1; b > 0; b--)
+		{
+			right = Union(right, bins[b]);
+			sideCount += binCounts[b];
+			rightCost[b - 1] = SplitCost(right);
+			rightCount[b - 1] = sideCount;
+		}
+
+		float regularization = maxExtent / (&halfExtents.x)[axis];
+		Cluster left = EmptyCluster();
+		sideCount = 0;
+		for (unsigned int b = 0; b < SplitBins - 1; b++)
+		{
+			left = Union(left, bins[b]);
+			sideCount += binCounts[b];
+			if (sideCount == 0 || rightCount[b] == 0)
+				continue;
+
+			float cost = regularization * (SplitCost(left) + rightCost[b]);
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				*bestAxis = axis;
+				*bestPosition = axisMin + (b + 1) / scale;
+			}
+		}
+	}
+
+	return bestCost;
+}
+
+// --------------------------------------------------------
+// Everything Sample() chooses between at the top: each
+// directional light, and the tree's root
+// --------------------------------------------------------
+float LightTree::TopLevelImportance(FXMVECTOR position, FXMVECTOR normal) const
+{
+	float total = treeNodeCount > 0 ? Importance(nodes[0], position, normal) : 0.0f;
+	for (unsigned int i = treeNodeCount; i < nodes.size(); i++)
+		total += Importance(nodes[i], position, normal);
+	return total;
+}
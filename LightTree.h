@@ -0,0 +1,129 @@
+#pragma once
+
+// Picks one light out of many for a shading point, with probability
+// roughly proportional to how much it's likely to contribute (Conty
+// Estevez and Kulla, "Importance Sampling of Many Lights with Adaptive
+// Tree Splitting", 2018).
+//
+// Point and spot lights go into a binary tree.  Every node bounds its
+// lights' positions with a box, their emission directions with a cone
+// (an axis, the spread of the axes around it, and how far past that
+// emission reaches), and sums their power.  Sampling walks from the root
+// to a single leaf, at each step picking a child in proportion to an
+// estimate of its importance from those bounds; the estimate is only
+// ever zero when none of the node's lights can reach the point, so no
+// light that matters is ever skipped.  Directional lights have no
+// position, so they sit beside the tree and compete with its root.
+//
+// Nodes are a flat array of LightTreeNode, laid out for a structured
+// buffer: the tree first (each pair of siblings next to each other and
+// always after their parent, like BoundingVolumeHierarchy, so refitting
+// after lights move is a single backwards pass), then one node per
+// directional light.  LightTree.hlsli samples the same array on the GPU
+// (for when the shaders take more lights than the SceneData cbuffer holds).
+//
+// Importance follows the engine's own light model: range falloff
+// rather than inverse square, and spot lights fading out by 90 degrees
+// with their falloff exponent.
+
+#include <DirectXMath.h>
+#include <stddef.h>
+#include <vector>
+
+#include "Bounds.h"
+#include "Lights.h"
+
+#define LIGHT_TREE_NODE_INTERIOR	0
+#define LIGHT_TREE_NODE_LEAF		1	// A point or spot light
+#define LIGHT_TREE_NODE_INFINITE	2	// A directional light
+
+// Returned when no light can reach the point
+#define LIGHT_TREE_NO_LIGHT 0xFFFFFFFF
+
+// Ensure this matches LightTreeNode in LightTree.hlsli!
+struct LightTreeNode
+{
+	DirectX::XMFLOAT3 boundsMin;	// Box around every light's position
+	float power;					// Sum of every light's luminance times intensity
+	DirectX::XMFLOAT3 boundsMax;
+	float range;					// Furthest any of the lights reach
+	DirectX::XMFLOAT3 axis;			// Emission cone's center direction
+	float thetaO;					// Angle from the axis that contains every light's own axis
+	float thetaE;					// Angle past thetaO that emission still reaches
+	unsigned int type;				// LIGHT_TREE_NODE_*
+	unsigned int index;				// Interior: first of two children.  Otherwise: the light's index.
+	float spotFalloff;				// Lowest spot falloff exponent (0 if any light shines everywhere)
+};
+
+// HLSL packs the structured buffer's elements tightly, so the C++ side has to as well
+static_assert(sizeof(LightTreeNode) == 64, "LightTreeNode no longer matches LightTree.hlsli");
+static_assert(offsetof(LightTreeNode, power) == 12, "LightTreeNode no longer matches LightTree.hlsli");
+static_assert(offsetof(LightTreeNode, boundsMax) == 16, "LightTreeNode no longer matches LightTree.hlsli");
+static_assert(offsetof(LightTreeNode, range) == 28, "LightTreeNode no longer matches LightTree.hlsli");
+static_assert(offsetof(LightTreeNode, axis) == 32, "LightTreeNode no longer matches LightTree.hlsli");
+static_assert(offsetof(LightTreeNode, thetaO) == 44, "LightTreeNode no longer matches LightTree.hlsli");
+static_assert(offsetof(LightTreeNode, thetaE) == 48, "LightTreeNode no longer matches LightTree.hlsli");
+static_assert(offsetof(LightTreeNode, type) == 52, "LightTreeNode no longer matches LightTree.hlsli");
+static_assert(offsetof(LightTreeNode, index) == 56, "LightTreeNode no longer matches LightTree.hlsli");
+static_assert(offsetof(LightTreeNode, spotFalloff) == 60, "LightTreeNode no longer matches LightTree.hlsli");
+
+class LightTree
+{
+public:
+	LightTree();
+
+	/// <summary>
+	/// Builds the tree from scratch
+	/// </summary>
+	/// <param name="lights">Lights to choose from (indices into this array are what Sample() returns)</param>
+	/// <param name="lightCount">How many lights there are</param>
+	void Build(const Light* lights, unsigned int lightCount);
+
+	/// <summary>
+	/// Updates every node for lights that have moved, turned or changed brightness,
+	/// keeping the same tree.  Needs the same lights as the last Build() (the same
+	/// count, with the same ones directional), only changed.
+	/// </summary>
+	void Refit(const Light* lights);
+
+	/// <summary>
+	/// Chooses a light for a point on a surface
+	/// </summary>
+	/// <param name="position">World space shading point</param>
+	/// <param name="normal">Surface's unit normal (on the side light arrives from)</param>
+	/// <param name="u">Random number in [0, 1)</param>
+	/// <param name="pdf">Set to the chance of having chosen that light</param>
+	/// <returns>Index of the light, or LIGHT_TREE_NO_LIGHT if none can reach the point</returns>
+	unsigned int Sample(DirectX::XMFLOAT3 position, DirectX::XMFLOAT3 normal, float u, float* pdf) const;
+
+	/// <summary>
+	/// The chance Sample() chooses a specific light for a point on a surface
+	/// </summary>
+	float Pdf(DirectX::XMFLOAT3 position, DirectX::XMFLOAT3 normal, unsigned int lightIndex) const;
+
+	/// <summary>
+	/// Estimate of how much a node's lights contribute to a point (zero only if none of them can)
+	/// </summary>
+	static float Importance(const LightTreeNode& node, DirectX::FXMVECTOR position, DirectX::FXMVECTOR normal);
+
+	// Tree nodes, then one per directional light (upload these as they are)
+	const std::vector<LightTreeNode>& GetNodes() const;
+	unsigned int GetNodeCount() const;
+	unsigned int GetInfiniteLightCount() const;
+
+private:
+	std::vector<LightTreeNode> nodes;
+	unsigned int treeNodeCount;
+
+	// For walking back up from a light (Pdf() only, so not part of the node)
+	std::vector<unsigned int> parents;
+	std::vector<unsigned int> lightNodes;
+
+	// Scratch space for building (kept to avoid reallocating on rebuilds)
+	std::vector<unsigned int> lightOrder;
+	std::vector<LightTreeNode> lightLeaves;	// What each light's leaf will hold
+
+	void Subdivide();
+	float FindSplit(unsigned int first, unsigned int count, const AABB& bounds, unsigned int* axis, float* position) const;
+	float TopLevelImportance(DirectX::FXMVECTOR position, DirectX::FXMVECTOR normal) const;
+};
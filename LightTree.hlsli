@@ -0,0 +1,131 @@
+// Samples the light tree LightTree builds on the CPU, from its node array
+// uploaded as a structured buffer (see LightTree.h for how it's laid out).
+// Mirrors LightTree::Sample() and LightTree::Importance() step by step.
+// No shader includes it yet; the static_asserts in LightTree.h keep the
+// node layout in step with this one until one does.
+
+#define LIGHT_TREE_NODE_INTERIOR	0
+#define LIGHT_TREE_NODE_LEAF		1
+#define LIGHT_TREE_NODE_INFINITE	2
+
+#define LIGHT_TREE_NO_LIGHT 0xFFFFFFFF
+
+static const float LightTreeHalfPi = 1.570796327f;
+
+// Ensure this matches C++ LightTreeNode struct (LightTree.h)!
+struct LightTreeNode
+{
+	float3 boundsMin;
+	float power;
+	float3 boundsMax;
+	float range;
+	float3 axis;
+	float thetaO;
+	float thetaE;
+	uint type;
+	uint index;
+	float spotFalloff;
+};
+
+// Upper bound on how much a node's lights contribute to a point (zero only if none of them can)
+float LightTreeImportance(LightTreeNode node, float3 position, float3 normal)
+{
+	if (node.power <= 0)
+		return 0;
+
+	if (node.type == LIGHT_TREE_NODE_INFINITE)
+		return node.power * max(-dot(normal, node.axis), 0);
+
+	// Range falloff from the closest the lights could be
+	float3 closest = clamp(position, node.boundsMin, node.boundsMax) - position;
+	float closestSquared = dot(closest, closest);
+	float rangeSquared = node.range * node.range;
+	if (closestSquared >= rangeSquared)
+		return 0;
+
+	float falloff = 1.0f - closestSquared / rangeSquared;
+	falloff *= falloff;
+
+	// Inside the box, light could come from any direction
+	float3 center = (node.boundsMin + node.boundsMax) * 0.5f;
+	float3 toCenter = center - position;
+	float centerDistance = length(toCenter);
+	float radius = length(node.boundsMax - center);
+	if (centerDistance <= radius)
+		return node.power * falloff;
+
+	float3 direction = toCenter / centerDistance;
+	float thetaU = asin(radius / centerDistance);
+
+	float thetaI = max(acos(clamp(dot(normal, direction), -1, 1)) - thetaU, 0);
+	if (thetaI >= LightTreeHalfPi)
+		return 0;
+
+	float theta = max(acos(clamp(-dot(node.axis, direction), -1, 1)) - node.thetaO - thetaU, 0);
+	if (theta >= node.thetaE)
+		return 0;
+
+	return node.power * falloff * cos(thetaI) * pow(cos(theta), node.spotFalloff);
+}
+
+// Chooses a light for a point on a surface, returning its index (or
+// LIGHT_TREE_NO_LIGHT) and the chance of having chosen it
+// - nodeCount: every node in the buffer
+// - infiniteCount: how many of those (at the end) are directional lights
+uint SampleLightTree(StructuredBuffer<LightTreeNode> nodes, uint nodeCount, uint infiniteCount, float3 position, float3 normal, float u, out float pdf)
+{
+	pdf = 0;
+	uint treeNodeCount = nodeCount - infiniteCount;
+
+	float rootImportance = treeNodeCount > 0 ? LightTreeImportance(nodes[0], position, normal) : 0;
+	float total = rootImportance;
+	for (uint i = treeNodeCount; i < nodeCount; i++)
+		total += LightTreeImportance(nodes[i], position, normal);
+	if (total <= 0)
+		return LIGHT_TREE_NO_LIGHT;
+
+	// Directional lights first, then the tree with whatever's left
+	float target = u * total;
+	for (uint j = treeNodeCount; j < nodeCount; j++)
+	{
+		float importance = LightTreeImportance(nodes[j], position, normal);
+		if (target < importance)
+		{
+			pdf = importance / total;
+			return nodes[j].index;
+		}
+		target -= importance;
+	}
+
+	if (rootImportance <= 0)
+		return LIGHT_TREE_NO_LIGHT;
+
+	float probability = rootImportance / total;
+	u = min(target / rootImportance, 0.99999994f);
+
+	uint index = 0;
+	while (nodes[index].type == LIGHT_TREE_NODE_INTERIOR)
+	{
+		uint child = nodes[index].index;
+		float firstImportance = LightTreeImportance(nodes[child], position, normal);
+		float secondImportance = LightTreeImportance(nodes[child + 1], position, normal);
+		float childTotal = firstImportance + secondImportance;
+		float firstProbability = childTotal > 0 ? firstImportance / childTotal : 0;
+		float secondProbability = childTotal > 0 ? secondImportance / childTotal : 1;
+		if (u < firstProbability)
+		{
+			u = min(u / firstProbability, 0.99999994f);
+			probability *= firstProbability;
+			index = child;
+		}
+		else
+		{
+			u = min(max(u - firstProbability, 0) / secondProbability, 0.99999994f);
+			probability *= secondProbability;
+			index = child + 1;
+		}
+	}
+
+	pdf = probability;
+	return probability > 0 ? nodes[index].index : LIGHT_TREE_NO_LIGHT;
+}
@@ -0,0 +1,245 @@
+#include "LightTreeBenchmark.h"
+#include "BenchmarkUtils.h"
+#include "LightTree.h"
+
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <vector>
+
+using namespace DirectX;
+using namespace BenchmarkUtils;
+
+namespace
+{
+	// Half the width of the square the lights are scattered over
+	const float SceneSize = 50.0f;
+
+	struct ShadingPoint
+	{
+		XMFLOAT3 position;
+		XMFLOAT3 normal;
+	};
+
+	// Luminance reaching a point from a light, exactly as the raytracing
+	// shaders light a diffuse surface (no shadows)
+	float Contribution(const Light& light, const ShadingPoint& point)
+	{
+		XMVECTOR position = XMLoadFloat3(&point.position);
+		XMVECTOR normal = XMLoadFloat3(&point.normal);
+		float luminance = (0.2126f * light.Color.x + 0.7152f * light.Color.y + 0.0722f * light.Color.z) * light.Intensity;
+		if (light.Type == LIGHT_TYPE_DIRECTIONAL)
+			return luminance * fmaxf(-XMVectorGetX(XMVector3Dot(normal, XMVector3Normalize(XMLoadFloat3(&light.Direction)))), 0.0f);
+
+		XMVECTOR toLight = XMLoadFloat3(&light.Position) - position;
+		float distance = XMVectorGetX(XMVector3Length(toLight));
+		XMVECTOR direction = toLight / XMVectorReplicate(distance);
+		float falloff = fmaxf(1.0f - distance * distance / (light.Range * light.Range), 0.0f);
+		falloff *= falloff;
+		if (light.Type == LIGHT_TYPE_SPOT)
+			falloff *= powf(fmaxf(-XMVectorGetX(XMVector3Dot(direction, XMVector3Normalize(XMLoadFloat3(&light.Direction)))), 0.0f), light.SpotFalloff);
+
+		return luminance * falloff * fmaxf(XMVectorGetX(XMVector3Dot(normal, direction)), 0.0f);
+	}
+
+	// Mostly point and spot lights hanging over the floor, plus a couple of dim suns
+	std::vector<Light> ScatterLights(unsigned int lightCount, std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		std::vector<Light> lights(lightCount);
+		for (unsigned int i = 0; i < lightCount; i++)
+		{
+			Light& light = lights[i];
+			light = {};
+			light.Color = XMFLOAT3(0.5f + unit(random) * 0.5f, 0.5f + unit(random) * 0.5f, 0.5f + unit(random) * 0.5f);
+			if (i < 2)
+			{
+				light.Type = LIGHT_TYPE_DIRECTIONAL;
+				light.Direction = XMFLOAT3(unit(random) - 0.5f, -1.0f, unit(random) - 0.5f);
+				light.Intensity = 0.05f;
+				continue;
+			}
+
+			light.Type = unit(random) < 0.25f ? LIGHT_TYPE_SPOT : LIGHT_TYPE_POINT;
+			light.Position = XMFLOAT3((unit(random) * 2 - 1) * SceneSize, 0.5f + unit(random) * 4.5f, (unit(random) * 2 - 1) * SceneSize);
+			light.Range = 2.0f + unit(random) * 8.0f;
+			light.Intensity = 0.2f + unit(random) * 2.0f;
+			light.Direction = XMFLOAT3(unit(random) - 0.5f, -1.0f, unit(random) - 0.5f);
+			light.SpotFalloff = 2.0f + unit(random) * 30.0f;
+		}
+		return lights;
+	}
+
+	// Root mean square error of one-light estimates at every point, relative
+	// to the average exact lighting, choosing lights with the tree (or
+	// uniformly, without one)
+	double EstimateError(
+		const std::vector<Light>& lights,
+		const LightTree* tree,
+		const std::vector<ShadingPoint>& points,
+		const std::vector<double>& exact,
+		unsigned int samplesPerPoint,
+		std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		double squaredError = 0;
+		double exactTotal = 0;
+		for (unsigned int p = 0; p < points.size(); p++)
+		{
+			double estimate = 0;
+			for (unsigned int s = 0; s < samplesPerPoint; s++)
+			{
+				float u = (s + unit(random)) / samplesPerPoint;
+				if (tree)
+				{
+					float pdf;
+					unsigned int light = tree->Sample(points[p].position, points[p].normal, u, &pdf);
+					if (light != LIGHT_TREE_NO_LIGHT)
+						estimate += Contribution(lights[light], points[p]) / pdf;
+				}
+				else
+				{
+					unsigned int light = (unsigned int)(u * lights.size());
+					light = light < lights.size() ? light : (unsigned int)lights.size() - 1;
+					estimate += Contribution(lights[light], points[p]) * lights.size();
+				}
+			}
+
+			double error = estimate / samplesPerPoint - exact[p];
+			squaredError += error * error;
+			exactTotal += exact[p];
+		}
+		return exactTotal > 0 ? sqrt(squaredError / points.size()) / (exactTotal / points.size()) : 0.0;
+	}
+}
+
+bool LightTreeBenchmark::Run()
+{
+	bool passed = true;
+	passed &= Run(1000, 2000, 4);
+	passed &= Run(10000, 2000, 4);
+	return passed;
+}
+
+// --------------------------------------------------------
+// Scatters lights and shading points, then checks the
+// tree's probabilities and compares its estimates against
+// uniform light selection, before and after moving every
+// light
+// --------------------------------------------------------
+bool LightTreeBenchmark::Run(unsigned int lightCount, unsigned int pointCount, unsigned int samplesPerPoint)
+{
+	printf("Light tree benchmark: %u lights, %u points, %u samples each\n", lightCount, pointCount, samplesPerPoint);
+
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::vector<Light> lights = ScatterLights(lightCount, random);
+
+	// Mostly the floor, with some points on walls facing every way
+	std::vector<ShadingPoint> points(pointCount);
+	for (ShadingPoint& point : points)
+	{
+		point.position = XMFLOAT3((unit(random) * 2 - 1) * SceneSize, 0.0f, (unit(random) * 2 - 1) * SceneSize);
+		point.normal = XMFLOAT3(0, 1, 0);
+		if (unit(random) < 0.25f)
+		{
+			float angle = unit(random) * XM_2PI;
+			point.position.y = unit(random) * 4.0f;
+			point.normal = XMFLOAT3(cosf(angle), 0, sinf(angle));
+		}
+	}
+
+	LightTree tree;
+	const unsigned int buildRepeats = 10;
+	Clock::time_point start = Clock::now();
+	for (unsigned int r = 0; r < buildRepeats; r++)
+		tree.Build(lights.data(), lightCount);
+	double buildMs = MillisecondsSince(start) / buildRepeats;
+	printf("  build     %8.3f ms   %u nodes (%u directional)\n", buildMs, tree.GetNodeCount(), tree.GetInfiniteLightCount());
+
+	std::vector<double> exact(pointCount, 0.0);
+	for (unsigned int p = 0; p < pointCount; p++)
+	{
+		for (const Light& light : lights)
+			exact[p] += Contribution(light, points[p]);
+	}
+
+	// Probabilities (at the first few hundred points, as it's every light
+	// at every point): every light that reaches a point must be choosable
+	// there (short of ones so faint their chance underflows), and the
+	// chances of choosing each light must add up to one
+	unsigned int checkedPoints = pointCount < 200 ? pointCount : 200;
+	unsigned int missedLights = 0;
+	double worstSum = 0;
+	double worstMismatch = 0;
+	for (unsigned int p = 0; p < checkedPoints; p++)
+	{
+		double pdfSum = 0;
+		for (unsigned int l = 0; l < lightCount; l++)
+		{
+			float pdf = tree.Pdf(points[p].position, points[p].normal, l);
+			pdfSum += pdf;
+			missedLights += Contribution(lights[l], points[p]) > exact[p] * 1e-6 && pdf <= 0 ? 1 : 0;
+		}
+
+		if (exact[p] > 0)
+			worstSum = fmax(worstSum, fabs(pdfSum - 1.0));
+
+		float pdf;
+		unsigned int light = tree.Sample(points[p].position, points[p].normal, unit(random), &pdf);
+		if (light != LIGHT_TREE_NO_LIGHT)
+		{
+			float expected = tree.Pdf(points[p].position, points[p].normal, light);
+			worstMismatch = fmax(worstMismatch, fabs(pdf - expected) / expected);
+		}
+	}
+	printf("  pdf       %u points   lights missed %u %s   worst sum error %.2e %s   worst Sample()/Pdf() mismatch %.2e %s\n",
+		checkedPoints,
+		missedLights, Verdict(missedLights == 0),
+		worstSum, Verdict(worstSum < 1e-3),
+		worstMismatch, Verdict(worstMismatch < 1e-3));
+
+	// Quality: tree against uniform, at the same number of samples
+	start = Clock::now();
+	double treeError = EstimateError(lights, &tree, points, exact, samplesPerPoint, random);
+	double treeMs = MillisecondsSince(start);
+	start = Clock::now();
+	double uniformError = EstimateError(lights, 0, points, exact, samplesPerPoint, random);
+	double uniformMs = MillisecondsSince(start);
+	printf("  estimate  uniform relative RMSE %8.4f (%.1f ms)   tree %8.4f (%.1f ms)   %.1fx lower\n",
+		uniformError, uniformMs, treeError, treeMs, treeError > 0 ? uniformError / treeError : 0.0);
+
+	// Move every light a little and turn the spots, then refit and rebuild
+	for (Light& light : lights)
+	{
+		light.Position.x += unit(random) * 2 - 1;
+		light.Position.z += unit(random) * 2 - 1;
+		light.Direction.x += (unit(random) - 0.5f) * 0.5f;
+	}
+	for (unsigned int p = 0; p < pointCount; p++)
+	{
+		exact[p] = 0;
+		for (const Light& light : lights)
+			exact[p] += Contribution(light, points[p]);
+	}
+
+	start = Clock::now();
+	for (unsigned int r = 0; r < buildRepeats; r++)
+		tree.Refit(lights.data());
+	double refitMs = MillisecondsSince(start) / buildRepeats;
+	double refitError = EstimateError(lights, &tree, points, exact, samplesPerPoint, random);
+
+	LightTree rebuilt;
+	rebuilt.Build(lights.data(), lightCount);
+	double rebuiltError = EstimateError(lights, &rebuilt, points, exact, samplesPerPoint, random);
+	printf("  moved     refit %8.3f ms (%.1fx faster than building)   relative RMSE refit %8.4f   rebuilt %8.4f\n",
+		refitMs, refitMs > 0 ? buildMs / refitMs : 0.0, refitError, rebuiltError);
+
+	// A refit only widens the bounds it already has, so it can lose some
+	// quality, but not so much that rebuilding would be worth it
+	bool passed = missedLights == 0 && worstSum < 1e-3 && worstMismatch < 1e-3;
+	passed &= Expect(treeError < uniformError, "the tree to beat choosing lights uniformly");
+	passed &= Expect(refitMs < buildMs, "refitting to be faster than building");
+	passed &= Expect(refitError < rebuiltError * 1.5, "a refit to stay within 50% of a rebuilt tree's error");
+	return passed;
+}
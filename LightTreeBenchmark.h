@@ -0,0 +1,31 @@
+#pragma once
+
+// Checks and times the LightTree on thousands of randomly placed point,
+// spot and directional lights over a floor:
+//  - every light that reaches a point can be chosen there, the chances of
+//    choosing each light add up to one, and Sample() agrees with Pdf()
+//  - error of one-light direct lighting estimates, against choosing
+//    lights uniformly, relative to the exact sum over every light
+//  - build and refit times, and how much a refit (after every light
+//    moves) costs in quality against a rebuild
+// Start the program with -benchmark to run it (see HeadlessTests.h); it
+// fails if any probability is off, the tree doesn't beat uniform choice,
+// or refitting isn't faster than building or costs too much quality.
+
+namespace LightTreeBenchmark
+{
+	/// <summary>
+	/// Runs the benchmark with 1k and 10k lights
+	/// </summary>
+	/// <returns>Whether every check passed at both sizes</returns>
+	bool Run();
+
+	/// <summary>
+	/// Runs the benchmark for a single number of lights
+	/// </summary>
+	/// <param name="lightCount">How many lights to scatter</param>
+	/// <param name="pointCount">How many shading points to estimate lighting at</param>
+	/// <param name="samplesPerPoint">How many lights to sample at each point</param>
+	/// <returns>Whether every check passed</returns>
+	bool Run(unsigned int lightCount, unsigned int pointCount, unsigned int samplesPerPoint);
+}
@@ -1,6 +1,9 @@
 
 #include <Windows.h>
+#include <stdio.h>
+#include <string.h>
 #include "Game.h"
+#include "HeadlessTests.h"
 
 // --------------------------------------------------------
 // Entry point for a graphical (non-console) Windows application
@@ -18,6 +21,19 @@ int WINAPI WinMain(
 	_CrtSetDbgFlag( _CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF );
 #endif
 
+	// Run the CPU-only checks (and benchmarks) instead of the game, reporting to
+	// the console we were started from (or a new one) and exiting with the failure count
+	bool benchmarks = strstr(lpCmdLine, "-benchmark") != 0;
+	if (strstr(lpCmdLine, "-test") || benchmarks)
+	{
+		if (!AttachConsole(ATTACH_PARENT_PROCESS))
+			AllocConsole();
+
+		FILE* stream;
+		freopen_s(&stream, "CONOUT$", "w", stdout);
+		return HeadlessTests::Run(benchmarks);
+	}
+
 	// Create the Game object using
 	// the app handle we got from WinMain
 	Game dxGame(hInstance);
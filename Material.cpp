@@ -52,12 +52,8 @@ void Material::FinalizeMaterial()
 	if (finalized) // Don't finalize twice
 		return;
 
-	// Store GPU reference to first SRV copied over
-	finalGPUHandleForFirstSRV = DX12Helper::GetInstance().CopySRVsToDescriptorHeapAndGetGPUDescriptorHandle(textureSRVsBySlot[0], 1);
-	for (unsigned int i = 1; i < 4; i++) {
-		// Can't copy all 4 at once because they are in different heaps
-		DX12Helper::GetInstance().CopySRVsToDescriptorHeapAndGetGPUDescriptorHandle(textureSRVsBySlot[i], 1);
-	}
+	// Gather all 4 SRVs into one table with a single copy and store GPU reference to the first
+	finalGPUHandleForFirstSRV = DX12Helper::GetInstance().CopySRVsToDescriptorHeapAndGetGPUDescriptorHandle(textureSRVsBySlot, 4);
 
 	finalized = true;
 }
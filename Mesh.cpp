@@ -7,10 +7,10 @@
 
 using namespace DirectX;
 
-Mesh::Mesh(Vertex* vertices, int vertexCount, unsigned int* indices, int indexCount)
-	: vertexCount(vertexCount), indexCount(indexCount)
+Mesh::Mesh(Vertex* vertices, int vertexCount, unsigned int* indices, int indexCount, bool cpuOnly)
+	: vbView{}, ibView{}, vertexCount(vertexCount), indexCount(indexCount)
 {
-	Init(vertices, vertexCount, indices, indexCount);
+	Init(vertices, vertexCount, indices, indexCount, cpuOnly);
 }
 
 Mesh::Mesh(const wchar_t* filename)
@@ -231,16 +231,26 @@ Mesh::~Mesh()
 
 }
 
-void Mesh::Init(Vertex* vertices, int vertexCount, unsigned int* indices, int indexCount)
+void Mesh::Init(Vertex* vertices, int vertexCount, unsigned int* indices, int indexCount, bool cpuOnly)
 {
 	CalculateTangents(vertices, vertexCount, indices, indexCount);
 
+	// Local space bounds, for spatial queries
+	localBounds = Bounds::Empty();
+	for (int i = 0; i < vertexCount; i++)
+		Bounds::Expand(localBounds, vertices[i].Position);
+
+	// CPU copy of the triangles, for picking
+	cpuBVH.Build(vertices, vertexCount, indices, indexCount);
+	if (cpuOnly)
+		return;
+
 	// Below code mostly copied from Game.cpp starter code
 	
 	// Create the two buffers
 	DX12Helper& dx12Helper = DX12Helper::GetInstance();
-	vertexBuffer = dx12Helper.CreateStaticBuffer(sizeof(Vertex), vertexCount, vertices);
-	indexBuffer = dx12Helper.CreateStaticBuffer(sizeof(unsigned int), indexCount, indices);
+	vertexBuffer = dx12Helper.CreateStaticBuffer(sizeof(Vertex), vertexCount, vertices, GpuMemoryCategory::MeshGeometry);
+	indexBuffer = dx12Helper.CreateStaticBuffer(sizeof(unsigned int), indexCount, indices, GpuMemoryCategory::MeshGeometry);
 
 	// Set up the views
 	vbView.StrideInBytes = sizeof(Vertex);
@@ -285,11 +295,21 @@ unsigned int Mesh::GetIndexCount()
 	return indexCount;
 }
 
-MeshRaytracingData Mesh::GetRaytracingData()
+const MeshRaytracingData& Mesh::GetRaytracingData()
 {
 	return raytraceData;
 }
 
+const AABB& Mesh::GetLocalBounds()
+{
+	return localBounds;
+}
+
+const MeshBVH& Mesh::GetCpuBVH()
+{
+	return cpuBVH;
+}
+
 //void Mesh::Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
 //{
 //	// Below code mostly copied from Game.cpp starter code
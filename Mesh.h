@@ -7,6 +7,8 @@
 #include <d3d12.h>
 #include <wrl/client.h>
 #include "Vertex.h"
+#include "Bounds.h"
+#include "MeshBVH.h"
 
 struct MeshRaytracingData
 {
@@ -22,7 +24,8 @@ public:
 	/// <summary>
 	/// Constructor that takes the raw vertex/index data
 	/// </summary>
-	Mesh(Vertex* vertices, int vertexCount, unsigned int* indices, int indexCount);
+	/// <param name="cpuOnly">Skips the GPU buffers and BLAS, keeping only the CPU copy (for running without a device)</param>
+	Mesh(Vertex* vertices, int vertexCount, unsigned int* indices, int indexCount, bool cpuOnly = false);
 	/// <summary>
 	/// Constructor that takes the name of an OBJ file to load from
 	/// </summary>
@@ -63,7 +66,17 @@ public:
 	/// Returns this mesh's raytracing data
 	/// </summary>
 	/// <returns>This mesh's raytracing data</returns>
-	MeshRaytracingData GetRaytracingData();
+	const MeshRaytracingData& GetRaytracingData();
+	/// <summary>
+	/// Returns the box around all of this mesh's vertices
+	/// </summary>
+	/// <returns>This mesh's bounds, in local space</returns>
+	const AABB& GetLocalBounds();
+	/// <summary>
+	/// Returns the CPU copy of this mesh's triangles, for tracing rays without the GPU
+	/// </summary>
+	/// <returns>This mesh's triangle hierarchy, in local space</returns>
+	const MeshBVH& GetCpuBVH();
 	/// <summary>
 	/// Draws this mesh
 	/// </summary>
@@ -80,8 +93,10 @@ private:
 	unsigned int indexCount;
 
 	MeshRaytracingData raytraceData;
+	AABB localBounds;
+	MeshBVH cpuBVH;
 
-	void Init(Vertex* vertices, int vertexCount, unsigned int* indices, int indexCount);
+	void Init(Vertex* vertices, int vertexCount, unsigned int* indices, int indexCount, bool cpuOnly = false);
 	void CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices);
 };
 
@@ -0,0 +1,108 @@
+#include "MeshBVH.h"
+
+#include <cassert>
+
+using namespace DirectX;
+
+MeshBVH::MeshBVH()
+{
+}
+
+
+// --------------------------------------------------------
+// Builds over each triangle's bounds, then lays the
+// triangles out in the order the leaves reference them
+// --------------------------------------------------------
+void MeshBVH::Build(const Vertex* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount)
+{
+	// An index past the end would read garbage into the hierarchy
+	for (unsigned int i = 0; i < indexCount; i++)
+		assert(indices[i] < vertexCount);
+
+	unsigned int triangleCount = indexCount / 3;
+	std::vector<AABB> triangleBounds(triangleCount);
+	for (unsigned int t = 0; t < triangleCount; t++)
+	{
+		AABB& box = triangleBounds[t] = Bounds::Empty();
+		for (unsigned int v = 0; v < 3; v++)
+			Bounds::Expand(box, vertices[indices[t * 3 + v]].Position);
+	}
+
+	hierarchy.Build(triangleBounds.data(), triangleCount);
+
+	triangles.resize(triangleCount);
+	for (unsigned int i = 0; i < triangleCount; i++)
+	{
+		unsigned int t = hierarchy.GetPrimitive(i);
+		XMVECTOR v0 = XMLoadFloat3(&vertices[indices[t * 3 + 0]].Position);
+		XMVECTOR v1 = XMLoadFloat3(&vertices[indices[t * 3 + 1]].Position);
+		XMVECTOR v2 = XMLoadFloat3(&vertices[indices[t * 3 + 2]].Position);
+
+		Triangle& triangle = triangles[i];
+		XMStoreFloat3(&triangle.vertex0, v0);
+		XMStoreFloat3(&triangle.edge1, v1 - v0);
+		XMStoreFloat3(&triangle.edge2, v2 - v0);
+		triangle.index = t;
+	}
+
+	normals.resize(triangleCount * 3);
+	for (unsigned int i = 0; i < triangleCount * 3; i++)
+		normals[i] = vertices[indices[i]].Normal;
+}
+
+// --------------------------------------------------------
+// Moller-Trumbore against each triangle the hierarchy
+// reaches, shortening the ray with every closer hit
+// --------------------------------------------------------
+bool MeshBVH::Raycast(const Ray& ray, TriangleHit* hit) const
+{
+	XMVECTOR origin = XMLoadFloat3(&ray.origin);
+	XMVECTOR direction = XMLoadFloat3(&ray.direction);
+
+	auto hitTest = [&](unsigned int primitive, Ray& currentRay)
+	{
+		const Triangle& triangle = triangles[primitive];
+		XMVECTOR edge1 = XMLoadFloat3(&triangle.edge1);
+		XMVECTOR edge2 = XMLoadFloat3(&triangle.edge2);
+
+		XMVECTOR p = XMVector3Cross(direction, edge2);
+		float determinant = XMVectorGetX(XMVector3Dot(edge1, p));
+		if (determinant == 0.0f)
+			return false; // Parallel to the triangle
+
+		float inverseDeterminant = 1.0f / determinant;
+		XMVECTOR toOrigin = origin - XMLoadFloat3(&triangle.vertex0);
+		float u = XMVectorGetX(XMVector3Dot(toOrigin, p)) * inverseDeterminant;
+		if (u < 0.0f || u > 1.0f)
+			return false;
+
+		XMVECTOR q = XMVector3Cross(toOrigin, edge1);
+		float v = XMVectorGetX(XMVector3Dot(direction, q)) * inverseDeterminant;
+		if (v < 0.0f || u + v > 1.0f)
+			return false;
+
+		float t = XMVectorGetX(XMVector3Dot(edge2, q)) * inverseDeterminant;
+		if (t < MESH_BVH_MIN_DISTANCE || t > currentRay.maxDistance)
+			return false;
+
+		currentRay.maxDistance = t;
+		hit->triangle = triangle.index;
+		hit->barycentrics = XMFLOAT2(u, v);
+		hit->distance = t;
+		return true;
+	};
+
+	return hierarchy.Raycast(ray, hitTest);
+}
+
+XMFLOAT3 MeshBVH::InterpolateNormal(unsigned int triangle, XMFLOAT2 barycentrics) const
+{
+	XMVECTOR normal =
+		XMLoadFloat3(&normals[triangle * 3 + 0]) * (1.0f - barycentrics.x - barycentrics.y) +
+		XMLoadFloat3(&normals[triangle * 3 + 1]) * barycentrics.x +
+		XMLoadFloat3(&normals[triangle * 3 + 2]) * barycentrics.y;
+
+	XMFLOAT3 result;
+	XMStoreFloat3(&result, normal);
+	return result;
+}
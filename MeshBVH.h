@@ -0,0 +1,73 @@
+#pragma once
+
+// A CPU copy of a mesh's triangles, arranged in a BoundingVolumeHierarchy
+// so rays can be traced against the mesh without the GPU - the CPU side
+// counterpart of the mesh's BLAS.  Triangles are stored in the order the
+// hierarchy visits them, already set up for the ray/triangle test.
+// Vertex normals are kept too (in the mesh's own order), so the CPU
+// tracer can shade hits the same way the hit shaders do.
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "BoundingVolumeHierarchy.h"
+#include "Vertex.h"
+
+// Hits closer than this are ignored (matches the TMin the raytracing shaders use)
+#define MESH_BVH_MIN_DISTANCE 0.0001f
+
+// Where a ray hit a triangle
+struct TriangleHit
+{
+	unsigned int triangle;				// Index of the triangle (its first index is at triangle * 3)
+	DirectX::XMFLOAT2 barycentrics;		// Weights of the triangle's second and third vertices, like DXR's
+	float distance;						// How far along the ray, in multiples of its direction
+};
+
+class MeshBVH
+{
+public:
+	MeshBVH();
+
+	/// <summary>
+	/// Copies the triangles and builds the hierarchy over them
+	/// </summary>
+	/// <param name="vertices">The mesh's vertices</param>
+	/// <param name="vertexCount">How many vertices there are (every index must be below this)</param>
+	/// <param name="indices">Three per triangle</param>
+	/// <param name="indexCount">How many indices there are</param>
+	void Build(const Vertex* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount);
+
+	/// <summary>
+	/// Finds the closest triangle the ray hits (both sides count, as with RAY_FLAG_NONE)
+	/// </summary>
+	/// <param name="ray">Ray in the mesh's local space</param>
+	/// <param name="hit">Filled in with the closest hit, if any</param>
+	/// <returns>True if a triangle was hit</returns>
+	bool Raycast(const Ray& ray, TriangleHit* hit) const;
+
+	/// <summary>
+	/// Blends a triangle's vertex normals, like InterpolateVertices() in the shaders
+	/// </summary>
+	/// <param name="triangle">Which triangle (as reported by a hit)</param>
+	/// <param name="barycentrics">Weights of the second and third vertices</param>
+	/// <returns>The local space normal (not renormalized)</returns>
+	DirectX::XMFLOAT3 InterpolateNormal(unsigned int triangle, DirectX::XMFLOAT2 barycentrics) const;
+
+	unsigned int GetTriangleCount() const { return (unsigned int)triangles.size(); }
+	unsigned int GetNodeCount() const { return hierarchy.GetNodeCount(); }
+
+private:
+	// A triangle set up for Moller-Trumbore
+	struct Triangle
+	{
+		DirectX::XMFLOAT3 vertex0;
+		DirectX::XMFLOAT3 edge1;	// vertex1 - vertex0
+		DirectX::XMFLOAT3 edge2;	// vertex2 - vertex0
+		unsigned int index;			// Which triangle of the mesh this is
+	};
+
+	BoundingVolumeHierarchy hierarchy;
+	std::vector<Triangle> triangles; // In hierarchy order
+	std::vector<DirectX::XMFLOAT3> normals; // Three per triangle, in the mesh's order
+};
@@ -1,8 +1,17 @@
 
+#include "Sampler.h"
+
 // === Defines ===
 
 #define PI 3.141592654f
-#define MAX_RECURSION_DEPTH 10
+#define MAX_PATH_DEPTH 10				// Bounces before a path is cut off
+#define ROULETTE_MIN_DEPTH 3			// Bounces before paths can be ended early by Russian roulette
+#define ROULETTE_MAX_SURVIVAL 0.95f		// Even the brightest paths have some chance of ending
+#define MAX_LIGHTS 5					// Matches MAX_RAYTRACING_LIGHTS in BufferStructs.h
+
+#define LIGHT_TYPE_DIRECTIONAL	0
+#define LIGHT_TYPE_POINT		1
+#define LIGHT_TYPE_SPOT			2
 
 // === Structs ===
 
@@ -25,14 +34,37 @@ struct MaterialData
 	uint metalIndex;
 };
 
+// Ensure this matches C++ RaytracingInstanceData struct!
+struct InstanceData
+{
+	matrix worldInvTranspose;
+	MaterialData material;
+};
+
+
+// Ensure this matches C++ Light struct (Lights.h)!
+struct Light
+{
+	int type;
+	float3 direction;
+	float range;
+	float3 position;
+	float intensity;
+	float3 color;
+	float spotFalloff;
+	float3 padding;
+};
+
 
 // Payload for rays (data that is "sent along" with each ray during raytrace)
 // Note: This should be as small as possible
+// Note: The hit shaders only describe what the ray found - RayGen does the bouncing
 struct RayPayload
 {
-	float3 color;
-	uint recursionDepth; // How many times this ray has bounced
-	uint rayPerPixelIndex; // What is this ray's index within its pixel (used for PRNG)
+	float3 color;		// Surface's tint, or the sky's color on a miss
+	float hitDistance;	// Negative on a miss
+	float3 normal;		// World space surface normal
+	float roughness;	// Blend between a perfect reflection (0) and diffuse (1)
 };
 
 // Note: We'll be using the built-in BuiltInTriangleIntersectionAttributes struct
@@ -46,27 +78,31 @@ cbuffer SceneData : register(b0)
 {
 	matrix inverseViewProjection;
 	float3 cameraPosition;
-	float pad0;
+	uint frameIndex;		// How many frames are already in the accumulation buffer (0 = start over)
+	uint samplesPerPixel;	// How many new samples each pixel gets this frame
+	float3 pad0;
+	Light lights[MAX_LIGHTS];
+	uint lightCount;
+	float3 pad1;
 };
 
 
-// Ensure this matches C++ buffer struct define!
-#define MAX_INSTANCES_PER_BLAS 100
-cbuffer ObjectData : register(b1)
-{
-	matrix worldInvTranspose[MAX_INSTANCES_PER_BLAS];
-	MaterialData material[MAX_INSTANCES_PER_BLAS];
-};
-
 
 // === Resources ===
 
 // Output UAV 
 RWTexture2D<float4> OutputColor				: register(u0);
 
+// Running sum of every sample since the last reset (linear color in rgb, sample count in a)
+RWTexture2D<float4> AccumulationBuffer		: register(u1);
+
 // The actual scene we want to trace through (a TLAS)
 RaytracingAccelerationStructure SceneTLAS	: register(t0);
 
+// Data for every instance in the scene, indexed by InstanceID()
+// Note: In its own space, since the bindless textures below take up the rest of space0
+StructuredBuffer<InstanceData> Instances	: register(t0, space1);
+
 // Geometry buffers
 ByteAddressBuffer IndexBuffer        		: register(t1);
 ByteAddressBuffer VertexBuffer				: register(t2);
@@ -74,25 +110,8 @@ Texture2D textures[]						: register(t3);
 
 SamplerState BasicSampler					: register(s0);
 
-// === Pseudo-random Number Generators ===
-float rand(float2 uv)
-{
-	return frac(sin(dot(uv, float2(12.9898, 78.233))) * 43758.5453);
-}
-
-float2 rand2(float2 uv)
-{
-	float x = rand(uv);
-	float y = sqrt(1 - x * x);
-	return float2(x, y);
-}
-
-float3 rand3(float2 uv)
-{
-	return float3(
-		rand2(uv),
-		rand(uv.yx));
-}
+// === Sampling ===
+// Note: Random numbers come from Sampler.h
 
 float3 RandomCosineWeightedHemisphere(float u0, float u1, float3 unitNormal)
 {
@@ -106,6 +125,21 @@ float3 RandomCosineWeightedHemisphere(float u0, float u1, float3 unitNormal)
 	return float3(x, y, z);
 }
 
+float3 RandomHemisphere(float u0, float u1, float3 unitNormal)
+{
+	float z = u0 * 2 - 1;
+	float r = sqrt(max(0, 1 - z * z));
+	float phi = 2.0f * PI * u1;
+	float3 direction = float3(r * cos(phi), r * sin(phi), z);
+	return dot(direction, unitNormal) < 0 ? -direction : direction;
+}
+
+// Weight for one of two ways of sampling the same thing (Veach's power heuristic)
+float PowerHeuristic(float pdf, float otherPdf)
+{
+	return pdf * pdf / (pdf * pdf + otherPdf * otherPdf);
+}
+
 
 // === Other Helpers ===
 
@@ -159,6 +193,99 @@ Vertex InterpolateVertices(uint triangleIndex, float3 barycentricData)
 	return vert;
 }
 
+// The sky, which is also a light
+float3 SkyColor(float3 direction)
+{
+	// Hemispheric gradient
+	float3 upColor = float3(0.3f, 0.5f, 0.95f);
+	float3 downColor = float3(1, 1, 1);
+
+	// Interpolate based on the direction of the ray
+	float interpolation = dot(normalize(direction), float3(0, 1, 0)) * 0.5f + 0.5f;
+	return lerp(downColor, upColor, interpolation);
+}
+
+// How much of a light reaches a point (before the surface's cosine), from which direction, and from how far away
+// Note: Follows the raster path's convention, where a light's intensity already includes the diffuse 1/PI
+float3 IlluminationFromLight(Light light, float3 position, out float3 directionToLight, out float distanceToLight)
+{
+	if (light.type == LIGHT_TYPE_DIRECTIONAL)
+	{
+		directionToLight = -normalize(light.direction);
+		distanceToLight = 1000.0f;
+		return light.color * light.intensity;
+	}
+
+	float3 toLight = light.position - position;
+	distanceToLight = length(toLight);
+	directionToLight = toLight / distanceToLight;
+
+	// Same falloff as Attenuate() in ShaderIncludes.hlsli
+	float falloff = saturate(1.0f - distanceToLight * distanceToLight / (light.range * light.range));
+	falloff *= falloff;
+	if (light.type == LIGHT_TYPE_SPOT)
+		falloff *= pow(saturate(dot(-directionToLight, normalize(light.direction))), light.spotFalloff);
+
+	return light.color * light.intensity * falloff;
+}
+
+// Whether nothing is in the way along a ray
+bool IsVisible(float3 origin, float3 direction, float maxDistance)
+{
+	RayDesc ray;
+	ray.Origin = origin;
+	ray.Direction = direction;
+	ray.TMin = 0.0001f;
+	ray.TMax = maxDistance;
+
+	// Any hit at all answers the question, and skips ClosestHit, so the
+	// distance is only changed (to negative) if the ray misses
+	RayPayload payload = (RayPayload)0;
+	TraceRay(
+		SceneTLAS,
+		RAY_FLAG_ACCEPT_FIRST_HIT_AND_END_SEARCH | RAY_FLAG_SKIP_CLOSEST_HIT_SHADER,
+		0xFF,
+		0,
+		0,
+		0,
+		ray,
+		payload);
+	return payload.hitDistance < 0;
+}
+
+// Next event estimation: light arriving at a diffuse surface straight from a
+// randomly chosen light (or the sky), with a shadow ray to see if it's blocked
+// Note: Multiply by the path's throughput, which already includes the surface's color
+float3 DirectLight(float3 position, float3 normal, uint pixelSeed, uint sampleIndex, uint depth)
+{
+	uint lightChoices = lightCount + 1;
+	float skyPdf = 1.0f / (2.0f * PI * lightChoices);
+	uint choice = min((uint)(Sample1D(pixelSeed, sampleIndex, SAMPLER_DIMENSION_LIGHT_CHOICE(depth)) * lightChoices), lightChoices - 1);
+
+	if (choice < lightCount)
+	{
+		float3 directionToLight;
+		float distanceToLight;
+		float3 illumination = IlluminationFromLight(lights[choice], position, directionToLight, distanceToLight);
+		float cosine = dot(normal, directionToLight);
+		if (cosine <= 0 || !any(illumination > 0) || !IsVisible(position, directionToLight, distanceToLight * 0.999f))
+			return float3(0, 0, 0);
+
+		// These lights are infinitely small, so bounces never find them and this is their only sample
+		return illumination * cosine * lightChoices;
+	}
+
+	// The sky, from a random direction above the surface, weighed against the bounce that could have found it too
+	float2 u = Sample2D(pixelSeed, sampleIndex, SAMPLER_DIMENSION_LIGHT_SAMPLE(depth));
+	float3 direction = RandomHemisphere(u.x, u.y, normal);
+	float cosine = dot(normal, direction);
+	if (cosine <= 0 || !IsVisible(position, direction, 1000.0f))
+		return float3(0, 0, 0);
+
+	float bouncePdf = cosine / PI;
+	return SkyColor(direction) * (cosine / PI) / skyPdf * PowerHeuristic(skyPdf, bouncePdf);
+}
+
 // Calculates an origin and direction from the camera fpr specific pixel indices
 void CalcRayFromCamera(float2 rayIndices, out float3 origin, out float3 direction)
 {
@@ -189,9 +316,13 @@ void RayGen()
 
 	float3 totalColor = float3(0, 0, 0);
 
-	int raysPerPixel = 25;
-	for (int r = 0; r < raysPerPixel; r++) {
-		float2 adjustedRayIndices = (float2)rayIndices + rand((float)r / raysPerPixel);
+	uint pixelSeed = PixelSeed(rayIndices.x, rayIndices.y);
+
+	for (uint r = 0; r < samplesPerPixel; r++) {
+		// Number samples across frames, so each frame's samples are new ones
+		uint sampleIndex = frameIndex * samplesPerPixel + r;
+		float2 jitter = Sample2D(pixelSeed, sampleIndex, SAMPLER_DIMENSION_JITTER);
+		float2 adjustedRayIndices = (float2)rayIndices + jitter - 0.5f;
 
 		// Calculate the ray data
 		float3 rayOrigin;
@@ -205,28 +336,75 @@ void RayGen()
 		ray.TMin = 0.0001f;
 		ray.TMax = 1000.0f;
 
-		// Set up the payload for the ray
-		// This initializes the struct to all zeros
-		RayPayload payload = (RayPayload)0;
-		payload.color = float3(1, 1, 1);
-
-		// Perform the ray trace for this ray
-		TraceRay(
-			SceneTLAS,
-			RAY_FLAG_NONE,
-			0xFF,
-			0,
-			0,
-			0,
-			ray,
-			payload);
-
-		totalColor += payload.color;
+		// Follow the path one bounce at a time, rather than recursing from the
+		// hit shader, so the pipeline never needs more than one level of TraceRay
+		float3 throughput = float3(1, 1, 1);
+		float bouncePdf = 0; // Of the last bounce, if it could have found the sky (0 if it couldn't be weighed against a light sample)
+		float skyPdf = 1.0f / (2.0f * PI * (lightCount + 1));
+		for (uint depth = 0; ; depth++)
+		{
+			RayPayload payload = (RayPayload)0;
+			TraceRay(
+				SceneTLAS,
+				RAY_FLAG_NONE,
+				0xFF,
+				0,
+				0,
+				0,
+				ray,
+				payload);
+
+			// Found the sky (which the last surface may also have sampled directly)
+			if (payload.hitDistance < 0)
+			{
+				float weight = bouncePdf > 0 ? PowerHeuristic(bouncePdf, skyPdf) : 1.0f;
+				totalColor += throughput * payload.color * weight;
+				break;
+			}
+
+			if (depth >= MAX_PATH_DEPTH)
+				break;
+
+			throughput *= payload.color;
+
+			// Surfaces are hit from either side
+			float3 position = ray.Origin + ray.Direction * payload.hitDistance;
+			float3 normal = faceforward(payload.normal, ray.Direction, payload.normal);
+
+			// Only fully diffuse surfaces have a BSDF that light samples can be weighed against
+			bool diffuseSurface = payload.roughness >= 1.0f;
+			if (diffuseSurface)
+				totalColor += throughput * DirectLight(position, normal, pixelSeed, sampleIndex, depth);
+
+			float3 refl = reflect(ray.Direction, normal); // A perfect reflection across the normal
+			float2 bounce = Sample2D(pixelSeed, sampleIndex, SAMPLER_DIMENSION_BOUNCE_DIRECTION(depth));
+			float3 diff = RandomCosineWeightedHemisphere(bounce.x, bounce.y, normal);
+
+			// Russian roulette: dim paths are likely to be ended, and the survivors
+			// are brightened to make up for the ones that weren't
+			if (depth >= ROULETTE_MIN_DEPTH)
+			{
+				float survival = min(max(throughput.r, max(throughput.g, throughput.b)), ROULETTE_MAX_SURVIVAL);
+				if (Sample1D(pixelSeed, sampleIndex, SAMPLER_DIMENSION_ROULETTE(depth)) >= survival)
+					break;
+
+				throughput /= survival;
+			}
+
+			// Set up the next bounce
+			ray.Origin = position;
+			ray.Direction = normalize(lerp(refl, diff, payload.roughness));
+			bouncePdf = diffuseSurface ? max(dot(normal, ray.Direction), 0) / PI : 0;
+		}
 	}
-	totalColor /= raysPerPixel;
+
+	// Add this frame's samples to the running sum (or start a new one)
+	float4 accumulated = frameIndex == 0 ? float4(0, 0, 0, 0) : AccumulationBuffer[rayIndices];
+	accumulated += float4(totalColor, samplesPerPixel);
+	AccumulationBuffer[rayIndices] = accumulated;
 
 	// Set the final color of the buffer (gamma corrected)
-	OutputColor[rayIndices] = float4(pow(totalColor, 1.0f / 2.2f), 1);
+	OutputColor[rayIndices] = float4(pow(accumulated.rgb / accumulated.a, 1.0f / 2.2f), 1);
 }
 
 
@@ -234,13 +412,8 @@ void RayGen()
 [shader("miss")]
 void Miss(inout RayPayload payload)
 {
-	// Hemispheric gradient
-	float3 upColor = float3(0.3f, 0.5f, 0.95f);
-	float3 downColor = float3(1, 1, 1);
-
-	// Interpolate based on the direction of the ray
-	float interpolation = dot(normalize(WorldRayDirection()), float3(0, 1, 0)) * 0.5f + 0.5f;
-	payload.color *= lerp(downColor, upColor, interpolation);
+	payload.color = SkyColor(WorldRayDirection());
+	payload.hitDistance = -1;
 }
 
 
@@ -248,12 +421,6 @@ void Miss(inout RayPayload payload)
 [shader("closesthit")]
 void ClosestHit(inout RayPayload payload, BuiltInTriangleIntersectionAttributes hitAttributes)
 {
-	// Check for max recursion depth
-	if (payload.recursionDepth > MAX_RECURSION_DEPTH) {
-		payload.color = float3(0, 0, 0);
-		return;
-	}
-	
 	// Grab the index of the triangle we hit
 	uint triangleIndex = PrimitiveIndex();
 
@@ -266,32 +433,11 @@ void ClosestHit(inout RayPayload payload, BuiltInTriangleIntersectionAttributes
 	// Get the interpolated vertex data
 	Vertex interpolatedVert = InterpolateVertices(triangleIndex, barycentricData);
 	// Get the data for this entity
-	uint instanceID = InstanceID();
-	// Adjust tint of payload
-	payload.color *= material[instanceID].color.rgb;
-	
-	float3 normal_WS = mul((float3x3)worldInvTranspose[instanceID], interpolatedVert.normal);
-	float3 refl = reflect(WorldRayDirection(), normal_WS); // A perfect reflection across the normal
-	float2 pixelUV = (float2)DispatchRaysIndex() / (float2)DispatchRaysDimensions();
-	float2 rng = rand2(pixelUV * (payload.recursionDepth + 1) + payload.rayPerPixelIndex + RayTCurrent());
-	float3 diff = RandomCosineWeightedHemisphere(rand(rng), rand(rng.yx), normal_WS);
-
-	// Set up new ray
-	RayDesc ray;
-	ray.Origin = WorldRayOrigin() + WorldRayDirection() * RayTCurrent(); // Intrinsic functions: the current ray's origin in world coords plus its direction times its T
-	ray.Direction = normalize(lerp(refl, diff, material[InstanceID()].color.a)); // Working just with specular for now
-	ray.TMin = 0.0001f;
-	ray.TMax = 1000.0f;
+	InstanceData instance = Instances[InstanceID()];
 
-	// Continue recursion
-	payload.recursionDepth++;
-	TraceRay(
-		SceneTLAS,
-		RAY_FLAG_NONE,
-		0xFF,
-		0,
-		0,
-		0,
-		ray,
-		payload);
+	// Hand the surface back to RayGen
+	payload.color = instance.material.color.rgb;
+	payload.hitDistance = RayTCurrent();
+	payload.normal = normalize(mul((float3x3)instance.worldInvTranspose, interpolatedVert.normal));
+	payload.roughness = instance.material.color.a;
 }
@@ -99,6 +99,13 @@ void RaytracingHelper::CreateRaytracingRootSignatures()
 		outputUAVRange.RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_UAV;
 		outputUAVRange.RegisterSpace = 0;
 
+		D3D12_DESCRIPTOR_RANGE accumulationUAVRange = {};
+		accumulationUAVRange.BaseShaderRegister = 1;
+		accumulationUAVRange.NumDescriptors = 1;
+		accumulationUAVRange.OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
+		accumulationUAVRange.RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_UAV;
+		accumulationUAVRange.RegisterSpace = 0;
+
 		D3D12_DESCRIPTOR_RANGE cbufferRange = {};
 		cbufferRange.BaseShaderRegister = 0;
 		cbufferRange.NumDescriptors = 1;
@@ -106,9 +113,9 @@ void RaytracingHelper::CreateRaytracingRootSignatures()
 		cbufferRange.RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_CBV;
 		cbufferRange.RegisterSpace = 0;
 
-		// Set up the root parameters for the global signature (of which there are four)
+		// Set up the root parameters for the global signature (of which there are five)
 		// These need to match the shader(s) we'll be using
-		D3D12_ROOT_PARAMETER rootParams[3] = {};
+		D3D12_ROOT_PARAMETER rootParams[5] = {};
 		{
 			// First param is the UAV range for the output texture
 			rootParams[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
@@ -127,6 +134,18 @@ void RaytracingHelper::CreateRaytracingRootSignatures()
 			rootParams[2].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
 			rootParams[2].DescriptorTable.NumDescriptorRanges = 1;
 			rootParams[2].DescriptorTable.pDescriptorRanges = &cbufferRange;
+
+			// Fourth is an SRV for the scene-wide instance data (as root SRV, since it's just one buffer)
+			rootParams[3].ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV;
+			rootParams[3].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+			rootParams[3].Descriptor.ShaderRegister = 0;
+			rootParams[3].Descriptor.RegisterSpace = 1;
+
+			// Fifth is the UAV range for the accumulation buffer
+			rootParams[4].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
+			rootParams[4].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+			rootParams[4].DescriptorTable.NumDescriptorRanges = 1;
+			rootParams[4].DescriptorTable.pDescriptorRanges = &accumulationUAVRange;
 		}
 
 		// Create a single static sampler (available to all pixel shaders at the same slot)
@@ -156,15 +175,9 @@ void RaytracingHelper::CreateRaytracingRootSignatures()
 	}
 
 	// Create a local root signature enabling shaders to have unique data from shader tables
+	// Note: Per-instance data lives in the global instance buffer, so hit groups only
+	//       need their geometry (and textures) here
 	{
-		// cbuffer for hit group data
-		D3D12_DESCRIPTOR_RANGE cbufferRange = {};
-		cbufferRange.BaseShaderRegister = 1;
-		cbufferRange.NumDescriptors = 1;
-		cbufferRange.OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
-		cbufferRange.RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_CBV;
-		cbufferRange.RegisterSpace = 0;
-
 		// Table of 2 starting at register(t1)
 		D3D12_DESCRIPTOR_RANGE geometrySRVRange = {};
 		geometrySRVRange.BaseShaderRegister = 1;
@@ -181,26 +194,20 @@ void RaytracingHelper::CreateRaytracingRootSignatures()
 		texture2DRange.RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
 		texture2DRange.RegisterSpace = 0;
 
-		// Two params: Tables for constant buffer and geometry
-		D3D12_ROOT_PARAMETER rootParams[3] = {};
+		// Two params: Tables for geometry and textures
+		D3D12_ROOT_PARAMETER rootParams[2] = {};
 
-		// Constant buffer at register(b1)
+		// Range of SRVs for geometry (verts & indices)
 		rootParams[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
 		rootParams[0].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
 		rootParams[0].DescriptorTable.NumDescriptorRanges = 1;
-		rootParams[0].DescriptorTable.pDescriptorRanges = &cbufferRange;
+		rootParams[0].DescriptorTable.pDescriptorRanges = &geometrySRVRange;
 
-		// Range of SRVs for geometry (verts & indices)
+		// One SRV for all 2D textures
 		rootParams[1].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
 		rootParams[1].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
 		rootParams[1].DescriptorTable.NumDescriptorRanges = 1;
-		rootParams[1].DescriptorTable.pDescriptorRanges = &geometrySRVRange;
-
-		// One SRV for all 2D textures
-		rootParams[2].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
-		rootParams[2].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
-		rootParams[2].DescriptorTable.NumDescriptorRanges = 1;
-		rootParams[2].DescriptorTable.pDescriptorRanges = &texture2DRange;
+		rootParams[1].DescriptorTable.pDescriptorRanges = &texture2DRange;
 
 		// Create the local root sig (ensure we denote it as a local sig)
 		Microsoft::WRL::ComPtr<ID3DBlob> blob;
@@ -321,7 +328,7 @@ void RaytracingHelper::CreateRaytracingPipelineState(std::wstring raytracingShad
 	// === Shader config (payload) ===
 	{
 		D3D12_RAYTRACING_SHADER_CONFIG shaderConfigDesc = {};
-		shaderConfigDesc.MaxPayloadSizeInBytes = sizeof(DirectX::XMFLOAT3) + sizeof(unsigned int) * 2;// Float3 color and two integer recursion variables
+		shaderConfigDesc.MaxPayloadSizeInBytes = sizeof(DirectX::XMFLOAT3) * 2 + sizeof(float) * 2; // Float3 color and normal, hit distance and roughness
 		shaderConfigDesc.MaxAttributeSizeInBytes = sizeof(DirectX::XMFLOAT2); // Float2 for barycentric coords
 
 		D3D12_STATE_SUBOBJECT shaderConfigSubObj = {};
@@ -388,7 +395,7 @@ void RaytracingHelper::CreateRaytracingPipelineState(std::wstring raytracingShad
 	{
 		// Add a state subobject for the ray tracing pipeline config
 		D3D12_RAYTRACING_PIPELINE_CONFIG pipelineConfig = {};
-		pipelineConfig.MaxTraceRecursionDepth = D3D12_RAYTRACING_MAX_DECLARABLE_TRACE_RECURSION_DEPTH;
+		pipelineConfig.MaxTraceRecursionDepth = 1; // Only RayGen traces rays (bounces are a loop there, not recursion)
 
 		D3D12_STATE_SUBOBJECT pipelineConfigSubObj = {};
 		pipelineConfigSubObj.Type = D3D12_STATE_SUBOBJECT_TYPE_RAYTRACING_PIPELINE_CONFIG;
@@ -432,7 +439,7 @@ void RaytracingHelper::CreateShaderTable()
 
 	UINT64 shaderTableRayGenRecordSize = D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES + sizeof(D3D12_GPU_DESCRIPTOR_HANDLE); // One descriptor
 	UINT64 shaderTableMissRecordSize = D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES + sizeof(D3D12_GPU_DESCRIPTOR_HANDLE); // One descriptor
-	UINT64 shaderTableHitGroupRecordSize = D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES + sizeof(D3D12_GPU_DESCRIPTOR_HANDLE) * 2; // Two descriptors: CBV and index/vertex buffer
+	UINT64 shaderTableHitGroupRecordSize = D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES + sizeof(D3D12_GPU_DESCRIPTOR_HANDLE) * 2; // Two descriptors: index/vertex buffer and textures
 
 	// Align them
 	shaderTableRayGenRecordSize = ALIGN(shaderTableRayGenRecordSize, D3D12_RAYTRACING_SHADER_RECORD_BYTE_ALIGNMENT);
@@ -447,7 +454,7 @@ void RaytracingHelper::CreateShaderTable()
 	shaderTableSize = ALIGN(shaderTableSize, D3D12_RAYTRACING_SHADER_TABLE_BYTE_ALIGNMENT);
 
 	// Create the shader table buffer and map it so we can write to it
-	shaderTable = DX12Helper::GetInstance().CreateBuffer(shaderTableSize, D3D12_HEAP_TYPE_UPLOAD, D3D12_RESOURCE_STATE_GENERIC_READ);
+	shaderTable = DX12Helper::GetInstance().CreateBuffer(shaderTableSize, D3D12_HEAP_TYPE_UPLOAD, D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_FLAG_NONE, 0, GpuMemoryCategory::ShaderTable);
 	unsigned char* shaderTableData = 0;
 	shaderTable->Map(0, 0, (void**)&shaderTableData);
 
@@ -506,6 +513,7 @@ void RaytracingHelper::CreateRaytracingOutputUAV(unsigned int width, unsigned in
 		D3D12_RESOURCE_STATE_COPY_SOURCE,
 		0,
 		IID_PPV_ARGS(raytracingOutput.GetAddressOf()));
+	DX12Helper::GetInstance().TrackResource(raytracingOutput.Get(), GpuMemoryCategory::RaytracingOutput, "Raytracing output");
 
 	// Do we have a UAV alrady?
 	if (!raytracingOutputUAV_GPU.ptr)
@@ -525,6 +533,34 @@ void RaytracingHelper::CreateRaytracingOutputUAV(unsigned int width, unsigned in
 		0,
 		&uavDesc,
 		raytracingOutputUAV_CPU);
+
+	// Same size again for the accumulation buffer, but in linear float
+	// (it's only ever used as a UAV, so it stays in that state)
+	desc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+	dxrDevice->CreateCommittedResource(
+		&heapDesc,
+		D3D12_HEAP_FLAG_NONE,
+		&desc,
+		D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+		0,
+		IID_PPV_ARGS(accumulationBuffer.GetAddressOf()));
+	DX12Helper::GetInstance().TrackResource(accumulationBuffer.Get(), GpuMemoryCategory::RaytracingOutput, "Raytracing accumulation");
+
+	if (!accumulationUAV_GPU.ptr)
+	{
+		DX12Helper::GetInstance().ReserveSrvUavDescriptorHeapSlot(
+			&accumulationUAV_CPU,
+			&accumulationUAV_GPU);
+	}
+
+	dxrDevice->CreateUnorderedAccessView(
+		accumulationBuffer.Get(),
+		0,
+		&uavDesc,
+		accumulationUAV_CPU);
+
+	// Whatever was accumulated before is gone
+	accumulation.Reset();
 }
 
 
@@ -542,8 +578,9 @@ void RaytracingHelper::ResizeOutputUAV(unsigned int screenWidth, unsigned int sc
 	// Wait for the GPU to be done
 	DX12Helper::GetInstance().WaitForGPU();
 
-	// Reset and re-created the buffer
+	// Reset and re-created the buffers
 	raytracingOutput.Reset();
+	accumulationBuffer.Reset();
 	CreateRaytracingOutputUAV(screenWidth, screenHeight);
 }
 
@@ -591,7 +628,8 @@ MeshRaytracingData RaytracingHelper::CreateBottomLevelAccelerationStructureForMe
 		D3D12_HEAP_TYPE_DEFAULT,
 		D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
 		D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
-		max(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT));
+		max(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT),
+		GpuMemoryCategory::BLASScratch);
 
 	// Create the final buffer for the BLAS
 	raytracingData.BLAS = DX12Helper::GetInstance().CreateBuffer(
@@ -599,7 +637,8 @@ MeshRaytracingData RaytracingHelper::CreateBottomLevelAccelerationStructureForMe
 		D3D12_HEAP_TYPE_DEFAULT,
 		D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE,
 		D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
-		max(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT));
+		max(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT),
+		GpuMemoryCategory::BLAS);
 
 	// Describe the final BLAS and set up the build
 	D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC buildDesc = {};
@@ -664,8 +703,7 @@ MeshRaytracingData RaytracingHelper::CreateBottomLevelAccelerationStructureForMe
 		tablePointer += shaderTableRecordSize * 2; // Get past raygen and miss shaders
 		tablePointer += shaderTableRecordSize * raytracingData.HitGroupIndex; // Skip to this hit group
 		tablePointer += D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES; // Get past the identifier
-		tablePointer += 8; // Skip first descriptor, which is for a CBV
-		memcpy(tablePointer, &raytracingData.IndexbufferSRV, 8); // Copy descriptor to table
+		memcpy(tablePointer, &raytracingData.IndexbufferSRV, 8); // Copy descriptor to table (first param is geometry)
 	}
 	shaderTable->Unmap(0, 0);
 
@@ -677,116 +715,146 @@ MeshRaytracingData RaytracingHelper::CreateBottomLevelAccelerationStructureForMe
 // Creates the top level accel structure for a vector of
 // game entities (a "scene"), using the meshes and transforms
 // of each entity for the BLAS instances.
+//
+// Instance descriptions and per-instance shader data are
+// written straight into their (persistently mapped) upload
+// buffers.  Instance i in the TLAS uses entry i of the
+// instance data table, so there is no limit on how many
+// instances a single mesh can have.
+//
+// Only instances that changed since the last call are
+// repacked, and the build is skipped entirely if nothing did.
 // --------------------------------------------------------
-void RaytracingHelper::CreateTopLevelAccelerationStructureForScene(std::vector<std::shared_ptr<Entity>> scene)
+void RaytracingHelper::CreateTopLevelAccelerationStructureForScene(const std::vector<std::shared_ptr<Entity>>& scene)
 {
 	if (scene.size() == 0)
 		return;
 
-	// Create vector of instance descriptions
-	std::vector<D3D12_RAYTRACING_INSTANCE_DESC> instanceDescs;
+	PrepareTlasInstanceBuffers((UINT64)scene.size());
+	BuildTopLevelAccelerationStructure((UINT64)scene.size(), instancePacker.Pack(scene, tlasInstanceDescsMapped, instanceDataMapped));
+}
 
-	// Create a vector of instance IDs
-	std::vector<unsigned int> instanceIDs;
-	std::vector<RaytracingEntityData> entityData;
-	instanceIDs.resize(blasCount); // One per BLAS (mesh) - all starting at zero due to resize()
-	entityData.resize(blasCount);
+// --------------------------------------------------------
+// Same as above, but from a snapshot published by the
+// simulation rather than the live entities
+// --------------------------------------------------------
+void RaytracingHelper::CreateTopLevelAccelerationStructureForScene(const SceneSnapshot& snapshot)
+{
+	if (snapshot.instances.size() == 0)
+		return;
 
-	// Create an instance description for each entity
-	for (size_t i = 0; i < scene.size(); i++)
-	{
-		// Grab this entity's transform and transpose to column major
-		DirectX::XMFLOAT4X4 transform = scene[i]->GetTransform()->GetWorldMatrix();
-		XMStoreFloat4x4(&transform, XMMatrixTranspose(XMLoadFloat4x4(&transform)));
-
-		// Grab this mesh's index in the shader table
-		std::shared_ptr<Mesh> mesh = scene[i]->GetMesh();
-		unsigned int meshBlasIndex = mesh->GetRaytracingData().HitGroupIndex;
-
-		// Create this description and add to our overall set of descriptions
-		D3D12_RAYTRACING_INSTANCE_DESC id = {};
-		id.InstanceContributionToHitGroupIndex = meshBlasIndex;
-		id.InstanceID = instanceIDs[meshBlasIndex];
-		id.InstanceMask = 0xFF;
-		memcpy(&id.Transform, &transform, sizeof(float) * 3 * 4); // Copy first [3][4] elements
-		id.AccelerationStructure = mesh->GetRaytracingData().BLAS->GetGPUVirtualAddress();
-		id.Flags = D3D12_RAYTRACING_INSTANCE_FLAG_NONE;
-		instanceDescs.push_back(id);
-
-		// Set up the entity data for this entity, too
-		// - mesh index tells us which cbuffer
-		// - instance ID tells us which instance in that cbuffer
-		XMFLOAT3 c = scene[i]->GetMaterial()->GetColorTint();
-		RaytracingMaterialData matData = {};
-		matData.color = XMFLOAT4(c.x, c.y, c.z, (float)((i + 1) % 2));
-		matData.albedoIndex = 0;
-		matData.roughnessIndex = 1;
-		matData.normalsIndex = 2;
-		matData.metalIndex = 3;
-
-		entityData[meshBlasIndex].worldInvTranspose[id.InstanceID] = scene[i]->GetTransform()->GetWorldInverseTransposeMatrix();
-		entityData[meshBlasIndex].materialData[id.InstanceID] = matData; // Using alpha channel as "roughness"
-
-		// On to the next instance for this mesh
-		instanceIDs[meshBlasIndex]++;
-	}
+	PrepareTlasInstanceBuffers((UINT64)snapshot.instances.size());
+	BuildTopLevelAccelerationStructure((UINT64)snapshot.instances.size(), instancePacker.Pack(snapshot, tlasInstanceDescsMapped, instanceDataMapped));
+}
 
-	// Is our current description buffer too small?
-	if (sizeof(D3D12_RAYTRACING_INSTANCE_DESC) * instanceDescs.size() > tlasInstanceDataSizeInBytes)
+// --------------------------------------------------------
+// Makes sure both TLAS upload buffers can hold the whole
+// scene, growing them if necessary
+// --------------------------------------------------------
+void RaytracingHelper::PrepareTlasInstanceBuffers(UINT64 instanceCount)
+{
+	if (sizeof(D3D12_RAYTRACING_INSTANCE_DESC) * instanceCount > tlasInstanceDataSizeInBytes)
 	{
 		// Create a new buffer to hold instance descriptions, since they
 		// need to actually be on the GPU
+		if (tlasInstanceDescBuffer)
+			GpuMemoryRegistry::GetInstance().RecordReallocation(GpuMemoryCategory::TLASInstanceData);
 		tlasInstanceDescBuffer.Reset();
-		tlasInstanceDataSizeInBytes = sizeof(D3D12_RAYTRACING_INSTANCE_DESC) * instanceDescs.size();
+		tlasInstanceDataSizeInBytes = sizeof(D3D12_RAYTRACING_INSTANCE_DESC) * instanceCount;
 
 		tlasInstanceDescBuffer = DX12Helper::GetInstance().CreateBuffer(
 			tlasInstanceDataSizeInBytes,
 			D3D12_HEAP_TYPE_UPLOAD,
-			D3D12_RESOURCE_STATE_GENERIC_READ);
+			D3D12_RESOURCE_STATE_GENERIC_READ,
+			D3D12_RESOURCE_FLAG_NONE,
+			0,
+			GpuMemoryCategory::TLASInstanceData);
+		tlasInstanceDescBuffer->Map(0, 0, (void**)&tlasInstanceDescsMapped);
+		instancePacker.Invalidate(); // New buffer is empty
 	}
 
-	// Copy the descriptions into the buffer
-	// NOTE: This may be a spot where a small ringbuffer would be useful
-	//       if we're working multiple frames ahead of the GPU
-	unsigned char* mapped = 0;
-	tlasInstanceDescBuffer->Map(0, 0, (void**)&mapped);
-	memcpy(mapped, &instanceDescs[0], sizeof(D3D12_RAYTRACING_INSTANCE_DESC) * instanceDescs.size());
-	tlasInstanceDescBuffer->Unmap(0, 0);
+	if (sizeof(RaytracingInstanceData) * instanceCount > instanceDataSizeInBytes)
+	{
+		// Same idea for the per-instance shader data
+		if (instanceDataBuffer)
+			GpuMemoryRegistry::GetInstance().RecordReallocation(GpuMemoryCategory::TLASInstanceData);
+		instanceDataBuffer.Reset();
+		instanceDataSizeInBytes = sizeof(RaytracingInstanceData) * instanceCount;
+
+		instanceDataBuffer = DX12Helper::GetInstance().CreateBuffer(
+			instanceDataSizeInBytes,
+			D3D12_HEAP_TYPE_UPLOAD,
+			D3D12_RESOURCE_STATE_GENERIC_READ,
+			D3D12_RESOURCE_FLAG_NONE,
+			0,
+			GpuMemoryCategory::TLASInstanceData);
+		instanceDataBuffer->Map(0, 0, (void**)&instanceDataMapped);
+		instancePacker.Invalidate();
+	}
+}
+
+// --------------------------------------------------------
+// Builds (or refits, or skips building) the TLAS from the
+// instances that were just packed
+//
+// NOTE: Packing writes straight into the mapped buffers, which
+//       relies on the GPU being finished with last frame's data
+//       (we wait every frame), and would need a small ringbuffer otherwise
+// --------------------------------------------------------
+void RaytracingHelper::BuildTopLevelAccelerationStructure(UINT64 instanceCount, const TlasPackResult& packResult)
+{
+	// Anything that changed (even just a material) invalidates the accumulated image
+	if (packResult.instancesRepacked > 0 || packResult.instanceCountChanged)
+		accumulation.Reset();
 
 	// Describe our overall input so we can get sizing info
 	D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS accelStructInputs = {};
 	accelStructInputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL;
 	accelStructInputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
 	accelStructInputs.InstanceDescs = tlasInstanceDescBuffer->GetGPUVirtualAddress();
-	accelStructInputs.NumDescs = (unsigned int)instanceDescs.size();
-	accelStructInputs.Flags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE;
+	accelStructInputs.NumDescs = (unsigned int)instanceCount;
+	accelStructInputs.Flags =
+		D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE |
+		D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_UPDATE; // Must be built with this to be updated later
 
-	D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO accelStructPrebuildInfo = {};
-	dxrDevice->GetRaytracingAccelerationStructurePrebuildInfo(&accelStructInputs, &accelStructPrebuildInfo);
+	// Sizes only depend on the inputs, so only re-query them when the instance count changes
+	if (packResult.instanceCountChanged)
+	{
+		dxrDevice->GetRaytracingAccelerationStructurePrebuildInfo(&accelStructInputs, &tlasPrebuildInfo);
 
-	// Handle alignment requirements ourselves
-	accelStructPrebuildInfo.ScratchDataSizeInBytes = ALIGN(accelStructPrebuildInfo.ScratchDataSizeInBytes, D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT);
-	accelStructPrebuildInfo.ResultDataMaxSizeInBytes = ALIGN(accelStructPrebuildInfo.ResultDataMaxSizeInBytes, D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT);
+		// Handle alignment requirements ourselves
+		tlasPrebuildInfo.ScratchDataSizeInBytes = ALIGN(tlasPrebuildInfo.ScratchDataSizeInBytes, D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT);
+		tlasPrebuildInfo.UpdateScratchDataSizeInBytes = ALIGN(tlasPrebuildInfo.UpdateScratchDataSizeInBytes, D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT);
+		tlasPrebuildInfo.ResultDataMaxSizeInBytes = ALIGN(tlasPrebuildInfo.ResultDataMaxSizeInBytes, D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT);
+	}
+	const D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO& accelStructPrebuildInfo = tlasPrebuildInfo;
 
-	// Is our current scratch size too small?
-	if (accelStructPrebuildInfo.ScratchDataSizeInBytes > tlasScratchSizeInBytes)
+	// Is our current scratch size too small?  The same buffer serves
+	// both builds and refits, so it has to fit whichever needs more
+	UINT64 scratchSizeInBytes = max(accelStructPrebuildInfo.ScratchDataSizeInBytes, accelStructPrebuildInfo.UpdateScratchDataSizeInBytes);
+	if (scratchSizeInBytes > tlasScratchSizeInBytes)
 	{
 		// Create a new scratch buffer
+		if (tlasScratchBuffer)
+			GpuMemoryRegistry::GetInstance().RecordReallocation(GpuMemoryCategory::TLASScratch);
 		tlasScratchBuffer.Reset();
-		tlasScratchSizeInBytes = accelStructPrebuildInfo.ScratchDataSizeInBytes;
+		tlasScratchSizeInBytes = scratchSizeInBytes;
 
 		tlasScratchBuffer = DX12Helper::GetInstance().CreateBuffer(
 			tlasScratchSizeInBytes,
 			D3D12_HEAP_TYPE_DEFAULT,
 			D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
 			D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
-			max(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT));
+			max(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT),
+			GpuMemoryCategory::TLASScratch);
 	}
 
 	// Is our current tlas too small?
 	if (accelStructPrebuildInfo.ResultDataMaxSizeInBytes > tlasBufferSizeInBytes)
 	{
 		// Create a new tlas buffer
+		if (topLevelAccelerationStructure)
+			GpuMemoryRegistry::GetInstance().RecordReallocation(GpuMemoryCategory::TLAS);
 		topLevelAccelerationStructure.Reset();
 		tlasBufferSizeInBytes = accelStructPrebuildInfo.ResultDataMaxSizeInBytes;
 
@@ -795,14 +863,29 @@ void RaytracingHelper::CreateTopLevelAccelerationStructureForScene(std::vector<s
 			D3D12_HEAP_TYPE_DEFAULT,
 			D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE,
 			D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
-			max(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT));
+			max(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT),
+			GpuMemoryCategory::TLAS);
+
+		// A brand new buffer has nothing in it to update
+		tlasBuildPolicy.Invalidate();
 	}
 
+	// Decide whether the existing TLAS can be reused, refit or needs a full rebuild
+	TlasBuildMode buildMode = tlasBuildPolicy.Decide(packResult.changes);
+	if (buildMode == TlasBuildMode::Skip)
+		return;
+
 	// Describe the final TLAS and set up the build
 	D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC buildDesc = {};
 	buildDesc.Inputs = accelStructInputs;
 	buildDesc.ScratchAccelerationStructureData = tlasScratchBuffer->GetGPUVirtualAddress();
 	buildDesc.DestAccelerationStructureData = topLevelAccelerationStructure->GetGPUVirtualAddress();
+	if (buildMode == TlasBuildMode::Update)
+	{
+		// Refit in place, reading from the structure we're writing to
+		buildDesc.Inputs.Flags |= D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PERFORM_UPDATE;
+		buildDesc.SourceAccelerationStructureData = topLevelAccelerationStructure->GetGPUVirtualAddress();
+	}
 	dxrCommandList->BuildRaytracingAccelerationStructure(&buildDesc, 0, 0);
 
 	// Set up a barrier to wait until the TLAS is actually built to proceed
@@ -811,30 +894,69 @@ void RaytracingHelper::CreateTopLevelAccelerationStructureForScene(std::vector<s
 	tlasBarrier.UAV.pResource = topLevelAccelerationStructure.Get();
 	tlasBarrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
 	dxrCommandList->ResourceBarrier(1, &tlasBarrier);
+}
 
-	// Finalize the entity data cbuffer stuff and copy descriptors to shader table
-	// NOTE: Another place where ringbuffer style management based on frame sync would be a good idea!
-	unsigned char* tablePointer = 0;
-	shaderTable->Map(0, 0, (void**)&tablePointer);
-	tablePointer += shaderTableRecordSize * 2; // Get past raygen and miss shaders
-	for(int i = 0; i < entityData.size(); i++)
-	{
-		// Need to get to the first descriptor in this hit group's record
-		unsigned char* hitGroupPointer = tablePointer + shaderTableRecordSize * i;
-		hitGroupPointer += D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES; // Get past identifier
 
-		// Copy the data to the CB ring buffer and grab associated CBV to place in shader table
-		D3D12_GPU_DESCRIPTOR_HANDLE cbv = DX12Helper::GetInstance().FillNextConstantBufferAndGetGPUDescriptorHandle(&entityData[i], sizeof(RaytracingEntityData));
-		memcpy(hitGroupPointer, &cbv, sizeof(D3D12_GPU_DESCRIPTOR_HANDLE));
-	}
-	shaderTable->Unmap(0, 0);
+// --------------------------------------------------------
+// Gets the policy deciding between skipping, updating and
+// rebuilding the TLAS, for tweaking thresholds or looking
+// at which mode recent frames used
+// --------------------------------------------------------
+TlasBuildPolicy& RaytracingHelper::GetTlasBuildPolicy()
+{
+	return tlasBuildPolicy;
+}
+
+AccumulationState& RaytracingHelper::GetAccumulationState()
+{
+	return accumulation;
+}
+
+unsigned int RaytracingHelper::GetSamplesPerPixel()
+{
+	return samplesPerPixel;
+}
+
+void RaytracingHelper::SetSamplesPerPixel(unsigned int samples)
+{
+	samplesPerPixel = samples < 1 ? 1 : samples;
+	accumulation.Reset(); // Keeps the sample numbering consistent
+}
+
+// --------------------------------------------------------
+// Copies the lights for the next Raytrace(), starting the
+// accumulated image over if they're any different
+// --------------------------------------------------------
+void RaytracingHelper::SetLights(const Light* newLights, unsigned int count)
+{
+	count = count < MAX_RAYTRACING_LIGHTS ? count : MAX_RAYTRACING_LIGHTS;
+	if (count == lightCount && memcmp(lights, newLights, sizeof(Light) * count) == 0)
+		return;
+
+	memcpy(lights, newLights, sizeof(Light) * count);
+	lightCount = count;
+	accumulation.Reset();
 }
 
 
 // --------------------------------------------------------
 // Performs the actual raytracing work
 // --------------------------------------------------------
-void RaytracingHelper::Raytrace(std::shared_ptr<Camera> camera, Microsoft::WRL::ComPtr<ID3D12Resource> currentBackBuffer, bool executeCommandList)
+void RaytracingHelper::Raytrace(const std::shared_ptr<Camera>& camera, const Microsoft::WRL::ComPtr<ID3D12Resource>& currentBackBuffer, bool executeCommandList)
+{
+	Raytrace(*(camera->GetTransform()->GetPosition()), camera->GetViewMatrix(), camera->GetProjectionMatrix(), currentBackBuffer, executeCommandList);
+}
+
+// --------------------------------------------------------
+// Same as above, with the camera's details passed in
+// directly (such as from a simulation snapshot)
+// --------------------------------------------------------
+void RaytracingHelper::Raytrace(
+	DirectX::XMFLOAT3 cameraPosition,
+	DirectX::XMFLOAT4X4 view,
+	DirectX::XMFLOAT4X4 proj,
+	const Microsoft::WRL::ComPtr<ID3D12Resource>& currentBackBuffer,
+	bool executeCommandList)
 {
 	if (!dxrAvailable || !helperInitialized)
 		return;
@@ -857,12 +979,18 @@ void RaytracingHelper::Raytrace(std::shared_ptr<Camera> camera, Microsoft::WRL::
 		dxrCommandList->ResourceBarrier(2, outputBarriers);
 	}
 
+	// Add to the accumulated image, start it over, or (once it's converged) leave it be
+	unsigned int frameIndex = 0;
+	bool traceThisFrame = accumulation.BeginFrame(cameraPosition, view, proj, &frameIndex);
+
 	// Grab and fill a constant buffer
 	RaytracingSceneData sceneData = {};
-	sceneData.cameraPosition = *(camera->GetTransform()->GetPosition());
+	sceneData.cameraPosition = cameraPosition;
+	sceneData.frameIndex = frameIndex;
+	sceneData.samplesPerPixel = samplesPerPixel;
+	sceneData.lightCount = lightCount;
+	memcpy(sceneData.lights, lights, sizeof(Light) * lightCount);
 	
-	DirectX::XMFLOAT4X4 view = camera->GetViewMatrix();
-	DirectX::XMFLOAT4X4 proj = camera->GetProjectionMatrix();
 	DirectX::XMMATRIX v = DirectX::XMLoadFloat4x4(&view);
 	DirectX::XMMATRIX p = DirectX::XMLoadFloat4x4(&proj);
 	DirectX::XMMATRIX vp = DirectX::XMMatrixMultiply(v, p);
@@ -871,6 +999,7 @@ void RaytracingHelper::Raytrace(std::shared_ptr<Camera> camera, Microsoft::WRL::
 	D3D12_GPU_DESCRIPTOR_HANDLE cbuffer = DX12Helper::GetInstance().FillNextConstantBufferAndGetGPUDescriptorHandle(&sceneData, sizeof(RaytracingSceneData));
 
 	// ACTUAL RAYTRACING HERE
+	if (traceThisFrame)
 	{
 		// Set the CBV/SRV/UAV descriptor heap
 		ID3D12DescriptorHeap* heap[] = { DX12Helper::GetInstance().GetCBVSRVDescriptorHeap().Get() };
@@ -885,6 +1014,8 @@ void RaytracingHelper::Raytrace(std::shared_ptr<Camera> camera, Microsoft::WRL::
 		dxrCommandList->SetComputeRootDescriptorTable(0, raytracingOutputUAV_GPU);	// First table is just output UAV
 		dxrCommandList->SetComputeRootShaderResourceView(1, topLevelAccelerationStructure->GetGPUVirtualAddress());		// Second is SRV for accel structure (as root SRV, no table needed)
 		dxrCommandList->SetComputeRootDescriptorTable(2, cbuffer);					// Third is CBV
+		dxrCommandList->SetComputeRootShaderResourceView(3, instanceDataBuffer->GetGPUVirtualAddress());	// Fourth is the scene-wide instance data table
+		dxrCommandList->SetComputeRootDescriptorTable(4, accumulationUAV_GPU);		// Fifth is the accumulation buffer
 
 		// Dispatch rays
 		D3D12_DISPATCH_RAYS_DESC dispatchDesc = {};
@@ -9,6 +9,11 @@
 #include "Mesh.h"
 #include "Camera.h"
 #include "Entity.h"
+#include "BufferStructs.h"
+#include "SceneSnapshot.h"
+#include "TlasInstancePacker.h"
+#include "TlasBuildPolicy.h"
+#include "AccumulationState.h"
 
 class RaytracingHelper
 {
@@ -36,11 +41,20 @@ private:
 		helperInitialized(false),
 		raytracingOutputUAV_CPU{},
 		raytracingOutputUAV_GPU{},
+		accumulationUAV_CPU{},
+		accumulationUAV_GPU{},
+		samplesPerPixel(4),
+		lights{},
+		lightCount(0),
 		screenHeight(1),
 		screenWidth(1),
 		tlasBufferSizeInBytes(0),
 		tlasScratchSizeInBytes(0),
 		tlasInstanceDataSizeInBytes(0),
+		tlasInstanceDescsMapped(0),
+		tlasPrebuildInfo{},
+		instanceDataSizeInBytes(0),
+		instanceDataMapped(0),
 		shaderTableRecordSize(0),
 		blasCount(0)
 	{};
@@ -64,10 +78,24 @@ public:
 
 	// Setup process requiring data from outside the helper
 	MeshRaytracingData CreateBottomLevelAccelerationStructureForMesh(Mesh* mesh);
-	void CreateTopLevelAccelerationStructureForScene(std::vector<std::shared_ptr<Entity>> scene);
+	void CreateTopLevelAccelerationStructureForScene(const std::vector<std::shared_ptr<Entity>>& scene);
+	void CreateTopLevelAccelerationStructureForScene(const SceneSnapshot& snapshot);
+
+	// Controls (and records) how the TLAS is built each frame
+	TlasBuildPolicy& GetTlasBuildPolicy();
+
+	// Progressive accumulation: each frame adds samplesPerPixel new samples
+	// to every pixel until the camera or scene changes
+	AccumulationState& GetAccumulationState();
+	unsigned int GetSamplesPerPixel();
+	void SetSamplesPerPixel(unsigned int samples);
+
+	// Lights sampled directly at each bounce (only the first MAX_RAYTRACING_LIGHTS are used)
+	void SetLights(const Light* newLights, unsigned int count);
 
 	// Actual work
-	void Raytrace(std::shared_ptr<Camera> camera, Microsoft::WRL::ComPtr<ID3D12Resource> currentBackBuffer, bool executeCommandList = true);
+	void Raytrace(const std::shared_ptr<Camera>& camera, const Microsoft::WRL::ComPtr<ID3D12Resource>& currentBackBuffer, bool executeCommandList = true);
+	void Raytrace(DirectX::XMFLOAT3 cameraPosition, DirectX::XMFLOAT4X4 view, DirectX::XMFLOAT4X4 proj, const Microsoft::WRL::ComPtr<ID3D12Resource>& currentBackBuffer, bool executeCommandList = true);
 
 
 private:
@@ -119,16 +147,40 @@ private:
 	Microsoft::WRL::ComPtr<ID3D12Resource> tlasScratchBuffer; 
 	Microsoft::WRL::ComPtr<ID3D12Resource> tlasInstanceDescBuffer;
 	Microsoft::WRL::ComPtr<ID3D12Resource> topLevelAccelerationStructure;
+	D3D12_RAYTRACING_INSTANCE_DESC* tlasInstanceDescsMapped; // Instance desc buffer stays mapped
+	D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO tlasPrebuildInfo; // Cached until the instance count changes
+	TlasInstancePacker instancePacker; // Tracks which instances need repacking each frame
+	TlasBuildPolicy tlasBuildPolicy; // Picks between skipping, updating and rebuilding the TLAS
+
+	// Scene-wide table of per-instance data (one entry per TLAS instance),
+	// bound as a structured buffer and indexed by InstanceID() in shaders
+	UINT64 instanceDataSizeInBytes;
+	Microsoft::WRL::ComPtr<ID3D12Resource> instanceDataBuffer;
+	RaytracingInstanceData* instanceDataMapped; // Also stays mapped
 
 	// Actual output resource
 	Microsoft::WRL::ComPtr<ID3D12Resource> raytracingOutput;
 	D3D12_CPU_DESCRIPTOR_HANDLE raytracingOutputUAV_CPU;
 	D3D12_GPU_DESCRIPTOR_HANDLE raytracingOutputUAV_GPU;
 
+	// Linear running sum of samples (rgb) and how many there are (a), and when to start over
+	Microsoft::WRL::ComPtr<ID3D12Resource> accumulationBuffer;
+	D3D12_CPU_DESCRIPTOR_HANDLE accumulationUAV_CPU;
+	D3D12_GPU_DESCRIPTOR_HANDLE accumulationUAV_GPU;
+	AccumulationState accumulation;
+	unsigned int samplesPerPixel;
+
+	Light lights[MAX_RAYTRACING_LIGHTS];
+	unsigned int lightCount;
+
 	// Helper functions for each initalization step
 	void CreateRaytracingRootSignatures();
 	void CreateRaytracingPipelineState(std::wstring raytracingShaderLibraryFile);
 	void CreateShaderTable();
 	void CreateRaytracingOutputUAV(unsigned int width, unsigned int height);
+
+	// Per-frame TLAS steps, shared by both sources of scene data
+	void PrepareTlasInstanceBuffers(UINT64 instanceCount);
+	void BuildTopLevelAccelerationStructure(UINT64 instanceCount, const TlasPackResult& packResult);
 };
 
@@ -0,0 +1,151 @@
+#include "ReprojectionBenchmark.h"
+#include "BenchmarkUtils.h"
+#include "CpuRaytracer.h"
+#include "ReprojectionCache.h"
+
+#include <stdio.h>
+#include <vector>
+
+using namespace DirectX;
+using namespace BenchmarkUtils;
+
+namespace
+{
+	// Summed squared error of only the pixels a mask picks
+	double SquaredError(const std::vector<XMFLOAT3>& image, const std::vector<XMFLOAT3>& reference, const std::vector<bool>& mask)
+	{
+		double total = 0;
+		for (size_t i = 0; i < image.size(); i++)
+		{
+			if (!mask[i])
+				continue;
+
+			const XMFLOAT3& a = image[i];
+			const XMFLOAT3& b = reference[i];
+			total += (a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y) + (a.z - b.z) * (a.z - b.z);
+		}
+		return total;
+	}
+}
+
+bool ReprojectionBenchmark::Run()
+{
+	return Run(160, 90, 16, 0.1f);
+}
+
+// --------------------------------------------------------
+// Traces each frame once and feeds it to every cache, then
+// averages each one's error against that frame's reference
+// (skipping the first few, while history builds up) - over
+// the whole image, and over just the disoccluded pixels,
+// where any ghosting would be.  The reference itself goes
+// through a pair of caches too: with no noise to average
+// away, all that's left is what reprojection gets wrong.
+// --------------------------------------------------------
+bool ReprojectionBenchmark::Run(unsigned int width, unsigned int height, unsigned int frames, float speed)
+{
+	printf("Reprojection benchmark: %ux%u, %u frames, camera moving %.2f per frame\n", width, height, frames, speed);
+
+	Scene scene;
+	CreateScene(&scene, (float)width / height);
+	const unsigned int referenceSamples = 256;
+
+	CpuRaytracer tracer;
+	tracer.Resize(width, height);
+	tracer.SetSamplesPerPixel(2);
+
+	// Noisy frames, then the reference's - each with and without disocclusion rejection
+	const unsigned int CacheCount = 4;
+	const char* names[CacheCount] = { "accumulated", "  no rejection", "reference accumulated", "  no rejection" };
+	ReprojectionCache caches[CacheCount];
+	for (unsigned int c = 0; c < CacheCount; c++)
+	{
+		caches[c].Resize(width, height);
+		caches[c].GetSettings().rejectDisocclusions = c % 2 == 0;
+	}
+
+	std::vector<XMFLOAT3> referenceImage;
+	std::vector<bool> disoccluded(width * height);
+	double rawError = 0;
+	double rawDisoccludedError = 0;
+	double errors[CacheCount] = {};
+	double disoccludedErrors[CacheCount] = {};
+	unsigned int disoccludedPixels = 0;
+	double cacheTime = 0;
+	double reprojected = 0;
+	double averageLength = 0;
+	unsigned int measured = 0;
+	for (unsigned int frame = 0; frame < frames; frame++)
+	{
+		// Sideways, a little further each frame
+		XMFLOAT3 offset(speed * frame, 0.0f, 0.0f);
+		XMFLOAT3 position(scene.cameraPosition.x + offset.x, scene.cameraPosition.y + offset.y, scene.cameraPosition.z + offset.z);
+		XMFLOAT4X4 frameView;
+		XMStoreFloat4x4(&frameView, XMMatrixMultiply(XMMatrixTranslation(-offset.x, -offset.y, -offset.z), XMLoadFloat4x4(&scene.view)));
+		const XMFLOAT4X4& projection = scene.projection;
+
+		RenderReference(scene.snapshot, position, frameView, projection, width, height, referenceSamples, &referenceImage);
+		tracer.Render(scene.snapshot, position, frameView, projection);
+
+		for (unsigned int c = 0; c < CacheCount; c++)
+		{
+			Clock::time_point start = Clock::now();
+			caches[c].SetCamera(position, frameView, projection);
+			caches[c].Update(tracer.GetGBuffer().data());
+			caches[c].Accumulate(c < 2 ? tracer.GetFrameRadiance().data() : referenceImage.data());
+			if (c == 0)
+				cacheTime += MillisecondsSince(start);
+		}
+
+		if (frame < frames / 4)
+			continue;
+
+		// Surfaces on screen that weren't last frame
+		for (unsigned int i = 0; i < width * height; i++)
+		{
+			const ReprojectionTaps& taps = caches[0].GetTaps()[i];
+			disoccluded[i] = tracer.GetGBuffer()[i].distance > 0.0f && taps.weights[0] + taps.weights[1] + taps.weights[2] + taps.weights[3] <= 0.0f;
+			disoccludedPixels += disoccluded[i] ? 1 : 0;
+		}
+
+		rawError += MeanSquaredError(tracer.GetFrameRadiance(), referenceImage);
+		rawDisoccludedError += SquaredError(tracer.GetFrameRadiance(), referenceImage, disoccluded);
+		for (unsigned int c = 0; c < CacheCount; c++)
+		{
+			errors[c] += MeanSquaredError(caches[c].GetOutput(), referenceImage);
+			disoccludedErrors[c] += SquaredError(caches[c].GetOutput(), referenceImage, disoccluded);
+		}
+
+		ReprojectionStats stats = caches[0].GetStats();
+		reprojected += stats.hitPixels > 0 ? (double)stats.reprojectedPixels / stats.hitPixels : 0.0;
+		for (float length : caches[0].GetHistoryLength())
+			averageLength += length / (width * height);
+		measured++;
+	}
+
+	if (measured == 0)
+		return Expect(false, "enough frames to measure (at least 2)");
+
+	double disoccludedScale = disoccludedPixels > 0 ? 1.0 / (3.0 * disoccludedPixels) : 0.0;
+	printf("  %.1f%% of hit pixels reprojected, %.1f frames of history on average, %.2f ms per frame\n",
+		100.0 * reprojected / measured, averageLength / measured, cacheTime / frames);
+	printf("                            whole image   disoccluded\n");
+	printf("  %u spp raw               MSE %.6f    MSE %.6f\n", tracer.GetSamplesPerPixel(), rawError / measured, rawDisoccludedError * disoccludedScale);
+	for (unsigned int c = 0; c < CacheCount; c++)
+	{
+		printf("  %-22s  MSE %.6f    MSE %.6f", names[c], errors[c] / measured, disoccludedErrors[c] * disoccludedScale);
+
+		// Accumulating should beat a single frame, and rejecting should beat smearing
+		if (c == 0)
+			printf("   %s\n", Verdict(errors[0] < rawError));
+		else if (c == 3)
+			printf("   %s\n", Verdict(disoccludedErrors[2] < disoccludedErrors[3]));
+		else
+			printf("\n");
+	}
+
+	bool passed = true;
+	passed &= Expect(errors[0] < rawError, "accumulating through the cache to beat a single frame");
+	passed &= Expect(disoccludedErrors[2] < disoccludedErrors[3], "rejecting disocclusions to beat smearing history over them");
+	return passed;
+}
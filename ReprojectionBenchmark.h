@@ -0,0 +1,30 @@
+#pragma once
+
+// Measures what the ReprojectionCache saves, without the GPU: moves the
+// camera sideways across the benchmark scene (BenchmarkUtils.h), tracing
+// a few samples per pixel each frame (the CpuRaytracer starts over
+// whenever the camera moves), and compares every frame against a
+// reference traced from the same spot - raw, accumulated through the
+// cache, and accumulated with disocclusion rejection off (history smeared
+// over whatever it lands on).  Start the program with -benchmark to run
+// it (see HeadlessTests.h); it fails if accumulating doesn't beat a
+// single frame, or if rejecting disocclusions doesn't beat smearing.
+
+namespace ReprojectionBenchmark
+{
+	/// <summary>
+	/// Runs the benchmark at 160x90 for 16 frames
+	/// </summary>
+	/// <returns>Whether accumulation and disocclusion rejection both paid off</returns>
+	bool Run();
+
+	/// <summary>
+	/// Runs the benchmark with a specific image size, number of frames and camera speed
+	/// </summary>
+	/// <param name="width">Image width in pixels</param>
+	/// <param name="height">Image height in pixels</param>
+	/// <param name="frames">How many frames to move the camera over</param>
+	/// <param name="speed">How far the camera moves sideways each frame</param>
+	/// <returns>Whether accumulation and disocclusion rejection both paid off</returns>
+	bool Run(unsigned int width, unsigned int height, unsigned int frames, float speed);
+}
@@ -0,0 +1,242 @@
+#include "ReprojectionCache.h"
+#include "JobSystem.h"
+
+#include <math.h>
+
+using namespace DirectX;
+
+ReprojectionSettings::ReprojectionSettings() :
+	normalCosine(0.9f),
+	distanceRatio(0.1f),
+	rejectDisocclusions(true),
+	colorAlpha(0.2f)
+{
+}
+
+ReprojectionCache::ReprojectionCache() :
+	width(0),
+	height(0),
+	stats{},
+	cameraPosition(),
+	inverseViewProjection(),
+	previousCameraPosition(),
+	previousViewProjection(),
+	hasHistory(false)
+{
+}
+
+
+void ReprojectionCache::Resize(unsigned int newWidth, unsigned int newHeight)
+{
+	width = newWidth;
+	height = newHeight;
+	taps.assign(width * height, ReprojectionTaps{});
+	previousGBuffer.assign(width * height, GBufferPixel{});
+	previousColor.assign(width * height, XMFLOAT3(0, 0, 0));
+	previousLength.assign(width * height, 0.0f);
+	output.assign(width * height, XMFLOAT3(0, 0, 0));
+	historyLength.assign(width * height, 0.0f);
+	hasHistory = false;
+}
+
+// --------------------------------------------------------
+// Makes a new frame's camera current, keeping the old one
+// to reproject into
+// --------------------------------------------------------
+void ReprojectionCache::SetCamera(XMFLOAT3 newCameraPosition, const XMFLOAT4X4& view, const XMFLOAT4X4& projection)
+{
+	XMMATRIX viewProjection = XMMatrixMultiply(XMLoadFloat4x4(&view), XMLoadFloat4x4(&projection));
+	XMStoreFloat4x4(&previousViewProjection, XMMatrixInverse(0, XMLoadFloat4x4(&inverseViewProjection)));
+	previousCameraPosition = cameraPosition;
+	cameraPosition = newCameraPosition;
+	XMStoreFloat4x4(&inverseViewProjection, XMMatrixInverse(0, viewProjection));
+}
+
+// --------------------------------------------------------
+// Reprojects every pixel against the last frame's camera
+// and G-buffer, then makes this frame the last one
+// --------------------------------------------------------
+void ReprojectionCache::Update(const GBufferPixel* gBuffer)
+{
+	if (width == 0 || height == 0)
+		return;
+
+	JobSystem::GetInstance().ParallelFor(height, 4,
+		[&](unsigned int start, unsigned int end)
+		{
+			ReprojectRows(gBuffer, start, end);
+		});
+
+	stats = {};
+	for (unsigned int i = 0; i < width * height; i++)
+	{
+		const ReprojectionTaps& pixelTaps = taps[i];
+		stats.hitPixels += gBuffer[i].distance > 0.0f ? 1 : 0;
+		stats.reprojectedPixels += pixelTaps.weights[0] + pixelTaps.weights[1] + pixelTaps.weights[2] + pixelTaps.weights[3] > 0.0f ? 1 : 0;
+	}
+
+	previousGBuffer.assign(gBuffer, gBuffer + width * height);
+	hasHistory = true;
+}
+
+// --------------------------------------------------------
+// An exponential average per surface: a plain average of
+// every frame so far while there are few, then one that
+// gives new frames at least colorAlpha of the weight.
+// Call it every frame or not at all, as the history it
+// blends with has to be last frame's.
+// --------------------------------------------------------
+void ReprojectionCache::Accumulate(const XMFLOAT3* color)
+{
+	JobSystem::GetInstance().ParallelFor(height, 4,
+		[&](unsigned int start, unsigned int end)
+		{
+			for (unsigned int i = start * width; i < end * width; i++)
+			{
+				const ReprojectionTaps& pixelTaps = taps[i];
+				XMVECTOR history = XMVectorZero();
+				float length = 0.0f;
+				for (unsigned int t = 0; t < 4; t++)
+				{
+					history += XMLoadFloat3(&previousColor[pixelTaps.pixels[t]]) * pixelTaps.weights[t];
+					length += previousLength[pixelTaps.pixels[t]] * pixelTaps.weights[t];
+				}
+
+				length += 1.0f;
+				float weight = fmaxf(settings.colorAlpha, 1.0f / length);
+				XMStoreFloat3(&output[i], XMVectorLerp(history, XMLoadFloat3(&color[i]), weight));
+				historyLength[i] = length;
+			}
+		});
+
+	previousColor = output;
+	previousLength = historyLength;
+}
+
+void ReprojectionCache::Reset()
+{
+	hasHistory = false;
+}
+
+// --------------------------------------------------------
+// Where a pixel's center ray is after a given distance
+// (as ScenePicker::CalculateRayFromCamera() aims it)
+// --------------------------------------------------------
+XMVECTOR ReprojectionCache::PixelPosition(unsigned int x, unsigned int y, float distance) const
+{
+	float screenX = (x + 0.5f) / width * 2.0f - 1.0f;
+	float screenY = -((y + 0.5f) / height * 2.0f - 1.0f);
+	XMVECTOR worldPosition = XMVector4Transform(XMVectorSet(screenX, screenY, 0, 1), XMLoadFloat4x4(&inverseViewProjection));
+	worldPosition /= XMVectorSplatW(worldPosition);
+
+	XMVECTOR origin = XMLoadFloat3(&cameraPosition);
+	return origin + XMVector3Normalize(worldPosition - origin) * distance;
+}
+
+const std::vector<ReprojectionTaps>& ReprojectionCache::GetTaps() const
+{
+	return taps;
+}
+
+const std::vector<XMFLOAT3>& ReprojectionCache::GetOutput() const
+{
+	return output;
+}
+
+const std::vector<float>& ReprojectionCache::GetHistoryLength() const
+{
+	return historyLength;
+}
+
+ReprojectionSettings& ReprojectionCache::GetSettings()
+{
+	return settings;
+}
+
+ReprojectionStats ReprojectionCache::GetStats() const
+{
+	return stats;
+}
+
+unsigned int ReprojectionCache::GetWidth() const
+{
+	return width;
+}
+
+unsigned int ReprojectionCache::GetHeight() const
+{
+	return height;
+}
+
+
+// --------------------------------------------------------
+// Projects each pixel's hit into the last frame, between
+// four pixel centers, and keeps the bilinear weight of each
+// one that saw the same surface (renormalized, so partly
+// disoccluded pixels lean on the taps that still match)
+// --------------------------------------------------------
+void ReprojectionCache::ReprojectRows(const GBufferPixel* gBuffer, unsigned int startRow, unsigned int endRow)
+{
+	XMMATRIX viewProjection = XMLoadFloat4x4(&previousViewProjection);
+	XMVECTOR previousCamera = XMLoadFloat3(&previousCameraPosition);
+	for (unsigned int y = startRow; y < endRow; y++)
+	{
+		for (unsigned int x = 0; x < width; x++)
+		{
+			ReprojectionTaps& pixelTaps = taps[y * width + x];
+			pixelTaps = {};
+
+			const GBufferPixel& pixel = gBuffer[y * width + x];
+			if (!hasHistory || pixel.distance <= 0.0f)
+				continue;
+
+			XMVECTOR position = PixelPosition(x, y, pixel.distance);
+			XMFLOAT4 clip;
+			XMStoreFloat4(&clip, XMVector4Transform(XMVectorSetW(position, 1.0f), viewProjection));
+			if (clip.w <= 0.0f)
+				continue;
+
+			float previousX = (clip.x / clip.w * 0.5f + 0.5f) * width - 0.5f;
+			float previousY = (0.5f - clip.y / clip.w * 0.5f) * height - 0.5f;
+			float cornerX = floorf(previousX);
+			float cornerY = floorf(previousY);
+			float fractionX = previousX - cornerX;
+			float fractionY = previousY - cornerY;
+			float previousDistance = XMVectorGetX(XMVector3Length(position - previousCamera));
+			XMVECTOR normal = XMLoadFloat3(&pixel.normal);
+
+			float totalWeight = 0.0f;
+			for (unsigned int t = 0; t < 4; t++)
+			{
+				int tapX = (int)cornerX + (int)(t & 1);
+				int tapY = (int)cornerY + (int)(t >> 1);
+				if (tapX < 0 || tapY < 0 || tapX >= (int)width || tapY >= (int)height)
+					continue;
+
+				unsigned int tapPixel = tapY * width + tapX;
+				const GBufferPixel& previous = previousGBuffer[tapPixel];
+				if (previous.distance <= 0.0f)
+					continue;
+
+				if (settings.rejectDisocclusions &&
+					(XMVectorGetX(XMVector3Dot(XMLoadFloat3(&previous.normal), normal)) < settings.normalCosine ||
+					fabsf(previous.distance - previousDistance) > settings.distanceRatio * previousDistance))
+					continue;
+
+				pixelTaps.pixels[t] = tapPixel;
+				pixelTaps.weights[t] = (t & 1 ? fractionX : 1.0f - fractionX) * (t >> 1 ? fractionY : 1.0f - fractionY);
+				totalWeight += pixelTaps.weights[t];
+			}
+
+			// Barely touching a matching pixel isn't enough to go on
+			if (totalWeight <= 0.01f)
+			{
+				pixelTaps = {};
+				continue;
+			}
+
+			for (unsigned int t = 0; t < 4; t++)
+				pixelTaps.weights[t] /= totalWeight;
+		}
+	}
+}
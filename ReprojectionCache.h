@@ -0,0 +1,128 @@
+#pragma once
+
+// Finds where each pixel's surface was on screen last frame, so anything
+// kept per pixel (accumulated color, denoiser history, reservoirs) can
+// follow the surface as the camera moves instead of starting over.
+//
+// Keeps last frame's view-projection and G-buffer (normal and distance
+// per pixel).  Each frame, every pixel's hit is rebuilt from its distance
+// and projected into last frame, landing between four pixels; each of
+// those counts (bilinearly) only if it saw a surface like this one -
+// normals close, and the same distance from last frame's camera - so
+// surfaces that were hidden or off screen last frame (disocclusions)
+// start over instead of smearing whatever was in front of them.
+//
+// Consumers index their own last-frame data with the taps.  Accumulate()
+// is the simplest one: an exponential average of color, following the
+// surfaces (the base TAA and progressive accumulation build on).
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "BufferStructs.h"
+
+// Where a pixel was last frame: four neighbouring pixels' indices, with
+// weights adding up to one - or all zero if none of them saw this surface
+struct ReprojectionTaps
+{
+	unsigned int pixels[4];
+	float weights[4];
+};
+
+struct ReprojectionSettings
+{
+	ReprojectionSettings();
+
+	float normalCosine;			// Least cosine between normals for a tap to count
+	float distanceRatio;		// Most distance can differ (relative to it) for a tap to count
+	bool rejectDisocclusions;	// Off, every tap on screen counts (to see how much ghosting it saves)
+	float colorAlpha;			// Least weight a new frame gets in Accumulate()
+};
+
+// How much of the last frame carried over
+struct ReprojectionStats
+{
+	unsigned int hitPixels;			// Pixels whose camera ray hit something
+	unsigned int reprojectedPixels;	// Those with at least one matching tap
+};
+
+class ReprojectionCache
+{
+public:
+	ReprojectionCache();
+
+	/// <summary>
+	/// Resizes the image (which drops any history)
+	/// </summary>
+	void Resize(unsigned int width, unsigned int height);
+
+	/// <summary>
+	/// Starts a new frame: its camera becomes current, and the old current one is what Update() reprojects into
+	/// </summary>
+	/// <param name="cameraPosition">Where the camera is this frame</param>
+	/// <param name="view">Camera's view matrix this frame</param>
+	/// <param name="projection">Camera's projection matrix this frame</param>
+	void SetCamera(
+		DirectX::XMFLOAT3 cameraPosition,
+		const DirectX::XMFLOAT4X4& view,
+		const DirectX::XMFLOAT4X4& projection);
+
+	/// <summary>
+	/// Finds every pixel's taps into the last frame (after SetCamera()), then remembers this one for the next
+	/// </summary>
+	/// <param name="gBuffer">What each pixel's camera ray hit this frame</param>
+	void Update(const GBufferPixel* gBuffer);
+
+	/// <summary>
+	/// Blends a frame's color with the accumulated color at each pixel's taps (after Update())
+	/// </summary>
+	/// <param name="color">This frame's linear color, one per pixel</param>
+	void Accumulate(const DirectX::XMFLOAT3* color);
+
+	/// <summary>
+	/// Forgets the last frame, so the next Update() finds no taps
+	/// </summary>
+	void Reset();
+
+	/// <summary>
+	/// Where a pixel's center ray is after a given distance this frame (as
+	/// ScenePicker::CalculateRayFromCamera() aims it), once SetCamera() has been called
+	/// </summary>
+	DirectX::XMVECTOR PixelPosition(unsigned int x, unsigned int y, float distance) const;
+
+	// Taps of every pixel from the last Update()
+	const std::vector<ReprojectionTaps>& GetTaps() const;
+
+	// Accumulated color and how many frames each pixel's average holds (after Accumulate())
+	const std::vector<DirectX::XMFLOAT3>& GetOutput() const;
+	const std::vector<float>& GetHistoryLength() const;
+
+	ReprojectionSettings& GetSettings();
+	ReprojectionStats GetStats() const;
+	unsigned int GetWidth() const;
+	unsigned int GetHeight() const;
+
+private:
+	unsigned int width;
+	unsigned int height;
+	ReprojectionSettings settings;
+	ReprojectionStats stats;
+
+	std::vector<ReprojectionTaps> taps;
+	std::vector<GBufferPixel> previousGBuffer;
+
+	// Accumulate()'s history (last frame's, indexed by the taps) and this frame's
+	std::vector<DirectX::XMFLOAT3> previousColor;
+	std::vector<float> previousLength;
+	std::vector<DirectX::XMFLOAT3> output;
+	std::vector<float> historyLength;
+
+	// Camera for this frame, and for the last one (to reproject into)
+	DirectX::XMFLOAT3 cameraPosition;
+	DirectX::XMFLOAT4X4 inverseViewProjection;
+	DirectX::XMFLOAT3 previousCameraPosition;
+	DirectX::XMFLOAT4X4 previousViewProjection;
+	bool hasHistory;
+
+	void ReprojectRows(const GBufferPixel* gBuffer, unsigned int startRow, unsigned int endRow);
+};
@@ -0,0 +1,173 @@
+#include "ResamplingBenchmark.h"
+#include "BenchmarkUtils.h"
+#include "Bounds.h"
+#include "DirectLightResampler.h"
+#include "Mesh.h"
+
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <vector>
+
+using namespace DirectX;
+using namespace BenchmarkUtils;
+
+namespace
+{
+	// Point and spot lights scattered through the box around every instance,
+	// each reaching a small part of it
+	std::vector<Light> ScatterLights(const SceneSnapshot& scene, unsigned int lightCount)
+	{
+		AABB sceneBounds = Bounds::Empty();
+		for (const SnapshotInstance& instance : scene.instances)
+		{
+			AABB bounds = Bounds::Transform(instance.mesh->GetLocalBounds(), instance.worldMatrix);
+			Bounds::Expand(sceneBounds, bounds.minCorner);
+			Bounds::Expand(sceneBounds, bounds.maxCorner);
+		}
+
+		XMFLOAT3 center = Bounds::GetCenter(sceneBounds);
+		XMFLOAT3 extents = Bounds::GetHalfExtents(sceneBounds);
+		float size = fmaxf(extents.x, fmaxf(extents.y, extents.z));
+
+		std::mt19937 random(1234);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		std::vector<Light> lights(lightCount);
+		for (Light& light : lights)
+		{
+			light = {};
+			light.Type = unit(random) < 0.25f ? LIGHT_TYPE_SPOT : LIGHT_TYPE_POINT;
+			light.Position = XMFLOAT3(
+				center.x + (unit(random) * 2 - 1) * (extents.x + 1.0f),
+				center.y + (unit(random) * 2 - 1) * (extents.y + 1.0f),
+				center.z + (unit(random) * 2 - 1) * (extents.z + 1.0f));
+			light.Range = size * (0.1f + unit(random) * 0.4f);
+			light.Intensity = 0.2f + unit(random) * 2.0f;
+			light.Color = XMFLOAT3(0.5f + unit(random) * 0.5f, 0.5f + unit(random) * 0.5f, 0.5f + unit(random) * 0.5f);
+			light.Direction = XMFLOAT3(unit(random) * 2 - 1, unit(random) * 2 - 1, unit(random) * 2 - 1);
+			light.SpotFalloff = 2.0f + unit(random) * 30.0f;
+		}
+		return lights;
+	}
+
+	// Everything in the image added up, for telling a biased estimate (too dark or too
+	// bright on average) from a merely noisy one
+	double TotalLight(const std::vector<XMFLOAT3>& image)
+	{
+		double total = 0;
+		for (const XMFLOAT3& color : image)
+			total += color.x + color.y + color.z;
+		return total;
+	}
+
+	struct Setup
+	{
+		const char* name;
+		unsigned int candidateCount;
+		bool visibilityReuse;
+		bool temporalReuse;
+		unsigned int spatialNeighbours;
+	};
+
+	const Setup Setups[] =
+	{
+		{ "light tree",         1, false, false, 0 },
+		{ "candidates",         8, false, false, 0 },
+		{ "+ visibility",       8, true,  false, 0 },
+		{ "+ temporal",         8, true,  true,  0 },
+		{ "+ spatial (ReSTIR)", 8, true,  true,  4 },
+	};
+}
+
+bool ResamplingBenchmark::Run()
+{
+	return Run(160, 90, 1000, 16);
+}
+
+// --------------------------------------------------------
+// Renders the same frames with each setup, averaging their
+// error against the exact lighting (every frame for the
+// moving camera, as its reference changes), along with
+// rays per pixel and time per frame
+// --------------------------------------------------------
+bool ResamplingBenchmark::Run(unsigned int width, unsigned int height, unsigned int lightCount, unsigned int frames)
+{
+	printf("Resampling benchmark: %ux%u, %u lights, %u frames\n", width, height, lightCount, frames);
+
+	Scene scene;
+	CreateScene(&scene, (float)width / height);
+	std::vector<Light> lights = ScatterLights(scene.snapshot, lightCount);
+
+	bool passed = true;
+	for (unsigned int moving = 0; moving < 2; moving++)
+	{
+		printf(moving ? "  moving camera\n" : "  still camera\n");
+
+		double firstError = 0;
+		double previousError = 0;
+		for (const Setup& setup : Setups)
+		{
+			DirectLightResampler resampler;
+			resampler.Resize(width, height);
+			ResamplerSettings& settings = resampler.GetSettings();
+			settings.candidateCount = setup.candidateCount;
+			settings.visibilityReuse = setup.visibilityReuse;
+			settings.temporalReuse = setup.temporalReuse;
+			settings.spatialNeighbours = setup.spatialNeighbours;
+			settings.spatialRadius *= width / 1920.0f; // The default suits 1080p, and a small image has far fewer pixels per surface
+
+			std::vector<XMFLOAT3> reference;
+			double totalError = 0;
+			double totalLight = 0;
+			double totalReferenceLight = 0;
+			double totalTime = 0;
+			unsigned long long totalRays = 0;
+			for (unsigned int frame = 0; frame < frames; frame++)
+			{
+				// Sideways, a little further each frame
+				XMFLOAT3 offset(moving ? 0.05f * frame : 0.0f, 0.0f, 0.0f);
+				XMFLOAT3 position(scene.cameraPosition.x + offset.x, scene.cameraPosition.y + offset.y, scene.cameraPosition.z + offset.z);
+				XMFLOAT4X4 frameView;
+				XMStoreFloat4x4(&frameView, XMMatrixMultiply(XMMatrixTranslation(-offset.x, -offset.y, -offset.z), XMLoadFloat4x4(&scene.view)));
+
+				Clock::time_point start = Clock::now();
+				resampler.Render(scene.snapshot, lights.data(), lightCount, position, frameView, scene.projection);
+				totalTime += MillisecondsSince(start);
+				totalRays += resampler.GetRaysCast();
+
+				if (moving || frame == 0)
+					resampler.RenderReference(reference);
+
+				// Reuse needs a few frames to get going, so skip the first
+				if (frame >= frames / 4)
+				{
+					totalError += MeanSquaredError(resampler.GetOutput(), reference);
+					totalLight += TotalLight(resampler.GetOutput());
+					totalReferenceLight += TotalLight(reference);
+				}
+			}
+
+			double error = totalError / (frames - frames / 4);
+			double light = totalReferenceLight > 0 ? totalLight / totalReferenceLight : 0.0;
+			if (firstError == 0)
+				firstError = error;
+			printf("    %-20s MSE %.6f (%5.1fx lower)   %.3f of the light   %5.2f rays per pixel   %7.2f ms per frame\n",
+				setup.name,
+				error,
+				error > 0 ? firstError / error : 0.0,
+				light,
+				(double)totalRays / ((double)frames * width * height),
+				totalTime / frames);
+
+			// Every step has to pay for itself, without darkening or brightening the image
+			if (&setup == &Setups[sizeof(Setups) / sizeof(Setups[0]) - 1])
+				passed &= Expect(error < previousError, "spatial reuse to lower the error further than temporal reuse alone");
+			else if (previousError > 0)
+				passed &= Expect(error <= previousError, "each step to be no worse than the one before");
+			passed &= Expect(fabs(light - 1.0) < 0.03, "the total light to be within 3% of the reference's");
+			previousError = error;
+		}
+	}
+
+	return passed;
+}
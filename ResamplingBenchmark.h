@@ -0,0 +1,31 @@
+#pragma once
+
+// Measures how much each step of the DirectLightResampler helps, without
+// the GPU: scatters many point and spot lights through the benchmark scene
+// (BenchmarkUtils.h), renders direct lighting over several frames with
+// more and more of the pipeline turned on (light tree alone, resampled
+// candidates, temporal reuse, spatial reuse), and compares each against
+// the exact sum over every light. Then moves the camera every frame, to
+// see how much of the gain survives reprojection.  Start the program with
+// -benchmark to run it (see HeadlessTests.h); it fails if any step makes
+// the error worse (spatial reuse has to make it better), or if any of
+// them gets the total light more than 3% off.
+
+namespace ResamplingBenchmark
+{
+	/// <summary>
+	/// Runs the benchmark at 160x90 with 1000 lights for 16 frames
+	/// </summary>
+	/// <returns>Whether every step paid for itself, without biasing the image</returns>
+	bool Run();
+
+	/// <summary>
+	/// Runs the benchmark with a specific image size, number of lights and frames
+	/// </summary>
+	/// <param name="width">Image width in pixels</param>
+	/// <param name="height">Image height in pixels</param>
+	/// <param name="lightCount">How many lights to scatter through the scene</param>
+	/// <param name="frames">How many frames to render with each setup</param>
+	/// <returns>Whether every step paid for itself, without biasing the image</returns>
+	bool Run(unsigned int width, unsigned int height, unsigned int lightCount, unsigned int frames);
+}
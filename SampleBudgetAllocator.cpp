@@ -0,0 +1,137 @@
+#include "SampleBudgetAllocator.h"
+
+#include <algorithm>
+#include <math.h>
+
+SampleBudgetSettings::SampleBudgetSettings() :
+	raysPerFrame(0),
+	minSamplesPerPixel(16),
+	maxSamplesPerPixel(64),
+	errorThreshold(0.01f)
+{
+}
+
+SampleBudgetAllocator::SampleBudgetAllocator() :
+	stats{}
+{
+}
+
+
+// --------------------------------------------------------
+// Converged tiles are dropped, every other tile gets one
+// sample per pixel (noisiest first, in case the budget
+// runs out), then the rest is shared out by error
+// --------------------------------------------------------
+void SampleBudgetAllocator::Allocate(const SampleTile* tiles, unsigned int tileCount, unsigned int* tileSamples)
+{
+	stats = {};
+	weights.resize(tileCount);
+	activeTiles.clear();
+
+	// Tiles still warming up can't be trusted to know their own error
+	// yet, so they count as at least as noisy as the worst settled tile
+	float worstError = settings.errorThreshold;
+	for (unsigned int t = 0; t < tileCount; t++)
+	{
+		if (tiles[t].samplesPerPixel >= settings.minSamplesPerPixel)
+			worstError = fmaxf(worstError, tiles[t].error);
+	}
+
+	for (unsigned int t = 0; t < tileCount; t++)
+	{
+		tileSamples[t] = 0;
+		weights[t] = 0;
+		if (tiles[t].pixelCount == 0)
+			continue;
+
+		bool warmingUp = tiles[t].samplesPerPixel < settings.minSamplesPerPixel;
+		if (!warmingUp && tiles[t].error <= settings.errorThreshold)
+		{
+			stats.convergedTiles++;
+			continue;
+		}
+
+		weights[t] = warmingUp ? fmaxf(tiles[t].error, worstError) : tiles[t].error;
+		activeTiles.push_back(t);
+	}
+	stats.activeTiles = (unsigned int)activeTiles.size();
+
+	// Tiles with nothing at all (just started over) first, so they
+	// can't be crowded out by the ones a sample ahead, then the noisiest
+	std::sort(activeTiles.begin(), activeTiles.end(),
+		[&](unsigned int a, unsigned int b)
+		{
+			bool emptyA = tiles[a].samplesPerPixel == 0;
+			bool emptyB = tiles[b].samplesPerPixel == 0;
+			return emptyA != emptyB ? emptyA : weights[a] > weights[b];
+		});
+
+	// One sample per pixel for as many tiles as the budget covers
+	unsigned int remaining = settings.raysPerFrame;
+	float totalWeight = 0;
+	for (unsigned int t : activeTiles)
+	{
+		if (tiles[t].pixelCount > remaining)
+			continue;
+
+		tileSamples[t] = 1;
+		remaining -= tiles[t].pixelCount;
+		totalWeight += weights[t];
+	}
+
+	// The rest in proportion to each tile's error
+	unsigned int maxExtra = settings.maxSamplesPerPixel > 1 ? settings.maxSamplesPerPixel - 1 : 0;
+	float shared = (float)remaining;
+	for (unsigned int t : activeTiles)
+	{
+		if (tileSamples[t] == 0 || totalWeight <= 0)
+			continue;
+
+		unsigned int extra = (unsigned int)(shared * weights[t] / totalWeight / tiles[t].pixelCount);
+		unsigned int affordable = remaining / tiles[t].pixelCount;
+		extra = extra < maxExtra ? extra : maxExtra;
+		extra = extra < affordable ? extra : affordable;
+		tileSamples[t] += extra;
+		remaining -= extra * tiles[t].pixelCount;
+	}
+
+	// Rounding down leaves a little over, which goes to the noisiest tiles
+	for (unsigned int t : activeTiles)
+	{
+		if (tileSamples[t] == 0 || tileSamples[t] >= settings.maxSamplesPerPixel || tiles[t].pixelCount > remaining)
+			continue;
+
+		tileSamples[t]++;
+		remaining -= tiles[t].pixelCount;
+	}
+
+	stats.raysAllocated = settings.raysPerFrame - remaining;
+}
+
+// --------------------------------------------------------
+// Standard error of the mean (the sample variance over the
+// sample count), relative to the mean itself
+// --------------------------------------------------------
+float SampleBudgetAllocator::RelativeError(unsigned int sampleCount, float mean, float squaredDifferences)
+{
+	if (sampleCount < 2)
+		return 1.0f;
+
+	float variance = squaredDifferences / (sampleCount - 1);
+	return sqrtf(variance / sampleCount) / (fabsf(mean) + SAMPLE_BUDGET_LUMINANCE_FLOOR);
+}
+
+SampleBudgetSettings& SampleBudgetAllocator::GetSettings()
+{
+	return settings;
+}
+
+void SampleBudgetAllocator::SetSettings(const SampleBudgetSettings& newSettings)
+{
+	settings = newSettings;
+}
+
+const SampleBudgetStats& SampleBudgetAllocator::GetStats()
+{
+	return stats;
+}
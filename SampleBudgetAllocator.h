@@ -0,0 +1,80 @@
+#pragma once
+
+// Splits a fixed number of camera rays per frame across the tiles of an
+// image by how noisy each tile still is.  Tiles whose pixels' running
+// means have settled (low relative standard error) get nothing at all,
+// every other tile gets at least one sample per pixel, and whatever's
+// left of the budget goes to tiles in proportion to their error.  Tiles
+// with too few samples to trust their error estimate yet are always
+// treated as at least as noisy as the worst settled tile.
+//
+// Only sees per-tile numbers, so any tracer keeping per-pixel running
+// means and variances (see RelativeError()) can be driven by it.
+
+#include <vector>
+
+// Added to a pixel's mean luminance before dividing its error by it, so
+// dark pixels don't need absurd sample counts to count as converged
+#define SAMPLE_BUDGET_LUMINANCE_FLOOR 0.1f
+
+struct SampleBudgetSettings
+{
+	SampleBudgetSettings();
+
+	unsigned int raysPerFrame;			// Camera rays to spend each frame across the whole image (0 disables adaptive sampling)
+	unsigned int minSamplesPerPixel;	// Samples a tile needs before it can be considered converged
+	unsigned int maxSamplesPerPixel;	// Most samples any tile gets in a single frame
+	float errorThreshold;				// Relative standard error below which a tile is converged
+};
+
+// How a tile's accumulation is going, as the tracer sees it
+struct SampleTile
+{
+	unsigned int pixelCount;
+	unsigned int samplesPerPixel;	// Fewest samples any of its pixels has
+	float error;					// Root mean square of its pixels' RelativeError()
+};
+
+// What the last allocation did
+struct SampleBudgetStats
+{
+	unsigned int raysAllocated;
+	unsigned int activeTiles;		// Tiles that still wanted samples
+	unsigned int convergedTiles;
+};
+
+class SampleBudgetAllocator
+{
+public:
+	SampleBudgetAllocator();
+
+	/// <summary>
+	/// Decides how many samples per pixel each tile gets this frame
+	/// </summary>
+	/// <param name="tiles">Every tile's current state</param>
+	/// <param name="tileCount">How many tiles there are</param>
+	/// <param name="tileSamples">Filled in with each tile's samples per pixel (0 means skip it)</param>
+	void Allocate(const SampleTile* tiles, unsigned int tileCount, unsigned int* tileSamples);
+
+	/// <summary>
+	/// A pixel's relative standard error, from its Welford running mean and sum of squared differences
+	/// </summary>
+	/// <param name="sampleCount">How many samples the pixel has</param>
+	/// <param name="mean">Running mean of the samples' luminance</param>
+	/// <param name="squaredDifferences">Welford's M2 (sum of squared differences from the mean)</param>
+	static float RelativeError(unsigned int sampleCount, float mean, float squaredDifferences);
+
+	// Settings
+	SampleBudgetSettings& GetSettings();
+	void SetSettings(const SampleBudgetSettings& newSettings);
+
+	const SampleBudgetStats& GetStats();
+
+private:
+	SampleBudgetSettings settings;
+	SampleBudgetStats stats;
+
+	// Scratch space, kept between frames so Allocate() doesn't hit the heap
+	std::vector<unsigned int> activeTiles;
+	std::vector<float> weights;
+};
@@ -0,0 +1,142 @@
+#pragma once
+
+// Random numbers for path tracing, written once for both C++ and HLSL
+// (Raytracing.hlsl includes this file directly, and CpuRaytracer uses the
+// same functions through the Sampler namespace), so the CPU tracer draws
+// exactly the samples the GPU does.
+//
+// Seeds are hashed with PCG, and samples come from a Sobol (0,2)-sequence
+// with hash-based Owen scrambling (Burley, "Practical Hash-based Owen
+// Scrambling", 2020).  Every pixel gets its own scramble, so neighbouring
+// pixels don't share a pattern, while each pixel's samples stay stratified
+// - any power of two count of them covers the unit square evenly.  Each
+// pair of dimensions also shuffles the sample order independently, so
+// dimensions don't correlate with each other either.
+//
+// Samples are addressed by pixel (its seed), sample index within the
+// pixel and dimension.  See SAMPLER_DIMENSION_* for how a path uses them.
+//
+// Only uses what both languages share: uint/float math, float2 and
+// functions.  Nothing here may use C++ or HLSL specific syntax.
+
+#ifdef __cplusplus
+#include <DirectXMath.h>
+
+namespace Sampler
+{
+	typedef unsigned int uint;
+	typedef DirectX::XMFLOAT2 float2;
+
+	inline uint reversebits(uint x)
+	{
+		x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+		x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+		x = ((x >> 4) & 0x0F0F0F0Fu) | ((x & 0x0F0F0F0Fu) << 4);
+		x = ((x >> 8) & 0x00FF00FFu) | ((x & 0x00FF00FFu) << 8);
+		return (x >> 16) | (x << 16);
+	}
+
+#define SAMPLER_FUNCTION inline
+#else
+#define SAMPLER_FUNCTION
+#endif
+
+// How a path uses its dimensions: pixel jitter first, then a fixed block
+// of dimensions per bounce (so adding uses for a bounce doesn't shift any
+// other bounce's samples)
+#define SAMPLER_DIMENSION_JITTER 0
+#define SAMPLER_DIMENSIONS_PER_BOUNCE 4
+#define SAMPLER_DIMENSION_BOUNCE_DIRECTION(depth) (1 + (depth) * SAMPLER_DIMENSIONS_PER_BOUNCE)
+#define SAMPLER_DIMENSION_ROULETTE(depth) (2 + (depth) * SAMPLER_DIMENSIONS_PER_BOUNCE)
+#define SAMPLER_DIMENSION_LIGHT_CHOICE(depth) (3 + (depth) * SAMPLER_DIMENSIONS_PER_BOUNCE)
+#define SAMPLER_DIMENSION_LIGHT_SAMPLE(depth) (4 + (depth) * SAMPLER_DIMENSIONS_PER_BOUNCE)
+
+// PCG output permutation (Jarzynski and Olano, "Hash Functions for GPU Rendering")
+SAMPLER_FUNCTION uint PcgHash(uint value)
+{
+	uint state = value * 747796405u + 2891336453u;
+	uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+	return (word >> 22u) ^ word;
+}
+
+SAMPLER_FUNCTION uint HashCombine(uint seed, uint value)
+{
+	return PcgHash(seed ^ (value + 0x9e3779b9u + (seed << 6) + (seed >> 2)));
+}
+
+// A different seed for every pixel
+SAMPLER_FUNCTION uint PixelSeed(uint x, uint y)
+{
+	return PcgHash(x + PcgHash(y));
+}
+
+// Top 24 bits as a float in [0, 1)
+SAMPLER_FUNCTION float UintToUnitFloat(uint value)
+{
+	return (value >> 8) * (1.0f / 16777216.0f);
+}
+
+// Owen scrambling, one bit at a time from the top, done as a hash that
+// only lets each bit depend on the bits above it
+SAMPLER_FUNCTION uint LaineKarrasPermutation(uint value, uint seed)
+{
+	value += seed;
+	value ^= value * 0x6c50b47cu;
+	value ^= value * 0xb82f1e52u;
+	value ^= value * 0xc7afe638u;
+	value ^= value * 0x8d22f6e6u;
+	return value;
+}
+
+SAMPLER_FUNCTION uint NestedUniformScramble(uint value, uint seed)
+{
+	return reversebits(LaineKarrasPermutation(reversebits(value), seed));
+}
+
+// The first two Sobol dimensions (van der Corput, then its x + 1 partner)
+SAMPLER_FUNCTION uint SobolDimension0(uint index)
+{
+	return reversebits(index);
+}
+
+SAMPLER_FUNCTION uint SobolDimension1(uint index)
+{
+	uint result = 0;
+	uint direction = 0x80000000u;
+	for (uint bit = 0; bit < 32; bit++)
+	{
+		if ((index >> bit) & 1u)
+			result ^= direction;
+		direction ^= direction >> 1;
+	}
+	return result;
+}
+
+/// <summary>
+/// A two dimensional sample in [0, 1)
+/// </summary>
+/// <param name="pixelSeed">From PixelSeed()</param>
+/// <param name="sampleIndex">Which of the pixel's samples this is (count up from 0 for the best coverage)</param>
+/// <param name="dimension">Which pair of dimensions - each one is independent of the others</param>
+SAMPLER_FUNCTION float2 Sample2D(uint pixelSeed, uint sampleIndex, uint dimension)
+{
+	uint seed = HashCombine(pixelSeed, dimension);
+	uint index = NestedUniformScramble(sampleIndex, seed);
+	uint x = NestedUniformScramble(SobolDimension0(index), HashCombine(seed, 0xa511e9b3u));
+	uint y = NestedUniformScramble(SobolDimension1(index), HashCombine(seed, 0x63d83595u));
+	return float2(UintToUnitFloat(x), UintToUnitFloat(y));
+}
+
+/// <summary>
+/// A one dimensional sample in [0, 1), stratified the same way
+/// </summary>
+SAMPLER_FUNCTION float Sample1D(uint pixelSeed, uint sampleIndex, uint dimension)
+{
+	uint seed = HashCombine(pixelSeed, dimension);
+	uint index = NestedUniformScramble(sampleIndex, seed);
+	return UintToUnitFloat(NestedUniformScramble(SobolDimension0(index), HashCombine(seed, 0xa511e9b3u)));
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,219 @@
+#include "SamplerBenchmark.h"
+#include "BenchmarkUtils.h"
+#include "Sampler.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+
+using namespace DirectX;
+using namespace BenchmarkUtils;
+
+namespace
+{
+	// Pixels are laid out in rows this wide, for the generators that care
+	const unsigned int PixelRowWidth = 64;
+
+	// Every generator answers the same question: a 2D sample for a pixel's
+	// sample index in a given pair of dimensions
+	typedef XMFLOAT2(*Generator)(unsigned int pixel, unsigned int sampleIndex, unsigned int dimension);
+
+	// The hash the shaders used before the Sampler existed
+	float LegacyRand(XMFLOAT2 uv)
+	{
+		float value = sinf(uv.x * 12.9898f + uv.y * 78.233f) * 43758.5453f;
+		return value - floorf(value);
+	}
+
+	// ...and how they used it: jitter was the same for every pixel, and
+	// bounces fed the pixel's position and sample index through rand2()
+	XMFLOAT2 LegacySample(unsigned int pixel, unsigned int sampleIndex, unsigned int dimension)
+	{
+		if (dimension == SAMPLER_DIMENSION_JITTER)
+			return XMFLOAT2(LegacyRand(XMFLOAT2((float)sampleIndex, 0.37f)), LegacyRand(XMFLOAT2(0.61f, (float)sampleIndex)));
+
+		float u = (float)(pixel % PixelRowWidth) / PixelRowWidth * dimension + sampleIndex;
+		float v = (float)(pixel / PixelRowWidth) / PixelRowWidth * dimension + sampleIndex;
+		float x = LegacyRand(XMFLOAT2(u, v));
+		XMFLOAT2 rng(x, sqrtf(1 - x * x));
+		return XMFLOAT2(LegacyRand(rng), LegacyRand(XMFLOAT2(rng.y, rng.x)));
+	}
+
+	XMFLOAT2 WhiteNoiseSample(unsigned int pixel, unsigned int sampleIndex, unsigned int dimension)
+	{
+		unsigned int seed = Sampler::HashCombine(Sampler::HashCombine(Sampler::PixelSeed(pixel % PixelRowWidth, pixel / PixelRowWidth), dimension), sampleIndex);
+		return XMFLOAT2(Sampler::UintToUnitFloat(Sampler::PcgHash(seed)), Sampler::UintToUnitFloat(Sampler::PcgHash(seed + 1)));
+	}
+
+	XMFLOAT2 SobolSample(unsigned int pixel, unsigned int sampleIndex, unsigned int dimension)
+	{
+		return Sampler::Sample2D(Sampler::PixelSeed(pixel % PixelRowWidth, pixel / PixelRowWidth), sampleIndex, dimension);
+	}
+
+	struct NamedGenerator
+	{
+		const char* name;
+		Generator generator;
+		bool checked;	// Whether it's expected to pass
+	};
+
+	// White noise comes before the Sampler, whose disk error is judged against it
+	const NamedGenerator Generators[] =
+	{
+		{ "sin hash", LegacySample, false },
+		{ "PCG white noise", WhiteNoiseSample, false },
+		{ "Owen-scrambled Sobol", SobolSample, true },
+	};
+
+	double Correlation(const std::vector<double>& a, const std::vector<double>& b)
+	{
+		double meanA = 0, meanB = 0;
+		for (size_t i = 0; i < a.size(); i++)
+		{
+			meanA += a[i];
+			meanB += b[i];
+		}
+		meanA /= a.size();
+		meanB /= b.size();
+
+		double covariance = 0, varianceA = 0, varianceB = 0;
+		for (size_t i = 0; i < a.size(); i++)
+		{
+			covariance += (a[i] - meanA) * (b[i] - meanB);
+			varianceA += (a[i] - meanA) * (a[i] - meanA);
+			varianceB += (b[i] - meanB) * (b[i] - meanB);
+		}
+		return varianceA > 0 && varianceB > 0 ? covariance / sqrt(varianceA * varianceB) : 1.0;
+	}
+}
+
+bool SamplerBenchmark::Run()
+{
+	return Run(4096, 1024);
+}
+
+// --------------------------------------------------------
+// Runs each check on each generator in turn
+// --------------------------------------------------------
+bool SamplerBenchmark::Run(unsigned int pixelCount, unsigned int maxSamples)
+{
+	printf("Sampler benchmark: %u pixels, up to %u samples each\n", pixelCount, maxSamples);
+
+	bool passed = true;
+	double whiteNoiseError = 0;
+	for (const NamedGenerator& named : Generators)
+	{
+		printf("  %s\n", named.name);
+		Generator generate = named.generator;
+
+		// Uniformity: one pixel's bounce samples into 64 bins (63 degrees of
+		// freedom, so anything over ~103 is off at p = 0.001)
+		{
+			const unsigned int binCount = 64;
+			unsigned int sampleCount = maxSamples * 64;
+			std::vector<unsigned int> bins(binCount, 0);
+			for (unsigned int i = 0; i < sampleCount; i++)
+			{
+				float x = generate(0, i, SAMPLER_DIMENSION_BOUNCE_DIRECTION(0)).x;
+				bins[(unsigned int)(x * binCount) % binCount]++;
+			}
+
+			double expected = (double)sampleCount / binCount;
+			double chiSquared = 0;
+			for (unsigned int count : bins)
+				chiSquared += (count - expected) * (count - expected) / expected;
+			bool uniform = chiSquared < 103.4;
+			printf("    uniformity      chi-squared %10.2f%s\n", chiSquared, Verdict(named.checked, uniform));
+			passed &= !named.checked || uniform;
+		}
+
+		// Stratification: the first N*N samples of a pixel against an NxN grid
+		{
+			unsigned int gridSize = (unsigned int)sqrt((double)maxSamples);
+			unsigned int sampleCount = gridSize * gridSize;
+			std::vector<bool> occupied(sampleCount, false);
+			for (unsigned int i = 0; i < sampleCount; i++)
+			{
+				XMFLOAT2 sample = generate(0, i, SAMPLER_DIMENSION_BOUNCE_DIRECTION(0));
+				unsigned int cellX = (unsigned int)(sample.x * gridSize) % gridSize;
+				unsigned int cellY = (unsigned int)(sample.y * gridSize) % gridSize;
+				occupied[cellY * gridSize + cellX] = true;
+			}
+
+			unsigned int cellsCovered = 0;
+			for (bool cell : occupied)
+				cellsCovered += cell ? 1 : 0;
+			bool stratified = cellsCovered == sampleCount;
+			printf("    stratification  %u of %u cells covered%s\n", cellsCovered, sampleCount, Verdict(named.checked, stratified));
+			passed &= !named.checked || stratified;
+		}
+
+		// Correlation: neighbouring pixels' jitter, and a sample's two
+		// coordinates, and a bounce's direction against its roulette
+		{
+			std::vector<double> pixel, neighbour, x, y, direction, roulette;
+			for (unsigned int p = 0; p + 1 < pixelCount; p++)
+			{
+				for (unsigned int i = 0; i < 16; i++)
+				{
+					XMFLOAT2 jitter = generate(p, i, SAMPLER_DIMENSION_JITTER);
+					pixel.push_back(jitter.x);
+					neighbour.push_back(generate(p + 1, i, SAMPLER_DIMENSION_JITTER).x);
+
+					XMFLOAT2 bounce = generate(p, i, SAMPLER_DIMENSION_BOUNCE_DIRECTION(1));
+					x.push_back(bounce.x);
+					y.push_back(bounce.y);
+					direction.push_back(bounce.x);
+					roulette.push_back(generate(p, i, SAMPLER_DIMENSION_ROULETTE(1)).x);
+				}
+			}
+
+			double pixels = Correlation(pixel, neighbour);
+			double coordinates = Correlation(x, y);
+			double dimensions = Correlation(direction, roulette);
+			bool uncorrelated[3] = { fabs(pixels) < 0.02, fabs(coordinates) < 0.02, fabs(dimensions) < 0.02 };
+			printf("    correlation     neighbouring pixels %+.4f%s   x and y %+.4f%s   dimensions %+.4f%s\n",
+				pixels, Verdict(named.checked, uncorrelated[0]),
+				coordinates, Verdict(named.checked, uncorrelated[1]),
+				dimensions, Verdict(named.checked, uncorrelated[2]));
+			passed &= !named.checked || (uncorrelated[0] && uncorrelated[1] && uncorrelated[2]);
+		}
+
+		// Integration: root mean square error (across pixels) estimating the
+		// area of a quarter disk, which should fall as more samples are taken
+		// (and for the Sampler, end up well under white noise's)
+		{
+			printf("    disk RMSE      ");
+			double exact = 3.14159265358979 / 4.0;
+			double error = 0;
+			bool falling = true;
+			for (unsigned int samples = 4; samples <= maxSamples; samples *= 4)
+			{
+				double squaredError = 0;
+				for (unsigned int p = 0; p < pixelCount; p++)
+				{
+					unsigned int inside = 0;
+					for (unsigned int i = 0; i < samples; i++)
+					{
+						XMFLOAT2 sample = generate(p, i, SAMPLER_DIMENSION_BOUNCE_DIRECTION(0));
+						inside += sample.x * sample.x + sample.y * sample.y < 1.0f ? 1 : 0;
+					}
+					double difference = (double)inside / samples - exact;
+					squaredError += difference * difference;
+				}
+				double previousError = error;
+				error = sqrt(squaredError / pixelCount);
+				falling &= samples == 4 || error < previousError;
+				printf("  %u: %.5f", samples, error);
+			}
+
+			if (named.generator == WhiteNoiseSample)
+				whiteNoiseError = error;
+			bool beatsWhiteNoise = error < whiteNoiseError * 0.5;
+			printf("%s\n", Verdict(named.checked, falling && beatsWhiteNoise));
+			passed &= !named.checked || (falling && beatsWhiteNoise);
+		}
+	}
+
+	return passed;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+// Statistical checks of the shared Sampler (Sampler.h), side by side with
+// the sin() hash the shaders used to use and plain PCG white noise:
+//  - uniformity (chi-squared over a histogram of one dimension)
+//  - stratification (how many cells of an NxN grid N*N samples land in)
+//  - correlation between neighbouring pixels, and between dimensions
+//  - error integrating a disk at growing sample counts, across many pixels
+// Each check the Sampler is expected to pass is marked PASS or FAIL, and
+// its disk error has to keep falling and end well below white noise's.
+// It's one of the headless checks (see HeadlessTests.h), so -test runs it.
+
+namespace SamplerBenchmark
+{
+	/// <summary>
+	/// Runs every check with 4096 pixels
+	/// </summary>
+	/// <returns>Whether the Sampler passed everything it's expected to</returns>
+	bool Run();
+
+	/// <summary>
+	/// Runs every check with a specific number of pixels and samples
+	/// </summary>
+	/// <param name="pixelCount">How many pixels (seeds) to average correlations and errors over</param>
+	/// <param name="maxSamples">Most samples per pixel to integrate with (a power of two)</param>
+	/// <returns>Whether the Sampler passed everything it's expected to</returns>
+	bool Run(unsigned int pixelCount, unsigned int maxSamples);
+}
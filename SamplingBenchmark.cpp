@@ -0,0 +1,119 @@
+#include "SamplingBenchmark.h"
+#include "BenchmarkUtils.h"
+#include "CpuRaytracer.h"
+
+#include <stdio.h>
+
+using namespace DirectX;
+using namespace BenchmarkUtils;
+
+bool SamplingBenchmark::Run()
+{
+	return Run(160, 90, 4, 32);
+}
+
+// --------------------------------------------------------
+// Renders a reference, then accumulates the same view with
+// uniform and adaptive sampling at an equal ray budget,
+// reporting both errors every power of two frames, then
+// with and without Russian roulette
+// --------------------------------------------------------
+bool SamplingBenchmark::Run(unsigned int width, unsigned int height, unsigned int samplesPerPixel, unsigned int frames)
+{
+	printf("Sampling benchmark: %ux%u, %u rays per pixel per frame, %u frames\n", width, height, samplesPerPixel, frames);
+
+	Scene scene;
+	CreateScene(&scene, (float)width / height);
+
+	std::vector<XMFLOAT3> reference;
+	std::vector<XMFLOAT3> image;
+	unsigned int referenceSamples = samplesPerPixel * frames * 8;
+	double referenceTime = RenderReference(scene, width, height, referenceSamples, &reference);
+	printf("  reference: %u samples per pixel in %.1f ms\n", referenceSamples, referenceTime);
+
+	CpuRaytracer uniform;
+	uniform.Resize(width, height);
+	uniform.SetSamplesPerPixel(samplesPerPixel);
+
+	CpuRaytracer adaptive;
+	adaptive.Resize(width, height);
+	adaptive.GetSampleBudget().GetSettings().raysPerFrame = width * height * samplesPerPixel;
+
+	unsigned long long uniformRays = 0;
+	unsigned long long adaptiveRays = 0;
+	double uniformTime = 0;
+	double adaptiveTime = 0;
+	double uniformError = 0;
+	double adaptiveError = 0;
+	Clock::time_point start;
+	for (unsigned int frame = 1; frame <= frames; frame++)
+	{
+		start = Clock::now();
+		uniform.Render(scene.snapshot, scene.cameraPosition, scene.view, scene.projection);
+		uniformTime += MillisecondsSince(start);
+		uniformRays += uniform.GetRaysTraced();
+
+		start = Clock::now();
+		adaptive.Render(scene.snapshot, scene.cameraPosition, scene.view, scene.projection);
+		adaptiveTime += MillisecondsSince(start);
+		adaptiveRays += adaptive.GetRaysTraced();
+
+		if ((frame & (frame - 1)) != 0 && frame != frames)
+			continue;
+
+		GetImage(uniform, &image);
+		uniformError = MeanSquaredError(image, reference);
+		GetImage(adaptive, &image);
+		adaptiveError = MeanSquaredError(image, reference);
+		const SampleBudgetStats& stats = adaptive.GetSampleBudget().GetStats();
+		printf("  frame %3u   uniform MSE %.6f (%llu rays, %.1f ms)   adaptive MSE %.6f (%llu rays, %.1f ms)   %.2fx lower, %u tiles converged\n",
+			frame,
+			uniformError, uniformRays, uniformTime,
+			adaptiveError, adaptiveRays, adaptiveTime,
+			adaptiveError > 0 ? uniformError / adaptiveError : 0.0,
+			stats.convergedTiles);
+	}
+
+	// Same rays, so the errors compare directly
+	bool passed = true;
+	passed &= Expect(adaptiveRays <= uniformRays, "adaptive sampling to stay within the uniform ray count");
+	passed &= Expect(adaptiveError < uniformError, "adaptive sampling to end up with a lower error than uniform");
+
+	// Roulette's worth is in how much tracing it saves for the noise it adds
+	printf("  Russian roulette:\n");
+	unsigned long long raysCastWithout = 0;
+	for (int enabled = 0; enabled < 2; enabled++)
+	{
+		CpuRaytracer tracer;
+		tracer.Resize(width, height);
+		tracer.SetSamplesPerPixel(samplesPerPixel);
+		tracer.SetRussianRoulette(enabled != 0);
+
+		unsigned long long raysCast = 0;
+		start = Clock::now();
+		for (unsigned int frame = 0; frame < frames; frame++)
+		{
+			tracer.Render(scene.snapshot, scene.cameraPosition, scene.view, scene.projection);
+			raysCast += tracer.GetRaysCast();
+		}
+		double time = MillisecondsSince(start);
+		GetImage(tracer, &image);
+		double error = MeanSquaredError(image, reference);
+
+		printf("    %-3s  %.1f ms   %llu rays cast (%.2f per path, %.2f Mrays/s)   MSE %.6f   efficiency %.1f\n",
+			enabled ? "on" : "off",
+			time,
+			raysCast,
+			(double)raysCast / ((double)width * height * samplesPerPixel * frames),
+			raysCast / (time * 1000.0),
+			error,
+			error > 0 ? 1.0 / (error * time) : 0.0);
+
+		if (enabled)
+			passed &= Expect(raysCast < raysCastWithout, "Russian roulette to cast fewer rays");
+		else
+			raysCastWithout = raysCast;
+	}
+
+	return passed;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+// Measures how much adaptive sampling helps, without the GPU: traces the
+// benchmark scene (BenchmarkUtils.h) on the CPU with the same number of
+// camera rays per frame spread evenly and by the SampleBudgetAllocator,
+// and compares each image's mean squared error against a much longer
+// uniform render as it converges.  Then does the same with and without
+// Russian roulette, reporting rays per second and efficiency (inverse of
+// error times render time).  Start the program with -benchmark to run it
+// (see HeadlessTests.h); it fails if adaptive sampling ends up no better
+// than uniform, or if roulette doesn't save rays.
+
+namespace SamplingBenchmark
+{
+	/// <summary>
+	/// Runs the benchmark at 160x90, with 4 samples per pixel's worth of rays each frame for 32 frames
+	/// </summary>
+	/// <returns>Whether adaptive sampling and roulette both paid off</returns>
+	bool Run();
+
+	/// <summary>
+	/// Runs the benchmark with a specific image size and budget
+	/// </summary>
+	/// <param name="width">Image width in pixels</param>
+	/// <param name="height">Image height in pixels</param>
+	/// <param name="samplesPerPixel">Rays per frame, as a number of samples for every pixel</param>
+	/// <param name="frames">How many frames to accumulate (the reference gets 8 times as many samples)</param>
+	/// <returns>Whether adaptive sampling and roulette both paid off</returns>
+	bool Run(unsigned int width, unsigned int height, unsigned int samplesPerPixel, unsigned int frames);
+}
@@ -0,0 +1,275 @@
+#include "ScenePicker.h"
+#include "FrameArena.h"
+#include "JobSystem.h"
+#include "Mesh.h"
+
+using namespace DirectX;
+
+ScenePicker::ScenePicker()
+{
+}
+
+
+// --------------------------------------------------------
+// Picks up every entity that changed since the last update
+// (skipping the rest before paying for their matrices)
+// --------------------------------------------------------
+TlasFrameChanges ScenePicker::Update(const std::vector<std::shared_ptr<Entity>>& scene)
+{
+	TlasFrameChanges changes = BeginUpdate((unsigned int)scene.size());
+
+	for (unsigned int i = 0; i < scene.size(); i++)
+	{
+		Entity* entity = scene[i].get();
+		const Instance& instance = instances[i];
+		unsigned int transformVersion = entity->GetTransform()->GetVersion();
+		if (instance.entity == entity && instance.mesh == entity->GetMesh().get() && instance.transformVersion == transformVersion)
+			continue;
+
+		SnapshotInstance source = {};
+		source.entity = entity;
+		source.mesh = entity->GetMesh().get();
+		source.transformVersion = transformVersion;
+		source.worldMatrix = entity->GetTransform()->GetWorldMatrix();
+		source.worldInverseTransposeMatrix = entity->GetTransform()->GetWorldInverseTransposeMatrix();
+		UpdateInstance(i, source, &changes);
+	}
+
+	FinishUpdate(changes);
+	return changes;
+}
+
+// --------------------------------------------------------
+// Same as above, from a snapshot of the scene rather than
+// the live entities
+// --------------------------------------------------------
+TlasFrameChanges ScenePicker::Update(const SceneSnapshot& snapshot)
+{
+	TlasFrameChanges changes = BeginUpdate((unsigned int)snapshot.instances.size());
+
+	for (unsigned int i = 0; i < snapshot.instances.size(); i++)
+	{
+		const SnapshotInstance& source = snapshot.instances[i];
+		const Instance& instance = instances[i];
+		if (instance.entity == source.entity && instance.mesh == source.mesh && instance.transformVersion == source.transformVersion)
+			continue;
+
+		UpdateInstance(i, source, &changes);
+	}
+
+	FinishUpdate(changes);
+	return changes;
+}
+
+// --------------------------------------------------------
+// Moves the pixel's center into clip space and back out
+// through the inverse view-projection, the same way the
+// ray generation shader does
+// --------------------------------------------------------
+Ray ScenePicker::CalculateRayFromCamera(
+	XMFLOAT3 cameraPosition,
+	const XMFLOAT4X4& view,
+	const XMFLOAT4X4& projection,
+	float pixelX, float pixelY,
+	unsigned int width, unsigned int height)
+{
+	float screenX = (pixelX + 0.5f) / width * 2.0f - 1.0f;
+	float screenY = -((pixelY + 0.5f) / height * 2.0f - 1.0f);
+
+	XMMATRIX viewProjection = XMMatrixMultiply(XMLoadFloat4x4(&view), XMLoadFloat4x4(&projection));
+	XMVECTOR worldPosition = XMVector4Transform(XMVectorSet(screenX, screenY, 0, 1), XMMatrixInverse(0, viewProjection));
+	worldPosition /= XMVectorSplatW(worldPosition);
+
+	Ray ray = {};
+	ray.origin = cameraPosition;
+	XMStoreFloat3(&ray.direction, XMVector3Normalize(worldPosition - XMLoadFloat3(&cameraPosition)));
+	ray.maxDistance = PICK_MAX_DISTANCE;
+	return ray;
+}
+
+Ray ScenePicker::CalculateRayFromCamera(Camera* camera, float pixelX, float pixelY, unsigned int width, unsigned int height)
+{
+	return CalculateRayFromCamera(
+		*camera->GetTransform()->GetPosition(),
+		camera->GetViewMatrix(),
+		camera->GetProjectionMatrix(),
+		pixelX, pixelY,
+		width, height);
+}
+
+// --------------------------------------------------------
+// Walks the instance hierarchy front to back, tracing each
+// instance the ray reaches in its own local space.  The ray
+// isn't renormalized there, so distances along it stay in
+// world units and the closest hit can keep shortening it.
+// --------------------------------------------------------
+PickResult ScenePicker::Pick(const Ray& ray) const
+{
+	PickResult result = {};
+	XMVECTOR origin = XMLoadFloat3(&ray.origin);
+	XMVECTOR direction = XMLoadFloat3(&ray.direction);
+
+	auto hitTest = [&](unsigned int primitive, Ray& currentRay)
+	{
+		unsigned int index = hierarchy.GetPrimitive(primitive);
+		TriangleHit triangleHit;
+		if (!RaycastInstance(index, origin, direction, currentRay.maxDistance, &triangleHit))
+			return false;
+
+		currentRay.maxDistance = triangleHit.distance;
+		result.hit = true;
+		result.instance = index;
+		result.entity = instances[index].entity;
+		result.triangle = triangleHit.triangle;
+		result.barycentrics = triangleHit.barycentrics;
+		result.distance = triangleHit.distance;
+		return true;
+	};
+
+	if (hierarchy.Raycast(ray, hitTest))
+		XMStoreFloat3(&result.position, origin + direction * result.distance);
+	return result;
+}
+
+// --------------------------------------------------------
+// Stops at the first triangle found in range, whichever it
+// is, by shrinking the ray to nothing so the walk ends
+// --------------------------------------------------------
+bool ScenePicker::IsOccluded(const Ray& ray) const
+{
+	XMVECTOR origin = XMLoadFloat3(&ray.origin);
+	XMVECTOR direction = XMLoadFloat3(&ray.direction);
+	bool occluded = false;
+
+	auto hitTest = [&](unsigned int primitive, Ray& currentRay)
+	{
+		TriangleHit triangleHit;
+		if (occluded || !RaycastInstance(hierarchy.GetPrimitive(primitive), origin, direction, currentRay.maxDistance, &triangleHit))
+			return false;
+
+		occluded = true;
+		currentRay.maxDistance = -1.0f;
+		return true;
+	};
+
+	hierarchy.Raycast(ray, hitTest);
+	return occluded;
+}
+
+// --------------------------------------------------------
+// Each ray only writes its own result, so batches split
+// cleanly across the job system
+// --------------------------------------------------------
+void ScenePicker::PickBatch(const Ray* rays, unsigned int rayCount, PickResult* results) const
+{
+	JobSystem::GetInstance().ParallelFor(rayCount, 64,
+		[&](unsigned int start, unsigned int end)
+		{
+			for (unsigned int i = start; i < end; i++)
+				results[i] = Pick(rays[i]);
+		});
+}
+
+TlasBuildPolicy& ScenePicker::GetBuildPolicy()
+{
+	return buildPolicy;
+}
+
+unsigned int ScenePicker::GetInstanceCount()
+{
+	return (unsigned int)instances.size();
+}
+
+unsigned int ScenePicker::GetNodeCount()
+{
+	return hierarchy.GetNodeCount();
+}
+
+
+// --------------------------------------------------------
+// Moves a world space ray into one instance's local space
+// and traces its mesh there
+// --------------------------------------------------------
+bool ScenePicker::RaycastInstance(unsigned int index, FXMVECTOR origin, FXMVECTOR direction, float maxDistance, TriangleHit* hit) const
+{
+	const Instance& instance = instances[index];
+	if (!instance.mesh)
+		return false;
+
+	XMMATRIX worldInverse = XMLoadFloat4x4(&instance.worldInverse);
+	Ray localRay = {};
+	XMStoreFloat3(&localRay.origin, XMVector3TransformCoord(origin, worldInverse));
+	XMStoreFloat3(&localRay.direction, XMVector3TransformNormal(direction, worldInverse));
+	localRay.maxDistance = maxDistance;
+	return instance.mesh->GetCpuBVH().Raycast(localRay, hit);
+}
+
+// --------------------------------------------------------
+// Sets up for updating a scene of the given size (new
+// slots start out empty, so they always count as changed)
+// --------------------------------------------------------
+TlasFrameChanges ScenePicker::BeginUpdate(unsigned int instanceCount)
+{
+	TlasFrameChanges changes = {};
+	changes.instanceCount = instanceCount;
+	instances.resize(instanceCount);
+	instanceBounds.resize(instanceCount, Bounds::Empty());
+	return changes;
+}
+
+// --------------------------------------------------------
+// Takes a single changed instance's new matrices and
+// bounds, and records what kind of change it was
+// --------------------------------------------------------
+void ScenePicker::UpdateInstance(unsigned int index, const SnapshotInstance& source, TlasFrameChanges* changes)
+{
+	Instance& instance = instances[index];
+	XMFLOAT3 worldPosition(source.worldMatrix._41, source.worldMatrix._42, source.worldMatrix._43);
+
+	if (instance.entity != source.entity || instance.mesh != source.mesh)
+	{
+		changes->instancesReassigned++;
+	}
+	else
+	{
+		float distance = XMVectorGetX(XMVector3Length(XMLoadFloat3(&worldPosition) - XMLoadFloat3(&instance.worldPosition)));
+		changes->instancesMoved++;
+		changes->totalDisplacement += distance;
+		changes->maxDisplacement = distance > changes->maxDisplacement ? distance : changes->maxDisplacement;
+	}
+
+	instance.entity = source.entity;
+	instance.mesh = source.mesh;
+	instance.transformVersion = source.transformVersion;
+	instance.worldPosition = worldPosition;
+
+	// The transpose of the inverse transpose is just the inverse
+	XMStoreFloat4x4(&instance.worldInverse, XMMatrixTranspose(XMLoadFloat4x4(&source.worldInverseTransposeMatrix)));
+	instanceBounds[index] = source.mesh ? Bounds::Transform(source.mesh->GetLocalBounds(), source.worldMatrix) : Bounds::Empty();
+}
+
+// --------------------------------------------------------
+// Lets the build policy decide how to bring the hierarchy
+// up to date with the new instance bounds.  Rebuilds take
+// their scratch space from the frame arena, so they cost
+// no heap allocations once it's warmed up.
+// --------------------------------------------------------
+void ScenePicker::FinishUpdate(const TlasFrameChanges& changes)
+{
+	switch (buildPolicy.Decide(changes))
+	{
+	case TlasBuildMode::Skip:
+		break;
+
+	case TlasBuildMode::Update:
+		hierarchy.Refit(instanceBounds.data());
+		break;
+
+	case TlasBuildMode::Rebuild:
+	{
+		FrameVector<XMFLOAT3> centroids(instanceBounds.size());
+		hierarchy.Build(instanceBounds.data(), (unsigned int)instanceBounds.size(), 2, centroids.data());
+		break;
+	}
+	}
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+// Ray picking against the scene entirely on the CPU, so tools can ask
+// "what's under the mouse?" without reading anything back from the GPU.
+//
+// Mirrors the DXR setup: a BoundingVolumeHierarchy over the instances'
+// world space bounds plays the TLAS, and each mesh's MeshBVH plays its
+// BLAS (rays are moved into the instance's local space to trace it).
+// It's fed the same scene (or snapshot) as the GPU TLAS each frame, so
+// picks match what's on screen, and uses its own TlasBuildPolicy to
+// decide between refitting and rebuilding.  Rebuilds borrow scratch
+// space from the FrameArena, so only update it from the thread that
+// resets the arena (the render thread).
+
+#include <DirectXMath.h>
+#include <memory>
+#include <vector>
+
+#include "BoundingVolumeHierarchy.h"
+#include "Camera.h"
+#include "Entity.h"
+#include "SceneSnapshot.h"
+#include "TlasBuildPolicy.h"
+
+// Furthest a pick ray reaches (matches the TMax the raytracing shaders use)
+#define PICK_MAX_DISTANCE 1000.0f
+
+// What a pick ray hit
+struct PickResult
+{
+	bool hit;
+	unsigned int instance;				// Index into the scene (or snapshot) the picker was last updated with
+	const Entity* entity;				// Identifies the entity - don't dereference it if another thread owns the scene
+	unsigned int triangle;				// Triangle within the entity's mesh
+	DirectX::XMFLOAT2 barycentrics;		// Weights of the triangle's second and third vertices, like DXR's
+	float distance;						// World space distance from the ray's origin
+	DirectX::XMFLOAT3 position;			// World space hit point
+};
+
+class ScenePicker
+{
+public:
+	ScenePicker();
+
+	/// <summary>
+	/// Catches up with the scene, refitting or rebuilding the instance hierarchy as needed
+	/// </summary>
+	/// <param name="scene">Entities to pick from (must be owned by the calling thread)</param>
+	/// <returns>What changed since the last update</returns>
+	TlasFrameChanges Update(const std::vector<std::shared_ptr<Entity>>& scene);
+
+	/// <summary>
+	/// Same as above, from a snapshot of the scene
+	/// </summary>
+	TlasFrameChanges Update(const SceneSnapshot& snapshot);
+
+	/// <summary>
+	/// Builds the ray through a pixel, exactly as CalcRayFromCamera() in Raytracing.hlsl does
+	/// </summary>
+	/// <param name="cameraPosition">Where the camera is</param>
+	/// <param name="view">Camera's view matrix</param>
+	/// <param name="projection">Camera's projection matrix</param>
+	/// <param name="pixelX">Pixel column (0 is the left edge; the ray goes through the pixel's center)</param>
+	/// <param name="pixelY">Pixel row (0 is the top edge)</param>
+	/// <param name="width">Width of the screen in pixels</param>
+	/// <param name="height">Height of the screen in pixels</param>
+	static Ray CalculateRayFromCamera(
+		DirectX::XMFLOAT3 cameraPosition,
+		const DirectX::XMFLOAT4X4& view,
+		const DirectX::XMFLOAT4X4& projection,
+		float pixelX, float pixelY,
+		unsigned int width, unsigned int height);
+
+	/// <summary>
+	/// Same as above, from a camera (which must be owned by the calling thread)
+	/// </summary>
+	static Ray CalculateRayFromCamera(Camera* camera, float pixelX, float pixelY, unsigned int width, unsigned int height);
+
+	/// <summary>
+	/// Finds the closest triangle the ray hits
+	/// </summary>
+	/// <param name="ray">World space ray (from CalculateRayFromCamera(), or anywhere else)</param>
+	/// <returns>What was hit - check result.hit first</returns>
+	PickResult Pick(const Ray& ray) const;
+
+	/// <summary>
+	/// Whether the ray hits anything at all before its max distance (cheaper than Pick(), as any hit will do)
+	/// </summary>
+	/// <param name="ray">World space ray</param>
+	bool IsOccluded(const Ray& ray) const;
+
+	/// <summary>
+	/// Picks with many rays at once, spread across the job system
+	/// </summary>
+	/// <param name="rays">World space rays</param>
+	/// <param name="rayCount">How many rays there are</param>
+	/// <param name="results">Filled in with one result per ray</param>
+	void PickBatch(const Ray* rays, unsigned int rayCount, PickResult* results) const;
+
+	TlasBuildPolicy& GetBuildPolicy();
+	unsigned int GetInstanceCount();
+	unsigned int GetNodeCount();
+
+private:
+	// What each instance was last updated from
+	struct Instance
+	{
+		const Entity* entity;
+		Mesh* mesh;
+		unsigned int transformVersion;
+		DirectX::XMFLOAT4X4 worldInverse;	// Takes rays into the mesh's local space
+		DirectX::XMFLOAT3 worldPosition;	// For measuring how far it moves
+	};
+
+	std::vector<Instance> instances;
+	std::vector<AABB> instanceBounds;		// World space, indexed like instances
+	BoundingVolumeHierarchy hierarchy;
+	TlasBuildPolicy buildPolicy;
+
+	bool RaycastInstance(unsigned int index, DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, float maxDistance, TriangleHit* hit) const;
+	TlasFrameChanges BeginUpdate(unsigned int instanceCount);
+	void UpdateInstance(unsigned int index, const SnapshotInstance& source, TlasFrameChanges* changes);
+	void FinishUpdate(const TlasFrameChanges& changes);
+};
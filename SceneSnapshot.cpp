@@ -0,0 +1,88 @@
+#include "SceneSnapshot.h"
+#include "TransformKernels.h"
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Interpolates every instance that moved between the two
+// snapshots, and copies everything else from the newer one
+// --------------------------------------------------------
+const SceneSnapshot& SnapshotInterpolator::Interpolate(const SceneSnapshot& previous, const SceneSnapshot& current, float alpha)
+{
+	alpha = alpha < 0.0f ? 0.0f : (alpha > 1.0f ? 1.0f : alpha);
+
+	result.tick = current.tick;
+	result.time = previous.time + (current.time - previous.time) * alpha;
+
+	// Only reallocates if the scene grows
+	size_t oldCount = result.instances.size();
+	result.instances.resize(current.instances.size());
+	sources.resize(current.instances.size());
+	for (size_t i = oldCount; i < result.instances.size(); i++)
+	{
+		result.instances[i] = {};
+		sources[i] = {};
+	}
+
+	for (size_t i = 0; i < current.instances.size(); i++)
+	{
+		const SnapshotInstance& to = current.instances[i];
+		SnapshotInstance& out = result.instances[i];
+		InstanceSource& source = sources[i];
+
+		bool moved =
+			alpha < 1.0f &&
+			i < previous.instances.size() &&
+			previous.instances[i].entity == to.entity &&
+			previous.instances[i].transformVersion != to.transformVersion;
+
+		if (moved)
+		{
+			// Split both matrices back up so rotations can be blended properly
+			XMVECTOR fromScale, fromRotation, fromPosition;
+			XMVECTOR toScale, toRotation, toPosition;
+			XMMatrixDecompose(&fromScale, &fromRotation, &fromPosition, XMLoadFloat4x4(&previous.instances[i].worldMatrix));
+			XMMatrixDecompose(&toScale, &toRotation, &toPosition, XMLoadFloat4x4(&to.worldMatrix));
+
+			XMFLOAT3 position, scale;
+			XMFLOAT4 rotation;
+			XMStoreFloat3(&position, XMVectorLerp(fromPosition, toPosition, alpha));
+			XMStoreFloat4(&rotation, XMQuaternionSlerp(fromRotation, toRotation, alpha));
+			XMStoreFloat3(&scale, XMVectorLerp(fromScale, toScale, alpha));
+
+			TransformKernels::CalculateMatrices(position, rotation, scale, &out.worldMatrix, &out.worldInverseTransposeMatrix);
+			out.transformVersion++;
+		}
+		else if (out.entity != to.entity || source.interpolated || source.transformVersion != to.transformVersion)
+		{
+			// Settled (or new), so use the real thing
+			out.worldMatrix = to.worldMatrix;
+			out.worldInverseTransposeMatrix = to.worldInverseTransposeMatrix;
+			out.transformVersion++;
+		}
+
+		out.entity = to.entity;
+		out.mesh = to.mesh;
+		out.material = to.material;
+		source.transformVersion = to.transformVersion;
+		source.interpolated = moved;
+	}
+
+	// Camera
+	if (alpha < 1.0f)
+	{
+		XMStoreFloat3(&result.camera.position, XMVectorLerp(XMLoadFloat3(&previous.camera.position), XMLoadFloat3(&current.camera.position), alpha));
+		XMStoreFloat4(&result.camera.rotation, XMQuaternionSlerp(XMLoadFloat4(&previous.camera.rotation), XMLoadFloat4(&current.camera.rotation), alpha));
+	}
+	else
+	{
+		result.camera = current.camera;
+	}
+
+	// Lights don't move often enough to be worth blending
+	result.lightCount = current.lightCount;
+	for (unsigned int i = 0; i < current.lightCount; i++)
+		result.lights[i] = current.lights[i];
+
+	return result;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+// An immutable copy of everything the renderer needs from the simulation
+// (entity matrices, the camera and lights) at a single simulation tick.
+// The simulation thread fills these in and publishes them through a
+// TripleBuffer; the renderer only ever reads them, so it never touches
+// the TransformSystem, entities or camera while the simulation runs.
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "Lights.h"
+
+class Entity;
+class Mesh;
+class Material;
+
+// Matches the size of the lights array the shaders receive
+#define SNAPSHOT_MAX_LIGHTS 5
+
+// A single entity, as the simulation left it
+struct SnapshotInstance
+{
+	const Entity* entity;				// Identifies the entity only - never dereferenced by the renderer
+	Mesh* mesh;							// Meshes and materials outlive the simulation
+	Material* material;
+	unsigned int transformVersion;		// Changes whenever the matrices do
+	DirectX::XMFLOAT4X4 worldMatrix;
+	DirectX::XMFLOAT4X4 worldInverseTransposeMatrix;
+};
+
+struct SnapshotCamera
+{
+	DirectX::XMFLOAT3 position;
+	DirectX::XMFLOAT4 rotation;
+};
+
+struct SceneSnapshot
+{
+	unsigned long long tick;	// Which simulation tick this is
+	double time;				// When it was due, in SimulationThread::GetTime() seconds
+
+	std::vector<SnapshotInstance> instances;
+	SnapshotCamera camera;
+	Light lights[SNAPSHOT_MAX_LIGHTS];
+	unsigned int lightCount;
+};
+
+// Blends the two most recent snapshots together so motion stays smooth
+// when the renderer runs at a different rate than the simulation.
+// Keeps its own per-instance transform versions, which change only
+// when an interpolated matrix actually does (so unchanged instances
+// still aren't repacked into the TLAS).
+class SnapshotInterpolator
+{
+public:
+	/// <summary>
+	/// Blends two consecutive snapshots.  Instances are matched by index, and anything
+	/// that isn't the same entity in both is taken straight from the current snapshot.
+	/// </summary>
+	/// <param name="previous">The older snapshot</param>
+	/// <param name="current">The newer snapshot</param>
+	/// <param name="alpha">How far from previous (0) to current (1)</param>
+	/// <returns>The blended snapshot, valid until the next call</returns>
+	const SceneSnapshot& Interpolate(const SceneSnapshot& previous, const SceneSnapshot& current, float alpha);
+
+private:
+	// What each instance of the result was last made from
+	struct InstanceSource
+	{
+		unsigned int transformVersion;
+		bool interpolated;
+	};
+
+	SceneSnapshot result;
+	std::vector<InstanceSource> sources;
+};
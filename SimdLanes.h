@@ -0,0 +1,84 @@
+#pragma once
+
+// Thin wrappers over SIMD intrinsics so batched kernels (one item per
+// lane, structure-of-arrays data) are written once for either lane
+// width: eight lanes with AVX2 (when compiled with /arch:AVX2), four
+// with SSE otherwise.  Loads and stores expect LaneCount * 4 byte
+// alignment - use alignas(32) on batch structures (the unaligned
+// versions are for images, read at arbitrary offsets by filters).
+
+#include <immintrin.h>
+
+namespace SimdLanes
+{
+#if defined(__AVX2__)
+	typedef __m256 Lanes;
+	const unsigned int LaneCount = 8;
+	inline Lanes Load(const float* p) { return _mm256_load_ps(p); }
+	inline Lanes LoadUnaligned(const float* p) { return _mm256_loadu_ps(p); }
+	inline void Store(float* p, Lanes v) { _mm256_store_ps(p, v); }
+	inline void StoreUnaligned(float* p, Lanes v) { _mm256_storeu_ps(p, v); }
+	inline Lanes Splat(float f) { return _mm256_set1_ps(f); }
+	inline Lanes Add(Lanes a, Lanes b) { return _mm256_add_ps(a, b); }
+	inline Lanes Sub(Lanes a, Lanes b) { return _mm256_sub_ps(a, b); }
+	inline Lanes Mul(Lanes a, Lanes b) { return _mm256_mul_ps(a, b); }
+	inline Lanes Div(Lanes a, Lanes b) { return _mm256_div_ps(a, b); }
+	inline Lanes Sqrt(Lanes a) { return _mm256_sqrt_ps(a); }
+	inline Lanes Min(Lanes a, Lanes b) { return _mm256_min_ps(a, b); }
+	inline Lanes Max(Lanes a, Lanes b) { return _mm256_max_ps(a, b); }
+	inline Lanes Or(Lanes a, Lanes b) { return _mm256_or_ps(a, b); }
+	inline Lanes And(Lanes a, Lanes b) { return _mm256_and_ps(a, b); }
+	inline Lanes Select(Lanes a, Lanes b, Lanes mask) { return _mm256_blendv_ps(a, b, mask); } // b where the mask's lane is set, a elsewhere
+	inline Lanes Abs(Lanes a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+	inline Lanes Less(Lanes a, Lanes b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+	inline unsigned int Mask(Lanes v) { return (unsigned int)_mm256_movemask_ps(v); } // One bit per lane, set where the lane's sign bit is
+	inline Lanes Round(Lanes a) { return _mm256_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+	inline Lanes Exp2Integer(Lanes n) { return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23)); }
+#else
+	typedef __m128 Lanes;
+	const unsigned int LaneCount = 4;
+	inline Lanes Load(const float* p) { return _mm_load_ps(p); }
+	inline Lanes LoadUnaligned(const float* p) { return _mm_loadu_ps(p); }
+	inline void Store(float* p, Lanes v) { _mm_store_ps(p, v); }
+	inline void StoreUnaligned(float* p, Lanes v) { _mm_storeu_ps(p, v); }
+	inline Lanes Splat(float f) { return _mm_set1_ps(f); }
+	inline Lanes Add(Lanes a, Lanes b) { return _mm_add_ps(a, b); }
+	inline Lanes Sub(Lanes a, Lanes b) { return _mm_sub_ps(a, b); }
+	inline Lanes Mul(Lanes a, Lanes b) { return _mm_mul_ps(a, b); }
+	inline Lanes Div(Lanes a, Lanes b) { return _mm_div_ps(a, b); }
+	inline Lanes Sqrt(Lanes a) { return _mm_sqrt_ps(a); }
+	inline Lanes Min(Lanes a, Lanes b) { return _mm_min_ps(a, b); }
+	inline Lanes Max(Lanes a, Lanes b) { return _mm_max_ps(a, b); }
+	inline Lanes Or(Lanes a, Lanes b) { return _mm_or_ps(a, b); }
+	inline Lanes And(Lanes a, Lanes b) { return _mm_and_ps(a, b); }
+	inline Lanes Select(Lanes a, Lanes b, Lanes mask) { return _mm_or_ps(_mm_and_ps(mask, b), _mm_andnot_ps(mask, a)); } // Masks from comparisons only
+	inline Lanes Abs(Lanes a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+	inline Lanes Less(Lanes a, Lanes b) { return _mm_cmplt_ps(a, b); }
+	inline unsigned int Mask(Lanes v) { return (unsigned int)_mm_movemask_ps(v); }
+	inline Lanes Round(Lanes a) { return _mm_cvtepi32_ps(_mm_cvtps_epi32(a)); } // Only for values an int can hold
+	inline Lanes Exp2Integer(Lanes n) { return _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(_mm_cvtps_epi32(n), _mm_set1_epi32(127)), 23)); }
+#endif
+
+	// --------------------------------------------------------
+	// e^x, to about 1e-5 relative error (x is clamped to
+	// [-87, 87], so the result never overflows or goes denormal)
+	// --------------------------------------------------------
+	inline Lanes Exp(Lanes x)
+	{
+		// 2^(x log2 e), split into an integer power (built straight into
+		// the float's exponent) and a fraction in [-0.5, 0.5]
+		x = Max(Min(x, Splat(87.0f)), Splat(-87.0f));
+		Lanes t = Mul(x, Splat(1.44269504f));
+		Lanes n = Round(t);
+		Lanes f = Sub(t, n);
+
+		// 2^f by its Taylor series in f ln 2
+		Lanes p = Splat(1.33335581e-3f);
+		p = Add(Mul(p, f), Splat(9.61812911e-3f));
+		p = Add(Mul(p, f), Splat(5.55041087e-2f));
+		p = Add(Mul(p, f), Splat(2.40226507e-1f));
+		p = Add(Mul(p, f), Splat(6.93147181e-1f));
+		p = Add(Mul(p, f), Splat(1.0f));
+		return Mul(p, Exp2Integer(n));
+	}
+}
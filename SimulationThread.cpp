@@ -0,0 +1,148 @@
+#include "SimulationThread.h"
+#include "AllocationTracker.h"
+
+SimulationThread::SimulationThread(float ticksPerSecond, TickFunction tick, CaptureFunction capture) :
+	tick(tick),
+	capture(capture),
+	tickSeconds(1.0f / ticksPerSecond),
+	running(false),
+	startTime(std::chrono::steady_clock::now()),
+	tickCount(0),
+	lastTickTime(0),
+	skippedTickCount(0),
+	pendingControls()
+{
+}
+
+SimulationThread::~SimulationThread()
+{
+	Stop();
+}
+
+// --------------------------------------------------------
+// Publishes the starting state and kicks off the thread
+// --------------------------------------------------------
+void SimulationThread::Start()
+{
+	if (running)
+		return;
+
+	// Done here, rather than on the thread, so the renderer
+	// has something to draw from the very first frame
+	lastTickTime = GetTime();
+	Publish();
+
+	running = true;
+	thread = std::thread(&SimulationThread::Run, this);
+}
+
+void SimulationThread::Stop()
+{
+	running = false;
+	if (thread.joinable())
+		thread.join();
+}
+
+// --------------------------------------------------------
+// Merges the latest controls into the ones waiting for
+// the next tick
+// --------------------------------------------------------
+void SimulationThread::SubmitControls(const CameraControls& controls)
+{
+	std::lock_guard<std::mutex> lock(controlsMutex);
+
+	// Buttons are whatever they are right now, but mouse movement adds up
+	int lookX = pendingControls.lookX + controls.lookX;
+	int lookY = pendingControls.lookY + controls.lookY;
+	pendingControls = controls;
+	pendingControls.lookX = lookX;
+	pendingControls.lookY = lookY;
+}
+
+bool SimulationThread::HasNewSnapshot()
+{
+	return snapshots.HasUpdate();
+}
+
+bool SimulationThread::AcquireLatestSnapshot()
+{
+	return snapshots.Acquire();
+}
+
+const SceneSnapshot& SimulationThread::GetLatestSnapshot()
+{
+	return snapshots.GetReadBuffer();
+}
+
+double SimulationThread::GetTime()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+float SimulationThread::GetTickSeconds() { return tickSeconds; }
+unsigned long long SimulationThread::GetTicksRun() { return tickCount; }
+unsigned long long SimulationThread::GetTicksSkipped() { return skippedTickCount; }
+
+
+// --------------------------------------------------------
+// The simulation loop: runs however many fixed ticks are
+// due, publishes the result and sleeps until the next one
+// --------------------------------------------------------
+void SimulationThread::Run()
+{
+	AllocationScope allocationScope(AllocationTag::Update);
+
+	double nextTickTime = lastTickTime + tickSeconds;
+	while (running)
+	{
+		double now = GetTime();
+		if (now < nextTickTime)
+		{
+			std::this_thread::sleep_for(std::chrono::duration<double>(nextTickTime - now));
+			continue;
+		}
+
+		// Catch up on every tick that's due, within reason
+		unsigned int ticksRun = 0;
+		while (now >= nextTickTime && ticksRun < MaxCatchUpTicks)
+		{
+			CameraControls controls;
+			{
+				std::lock_guard<std::mutex> lock(controlsMutex);
+				controls = pendingControls;
+				pendingControls.lookX = 0;
+				pendingControls.lookY = 0;
+			}
+
+			tickCount++;
+			tick(tickSeconds, tickCount * tickSeconds, controls);
+
+			lastTickTime = nextTickTime;
+			nextTickTime += tickSeconds;
+			ticksRun++;
+		}
+
+		// Too far behind to ever catch up?  Drop the missed time rather
+		// than spiralling (the simulation just runs slow for a moment)
+		if (now >= nextTickTime)
+		{
+			skippedTickCount += (unsigned long long)((now - nextTickTime) / tickSeconds) + 1;
+			lastTickTime = now;
+			nextTickTime = now + tickSeconds;
+		}
+
+		Publish();
+	}
+}
+
+// --------------------------------------------------------
+// Captures the current state and hands it to the renderer
+// --------------------------------------------------------
+void SimulationThread::Publish()
+{
+	SceneSnapshot& snapshot = snapshots.GetWriteBuffer();
+	capture(snapshot);
+	snapshot.tick = tickCount;
+	snapshot.time = lastTickTime;
+	snapshots.Publish();
+}
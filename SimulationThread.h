@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "Camera.h"
+#include "SceneSnapshot.h"
+#include "TripleBuffer.h"
+
+// Runs the simulation on its own thread at a fixed tick rate, so slow
+// frames don't slow the simulation down (or vice versa).
+//
+// After each batch of ticks the scene is captured into a SceneSnapshot
+// and published through a lock-free TripleBuffer; the renderer grabs
+// the newest one whenever it's ready to draw, and can blend it with the
+// one before (see SnapshotInterpolator).  While this is running, the
+// simulation owns the TransformSystem, the entities and the camera's
+// transform - everything else should only look at snapshots.
+//
+// Input is handed over the other way: the main thread submits camera
+// controls as often as it likes, and mouse movement accumulates until a
+// tick uses it.
+class SimulationThread
+{
+public:
+	// Advances the simulation by a single tick
+	typedef std::function<void(float tickSeconds, float totalTime, const CameraControls& controls)> TickFunction;
+
+	// Copies the current state of the simulation into a snapshot (reusing its memory)
+	typedef std::function<void(SceneSnapshot& snapshot)> CaptureFunction;
+
+	SimulationThread(float ticksPerSecond, TickFunction tick, CaptureFunction capture);
+	~SimulationThread();
+
+	SimulationThread(SimulationThread const&) = delete;
+	void operator=(SimulationThread const&) = delete;
+
+	/// <summary>
+	/// Publishes a snapshot of the starting state (so there's always one to draw) and starts ticking
+	/// </summary>
+	void Start();
+
+	/// <summary>
+	/// Waits for the current tick to finish and stops the thread
+	/// </summary>
+	void Stop();
+
+	/// <summary>
+	/// Hands the latest state of the controls to the simulation.  Mouse movement
+	/// is added up until the next tick, so none is lost between ticks.
+	/// </summary>
+	void SubmitControls(const CameraControls& controls);
+
+	/// <summary>
+	/// Renderer only: has a snapshot been published since the last AcquireLatestSnapshot()?
+	/// (Handy for holding on to a copy of the current one before it's swapped out)
+	/// </summary>
+	bool HasNewSnapshot();
+
+	/// <summary>
+	/// Renderer only: swaps in the newest snapshot, if one has been published since the last call
+	/// </summary>
+	/// <returns>True if the latest snapshot changed</returns>
+	bool AcquireLatestSnapshot();
+	const SceneSnapshot& GetLatestSnapshot();
+
+	double GetTime(); // Seconds since this was created - the clock snapshot times are measured on
+	float GetTickSeconds();
+	unsigned long long GetTicksRun();
+	unsigned long long GetTicksSkipped(); // Ticks dropped because the simulation couldn't keep up
+
+private:
+	// Most ticks that will be run to catch up before giving up on the missed time
+	static const unsigned int MaxCatchUpTicks = 5;
+
+	void Run();
+	void Publish();
+
+	TickFunction tick;
+	CaptureFunction capture;
+	float tickSeconds;
+
+	std::thread thread;
+	std::atomic<bool> running;
+	std::chrono::steady_clock::time_point startTime;
+
+	std::atomic<unsigned long long> tickCount;
+	double lastTickTime; // When the most recent tick was due (only touched by the simulation)
+	std::atomic<unsigned long long> skippedTickCount;
+
+	TripleBuffer<SceneSnapshot> snapshots;
+
+	// Controls waiting to be used by the next tick
+	std::mutex controlsMutex;
+	CameraControls pendingControls;
+};
@@ -0,0 +1,353 @@
+#include "SpatialIndex.h"
+
+#include <cmath>
+
+using namespace DirectX;
+
+SpatialIndex::SpatialIndex(XMFLOAT3 worldCenter, float worldHalfSize, unsigned int maxDepth) :
+	maxDepth(maxDepth),
+	itemCount(0)
+{
+	Node root = {};
+	root.center = worldCenter;
+	root.halfSize = worldHalfSize;
+	root.depth = 0;
+	root.parent = SPATIAL_NO_INDEX;
+	for (unsigned int& child : root.children)
+		child = SPATIAL_NO_INDEX;
+	root.firstItem = SPATIAL_NO_INDEX;
+	root.subtreeItemCount = 0;
+	nodes.push_back(root);
+}
+
+// --------------------------------------------------------
+// Adds an item, reusing a removed item's slot if possible
+// --------------------------------------------------------
+unsigned int SpatialIndex::Insert(const AABB& bounds, unsigned int userData)
+{
+	unsigned int item;
+	if (!freeItems.empty())
+	{
+		item = freeItems.back();
+		freeItems.pop_back();
+	}
+	else
+	{
+		item = (unsigned int)items.size();
+		items.emplace_back();
+	}
+
+	Item& newItem = items[item];
+	newItem.bounds = bounds;
+	newItem.userData = userData;
+	newItem.transform.index = TRANSFORM_NO_INDEX;
+	newItem.transform.generation = 0;
+	newItem.localBounds = bounds;
+	newItem.transformVersion = 0;
+
+	Link(item, FindNode(bounds));
+	itemCount++;
+	return item;
+}
+
+unsigned int SpatialIndex::InsertTracked(TransformHandle transform, const AABB& localBounds, unsigned int userData)
+{
+	TransformSystem& transformSystem = TransformSystem::GetInstance();
+	transformSystem.UpdateMatrices(transform.index);
+
+	unsigned int item = Insert(Bounds::Transform(localBounds, transformSystem.GetWorldMatrices()[transform.index]), userData);
+	items[item].transform = transform;
+	items[item].localBounds = localBounds;
+	items[item].transformVersion = transformSystem.GetVersions()[transform.index];
+	return item;
+}
+
+// --------------------------------------------------------
+// Updates an item's bounds, only changing nodes if it no
+// longer belongs where it is
+// --------------------------------------------------------
+void SpatialIndex::Move(unsigned int item, const AABB& bounds)
+{
+	items[item].bounds = bounds;
+	if (BelongsInNode(items[item].node, bounds))
+		return;
+
+	Unlink(item);
+	Link(item, FindNode(bounds));
+}
+
+void SpatialIndex::Remove(unsigned int item)
+{
+	if (item >= items.size() || items[item].node == SPATIAL_NO_INDEX)
+		return;
+
+	Unlink(item);
+	freeItems.push_back(item);
+	itemCount--;
+}
+
+// --------------------------------------------------------
+// A single pass over every item, moving those whose
+// transforms changed (including through their parents)
+// --------------------------------------------------------
+unsigned int SpatialIndex::SyncWithTransforms()
+{
+	TransformSystem& transformSystem = TransformSystem::GetInstance();
+	const unsigned int* versions = transformSystem.GetVersions();
+	const unsigned char* flags = transformSystem.GetFlags();
+	const XMFLOAT4X4* worldMatrices = transformSystem.GetWorldMatrices();
+
+	unsigned int moved = 0;
+	for (unsigned int i = 0; i < items.size(); i++)
+	{
+		Item& item = items[i];
+		if (item.node == SPATIAL_NO_INDEX || item.transform.index == TRANSFORM_NO_INDEX)
+			continue;
+
+		unsigned int index = item.transform.index;
+		if (versions[index] == item.transformVersion || !transformSystem.IsValid(item.transform))
+			continue;
+
+		// Anything not caught by the last batch update
+		if (flags[index] & TransformFlag_MatricesDirty)
+			transformSystem.UpdateMatrices(index);
+
+		Move(i, Bounds::Transform(item.localBounds, worldMatrices[index]));
+		item.transformVersion = versions[index];
+		moved++;
+	}
+
+	return moved;
+}
+
+
+// --------------------------------------------------------
+// Queries
+// --------------------------------------------------------
+void SpatialIndex::QueryAABB(const AABB& box, std::vector<unsigned int>& results)
+{
+	results.clear();
+	Traverse(
+		[&](const AABB& nodeBounds) { return Bounds::Overlaps(nodeBounds, box); },
+		[&](const Item& item) { if (Bounds::Overlaps(item.bounds, box)) results.push_back(item.userData); });
+}
+
+void SpatialIndex::QuerySphere(XMFLOAT3 center, float radius, std::vector<unsigned int>& results)
+{
+	results.clear();
+	Traverse(
+		[&](const AABB& nodeBounds) { return Bounds::OverlapsSphere(nodeBounds, center, radius); },
+		[&](const Item& item) { if (Bounds::OverlapsSphere(item.bounds, center, radius)) results.push_back(item.userData); });
+}
+
+void SpatialIndex::QueryFrustum(const Frustum& frustum, std::vector<unsigned int>& results)
+{
+	results.clear();
+	Traverse(
+		[&](const AABB& nodeBounds) { return Bounds::OverlapsFrustum(nodeBounds, frustum); },
+		[&](const Item& item) { if (Bounds::OverlapsFrustum(item.bounds, frustum)) results.push_back(item.userData); });
+}
+
+void SpatialIndex::QueryRay(const Ray& ray, std::vector<unsigned int>& results)
+{
+	results.clear();
+	Traverse(
+		[&](const AABB& nodeBounds) { return Bounds::IntersectsRay(nodeBounds, ray, 0); },
+		[&](const Item& item) { if (Bounds::IntersectsRay(item.bounds, ray, 0)) results.push_back(item.userData); });
+}
+
+bool SpatialIndex::Raycast(const Ray& ray, unsigned int* userData, float* distance)
+{
+	// Shorten the ray as hits are found, so anything further away gets skipped
+	Ray shortened = ray;
+	bool hit = false;
+	Traverse(
+		[&](const AABB& nodeBounds) { return Bounds::IntersectsRay(nodeBounds, shortened, 0); },
+		[&](const Item& item)
+		{
+			float itemDistance;
+			if (Bounds::IntersectsRay(item.bounds, shortened, &itemDistance))
+			{
+				hit = true;
+				shortened.maxDistance = itemDistance;
+				if (userData) *userData = item.userData;
+			}
+		});
+
+	if (hit && distance)
+		*distance = shortened.maxDistance;
+	return hit;
+}
+
+const AABB& SpatialIndex::GetBounds(unsigned int item) { return items[item].bounds; }
+unsigned int SpatialIndex::GetItemCount() { return itemCount; }
+unsigned int SpatialIndex::GetNodeCount() { return (unsigned int)nodes.size(); }
+
+
+// --------------------------------------------------------
+// Depth-first walk over every non-empty node whose loose
+// bounds pass the node test (the root always does, since
+// it also holds anything outside the world region)
+// --------------------------------------------------------
+template<typename NodeTest, typename ItemVisitor>
+void SpatialIndex::Traverse(NodeTest nodeTest, ItemVisitor visitItem)
+{
+	traversalStack.clear();
+	traversalStack.push_back(0);
+
+	while (!traversalStack.empty())
+	{
+		unsigned int nodeIndex = traversalStack.back();
+		traversalStack.pop_back();
+
+		const Node& node = nodes[nodeIndex];
+		if (node.subtreeItemCount == 0)
+			continue;
+		if (nodeIndex != 0 && !nodeTest(GetLooseBounds(nodeIndex)))
+			continue;
+
+		for (unsigned int item = node.firstItem; item != SPATIAL_NO_INDEX; item = items[item].next)
+			visitItem(items[item]);
+
+		for (unsigned int child : node.children)
+		{
+			if (child != SPATIAL_NO_INDEX)
+				traversalStack.push_back(child);
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Creates one of a node's children
+// --------------------------------------------------------
+unsigned int SpatialIndex::CreateNode(unsigned int parent, unsigned int octant)
+{
+	Node child = {};
+	child.halfSize = nodes[parent].halfSize * 0.5f;
+	child.center = nodes[parent].center;
+	child.center.x += (octant & 1) ? child.halfSize : -child.halfSize;
+	child.center.y += (octant & 2) ? child.halfSize : -child.halfSize;
+	child.center.z += (octant & 4) ? child.halfSize : -child.halfSize;
+	child.depth = nodes[parent].depth + 1;
+	child.parent = parent;
+	for (unsigned int& grandchild : child.children)
+		grandchild = SPATIAL_NO_INDEX;
+	child.firstItem = SPATIAL_NO_INDEX;
+	child.subtreeItemCount = 0;
+
+	unsigned int index = (unsigned int)nodes.size();
+	nodes.push_back(child); // Note: Invalidates references into nodes
+	nodes[parent].children[octant] = index;
+	return index;
+}
+
+// --------------------------------------------------------
+// Walks down from the root, following the item's center,
+// until the children would be too small for it (creating
+// nodes along the way as needed)
+// --------------------------------------------------------
+unsigned int SpatialIndex::FindNode(const AABB& bounds)
+{
+	XMFLOAT3 center = Bounds::GetCenter(bounds);
+	XMFLOAT3 halfExtents = Bounds::GetHalfExtents(bounds);
+	float largestHalfExtent = fmaxf(halfExtents.x, fmaxf(halfExtents.y, halfExtents.z));
+
+	// Outside the world region entirely?  Keep it in the root.
+	const Node& root = nodes[0];
+	if (fabsf(center.x - root.center.x) > root.halfSize ||
+		fabsf(center.y - root.center.y) > root.halfSize ||
+		fabsf(center.z - root.center.z) > root.halfSize)
+		return 0;
+
+	// A child's loose bounds reach one child-width out from its
+	// cell, so anything no bigger than that fits inside them
+	unsigned int node = 0;
+	while (nodes[node].depth < maxDepth && largestHalfExtent <= nodes[node].halfSize * 0.5f)
+	{
+		const XMFLOAT3& nodeCenter = nodes[node].center;
+		unsigned int octant =
+			(center.x >= nodeCenter.x ? 1 : 0) |
+			(center.y >= nodeCenter.y ? 2 : 0) |
+			(center.z >= nodeCenter.z ? 4 : 0);
+
+		unsigned int child = nodes[node].children[octant];
+		if (child == SPATIAL_NO_INDEX)
+			child = CreateNode(node, octant);
+		node = child;
+	}
+
+	return node;
+}
+
+// --------------------------------------------------------
+// Would FindNode() put something with these bounds in this
+// node?  (Answered without walking down from the root.)
+// --------------------------------------------------------
+bool SpatialIndex::BelongsInNode(unsigned int nodeIndex, const AABB& bounds)
+{
+	const Node& node = nodes[nodeIndex];
+	XMFLOAT3 center = Bounds::GetCenter(bounds);
+	XMFLOAT3 halfExtents = Bounds::GetHalfExtents(bounds);
+	float largestHalfExtent = fmaxf(halfExtents.x, fmaxf(halfExtents.y, halfExtents.z));
+
+	bool insideCell =
+		fabsf(center.x - node.center.x) <= node.halfSize &&
+		fabsf(center.y - node.center.y) <= node.halfSize &&
+		fabsf(center.z - node.center.z) <= node.halfSize;
+
+	// The root takes everything outside the world region
+	if (nodeIndex == 0 && !insideCell)
+		return true;
+
+	// Needs to fit here, but be too big for any child
+	bool fitsHere = nodeIndex == 0 || largestHalfExtent <= node.halfSize;
+	bool fitsChild = node.depth < maxDepth && largestHalfExtent <= node.halfSize * 0.5f;
+	return insideCell && fitsHere && !fitsChild;
+}
+
+AABB SpatialIndex::GetLooseBounds(unsigned int nodeIndex)
+{
+	const Node& node = nodes[nodeIndex];
+	float looseHalfSize = node.halfSize * 2.0f;
+
+	AABB bounds = {};
+	bounds.minCorner = XMFLOAT3(node.center.x - looseHalfSize, node.center.y - looseHalfSize, node.center.z - looseHalfSize);
+	bounds.maxCorner = XMFLOAT3(node.center.x + looseHalfSize, node.center.y + looseHalfSize, node.center.z + looseHalfSize);
+	return bounds;
+}
+
+// --------------------------------------------------------
+// Adds an item to the front of a node's list, and counts it
+// in that node and everything above it
+// --------------------------------------------------------
+void SpatialIndex::Link(unsigned int item, unsigned int node)
+{
+	Item& linked = items[item];
+	linked.node = node;
+	linked.previous = SPATIAL_NO_INDEX;
+	linked.next = nodes[node].firstItem;
+	if (linked.next != SPATIAL_NO_INDEX)
+		items[linked.next].previous = item;
+	nodes[node].firstItem = item;
+
+	for (unsigned int n = node; n != SPATIAL_NO_INDEX; n = nodes[n].parent)
+		nodes[n].subtreeItemCount++;
+}
+
+void SpatialIndex::Unlink(unsigned int item)
+{
+	Item& unlinked = items[item];
+	if (unlinked.previous != SPATIAL_NO_INDEX)
+		items[unlinked.previous].next = unlinked.next;
+	else
+		nodes[unlinked.node].firstItem = unlinked.next;
+	if (unlinked.next != SPATIAL_NO_INDEX)
+		items[unlinked.next].previous = unlinked.previous;
+
+	for (unsigned int n = unlinked.node; n != SPATIAL_NO_INDEX; n = nodes[n].parent)
+		nodes[n].subtreeItemCount--;
+
+	unlinked.node = SPATIAL_NO_INDEX;
+	unlinked.next = SPATIAL_NO_INDEX;
+	unlinked.previous = SPATIAL_NO_INDEX;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "Bounds.h"
+#include "TransformSystem.h"
+
+// Index used for "no node" / "no item"
+#define SPATIAL_NO_INDEX 0xFFFFFFFF
+
+// A loose octree over a set of bounding boxes, for answering "what's
+// in this box / sphere / frustum / along this ray?" without checking
+// every single thing in the scene.
+//
+// Every node's bounds are "loosened" to twice the size of its cell, so
+// an item lives in the node whose cell contains its center and whose
+// size matches its own - which can be worked out directly, without
+// searching.  Items are kept in intrusive linked lists per node, so
+// moves that stay within the same node just update its bounds, and
+// moving to a different node only costs the depth of the two nodes
+// (each ancestor's count of the items under it is kept up to date, so
+// queries can skip empty subtrees).
+//
+// Items can optionally follow a transform: SyncWithTransforms() picks
+// up every transform whose version changed and moves its item, so the
+// index stays current with a single pass after matrices are updated.
+//
+// Anything outside the root cell is kept in the root (and so is tested
+// by every query), which keeps things correct if something wanders off.
+class SpatialIndex
+{
+public:
+	/// <summary>
+	/// Creates an empty index
+	/// </summary>
+	/// <param name="worldCenter">Center of the region things are expected to be in</param>
+	/// <param name="worldHalfSize">Half the width of that (cube shaped) region</param>
+	/// <param name="maxDepth">How many times the region can be subdivided</param>
+	SpatialIndex(DirectX::XMFLOAT3 worldCenter, float worldHalfSize, unsigned int maxDepth = 8);
+
+	/// <summary>
+	/// Adds an item with fixed bounds (move it with Move())
+	/// </summary>
+	/// <param name="bounds">World space bounds</param>
+	/// <param name="userData">Returned by queries that find this item (such as an entity index)</param>
+	/// <returns>Handle for moving or removing the item later</returns>
+	unsigned int Insert(const AABB& bounds, unsigned int userData);
+
+	/// <summary>
+	/// Adds an item that follows a transform (see SyncWithTransforms())
+	/// </summary>
+	/// <param name="transform">Transform to follow</param>
+	/// <param name="localBounds">Bounds in the transform's local space (such as a mesh's bounds)</param>
+	/// <param name="userData">Returned by queries that find this item</param>
+	unsigned int InsertTracked(TransformHandle transform, const AABB& localBounds, unsigned int userData);
+
+	void Move(unsigned int item, const AABB& bounds);
+	void Remove(unsigned int item);
+
+	/// <summary>
+	/// Moves every tracked item whose transform has changed since the last sync.
+	/// Call after TransformSystem::UpdateAllMatrices(), from whichever thread owns the transforms.
+	/// </summary>
+	/// <returns>How many items moved</returns>
+	unsigned int SyncWithTransforms();
+
+	// Queries - each clears the results and fills them with the userData of every item found
+	void QueryAABB(const AABB& box, std::vector<unsigned int>& results);
+	void QuerySphere(DirectX::XMFLOAT3 center, float radius, std::vector<unsigned int>& results);
+	void QueryFrustum(const Frustum& frustum, std::vector<unsigned int>& results);
+	void QueryRay(const Ray& ray, std::vector<unsigned int>& results);
+
+	/// <summary>
+	/// Finds the item whose bounds the ray hits first
+	/// </summary>
+	/// <param name="userData">The hit item's userData</param>
+	/// <param name="distance">How far along the ray it was hit</param>
+	/// <returns>True if anything was hit</returns>
+	bool Raycast(const Ray& ray, unsigned int* userData, float* distance);
+
+	const AABB& GetBounds(unsigned int item);
+	unsigned int GetItemCount();
+	unsigned int GetNodeCount();
+
+private:
+	struct Node
+	{
+		DirectX::XMFLOAT3 center;	// Center of this node's cell
+		float halfSize;				// Half the width of the cell (loose bounds are twice this)
+		unsigned int depth;
+		unsigned int parent;
+		unsigned int children[8];	// Indexed by octant: x + 2y + 4z, 1 meaning the positive side
+		unsigned int firstItem;
+		unsigned int subtreeItemCount; // Items in this node and everything below it (empty branches are skipped)
+	};
+
+	struct Item
+	{
+		AABB bounds;
+		unsigned int userData;
+		unsigned int node;			// SPATIAL_NO_INDEX if this slot is free
+		unsigned int next;			// Siblings in the node's list
+		unsigned int previous;
+
+		// Transform tracking (transform.index is TRANSFORM_NO_INDEX if not tracked)
+		TransformHandle transform;
+		AABB localBounds;
+		unsigned int transformVersion;
+	};
+
+	unsigned int maxDepth;
+	std::vector<Node> nodes;
+	std::vector<Item> items;
+	std::vector<unsigned int> freeItems;
+	unsigned int itemCount;
+
+	// Scratch stack for traversals (reused to avoid reallocating)
+	std::vector<unsigned int> traversalStack;
+
+	unsigned int CreateNode(unsigned int parent, unsigned int octant);
+	unsigned int FindNode(const AABB& bounds);
+	bool BelongsInNode(unsigned int node, const AABB& bounds);
+	AABB GetLooseBounds(unsigned int node);
+	void Link(unsigned int item, unsigned int node);
+	void Unlink(unsigned int item);
+
+	template<typename NodeTest, typename ItemVisitor>
+	void Traverse(NodeTest nodeTest, ItemVisitor visitItem);
+};
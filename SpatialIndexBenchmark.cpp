@@ -0,0 +1,192 @@
+#include "SpatialIndexBenchmark.h"
+#include "BenchmarkUtils.h"
+#include "SpatialIndex.h"
+
+#include <cmath>
+#include <random>
+#include <stdio.h>
+#include <vector>
+
+using namespace DirectX;
+using namespace BenchmarkUtils;
+
+namespace
+{
+	AABB MakeBox(XMFLOAT3 center, float halfExtent)
+	{
+		AABB box = {};
+		box.minCorner = XMFLOAT3(center.x - halfExtent, center.y - halfExtent, center.z - halfExtent);
+		box.maxCorner = XMFLOAT3(center.x + halfExtent, center.y + halfExtent, center.z + halfExtent);
+		return box;
+	}
+
+	// The index has to find exactly what checking every box does, and sooner
+	bool PrintComparison(const char* name, double indexMs, double bruteForceMs, size_t found, bool resultsMatch)
+	{
+		bool passed = resultsMatch && indexMs < bruteForceMs;
+		printf("  %-8s index %9.2f ms   brute force %9.2f ms   (%6.1fx)   found %zu%s   %s\n",
+			name, indexMs, bruteForceMs, bruteForceMs / fmax(indexMs, 0.001), found,
+			resultsMatch ? "" : "   MISMATCH!", Verdict(passed));
+		return passed;
+	}
+}
+
+bool SpatialIndexBenchmark::Run()
+{
+	bool passed = true;
+	passed &= Run(10000, 1000);
+	passed &= Run(100000, 500);
+	passed &= Run(1000000, 100);
+	return passed;
+}
+
+// --------------------------------------------------------
+// Scatters boxes around at a constant density (so bigger
+// scenes are just bigger, not more crowded), then times
+// building, moving and querying
+// --------------------------------------------------------
+bool SpatialIndexBenchmark::Run(unsigned int itemCount, unsigned int queryCount)
+{
+	std::mt19937 random(1234);
+	float worldHalfSize = 2.0f * cbrtf((float)itemCount);
+	std::uniform_real_distribution<float> position(-worldHalfSize, worldHalfSize);
+	std::uniform_real_distribution<float> size(0.25f, 1.0f);
+	std::uniform_real_distribution<float> offset(-1.0f, 1.0f);
+
+	std::vector<AABB> boxes(itemCount);
+	for (AABB& box : boxes)
+		box = MakeBox(XMFLOAT3(position(random), position(random), position(random)), size(random));
+
+	printf("SpatialIndex benchmark: %u items\n", itemCount);
+
+	// Building
+	Clock::time_point start = Clock::now();
+	SpatialIndex index(XMFLOAT3(0, 0, 0), worldHalfSize);
+	std::vector<unsigned int> handles(itemCount);
+	for (unsigned int i = 0; i < itemCount; i++)
+		handles[i] = index.Insert(boxes[i], i);
+	printf("  build    %9.2f ms   (%u nodes)\n", MillisecondsSince(start), index.GetNodeCount());
+
+	// Moving a tenth of everything a little, like a frame of animation
+	start = Clock::now();
+	for (unsigned int i = 0; i < itemCount; i += 10)
+	{
+		XMFLOAT3 center = Bounds::GetCenter(boxes[i]);
+		XMFLOAT3 halfExtents = Bounds::GetHalfExtents(boxes[i]);
+		boxes[i] = MakeBox(XMFLOAT3(center.x + offset(random), center.y + offset(random), center.z + offset(random)), halfExtents.x);
+		index.Move(handles[i], boxes[i]);
+	}
+	printf("  move 10%% %8.2f ms\n", MillisecondsSince(start));
+
+	bool passed = true;
+	std::vector<unsigned int> results;
+	size_t indexFound = 0;
+	size_t bruteForceFound = 0;
+
+	// Box queries
+	std::vector<AABB> queryBoxes(queryCount);
+	for (AABB& box : queryBoxes)
+		box = MakeBox(XMFLOAT3(position(random), position(random), position(random)), 8.0f);
+
+	start = Clock::now();
+	for (const AABB& query : queryBoxes)
+	{
+		index.QueryAABB(query, results);
+		indexFound += results.size();
+	}
+	double indexMs = MillisecondsSince(start);
+
+	start = Clock::now();
+	for (const AABB& query : queryBoxes)
+		for (const AABB& box : boxes)
+			bruteForceFound += Bounds::Overlaps(box, query);
+	passed &= PrintComparison("AABB", indexMs, MillisecondsSince(start), indexFound, indexFound == bruteForceFound);
+
+	// Sphere queries
+	std::vector<XMFLOAT3> sphereCenters(queryCount);
+	for (XMFLOAT3& center : sphereCenters)
+		center = XMFLOAT3(position(random), position(random), position(random));
+
+	indexFound = bruteForceFound = 0;
+	start = Clock::now();
+	for (const XMFLOAT3& center : sphereCenters)
+	{
+		index.QuerySphere(center, 8.0f, results);
+		indexFound += results.size();
+	}
+	indexMs = MillisecondsSince(start);
+
+	start = Clock::now();
+	for (const XMFLOAT3& center : sphereCenters)
+		for (const AABB& box : boxes)
+			bruteForceFound += Bounds::OverlapsSphere(box, center, 8.0f);
+	passed &= PrintComparison("sphere", indexMs, MillisecondsSince(start), indexFound, indexFound == bruteForceFound);
+
+	// Frustum queries, from cameras looking in random directions
+	std::vector<Frustum> frustums(queryCount);
+	XMMATRIX projection = XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, 50.0f);
+	for (Frustum& frustum : frustums)
+	{
+		XMVECTOR eye = XMVectorSet(position(random), position(random), position(random), 1);
+		XMVECTOR direction = XMVectorSet(offset(random), offset(random) * 0.5f, offset(random) + 0.01f, 0);
+		XMFLOAT4X4 viewProjection;
+		XMStoreFloat4x4(&viewProjection, XMMatrixMultiply(XMMatrixLookToLH(eye, direction, XMVectorSet(0, 1, 0, 0)), projection));
+		frustum = Bounds::FrustumFromViewProjection(viewProjection);
+	}
+
+	indexFound = bruteForceFound = 0;
+	start = Clock::now();
+	for (const Frustum& frustum : frustums)
+	{
+		index.QueryFrustum(frustum, results);
+		indexFound += results.size();
+	}
+	indexMs = MillisecondsSince(start);
+
+	start = Clock::now();
+	for (const Frustum& frustum : frustums)
+		for (const AABB& box : boxes)
+			bruteForceFound += Bounds::OverlapsFrustum(box, frustum);
+	passed &= PrintComparison("frustum", indexMs, MillisecondsSince(start), indexFound, indexFound == bruteForceFound);
+
+	// Closest hit raycasts (counting hits, and making sure both agree on what was hit first)
+	std::vector<Ray> rays(queryCount);
+	for (Ray& ray : rays)
+	{
+		ray.origin = XMFLOAT3(position(random), position(random), position(random));
+		XMStoreFloat3(&ray.direction, XMVector3Normalize(XMVectorSet(offset(random), offset(random), offset(random) + 0.01f, 0)));
+		ray.maxDistance = 100.0f;
+	}
+
+	std::vector<float> indexDistances(queryCount, -1.0f);
+	indexFound = bruteForceFound = 0;
+	start = Clock::now();
+	for (unsigned int r = 0; r < queryCount; r++)
+	{
+		unsigned int hit;
+		if (index.Raycast(rays[r], &hit, &indexDistances[r]))
+			indexFound++;
+	}
+	indexMs = MillisecondsSince(start);
+
+	unsigned int distanceMismatches = 0;
+	start = Clock::now();
+	for (unsigned int r = 0; r < queryCount; r++)
+	{
+		float closest = -1.0f;
+		for (const AABB& box : boxes)
+		{
+			float distance;
+			if (Bounds::IntersectsRay(box, rays[r], &distance) && (closest < 0 || distance < closest))
+				closest = distance;
+		}
+
+		if (closest >= 0)
+			bruteForceFound++;
+		if (closest != indexDistances[r])
+			distanceMismatches++;
+	}
+	passed &= PrintComparison("raycast", indexMs, MillisecondsSince(start), indexFound, indexFound == bruteForceFound && distanceMismatches == 0);
+
+	return passed;
+}
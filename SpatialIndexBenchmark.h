@@ -0,0 +1,23 @@
+#pragma once
+
+// Times the SpatialIndex against simply checking every box, on randomly
+// generated scenes, and makes sure both find exactly the same things.
+// Start the program with -benchmark to run it (see HeadlessTests.h); it
+// fails if any query finds something different, or isn't faster.
+
+namespace SpatialIndexBenchmark
+{
+	/// <summary>
+	/// Runs the benchmark at 10k, 100k and 1M items
+	/// </summary>
+	/// <returns>Whether every query matched checking every box, and beat it</returns>
+	bool Run();
+
+	/// <summary>
+	/// Runs the benchmark for a single scene size
+	/// </summary>
+	/// <param name="itemCount">How many boxes to scatter around</param>
+	/// <param name="queryCount">How many of each kind of query to time</param>
+	/// <returns>Whether every query matched checking every box, and beat it</returns>
+	bool Run(unsigned int itemCount, unsigned int queryCount);
+}
@@ -0,0 +1,199 @@
+#include "TlasBuildPolicy.h"
+
+TlasBuildPolicySettings::TlasBuildPolicySettings() :
+	allowUpdates(true),
+	maxConsecutiveUpdates(120),
+	maxFrameDisplacement(10.0f),
+	maxDegradation(2.0f)
+{
+}
+
+TlasBuildPolicy::TlasBuildPolicy(unsigned int historySize) :
+	built(false),
+	builtInstanceCount(0),
+	consecutiveUpdates(0),
+	degradation(0),
+	historyCapacity(historySize > 0 ? historySize : 1),
+	historyStart(0),
+	decisionCount(0),
+	modeCounts{}
+{
+	history.reserve(historyCapacity);
+}
+
+
+// --------------------------------------------------------
+// Picks a build mode for this frame, updates the running
+// degradation estimate and records the decision
+// --------------------------------------------------------
+TlasBuildMode TlasBuildPolicy::Decide(const TlasFrameChanges& changes)
+{
+	TlasBuildReason reason = TlasBuildReason::NoChanges;
+	TlasBuildMode mode = Choose(changes, &reason);
+
+	switch (mode)
+	{
+	case TlasBuildMode::Rebuild:
+		// Fresh structure, so no drift
+		built = true;
+		builtInstanceCount = changes.instanceCount;
+		consecutiveUpdates = 0;
+		degradation = 0;
+		break;
+
+	case TlasBuildMode::Update:
+		// Each refit leaves the structure's nodes shaped for where instances
+		// used to be, so accumulate the average distance travelled per instance
+		consecutiveUpdates++;
+		if (changes.instanceCount > 0)
+			degradation += changes.totalDisplacement / changes.instanceCount;
+		break;
+
+	default:
+		break;
+	}
+
+	Record(mode, reason, changes);
+	return mode;
+}
+
+void TlasBuildPolicy::Invalidate()
+{
+	built = false;
+}
+
+
+// --------------------------------------------------------
+// The actual decision, in order of priority
+// --------------------------------------------------------
+TlasBuildMode TlasBuildPolicy::Choose(const TlasFrameChanges& changes, TlasBuildReason* reason)
+{
+	// Things that make an update impossible
+	if (!built)
+	{
+		*reason = TlasBuildReason::FirstBuild;
+		return TlasBuildMode::Rebuild;
+	}
+
+	if (changes.instanceCount != builtInstanceCount)
+	{
+		*reason = TlasBuildReason::InstanceCountChanged;
+		return TlasBuildMode::Rebuild;
+	}
+
+	// Nothing to do?
+	if (changes.instancesMoved == 0 && changes.instancesReassigned == 0)
+	{
+		*reason = TlasBuildReason::NoChanges;
+		return TlasBuildMode::Skip;
+	}
+
+	// Things that make an update a bad idea
+	if (!settings.allowUpdates)
+	{
+		*reason = TlasBuildReason::UpdatesDisabled;
+		return TlasBuildMode::Rebuild;
+	}
+
+	if (changes.instancesReassigned > 0)
+	{
+		*reason = TlasBuildReason::InstancesReassigned;
+		return TlasBuildMode::Rebuild;
+	}
+
+	if (changes.maxDisplacement > settings.maxFrameDisplacement)
+	{
+		*reason = TlasBuildReason::LargeMotion;
+		return TlasBuildMode::Rebuild;
+	}
+
+	if (consecutiveUpdates >= settings.maxConsecutiveUpdates)
+	{
+		*reason = TlasBuildReason::UpdateLimit;
+		return TlasBuildMode::Rebuild;
+	}
+
+	// Would this update push the estimate over the limit?
+	float frameDrift = changes.instanceCount > 0 ? changes.totalDisplacement / changes.instanceCount : 0;
+	if (degradation + frameDrift > settings.maxDegradation)
+	{
+		*reason = TlasBuildReason::DegradationLimit;
+		return TlasBuildMode::Rebuild;
+	}
+
+	*reason = TlasBuildReason::Refit;
+	return TlasBuildMode::Update;
+}
+
+void TlasBuildPolicy::Record(TlasBuildMode mode, TlasBuildReason reason, const TlasFrameChanges& changes)
+{
+	TlasBuildRecord record = {};
+	record.decision = decisionCount++;
+	record.mode = mode;
+	record.reason = reason;
+	record.instanceCount = changes.instanceCount;
+	record.instancesMoved = changes.instancesMoved;
+	record.degradation = degradation;
+
+	modeCounts[(int)mode]++;
+
+	// Fill the ring until it's full, then overwrite the oldest entry
+	if (history.size() < historyCapacity)
+	{
+		history.push_back(record);
+	}
+	else
+	{
+		history[historyStart] = record;
+		historyStart = (historyStart + 1) % history.size();
+	}
+}
+
+
+#pragma region Getters & Setters
+TlasBuildPolicySettings& TlasBuildPolicy::GetSettings() { return settings; }
+void TlasBuildPolicy::SetSettings(const TlasBuildPolicySettings& newSettings) { settings = newSettings; }
+
+float TlasBuildPolicy::GetDegradation() { return degradation; }
+unsigned int TlasBuildPolicy::GetConsecutiveUpdates() { return consecutiveUpdates; }
+
+unsigned int TlasBuildPolicy::GetHistoryCount() { return (unsigned int)history.size(); }
+
+const TlasBuildRecord& TlasBuildPolicy::GetRecord(unsigned int decisionsAgo)
+{
+	// Newest entry is just before the start of the ring
+	unsigned int count = (unsigned int)history.size();
+	unsigned int newest = (historyStart + count - 1) % count;
+	return history[(newest + count - (decisionsAgo % count)) % count];
+}
+
+unsigned long long TlasBuildPolicy::GetModeCount(TlasBuildMode mode) { return modeCounts[(int)mode]; }
+
+const char* TlasBuildPolicy::GetModeName(TlasBuildMode mode)
+{
+	switch (mode)
+	{
+	case TlasBuildMode::Skip: return "Skip";
+	case TlasBuildMode::Update: return "Update";
+	case TlasBuildMode::Rebuild: return "Rebuild";
+	default: return "Unknown";
+	}
+}
+
+const char* TlasBuildPolicy::GetReasonName(TlasBuildReason reason)
+{
+	switch (reason)
+	{
+	case TlasBuildReason::NoChanges: return "NoChanges";
+	case TlasBuildReason::Refit: return "Refit";
+	case TlasBuildReason::FirstBuild: return "FirstBuild";
+	case TlasBuildReason::InstanceCountChanged: return "InstanceCountChanged";
+	case TlasBuildReason::InstancesReassigned: return "InstancesReassigned";
+	case TlasBuildReason::LargeMotion: return "LargeMotion";
+	case TlasBuildReason::DegradationLimit: return "DegradationLimit";
+	case TlasBuildReason::UpdateLimit: return "UpdateLimit";
+	case TlasBuildReason::UpdatesDisabled: return "UpdatesDisabled";
+	default: return "Unknown";
+	}
+}
+#pragma endregion
@@ -0,0 +1,122 @@
+#pragma once
+
+// Decides, once per frame, whether a top level acceleration structure
+// should be left alone, updated in place (refit) or fully rebuilt.
+// Refits are much cheaper than rebuilds but the structure's quality
+// drifts as instances move away from where they were when it was last
+// built, so this keeps a running estimate of that drift and rebuilds
+// once it gets too large.
+//
+// Knows nothing about the API doing the building, so the same policy
+// drives the DXR TLAS and any CPU-side BVH, and can be fed scripted
+// changes (as the headless checks in HeadlessTests.cpp do).
+
+#include <vector>
+
+enum class TlasBuildMode
+{
+	Skip,		// Nothing changed; keep the existing structure
+	Update,		// Refit the existing structure in place
+	Rebuild		// Build from scratch
+};
+
+enum class TlasBuildReason
+{
+	NoChanges,
+	Refit,
+	FirstBuild,
+	InstanceCountChanged,
+	InstancesReassigned,
+	LargeMotion,
+	DegradationLimit,
+	UpdateLimit,
+	UpdatesDisabled,
+	Count
+};
+
+// What changed in the scene since the last decision
+struct TlasFrameChanges
+{
+	unsigned int instanceCount;
+	unsigned int instancesMoved;		// Instances whose transform changed
+	unsigned int instancesReassigned;	// Instances whose geometry (or entity) changed
+	float totalDisplacement;			// Sum of how far each moved instance travelled
+	float maxDisplacement;				// Furthest any single instance travelled
+};
+
+// Thresholds for the policy - all distances are in world units
+struct TlasBuildPolicySettings
+{
+	TlasBuildPolicySettings();
+
+	bool allowUpdates;
+	unsigned int maxConsecutiveUpdates;	// Rebuild at least this often
+	float maxFrameDisplacement;			// Any single instance moving further than this forces a rebuild
+	float maxDegradation;				// Average drift per instance since the last rebuild
+};
+
+// The decision made for a single frame, along with why
+struct TlasBuildRecord
+{
+	unsigned long long decision;	// Which decision this was (increases by one each call)
+	TlasBuildMode mode;
+	TlasBuildReason reason;
+	unsigned int instanceCount;
+	unsigned int instancesMoved;
+	float degradation;				// Estimate after this decision
+};
+
+class TlasBuildPolicy
+{
+public:
+	TlasBuildPolicy(unsigned int historySize = 256);
+
+	/// <summary>
+	/// Picks the build mode for this frame and records the decision
+	/// </summary>
+	/// <param name="changes">What changed since the last call</param>
+	/// <returns>Whether to skip, update or rebuild</returns>
+	TlasBuildMode Decide(const TlasFrameChanges& changes);
+
+	/// <summary>
+	/// Forgets the current structure, so the next decision is a rebuild.  Call
+	/// this when the structure itself is lost (for instance, reallocated).
+	/// </summary>
+	void Invalidate();
+
+	// Settings
+	TlasBuildPolicySettings& GetSettings();
+	void SetSettings(const TlasBuildPolicySettings& newSettings);
+
+	// Current state
+	float GetDegradation();
+	unsigned int GetConsecutiveUpdates();
+
+	// History
+	unsigned int GetHistoryCount();
+	const TlasBuildRecord& GetRecord(unsigned int decisionsAgo); // 0 is the most recent - only valid once a decision exists
+	unsigned long long GetModeCount(TlasBuildMode mode);
+
+	static const char* GetModeName(TlasBuildMode mode);
+	static const char* GetReasonName(TlasBuildReason reason);
+
+private:
+	TlasBuildPolicySettings settings;
+
+	// State since the last rebuild
+	bool built;
+	unsigned int builtInstanceCount;
+	unsigned int consecutiveUpdates;
+	float degradation;
+
+	// Ring buffer of recent decisions
+	std::vector<TlasBuildRecord> history;
+	unsigned int historyCapacity;
+	unsigned int historyStart;
+	unsigned long long decisionCount;
+	unsigned long long modeCounts[3];
+
+	TlasBuildMode Choose(const TlasFrameChanges& changes, TlasBuildReason* reason);
+	void Record(TlasBuildMode mode, TlasBuildReason reason, const TlasFrameChanges& changes);
+};
+
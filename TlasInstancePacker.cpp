@@ -0,0 +1,199 @@
+#include "TlasInstancePacker.h"
+
+#include <DirectXMath.h>
+
+using namespace DirectX;
+
+TlasInstancePacker::TlasInstancePacker() :
+	invalidated(true)
+{
+}
+
+
+// --------------------------------------------------------
+// Packs every instance that differs from what was packed
+// last time (different entity, mesh or material, or a
+// transform that has changed since), and measures how far
+// moved instances travelled.
+// --------------------------------------------------------
+TlasPackResult TlasInstancePacker::Pack(
+	const std::vector<std::shared_ptr<Entity>>& scene,
+	D3D12_RAYTRACING_INSTANCE_DESC* instanceDescs,
+	RaytracingInstanceData* instanceData)
+{
+	TlasPackResult result = BeginPack((unsigned int)scene.size());
+
+	for (unsigned int i = 0; i < scene.size(); i++)
+	{
+		Entity* entity = scene[i].get();
+
+		// Skip anything that hasn't changed (before paying for its matrices)
+		unsigned int transformVersion = entity->GetTransform()->GetVersion();
+		if (IsUnchanged(i, entity, entity->GetMesh().get(), entity->GetMaterial().get(), transformVersion))
+			continue;
+
+		SnapshotInstance source = {};
+		source.entity = entity;
+		source.mesh = entity->GetMesh().get();
+		source.material = entity->GetMaterial().get();
+		source.transformVersion = transformVersion;
+		source.worldMatrix = entity->GetTransform()->GetWorldMatrix();
+		source.worldInverseTransposeMatrix = entity->GetTransform()->GetWorldInverseTransposeMatrix();
+		PackChangedInstance(i, source, instanceDescs, instanceData, &result);
+	}
+
+	invalidated = false;
+	return result;
+}
+
+// --------------------------------------------------------
+// Same as above, from a snapshot of the scene rather than
+// the live entities
+// --------------------------------------------------------
+TlasPackResult TlasInstancePacker::Pack(
+	const SceneSnapshot& snapshot,
+	D3D12_RAYTRACING_INSTANCE_DESC* instanceDescs,
+	RaytracingInstanceData* instanceData)
+{
+	TlasPackResult result = BeginPack((unsigned int)snapshot.instances.size());
+
+	for (unsigned int i = 0; i < snapshot.instances.size(); i++)
+	{
+		const SnapshotInstance& source = snapshot.instances[i];
+		if (IsUnchanged(i, source.entity, source.mesh, source.material, source.transformVersion))
+			continue;
+
+		PackChangedInstance(i, source, instanceDescs, instanceData, &result);
+	}
+
+	invalidated = false;
+	return result;
+}
+
+void TlasInstancePacker::Invalidate()
+{
+	invalidated = true;
+}
+
+unsigned int TlasInstancePacker::GetInstanceCount()
+{
+	return (unsigned int)packedInstances.size();
+}
+
+
+// --------------------------------------------------------
+// Sets up the results for packing a scene of the given size
+// --------------------------------------------------------
+TlasPackResult TlasInstancePacker::BeginPack(unsigned int instanceCount)
+{
+	TlasPackResult result = {};
+	result.changes.instanceCount = instanceCount;
+	result.instanceCountChanged = invalidated || instanceCount != packedInstances.size();
+
+	// Anything past the end of the old scene is new, and anything
+	// past the end of the new scene is simply not drawn any more
+	packedInstances.resize(instanceCount);
+	return result;
+}
+
+bool TlasInstancePacker::IsUnchanged(unsigned int index, const Entity* entity, const Mesh* mesh, const Material* material, unsigned int transformVersion)
+{
+	const PackedInstance& packed = packedInstances[index];
+	return
+		!invalidated &&
+		packed.entity == entity &&
+		packed.mesh == mesh &&
+		packed.material == material &&
+		packed.transformVersion == transformVersion;
+}
+
+// --------------------------------------------------------
+// Packs a single instance that's known to have changed,
+// and records what kind of change it was
+// --------------------------------------------------------
+void TlasInstancePacker::PackChangedInstance(
+	unsigned int index,
+	const SnapshotInstance& source,
+	D3D12_RAYTRACING_INSTANCE_DESC* instanceDescs,
+	RaytracingInstanceData* instanceData,
+	TlasPackResult* result)
+{
+	PackedInstance& packed = packedInstances[index];
+
+	XMFLOAT3 worldPosition;
+	PackInstance(index, source, &instanceDescs[index], &instanceData[index], &worldPosition);
+	result->instancesRepacked++;
+
+	// Classify the change: new geometry in this slot, or the same thing moving?
+	// (Material-only changes don't matter to the acceleration structure)
+	if (invalidated)
+	{
+		// Nothing to compare against
+	}
+	else if (packed.entity != source.entity || packed.mesh != source.mesh)
+	{
+		result->changes.instancesReassigned++;
+	}
+	else if (packed.transformVersion != source.transformVersion)
+	{
+		float distance = XMVectorGetX(XMVector3Length(XMLoadFloat3(&worldPosition) - XMLoadFloat3(&packed.worldPosition)));
+		result->changes.instancesMoved++;
+		result->changes.totalDisplacement += distance;
+		result->changes.maxDisplacement = max(result->changes.maxDisplacement, distance);
+	}
+
+	packed.entity = source.entity;
+	packed.mesh = source.mesh;
+	packed.material = source.material;
+	packed.transformVersion = source.transformVersion;
+	packed.worldPosition = worldPosition;
+}
+
+// --------------------------------------------------------
+// Fills out the instance description and instance data
+// for a single entity
+// --------------------------------------------------------
+void TlasInstancePacker::PackInstance(
+	unsigned int index,
+	const SnapshotInstance& source,
+	D3D12_RAYTRACING_INSTANCE_DESC* instanceDesc,
+	RaytracingInstanceData* instanceData,
+	XMFLOAT3* worldPosition)
+{
+	// Grab this entity's transform and transpose to column major
+	XMFLOAT4X4 transform = source.worldMatrix;
+	*worldPosition = XMFLOAT3(transform._41, transform._42, transform._43);
+	XMStoreFloat4x4(&transform, XMMatrixTranspose(XMLoadFloat4x4(&transform)));
+
+	// Grab this mesh's index in the shader table and its BLAS, if it has them
+	unsigned int hitGroupIndex = 0;
+	D3D12_GPU_VIRTUAL_ADDRESS blasAddress = 0;
+	Mesh* mesh = source.mesh;
+	if (mesh && mesh->GetRaytracingData().BLAS)
+	{
+		hitGroupIndex = mesh->GetRaytracingData().HitGroupIndex;
+		blasAddress = mesh->GetRaytracingData().BLAS->GetGPUVirtualAddress();
+	}
+
+	// Build the description in a local and write it out in one go, since
+	// the destination is usually write-combined upload memory
+	D3D12_RAYTRACING_INSTANCE_DESC id = {};
+	id.InstanceContributionToHitGroupIndex = hitGroupIndex;
+	id.InstanceID = index; // Index into the instance data table
+	id.InstanceMask = 0xFF;
+	memcpy(&id.Transform, &transform, sizeof(float) * 3 * 4); // Copy first [3][4] elements
+	id.AccelerationStructure = blasAddress;
+	id.Flags = D3D12_RAYTRACING_INSTANCE_FLAG_NONE;
+	*instanceDesc = id;
+
+	// Same for the instance data
+	XMFLOAT3 c = source.material ? source.material->GetColorTint() : XMFLOAT3(1, 1, 1);
+	RaytracingInstanceData data = {};
+	data.worldInvTranspose = source.worldInverseTransposeMatrix;
+	data.materialData.color = XMFLOAT4(c.x, c.y, c.z, (float)((index + 1) % 2)); // Using alpha channel as "roughness"
+	data.materialData.albedoIndex = 0;
+	data.materialData.roughnessIndex = 1;
+	data.materialData.normalsIndex = 2;
+	data.materialData.metalIndex = 3;
+	*instanceData = data;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+// Packs a scene of entities into TLAS instance descriptions and the
+// matching per-instance shader data, remembering what it packed so
+// that later calls only rewrite the instances that actually changed
+// (and can report how far they moved, for the TLAS build policy).
+// Needs nothing from the GPU (meshes without a BLAS pack with a null
+// address), so it can be exercised entirely on the CPU.
+
+#include <d3d12.h>
+#include <memory>
+#include <vector>
+
+#include "Entity.h"
+#include "SceneSnapshot.h"
+#include "BufferStructs.h"
+#include "TlasBuildPolicy.h"
+
+// Results of a single call to TlasInstancePacker::Pack()
+struct TlasPackResult
+{
+	unsigned int instancesRepacked;	// How many were actually rewritten (including material-only changes)
+	bool instanceCountChanged;		// Did the scene grow or shrink?
+	TlasFrameChanges changes;		// What changed, as far as the acceleration structure is concerned
+};
+
+class TlasInstancePacker
+{
+public:
+	TlasInstancePacker();
+
+	/// <summary>
+	/// Writes instance descriptions and instance data for every entity in the
+	/// scene that changed since the last call.  Instance i of the scene always
+	/// lands in element i of each destination array.
+	/// </summary>
+	/// <param name="scene">Entities to pack</param>
+	/// <param name="instanceDescs">Destination for instance descriptions (at least scene.size() elements)</param>
+	/// <param name="instanceData">Destination for per-instance shader data (at least scene.size() elements)</param>
+	/// <returns>What was packed, and whether a build is required</returns>
+	TlasPackResult Pack(
+		const std::vector<std::shared_ptr<Entity>>& scene,
+		D3D12_RAYTRACING_INSTANCE_DESC* instanceDescs,
+		RaytracingInstanceData* instanceData);
+
+	/// <summary>
+	/// Same as above, but from a snapshot of the scene, so the live entities
+	/// (which may be owned by another thread) are never touched
+	/// </summary>
+	TlasPackResult Pack(
+		const SceneSnapshot& snapshot,
+		D3D12_RAYTRACING_INSTANCE_DESC* instanceDescs,
+		RaytracingInstanceData* instanceData);
+
+	/// <summary>
+	/// Forgets everything packed so far, so the next Pack() rewrites every
+	/// instance.  Call this whenever the destination arrays are replaced.
+	/// </summary>
+	void Invalidate();
+
+	unsigned int GetInstanceCount();
+
+private:
+	// Everything that feeds a single packed instance, used to detect changes
+	struct PackedInstance
+	{
+		const Entity* entity;
+		const Mesh* mesh;
+		const Material* material;
+		unsigned int transformVersion;
+		DirectX::XMFLOAT3 worldPosition; // For measuring how far it moves
+	};
+
+	std::vector<PackedInstance> packedInstances;
+	bool invalidated;
+
+	TlasPackResult BeginPack(unsigned int instanceCount);
+	bool IsUnchanged(unsigned int index, const Entity* entity, const Mesh* mesh, const Material* material, unsigned int transformVersion);
+	void PackChangedInstance(
+		unsigned int index,
+		const SnapshotInstance& source,
+		D3D12_RAYTRACING_INSTANCE_DESC* instanceDescs,
+		RaytracingInstanceData* instanceData,
+		TlasPackResult* result);
+	void PackInstance(
+		unsigned int index,
+		const SnapshotInstance& source,
+		D3D12_RAYTRACING_INSTANCE_DESC* instanceDesc,
+		RaytracingInstanceData* instanceData,
+		DirectX::XMFLOAT3* worldPosition);
+};
+
@@ -8,25 +8,57 @@ Transform::Transform() : Transform(XMFLOAT3(0, 0, 0), XMFLOAT3(0, 0, 0), XMFLOAT
 }
 
 Transform::Transform(DirectX::XMFLOAT3 position, DirectX::XMFLOAT4 rotation, DirectX::XMFLOAT3 scale) 
-    : position(position),
-    rotation(rotation),
-    scale(scale)
+    : handle(TransformSystem::GetInstance().Allocate(position, rotation, scale))
 {
-    XMStoreFloat4x4(&worldMatrix, XMMatrixIdentity());
-    XMStoreFloat4x4(&worldInverseTransposeMatrix, XMMatrixIdentity());
-    transformAltered = true;
-    UpdateRotation();
 }
 
 Transform::Transform(DirectX::XMFLOAT3 position, DirectX::XMFLOAT3 pitchYawRoll, DirectX::XMFLOAT3 scale)
     : Transform(position, XMFLOAT4(0, 0, 0, 0), scale)
 {
     SetRotation(pitchYawRoll);
-    UpdateRotation();
+    TransformSystem::GetInstance().UpdateRotation(handle.index);
+}
+
+// Copies get their own slot
+Transform::Transform(const Transform& other)
+    : handle(TransformSystem::GetInstance().Allocate(other.Position(), other.Rotation(), other.Scale()))
+{
+}
+
+// Moves take over the other transform's slot
+Transform::Transform(Transform&& other) noexcept
+    : handle(other.handle)
+{
+    other.handle.generation = INVALID_GENERATION;
+}
+
+Transform& Transform::operator=(const Transform& other)
+{
+    if (this != &other)
+    {
+        Position() = other.Position();
+        Rotation() = other.Rotation();
+        Scale() = other.Scale();
+        TransformSystem::GetInstance().MarkRotated(handle.index);
+    }
+    return *this;
+}
+
+Transform& Transform::operator=(Transform&& other) noexcept
+{
+    if (this != &other)
+    {
+        TransformSystem::GetInstance().Free(handle);
+        handle = other.handle;
+        other.handle.generation = INVALID_GENERATION;
+    }
+    return *this;
 }
 
 Transform::~Transform()
 {
+    // Moved-from transforms have nothing to free
+    TransformSystem::GetInstance().Free(handle);
 }
 #pragma endregion
 
@@ -34,111 +66,133 @@ Transform::~Transform()
 #pragma region === GETTERS ===
 DirectX::XMFLOAT3* Transform::GetPosition()
 {
-    return &position;
+    return &Position();
 }
 
 DirectX::XMFLOAT4* Transform::GetRotation()
 {
-    return &rotation;
+    return &Rotation();
 }
 
 DirectX::XMFLOAT3* Transform::GetScale()
 {
-    return &scale;
+    return &Scale();
 }
 
 DirectX::XMFLOAT4X4 Transform::GetWorldMatrix()
 {
-    if (transformAltered)
-        UpdateMatrices();
+    // Always ask the system, since a parent may have moved even if this hasn't
+    TransformSystem& system = TransformSystem::GetInstance();
+    system.UpdateMatrices(handle.index);
 
-    return worldMatrix;
+    return system.GetWorldMatrices()[handle.index];
 }
 
 DirectX::XMFLOAT4X4 Transform::GetWorldInverseTransposeMatrix()
 {
-    if (transformAltered)
-        UpdateMatrices();
+    TransformSystem& system = TransformSystem::GetInstance();
+    system.UpdateMatrices(handle.index);
 
-    return worldInverseTransposeMatrix;
+    return system.GetWorldInverseTransposeMatrices()[handle.index];
 }
 DirectX::XMFLOAT3* Transform::GetRight()
 {
-    if (rotationAltered)
-        UpdateRotation();
+    TransformSystem& system = TransformSystem::GetInstance();
+    if (system.GetFlags()[handle.index] & TransformFlag_RotationDirty)
+        system.UpdateRotation(handle.index);
 
-    return &right;
+    return &system.GetRights()[handle.index];
 }
 DirectX::XMFLOAT3* Transform::GetUp()
 {
-    if (rotationAltered)
-        UpdateRotation();
+    TransformSystem& system = TransformSystem::GetInstance();
+    if (system.GetFlags()[handle.index] & TransformFlag_RotationDirty)
+        system.UpdateRotation(handle.index);
 
-    return &up;
+    return &system.GetUps()[handle.index];
 }
 DirectX::XMFLOAT3* Transform::GetForward()
 {
-    if (rotationAltered)
-        UpdateRotation();
+    TransformSystem& system = TransformSystem::GetInstance();
+    if (system.GetFlags()[handle.index] & TransformFlag_RotationDirty)
+        system.UpdateRotation(handle.index);
 
-    return &forward;
+    return &system.GetForwards()[handle.index];
 }
 float Transform::GetPitch()
 {
-    return pitch;
+    return TransformSystem::GetInstance().GetPitches()[handle.index];
 }
 float Transform::GetYaw()
 {
-    return yaw;
+    return TransformSystem::GetInstance().GetYaws()[handle.index];
+}
+unsigned int Transform::GetVersion()
+{
+    return TransformSystem::GetInstance().GetVersions()[handle.index];
+}
+TransformHandle Transform::GetHandle() const
+{
+    return handle;
+}
+bool Transform::HasParent()
+{
+    return TransformSystem::GetInstance().GetParent(handle).index != TRANSFORM_NO_INDEX;
 }
 #pragma endregion
 
 
 
 #pragma region === SETTERS ===
+bool Transform::SetParent(const Transform* parent)
+{
+    TransformHandle parentHandle = { TRANSFORM_NO_INDEX, 0 };
+    if (parent)
+        parentHandle = parent->handle;
+
+    return TransformSystem::GetInstance().SetParent(handle, parentHandle);
+}
+
 void Transform::SetPosition(DirectX::XMFLOAT3 newPos)
 {
-    position = newPos;
-    transformAltered = true;
+    Position() = newPos;
+    TransformSystem::GetInstance().MarkMoved(handle.index);
 }
 
 void Transform::SetPosition(float x, float y, float z)
 {
-    position = XMFLOAT3(x, y, z);
-    transformAltered = true;
+    Position() = XMFLOAT3(x, y, z);
+    TransformSystem::GetInstance().MarkMoved(handle.index);
 }
 
 void Transform::SetRotation(DirectX::XMFLOAT3 newPitchYawRoll)
 {
-    XMStoreFloat4(&rotation, XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&newPitchYawRoll)));
-    transformAltered = true;
-    rotationAltered = true;
+    XMStoreFloat4(&Rotation(), XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&newPitchYawRoll)));
+    TransformSystem::GetInstance().MarkRotated(handle.index);
 }
 
 void Transform::SetRotation(float pitch, float yaw, float roll)
 {
-    XMStoreFloat4(&rotation, XMQuaternionRotationRollPitchYaw(pitch, yaw, roll));
-    transformAltered = true;
-    rotationAltered = true;
+    XMStoreFloat4(&Rotation(), XMQuaternionRotationRollPitchYaw(pitch, yaw, roll));
+    TransformSystem::GetInstance().MarkRotated(handle.index);
 }
 
 void Transform::SetRotation(DirectX::XMFLOAT4 newQuaternion)
 {
-    rotation = newQuaternion;
-    transformAltered = true;
-    rotationAltered = true;
+    Rotation() = newQuaternion;
+    TransformSystem::GetInstance().MarkRotated(handle.index);
 }
 
 void Transform::SetScale(DirectX::XMFLOAT3 newScale)
 {
-    scale = newScale;
-    transformAltered = true;
+    Scale() = newScale;
+    TransformSystem::GetInstance().MarkMoved(handle.index);
 }
 
 void Transform::SetScale(float x, float y, float z)
 {
-    scale = XMFLOAT3(x, y, z);
-    transformAltered = true;
+    Scale() = XMFLOAT3(x, y, z);
+    TransformSystem::GetInstance().MarkMoved(handle.index);
 }
 #pragma endregion
 
@@ -147,87 +201,67 @@ void Transform::SetScale(float x, float y, float z)
 #pragma region === MUTATORS ===
 void Transform::MoveBy(DirectX::XMFLOAT3 offset)
 {
-    XMStoreFloat3(&position, XMVectorAdd(XMLoadFloat3(&position), XMLoadFloat3(&offset)));
-    transformAltered = true;
+    XMStoreFloat3(&Position(), XMVectorAdd(XMLoadFloat3(&Position()), XMLoadFloat3(&offset)));
+    TransformSystem::GetInstance().MarkMoved(handle.index);
 }
 
 void Transform::MoveBy(float x, float y, float z)
 {
-    XMStoreFloat3(&position, XMVectorAdd(XMLoadFloat3(&position), XMVectorSet(x, y, z, 0)));
-    transformAltered = true;
+    XMStoreFloat3(&Position(), XMVectorAdd(XMLoadFloat3(&Position()), XMVectorSet(x, y, z, 0)));
+    TransformSystem::GetInstance().MarkMoved(handle.index);
 }
 
 void Transform::LocalMoveBy(DirectX::XMFLOAT3 offset)
 {
-    XMStoreFloat3(&position, XMVectorAdd(XMLoadFloat3(&position), XMVector3Rotate(XMLoadFloat3(&offset), XMLoadFloat4(&rotation))));
-    transformAltered = true;
+    XMStoreFloat3(&Position(), XMVectorAdd(XMLoadFloat3(&Position()), XMVector3Rotate(XMLoadFloat3(&offset), XMLoadFloat4(&Rotation()))));
+    TransformSystem::GetInstance().MarkMoved(handle.index);
 }
 
 void Transform::LocalMoveBy(float x, float y, float z)
 {
-    XMStoreFloat3(&position, XMVectorAdd(XMLoadFloat3(&position), XMVector3Rotate(XMVectorSet(x, y, z, 0), XMLoadFloat4(&rotation))));
-    transformAltered = true;
+    XMStoreFloat3(&Position(), XMVectorAdd(XMLoadFloat3(&Position()), XMVector3Rotate(XMVectorSet(x, y, z, 0), XMLoadFloat4(&Rotation()))));
+    TransformSystem::GetInstance().MarkMoved(handle.index);
 }
 
 void Transform::RotateBy(DirectX::XMFLOAT4 quaternion)
 {
-    XMStoreFloat4(&rotation, XMQuaternionMultiply(XMLoadFloat4(&rotation), XMLoadFloat4(&quaternion)));
-    transformAltered = true;
-    rotationAltered = true;
+    // Keep it unit length as errors accumulate (the matrix math relies on it)
+    XMStoreFloat4(&Rotation(), XMQuaternionNormalize(XMQuaternionMultiply(XMLoadFloat4(&Rotation()), XMLoadFloat4(&quaternion))));
+    TransformSystem::GetInstance().MarkRotated(handle.index);
 }
 
 void Transform::RotateBy(DirectX::XMFLOAT3 pitchYawRoll)
 {
-    XMStoreFloat4(&rotation, XMQuaternionMultiply(XMLoadFloat4(&rotation), XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&pitchYawRoll))));
-    transformAltered = true;
-    rotationAltered = true;
+    XMStoreFloat4(&Rotation(), XMQuaternionNormalize(XMQuaternionMultiply(XMLoadFloat4(&Rotation()), XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&pitchYawRoll)))));
+    TransformSystem::GetInstance().MarkRotated(handle.index);
 }
 
 void Transform::RotateBy(float pitch, float yaw, float roll)
 {
-    XMStoreFloat4(&rotation, XMQuaternionMultiply(XMLoadFloat4(&rotation), XMQuaternionRotationRollPitchYaw(pitch, yaw, roll)));
-    transformAltered = true;
-    rotationAltered = true;
-
+    XMStoreFloat4(&Rotation(), XMQuaternionNormalize(XMQuaternionMultiply(XMLoadFloat4(&Rotation()), XMQuaternionRotationRollPitchYaw(pitch, yaw, roll))));
+    TransformSystem::GetInstance().MarkRotated(handle.index);
 }
 
 void Transform::ScaleBy(DirectX::XMFLOAT3 scaleFactor)
 {
-    XMStoreFloat3(&scale, XMVectorMultiply(XMLoadFloat3(&scale), XMLoadFloat3(&scaleFactor)));
-    transformAltered = true;
+    XMStoreFloat3(&Scale(), XMVectorMultiply(XMLoadFloat3(&Scale()), XMLoadFloat3(&scaleFactor)));
+    TransformSystem::GetInstance().MarkMoved(handle.index);
 }
 
 void Transform::ScaleBy(float x, float y, float z)
 {
-    XMStoreFloat3(&scale, XMVectorMultiply(XMLoadFloat3(&scale), XMVectorSet(x, y, z, 0)));
-    transformAltered = true;
+    XMStoreFloat3(&Scale(), XMVectorMultiply(XMLoadFloat3(&Scale()), XMVectorSet(x, y, z, 0)));
+    TransformSystem::GetInstance().MarkMoved(handle.index);
 }
 #pragma endregion
 
 
 
-void Transform::UpdateMatrices()
-{
-    XMMATRIX t = XMMatrixTranslationFromVector(XMLoadFloat3(&position));
-    XMMATRIX r = XMMatrixRotationQuaternion(XMLoadFloat4(&rotation));
-    XMMATRIX s = XMMatrixScalingFromVector(XMLoadFloat3(&scale));
-
-    XMMATRIX world = XMMatrixMultiply(XMMatrixMultiply(s, r), t);
-
-    XMStoreFloat4x4(&worldMatrix, world);
-    XMStoreFloat4x4(&worldInverseTransposeMatrix, XMMatrixInverse(0, XMMatrixTranspose(world)));
-
-    transformAltered = false;
-}
-
-void Transform::UpdateRotation()
-{
-    XMStoreFloat3(&right, XMVector3Normalize(XMVector3Rotate(XMVectorSet(1, 0, 0, 0), XMLoadFloat4(&rotation))));
-    XMStoreFloat3(&up, XMVector3Normalize(XMVector3Rotate(XMVectorSet(0, 1, 0, 0), XMLoadFloat4(&rotation))));
-    XMStoreFloat3(&forward, XMVector3Normalize(XMVector3Rotate(XMVectorSet(0, 0, 1, 0), XMLoadFloat4(&rotation))));
-
-    XMStoreFloat(&yaw, XMVector3AngleBetweenVectors(XMVectorSet(0, 0, 1, 0), XMVectorSet(forward.x, 0, forward.z, 0)) * copysignf(1, forward.x));
-    XMStoreFloat(&pitch, XMVector3AngleBetweenVectors(XMVectorSet(sinf(yaw), 0, cosf(yaw), 0), XMLoadFloat3(&forward)) * copysignf(1, -forward.y));
-
-    rotationAltered = false;
-}
\ No newline at end of file
+#pragma region === SLOT ACCESS ===
+DirectX::XMFLOAT3& Transform::Position() { return TransformSystem::GetInstance().GetPositions()[handle.index]; }
+DirectX::XMFLOAT4& Transform::Rotation() { return TransformSystem::GetInstance().GetRotations()[handle.index]; }
+DirectX::XMFLOAT3& Transform::Scale() { return TransformSystem::GetInstance().GetScales()[handle.index]; }
+const DirectX::XMFLOAT3& Transform::Position() const { return TransformSystem::GetInstance().GetPositions()[handle.index]; }
+const DirectX::XMFLOAT4& Transform::Rotation() const { return TransformSystem::GetInstance().GetRotations()[handle.index]; }
+const DirectX::XMFLOAT3& Transform::Scale() const { return TransformSystem::GetInstance().GetScales()[handle.index]; }
+#pragma endregion
@@ -2,9 +2,11 @@
 
 // Ben Coukos-Wiley
 // 2/3/2023
-// A representation of the physical aspects of an object
+// A representation of the physical aspects of an object, optionally relative to a parent
+// (The data itself lives in the TransformSystem; this is a handle to it)
 
 #include <DirectXMath.h>
+#include "TransformSystem.h"
 
 class Transform
 {
@@ -12,6 +14,10 @@ public:
 	Transform();
 	Transform(DirectX::XMFLOAT3 position, DirectX::XMFLOAT4 rotation, DirectX::XMFLOAT3 scale);
 	Transform(DirectX::XMFLOAT3 position, DirectX::XMFLOAT3 pitchYawRoll, DirectX::XMFLOAT3 scale);
+	Transform(const Transform& other);
+	Transform(Transform&& other) noexcept;
+	Transform& operator=(const Transform& other);
+	Transform& operator=(Transform&& other) noexcept;
 	~Transform();
 
 	// Getters
@@ -25,8 +31,13 @@ public:
 	DirectX::XMFLOAT3* GetForward();
 	float GetPitch();
 	float GetYaw();
+	unsigned int GetVersion(); // Changes every time the transform is altered (or a parent is, once matrices are updated)
+	TransformHandle GetHandle() const;
+	bool HasParent();
 
 	// Setters
+	// Note: Position, rotation and scale are relative to the parent, if there is one
+	bool SetParent(const Transform* parent); // Null to detach; false if it would create a cycle
 	void SetPosition(DirectX::XMFLOAT3 newPos);
 	void SetPosition(float x, float y, float z);
 	void SetRotation(DirectX::XMFLOAT3 newPitchYawRoll);
@@ -47,26 +58,17 @@ public:
 	void ScaleBy(float x, float y, float z);
 
 private:
-	DirectX::XMFLOAT3 position;
-	DirectX::XMFLOAT4 rotation;
-	DirectX::XMFLOAT3 scale;
-	
-	DirectX::XMFLOAT3 right;
-	DirectX::XMFLOAT3 up;
-	DirectX::XMFLOAT3 forward;
+	// Marks a transform that has been moved from
+	static const unsigned int INVALID_GENERATION = 0xFFFFFFFF;
 
-	float pitch;
-	float yaw;
+	TransformHandle handle;
 
-	DirectX::XMFLOAT4X4 worldMatrix;
-	DirectX::XMFLOAT4X4 worldInverseTransposeMatrix;
-
-	// Has the transform changed since the matrix was last calculated?
-	bool transformAltered;
-	// Has the rotation changed since the matrix was last calculated?
-	bool rotationAltered;
-
-	void UpdateMatrices();
-	void UpdateRotation();
+	// Shortcuts to this transform's data in the system
+	DirectX::XMFLOAT3& Position();
+	DirectX::XMFLOAT4& Rotation();
+	DirectX::XMFLOAT3& Scale();
+	const DirectX::XMFLOAT3& Position() const;
+	const DirectX::XMFLOAT4& Rotation() const;
+	const DirectX::XMFLOAT3& Scale() const;
 };
 
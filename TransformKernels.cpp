@@ -0,0 +1,195 @@
+#include "TransformKernels.h"
+#include "SimdLanes.h"
+
+#include <cmath>
+
+using namespace DirectX;
+using namespace SimdLanes;
+
+namespace
+{
+	// A batch of transforms in SoA form, one transform per lane
+	struct alignas(32) BatchInput
+	{
+		float px[LaneCount], py[LaneCount], pz[LaneCount];
+		float qx[LaneCount], qy[LaneCount], qz[LaneCount], qw[LaneCount];
+		float sx[LaneCount], sy[LaneCount], sz[LaneCount];
+	};
+
+	// The non-constant elements of each matrix, one transform per lane:
+	// - world is [3x3 scaled rotation | 0] over [translation | 1]
+	// - inverse transpose is [3x3 | column of 3] over [0 0 0 1]
+	struct alignas(32) BatchOutput
+	{
+		float world[3][3][LaneCount];
+		float translation[3][LaneCount];
+		float invTranspose[3][4][LaneCount];
+	};
+
+	// --------------------------------------------------------
+	// The actual math, for a full batch at once
+	// --------------------------------------------------------
+	void CalculateBatch(const BatchInput& in, BatchOutput& out)
+	{
+		Lanes one = Splat(1.0f);
+		Lanes two = Splat(2.0f);
+
+		// Rotation matrix from the quaternion (same layout as XMMatrixRotationQuaternion)
+		Lanes x = Load(in.qx);
+		Lanes y = Load(in.qy);
+		Lanes z = Load(in.qz);
+		Lanes w = Load(in.qw);
+
+		Lanes xx = Mul(x, x), yy = Mul(y, y), zz = Mul(z, z);
+		Lanes xy = Mul(x, y), xz = Mul(x, z), yz = Mul(y, z);
+		Lanes wx = Mul(w, x), wy = Mul(w, y), wz = Mul(w, z);
+
+		Lanes r[3][3];
+		r[0][0] = Sub(one, Mul(two, Add(yy, zz)));
+		r[0][1] = Mul(two, Add(xy, wz));
+		r[0][2] = Mul(two, Sub(xz, wy));
+		r[1][0] = Mul(two, Sub(xy, wz));
+		r[1][1] = Sub(one, Mul(two, Add(xx, zz)));
+		r[1][2] = Mul(two, Add(yz, wx));
+		r[2][0] = Mul(two, Add(xz, wy));
+		r[2][1] = Mul(two, Sub(yz, wx));
+		r[2][2] = Sub(one, Mul(two, Add(xx, yy)));
+
+		Lanes s[3] = { Load(in.sx), Load(in.sy), Load(in.sz) };
+		Lanes p[3] = { Load(in.px), Load(in.py), Load(in.pz) };
+
+		for (int row = 0; row < 3; row++)
+		{
+			// World: each rotation row scaled by its axis' scale
+			for (int col = 0; col < 3; col++)
+				Store(out.world[row][col], Mul(r[row][col], s[row]));
+
+			// Inverse transpose: each rotation row divided by the scale instead,
+			// with the translation (projected onto that row) undone in the last column
+			Lanes invScale = Div(one, s[row]);
+			for (int col = 0; col < 3; col++)
+				Store(out.invTranspose[row][col], Mul(r[row][col], invScale));
+
+			Lanes projected = Add(Add(Mul(p[0], r[row][0]), Mul(p[1], r[row][1])), Mul(p[2], r[row][2]));
+			Store(out.invTranspose[row][3], Sub(Splat(0.0f), Mul(projected, invScale)));
+
+			Store(out.translation[row], p[row]);
+		}
+	}
+
+	// --------------------------------------------------------
+	// Copies one lane of results out to full matrices
+	// --------------------------------------------------------
+	void ScatterLane(const BatchOutput& out, unsigned int lane, XMFLOAT4X4* world, XMFLOAT4X4* invTranspose)
+	{
+		for (int row = 0; row < 3; row++)
+		{
+			for (int col = 0; col < 3; col++)
+				world->m[row][col] = out.world[row][col][lane];
+			world->m[row][3] = 0.0f;
+
+			for (int col = 0; col < 4; col++)
+				invTranspose->m[row][col] = out.invTranspose[row][col][lane];
+		}
+
+		world->m[3][0] = out.translation[0][lane];
+		world->m[3][1] = out.translation[1][lane];
+		world->m[3][2] = out.translation[2][lane];
+		world->m[3][3] = 1.0f;
+
+		invTranspose->m[3][0] = 0.0f;
+		invTranspose->m[3][1] = 0.0f;
+		invTranspose->m[3][2] = 0.0f;
+		invTranspose->m[3][3] = 1.0f;
+	}
+
+	void SetLane(BatchInput& in, unsigned int lane, const XMFLOAT3& position, const XMFLOAT4& rotation, const XMFLOAT3& scale)
+	{
+		in.px[lane] = position.x; in.py[lane] = position.y; in.pz[lane] = position.z;
+		in.qx[lane] = rotation.x; in.qy[lane] = rotation.y; in.qz[lane] = rotation.z; in.qw[lane] = rotation.w;
+		in.sx[lane] = scale.x; in.sy[lane] = scale.y; in.sz[lane] = scale.z;
+	}
+}
+
+
+// --------------------------------------------------------
+// Gathers dirty transforms into batches, runs the kernel
+// and scatters the results back out
+// --------------------------------------------------------
+void TransformKernels::CalculateMatrices(
+	const unsigned int* indices,
+	unsigned int count,
+	const XMFLOAT3* positions,
+	const XMFLOAT4* rotations,
+	const XMFLOAT3* scales,
+	XMFLOAT4X4* worldMatrices,
+	XMFLOAT4X4* worldInverseTransposeMatrices)
+{
+	BatchInput in;
+	BatchOutput out;
+
+	for (unsigned int start = 0; start < count; start += LaneCount)
+	{
+		unsigned int lanesUsed = count - start < LaneCount ? count - start : LaneCount;
+
+		// Unused lanes get an identity transform so they don't divide by zero
+		for (unsigned int lane = 0; lane < LaneCount; lane++)
+		{
+			if (lane < lanesUsed)
+			{
+				unsigned int i = indices[start + lane];
+				SetLane(in, lane, positions[i], rotations[i], scales[i]);
+			}
+			else
+			{
+				SetLane(in, lane, XMFLOAT3(0, 0, 0), XMFLOAT4(0, 0, 0, 1), XMFLOAT3(1, 1, 1));
+			}
+		}
+
+		CalculateBatch(in, out);
+
+		for (unsigned int lane = 0; lane < lanesUsed; lane++)
+		{
+			unsigned int i = indices[start + lane];
+			ScatterLane(out, lane, &worldMatrices[i], &worldInverseTransposeMatrices[i]);
+		}
+	}
+}
+
+void TransformKernels::CalculateMatrices(
+	const XMFLOAT3& position,
+	const XMFLOAT4& rotation,
+	const XMFLOAT3& scale,
+	XMFLOAT4X4* worldMatrix,
+	XMFLOAT4X4* worldInverseTransposeMatrix)
+{
+	// Just a batch with one lane in use
+	unsigned int index = 0;
+	CalculateMatrices(&index, 1, &position, &rotation, &scale, worldMatrix, worldInverseTransposeMatrix);
+}
+
+void TransformKernels::CalculateMatricesReference(
+	const XMFLOAT3& position,
+	const XMFLOAT4& rotation,
+	const XMFLOAT3& scale,
+	XMFLOAT4X4* worldMatrix,
+	XMFLOAT4X4* worldInverseTransposeMatrix)
+{
+	XMMATRIX t = XMMatrixTranslationFromVector(XMLoadFloat3(&position));
+	XMMATRIX r = XMMatrixRotationQuaternion(XMLoadFloat4(&rotation));
+	XMMATRIX s = XMMatrixScalingFromVector(XMLoadFloat3(&scale));
+
+	XMMATRIX world = XMMatrixMultiply(XMMatrixMultiply(s, r), t);
+
+	XMStoreFloat4x4(worldMatrix, world);
+	XMStoreFloat4x4(worldInverseTransposeMatrix, XMMatrixInverse(0, XMMatrixTranspose(world)));
+}
+
+float TransformKernels::MaxDifference(const XMFLOAT4X4& a, const XMFLOAT4X4& b)
+{
+	float maxDiff = 0.0f;
+	for (int row = 0; row < 4; row++)
+		for (int col = 0; col < 4; col++)
+			maxDiff = fmaxf(maxDiff, fabsf(a.m[row][col] - b.m[row][col]));
+	return maxDiff;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+// Batched calculation of world and world inverse transpose matrices
+// straight from position, rotation (unit quaternion) and scale.
+//
+// Rather than building S*R*T and running a general 4x4 inverse, the
+// inverse transpose is written out directly: its upper 3x3 is the
+// rotation with each row divided by that axis' scale, and its last
+// column undoes the translation.  Transforms are processed several at
+// a time, one per SIMD lane - eight with AVX2 (when compiled with
+// /arch:AVX2), four with SSE otherwise.
+//
+// Note: Zero scale has no inverse, just like the general path.
+
+#include <DirectXMath.h>
+
+namespace TransformKernels
+{
+	/// <summary>
+	/// Calculates matrices for a set of transforms, reading and writing each at the given indices
+	/// </summary>
+	/// <param name="indices">Which transforms to calculate</param>
+	/// <param name="count">Number of indices</param>
+	void CalculateMatrices(
+		const unsigned int* indices,
+		unsigned int count,
+		const DirectX::XMFLOAT3* positions,
+		const DirectX::XMFLOAT4* rotations,
+		const DirectX::XMFLOAT3* scales,
+		DirectX::XMFLOAT4X4* worldMatrices,
+		DirectX::XMFLOAT4X4* worldInverseTransposeMatrices);
+
+	/// <summary>
+	/// Same calculation, for a single transform
+	/// </summary>
+	void CalculateMatrices(
+		const DirectX::XMFLOAT3& position,
+		const DirectX::XMFLOAT4& rotation,
+		const DirectX::XMFLOAT3& scale,
+		DirectX::XMFLOAT4X4* worldMatrix,
+		DirectX::XMFLOAT4X4* worldInverseTransposeMatrix);
+
+	/// <summary>
+	/// The original, general path: builds S*R*T and inverts its transpose.
+	/// Slow, but useful for checking the fast path.
+	/// </summary>
+	void CalculateMatricesReference(
+		const DirectX::XMFLOAT3& position,
+		const DirectX::XMFLOAT4& rotation,
+		const DirectX::XMFLOAT3& scale,
+		DirectX::XMFLOAT4X4* worldMatrix,
+		DirectX::XMFLOAT4X4* worldInverseTransposeMatrix);
+
+	/// <summary>
+	/// Largest absolute difference between any two elements of two matrices
+	/// </summary>
+	float MaxDifference(const DirectX::XMFLOAT4X4& a, const DirectX::XMFLOAT4X4& b);
+}
+
@@ -0,0 +1,413 @@
+#include "TransformSystem.h"
+#include "TransformKernels.h"
+
+#include <cassert>
+#include <cmath>
+
+using namespace DirectX;
+
+// Singleton requirement
+TransformSystem* TransformSystem::instance;
+
+TransformSystem::~TransformSystem()
+{
+}
+
+// --------------------------------------------------------
+// Reserves room in every per-slot array
+// --------------------------------------------------------
+void TransformSystem::Reserve(unsigned int transformCount)
+{
+	positions.reserve(transformCount);
+	rotations.reserve(transformCount);
+	scales.reserve(transformCount);
+	flags.reserve(transformCount);
+	versions.reserve(transformCount);
+	worldMatrices.reserve(transformCount);
+	worldInverseTransposeMatrices.reserve(transformCount);
+	rights.reserve(transformCount);
+	ups.reserve(transformCount);
+	forwards.reserve(transformCount);
+	pitches.reserve(transformCount);
+	yaws.reserve(transformCount);
+	parents.reserve(transformCount);
+	parentVersions.reserve(transformCount);
+	localMatrices.reserve(transformCount);
+	localInverseTransposeMatrices.reserve(transformCount);
+	generations.reserve(transformCount);
+}
+
+// --------------------------------------------------------
+// Finds a slot for a new transform, either from the free
+// list or by growing the arrays, and fills it in
+// --------------------------------------------------------
+TransformHandle TransformSystem::Allocate(XMFLOAT3 position, XMFLOAT4 rotation, XMFLOAT3 scale)
+{
+	TransformHandle handle = {};
+
+	if (!freeSlots.empty())
+	{
+		handle.index = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	else
+	{
+		// Grow everything by one
+		handle.index = (unsigned int)flags.size();
+		positions.emplace_back();
+		rotations.emplace_back();
+		scales.emplace_back();
+		flags.emplace_back();
+		versions.emplace_back();
+		worldMatrices.emplace_back();
+		worldInverseTransposeMatrices.emplace_back();
+		rights.emplace_back();
+		ups.emplace_back();
+		forwards.emplace_back();
+		pitches.emplace_back();
+		yaws.emplace_back();
+		parents.emplace_back();
+		parentVersions.emplace_back();
+		localMatrices.emplace_back();
+		localInverseTransposeMatrices.emplace_back();
+		generations.emplace_back(0u);
+	}
+
+	unsigned int i = handle.index;
+	handle.generation = generations[i];
+
+	positions[i] = position;
+	rotations[i] = rotation;
+	scales[i] = scale;
+	XMStoreFloat4x4(&worldMatrices[i], XMMatrixIdentity());
+	XMStoreFloat4x4(&worldInverseTransposeMatrices[i], XMMatrixIdentity());
+	flags[i] = TransformFlag_Alive | TransformFlag_MatricesDirty;
+	versions[i]++; // Keeps counting across reuse, so nothing mistakes this for the slot's last occupant
+	parents[i].index = TRANSFORM_NO_INDEX;
+	parents[i].generation = 0;
+	UpdateRotation(i);
+
+	liveCount++;
+	return handle;
+}
+
+// --------------------------------------------------------
+// Marks a slot as free and invalidates outstanding handles
+// --------------------------------------------------------
+void TransformSystem::Free(TransformHandle handle)
+{
+	if (!IsValid(handle))
+		return;
+
+	// Anything in the hierarchy means the update order needs rebuilding
+	// (orphaned children become roots when that happens)
+	if (parents[handle.index].index != TRANSFORM_NO_INDEX || (flags[handle.index] & TransformFlag_HasChildren))
+		hierarchyChanged = true;
+
+	flags[handle.index] = TransformFlag_None;
+	generations[handle.index]++;
+	freeSlots.push_back(handle.index);
+	liveCount--;
+}
+
+bool TransformSystem::IsValid(TransformHandle handle)
+{
+	return handle.index < flags.size() &&
+		generations[handle.index] == handle.generation &&
+		(flags[handle.index] & TransformFlag_Alive);
+}
+
+// --------------------------------------------------------
+// Parents a transform to another, refusing to create cycles
+// --------------------------------------------------------
+bool TransformSystem::SetParent(TransformHandle child, TransformHandle parent)
+{
+	if (!IsValid(child))
+		return false;
+
+	bool detaching = parent.index == TRANSFORM_NO_INDEX;
+	if (!detaching)
+	{
+		if (!IsValid(parent))
+			return false;
+
+		// Walk up from the new parent - finding the child means it's an ancestor
+		for (unsigned int i = parent.index; i != TRANSFORM_NO_INDEX; i = parents[i].index)
+		{
+			if (i == child.index)
+				return false;
+		}
+
+		flags[parent.index] |= TransformFlag_HasChildren;
+	}
+
+	parents[child.index].index = detaching ? TRANSFORM_NO_INDEX : parent.index;
+	parents[child.index].generation = detaching ? 0 : parent.generation;
+	MarkMoved(child.index);
+	hierarchyChanged = true;
+	return true;
+}
+
+TransformHandle TransformSystem::GetParent(TransformHandle child)
+{
+	TransformHandle none = { TRANSFORM_NO_INDEX, 0 };
+	if (!IsValid(child) || !IsValid(parents[child.index]))
+		return none;
+
+	return parents[child.index];
+}
+
+// --------------------------------------------------------
+// Recalculates every out of date world matrix:
+//  1. Local matrices of everything that changed, in SIMD
+//     batches (roots go straight to their world matrices)
+//  2. One pass over the children, parents first, combining
+//     local matrices with their (finished) parent's world
+// --------------------------------------------------------
+void TransformSystem::UpdateAllMatrices()
+{
+	if (hierarchyChanged)
+		RebuildChildUpdateOrder();
+
+	dirtyIndices.clear();
+	dirtyChildIndices.clear();
+	unsigned int count = (unsigned int)flags.size();
+	for (unsigned int i = 0; i < count; i++)
+	{
+		if (!(flags[i] & TransformFlag_MatricesDirty))
+			continue;
+
+		if (parents[i].index == TRANSFORM_NO_INDEX)
+			dirtyIndices.push_back(i);
+		else
+			dirtyChildIndices.push_back(i);
+	}
+
+	TransformKernels::CalculateMatrices(
+		dirtyIndices.data(),
+		(unsigned int)dirtyIndices.size(),
+		positions.data(),
+		rotations.data(),
+		scales.data(),
+		worldMatrices.data(),
+		worldInverseTransposeMatrices.data());
+
+	TransformKernels::CalculateMatrices(
+		dirtyChildIndices.data(),
+		(unsigned int)dirtyChildIndices.size(),
+		positions.data(),
+		rotations.data(),
+		scales.data(),
+		localMatrices.data(),
+		localInverseTransposeMatrices.data());
+
+#if defined(TRANSFORM_VERIFY_MATRICES)
+	VerifyMatrices();
+#endif
+
+	for (unsigned int i : dirtyIndices)
+		flags[i] &= ~TransformFlag_MatricesDirty;
+
+	// Parents always come before their children here, so by the time a child is
+	// reached its parent's world matrix (and version) are final for this frame
+	for (unsigned int i : childUpdateOrder)
+	{
+		bool locallyDirty = (flags[i] & TransformFlag_MatricesDirty) != 0;
+		bool parentChanged = parentVersions[i] != versions[parents[i].index];
+		if (!locallyDirty && !parentChanged)
+			continue;
+
+		CombineWithParent(i);
+		flags[i] &= ~TransformFlag_MatricesDirty;
+
+		// Moved by a parent counts as a change, too (this is what
+		// lets the change propagate down to grandchildren)
+		if (!locallyDirty)
+			versions[i]++;
+	}
+}
+
+// --------------------------------------------------------
+// Brings a single world matrix up to date, along with any
+// ancestors that are out of date themselves
+// --------------------------------------------------------
+void TransformSystem::UpdateMatrices(unsigned int index)
+{
+	if (hierarchyChanged)
+		RebuildChildUpdateOrder();
+
+	unsigned int parent = parents[index].index;
+	bool locallyDirty = (flags[index] & TransformFlag_MatricesDirty) != 0;
+
+	// Roots have nothing to combine with
+	if (parent == TRANSFORM_NO_INDEX)
+	{
+		if (locallyDirty)
+		{
+			TransformKernels::CalculateMatrices(
+				positions[index],
+				rotations[index],
+				scales[index],
+				&worldMatrices[index],
+				&worldInverseTransposeMatrices[index]);
+
+			flags[index] &= ~TransformFlag_MatricesDirty;
+		}
+		return;
+	}
+
+	// Parent first (which may in turn bump its version)
+	UpdateMatrices(parent);
+	bool parentChanged = parentVersions[index] != versions[parent];
+	if (!locallyDirty && !parentChanged)
+		return;
+
+	if (locallyDirty)
+	{
+		TransformKernels::CalculateMatrices(
+			positions[index],
+			rotations[index],
+			scales[index],
+			&localMatrices[index],
+			&localInverseTransposeMatrices[index]);
+	}
+
+	CombineWithParent(index);
+	flags[index] &= ~TransformFlag_MatricesDirty;
+	if (!locallyDirty)
+		versions[index]++;
+}
+
+// --------------------------------------------------------
+// World = local * parent's world, and since inverting and
+// transposing a product reverses it twice, the inverse
+// transpose is local inverse transpose * parent's
+// --------------------------------------------------------
+void TransformSystem::CombineWithParent(unsigned int index)
+{
+	unsigned int parent = parents[index].index;
+
+	XMStoreFloat4x4(&worldMatrices[index], XMMatrixMultiply(
+		XMLoadFloat4x4(&localMatrices[index]),
+		XMLoadFloat4x4(&worldMatrices[parent])));
+
+	XMStoreFloat4x4(&worldInverseTransposeMatrices[index], XMMatrixMultiply(
+		XMLoadFloat4x4(&localInverseTransposeMatrices[index]),
+		XMLoadFloat4x4(&worldInverseTransposeMatrices[parent])));
+
+	parentVersions[index] = versions[parent];
+}
+
+// --------------------------------------------------------
+// Sorts every transform with a parent by depth, so parents
+// are always updated before children.  Children whose
+// parent has been freed are turned into roots, and only
+// transforms that still have children keep that flag.
+// --------------------------------------------------------
+void TransformSystem::RebuildChildUpdateOrder()
+{
+	unsigned int count = (unsigned int)flags.size();
+
+	// Deal with orphans first, so depths below are all valid (and
+	// clear every flag for children, which the depth pass sets again)
+	for (unsigned int i = 0; i < count; i++)
+	{
+		flags[i] &= ~TransformFlag_HasChildren;
+		if ((flags[i] & TransformFlag_Alive) &&
+			parents[i].index != TRANSFORM_NO_INDEX &&
+			!IsValid(parents[i]))
+		{
+			parents[i].index = TRANSFORM_NO_INDEX;
+			parents[i].generation = 0;
+			MarkMoved(i); // Its world matrix is now just its local one
+		}
+	}
+
+	// Depth of each transform (0 for roots), counting how many are at each depth
+	std::vector<unsigned int> depths(count, 0);
+	std::vector<unsigned int> depthCounts;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		if (!(flags[i] & TransformFlag_Alive) || parents[i].index == TRANSFORM_NO_INDEX)
+			continue;
+
+		flags[parents[i].index] |= TransformFlag_HasChildren;
+		unsigned int depth = 0;
+		for (unsigned int p = i; parents[p].index != TRANSFORM_NO_INDEX; p = parents[p].index)
+			depth++;
+
+		depths[i] = depth;
+		if (depthCounts.size() <= depth)
+			depthCounts.resize(depth + 1, 0);
+		depthCounts[depth]++;
+	}
+
+	// Counting sort by depth (keeps slot order within a depth, so memory access stays mostly linear)
+	std::vector<unsigned int> depthStarts(depthCounts.size(), 0);
+	for (unsigned int d = 1; d < depthCounts.size(); d++)
+		depthStarts[d] = depthStarts[d - 1] + depthCounts[d - 1];
+
+	childUpdateOrder.resize(depthCounts.empty() ? 0 : depthStarts.back() + depthCounts.back());
+	for (unsigned int i = 0; i < count; i++)
+	{
+		if (depths[i] > 0)
+			childUpdateOrder[depthStarts[depths[i]]++] = i;
+	}
+
+	hierarchyChanged = false;
+}
+
+void TransformSystem::UpdateRotation(unsigned int index)
+{
+	XMVECTOR rotation = XMLoadFloat4(&rotations[index]);
+	XMStoreFloat3(&rights[index], XMVector3Normalize(XMVector3Rotate(XMVectorSet(1, 0, 0, 0), rotation)));
+	XMStoreFloat3(&ups[index], XMVector3Normalize(XMVector3Rotate(XMVectorSet(0, 1, 0, 0), rotation)));
+	XMStoreFloat3(&forwards[index], XMVector3Normalize(XMVector3Rotate(XMVectorSet(0, 0, 1, 0), rotation)));
+
+	XMFLOAT3& forward = forwards[index];
+	float& yaw = yaws[index];
+	XMStoreFloat(&yaw, XMVector3AngleBetweenVectors(XMVectorSet(0, 0, 1, 0), XMVectorSet(forward.x, 0, forward.z, 0)) * copysignf(1, forward.x));
+	XMStoreFloat(&pitches[index], XMVector3AngleBetweenVectors(XMVectorSet(sinf(yaw), 0, cosf(yaw), 0), XMLoadFloat3(&forward)) * copysignf(1, -forward.y));
+
+	flags[index] &= ~TransformFlag_RotationDirty;
+}
+
+#if defined(TRANSFORM_VERIFY_MATRICES)
+// --------------------------------------------------------
+// Checks the batched results for the transforms that were
+// just updated against the general (S*R*T, then invert)
+// path, and asserts if they've drifted apart
+// --------------------------------------------------------
+void TransformSystem::VerifyMatrices()
+{
+	// Roots are checked against their world matrices, children their local ones
+	for (unsigned int i : dirtyIndices)
+		VerifyMatrices(i, worldMatrices[i], worldInverseTransposeMatrices[i]);
+	for (unsigned int i : dirtyChildIndices)
+		VerifyMatrices(i, localMatrices[i], localInverseTransposeMatrices[i]);
+}
+
+void TransformSystem::VerifyMatrices(unsigned int index, const XMFLOAT4X4& batchedMatrix, const XMFLOAT4X4& batchedInverseTranspose)
+{
+	const float tolerance = 1e-4f;
+
+	XMFLOAT4X4 reference;
+	XMFLOAT4X4 referenceInverseTranspose;
+	TransformKernels::CalculateMatricesReference(positions[index], rotations[index], scales[index], &reference, &referenceInverseTranspose);
+
+	// Relative to the size of the values involved, since large
+	// translations and tiny scales naturally lose precision
+	float matrixScale = 1.0f;
+	float inverseTransposeScale = 1.0f;
+	for (int e = 0; e < 16; e++)
+	{
+		matrixScale = fmaxf(matrixScale, fabsf((&reference._11)[e]));
+		inverseTransposeScale = fmaxf(inverseTransposeScale, fabsf((&referenceInverseTranspose._11)[e]));
+	}
+
+	float matrixError = TransformKernels::MaxDifference(reference, batchedMatrix) / matrixScale;
+	float inverseTransposeError = TransformKernels::MaxDifference(referenceInverseTranspose, batchedInverseTranspose) / inverseTransposeScale;
+	assert(matrixError <= tolerance && "Batched matrix differs from the reference");
+	assert(inverseTransposeError <= tolerance && "Batched inverse transpose differs from the reference");
+}
+#endif
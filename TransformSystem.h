@@ -0,0 +1,194 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+// Identifies a single transform's slot in the TransformSystem
+struct TransformHandle
+{
+	unsigned int index;
+	unsigned int generation; // Catches handles to slots that have been freed and reused
+};
+
+// Index used by handles that don't refer to anything (such as a root's parent)
+#define TRANSFORM_NO_INDEX 0xFFFFFFFF
+
+// Per-slot state flags
+enum TransformFlags : unsigned char
+{
+	TransformFlag_None = 0,
+	TransformFlag_Alive = 1 << 0,
+	TransformFlag_MatricesDirty = 1 << 1,	// Local (and therefore world) matrices need recalculating
+	TransformFlag_RotationDirty = 1 << 2,	// Basis vectors, pitch & yaw need recalculating
+	TransformFlag_HasChildren = 1 << 3		// Something has been parented to this slot
+};
+
+// Owns the data for every transform in the game, stored as parallel
+// arrays (one per attribute) indexed by handle rather than as individual
+// heap objects.  Walking every transform - updating entities, packing
+// the TLAS, recalculating matrices - then streams linearly through
+// memory instead of chasing pointers.
+//
+// Transforms can be parented to one another.  Position, rotation and
+// scale are then relative to the parent, and world matrices are built
+// in breadth-first order (every parent before any of its children), so
+// a single linear pass over that order updates the whole scene.  Only
+// subtrees below something that changed are recalculated, and children
+// moved by their parents get their versions bumped like anything else.
+//
+// Transform is a thin wrapper around a handle into this system.
+//
+// Define TRANSFORM_VERIFY_MATRICES to check every batched matrix against
+// the general (S*R*T, then invert) path as it's calculated, asserting if
+// they've drifted apart - it redoes all the work, so it's off otherwise.
+class TransformSystem
+{
+#pragma region Singleton
+public:
+	// Gets the one and only instance of this class
+	static TransformSystem& GetInstance()
+	{
+		if (!instance)
+		{
+			instance = new TransformSystem();
+		}
+
+		return *instance;
+	}
+
+	// Remove these functions (C++ 11 version)
+	TransformSystem(TransformSystem const&) = delete;
+	void operator=(TransformSystem const&) = delete;
+
+private:
+	static TransformSystem* instance;
+	TransformSystem() :
+		hierarchyChanged(false),
+		liveCount(0)
+	{};
+#pragma endregion
+
+public:
+	~TransformSystem();
+
+	/// <summary>
+	/// Grows every array up front, so large scenes don't reallocate while being created
+	/// </summary>
+	/// <param name="transformCount">Total number of transforms expected</param>
+	void Reserve(unsigned int transformCount);
+
+	/// <summary>
+	/// Grabs a slot (reusing a freed one if possible) and fills it in
+	/// </summary>
+	/// <returns>Handle to the new transform</returns>
+	TransformHandle Allocate(DirectX::XMFLOAT3 position, DirectX::XMFLOAT4 rotation, DirectX::XMFLOAT3 scale);
+
+	/// <summary>
+	/// Returns a slot to the system.  The handle (and any copies of it) are invalid afterwards.
+	/// </summary>
+	void Free(TransformHandle handle);
+
+	bool IsValid(TransformHandle handle);
+
+	/// <summary>
+	/// Attaches a transform to a parent, so its position, rotation and scale
+	/// become relative to that parent.  The local values are kept as they are.
+	/// </summary>
+	/// <param name="child">Transform to attach</param>
+	/// <param name="parent">New parent, or a handle with TRANSFORM_NO_INDEX to detach</param>
+	/// <returns>False (and no change) if this would create a cycle</returns>
+	bool SetParent(TransformHandle child, TransformHandle parent);
+	TransformHandle GetParent(TransformHandle child);
+
+	/// <summary>
+	/// Recalculates the world matrices of every dirty transform in a single
+	/// linear pass, several at a time (see TransformKernels).  Anything left
+	/// dirty is still recalculated lazily on access.  Debug builds also check
+	/// the results against the general matrix inverse.
+	/// </summary>
+	void UpdateAllMatrices();
+
+	// Single slot updates (used by Transform for lazy recalculation - also updates any stale ancestors)
+	void UpdateMatrices(unsigned int index);
+	void UpdateRotation(unsigned int index);
+
+	// Change tracking
+	void MarkMoved(unsigned int index)
+	{
+		flags[index] |= TransformFlag_MatricesDirty;
+		versions[index]++;
+	}
+	void MarkRotated(unsigned int index)
+	{
+		flags[index] |= TransformFlag_MatricesDirty | TransformFlag_RotationDirty;
+		versions[index]++;
+	}
+
+	// Counts
+	unsigned int GetSlotCount() { return (unsigned int)flags.size(); } // Live and free slots
+	unsigned int GetLiveCount() { return liveCount; }
+
+	// Raw per-slot arrays, indexed by TransformHandle::index (only valid until the next Allocate)
+	DirectX::XMFLOAT3* GetPositions() { return positions.data(); }
+	DirectX::XMFLOAT4* GetRotations() { return rotations.data(); }
+	DirectX::XMFLOAT3* GetScales() { return scales.data(); }
+	DirectX::XMFLOAT4X4* GetWorldMatrices() { return worldMatrices.data(); }
+	DirectX::XMFLOAT4X4* GetWorldInverseTransposeMatrices() { return worldInverseTransposeMatrices.data(); }
+	TransformHandle* GetParents() { return parents.data(); }
+	DirectX::XMFLOAT3* GetRights() { return rights.data(); }
+	DirectX::XMFLOAT3* GetUps() { return ups.data(); }
+	DirectX::XMFLOAT3* GetForwards() { return forwards.data(); }
+	float* GetPitches() { return pitches.data(); }
+	float* GetYaws() { return yaws.data(); }
+	unsigned int* GetVersions() { return versions.data(); }
+	unsigned char* GetFlags() { return flags.data(); }
+
+private:
+	// Hot data, touched whenever anything moves
+	std::vector<DirectX::XMFLOAT3> positions;
+	std::vector<DirectX::XMFLOAT4> rotations;
+	std::vector<DirectX::XMFLOAT3> scales;
+	std::vector<unsigned char> flags;
+	std::vector<unsigned int> versions; // Bumped on every change (and on reuse - never reset)
+
+	// Derived data
+	std::vector<DirectX::XMFLOAT4X4> worldMatrices;
+	std::vector<DirectX::XMFLOAT4X4> worldInverseTransposeMatrices;
+
+	// Hierarchy
+	// - Local matrices are only kept up to date for transforms with a parent
+	//   (for roots, local and world are the same thing)
+	// - parentVersions holds the parent's version when the world matrix was
+	//   last built, which is how parent changes are noticed
+	std::vector<TransformHandle> parents;
+	std::vector<unsigned int> parentVersions;
+	std::vector<DirectX::XMFLOAT4X4> localMatrices;
+	std::vector<DirectX::XMFLOAT4X4> localInverseTransposeMatrices;
+	std::vector<unsigned int> childUpdateOrder; // Every transform with a parent, shallowest first
+	bool hierarchyChanged;
+
+	// Cold data, mostly used by cameras
+	std::vector<DirectX::XMFLOAT3> rights;
+	std::vector<DirectX::XMFLOAT3> ups;
+	std::vector<DirectX::XMFLOAT3> forwards;
+	std::vector<float> pitches;
+	std::vector<float> yaws;
+
+	// Slot bookkeeping
+	std::vector<unsigned int> generations;
+	std::vector<unsigned int> freeSlots;
+	unsigned int liveCount;
+
+	// Scratch lists of transforms being updated this frame (reused to avoid reallocating)
+	std::vector<unsigned int> dirtyIndices;
+	std::vector<unsigned int> dirtyChildIndices;
+
+	void RebuildChildUpdateOrder();
+	void CombineWithParent(unsigned int index);
+
+#if defined(TRANSFORM_VERIFY_MATRICES)
+	void VerifyMatrices();
+	void VerifyMatrices(unsigned int index, const DirectX::XMFLOAT4X4& batchedMatrix, const DirectX::XMFLOAT4X4& batchedInverseTranspose);
+#endif
+};
+
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+
+// Hands the latest copy of some data from one thread to another without
+// either side ever waiting on the other.
+//
+// Of the three buffers, the writer owns one (filling it in), the reader
+// owns one (reading the last thing it grabbed) and the third sits in the
+// middle holding the most recent finished copy.  Publishing and acquiring
+// are each a single atomic exchange with that middle slot, so the writer
+// can publish as often as it likes (older, unread copies are simply
+// overwritten) and the reader always gets the newest one.
+//
+// Exactly one thread may write and exactly one may read.
+template<typename T>
+class TripleBuffer
+{
+public:
+	TripleBuffer() :
+		writeIndex(0),
+		middle(1),
+		readIndex(2)
+	{}
+
+	TripleBuffer(TripleBuffer const&) = delete;
+	void operator=(TripleBuffer const&) = delete;
+
+	/// <summary>
+	/// Writer only: the buffer to fill in before the next Publish().  Holds
+	/// whatever was in it last time it was written, so anything that's fully
+	/// rewritten each time can reuse its memory.
+	/// </summary>
+	T& GetWriteBuffer() { return buffers[writeIndex]; }
+
+	/// <summary>
+	/// Writer only: makes the write buffer the newest copy, and grabs a new write buffer
+	/// </summary>
+	void Publish()
+	{
+		unsigned int previous = middle.exchange(writeIndex | FreshBit, std::memory_order_acq_rel);
+		writeIndex = previous & IndexMask;
+	}
+
+	/// <summary>
+	/// Reader only: has a new copy been published since the last Acquire()?
+	/// </summary>
+	bool HasUpdate() const { return (middle.load(std::memory_order_relaxed) & FreshBit) != 0; }
+
+	/// <summary>
+	/// Reader only: swaps in the newest copy, if there's been one since the last call
+	/// </summary>
+	/// <returns>True if the read buffer changed</returns>
+	bool Acquire()
+	{
+		// Nothing new?  (Only the reader clears the bit, so this can't go stale)
+		if (!HasUpdate())
+			return false;
+
+		unsigned int previous = middle.exchange(readIndex, std::memory_order_acq_rel);
+		readIndex = previous & IndexMask;
+		return true;
+	}
+
+	/// <summary>
+	/// Reader only: the copy grabbed by the last successful Acquire()
+	/// </summary>
+	const T& GetReadBuffer() const { return buffers[readIndex]; }
+
+private:
+	static const unsigned int IndexMask = 0x3;
+	static const unsigned int FreshBit = 0x4; // Set in the middle slot when it hasn't been read yet
+
+	T buffers[3];
+	unsigned int writeIndex;
+	std::atomic<unsigned int> middle;
+	unsigned int readIndex;
+};
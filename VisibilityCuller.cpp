@@ -0,0 +1,152 @@
+#include "VisibilityCuller.h"
+#include "Mesh.h"
+#include "SimdLanes.h"
+
+#include <math.h>
+
+using namespace DirectX;
+using namespace SimdLanes;
+
+namespace
+{
+	// A batch of boxes in SoA form, one box per lane
+	struct alignas(32) BoxBatch
+	{
+		float centerX[LaneCount], centerY[LaneCount], centerZ[LaneCount];
+		float extentX[LaneCount], extentY[LaneCount], extentZ[LaneCount];
+	};
+
+	void SetLane(BoxBatch& batch, unsigned int lane, const AABB& box)
+	{
+		batch.centerX[lane] = (box.minCorner.x + box.maxCorner.x) * 0.5f;
+		batch.centerY[lane] = (box.minCorner.y + box.maxCorner.y) * 0.5f;
+		batch.centerZ[lane] = (box.minCorner.z + box.maxCorner.z) * 0.5f;
+		batch.extentX[lane] = (box.maxCorner.x - box.minCorner.x) * 0.5f;
+		batch.extentY[lane] = (box.maxCorner.y - box.minCorner.y) * 0.5f;
+		batch.extentZ[lane] = (box.maxCorner.z - box.minCorner.z) * 0.5f;
+	}
+
+	// --------------------------------------------------------
+	// A box is outside a plane when even its furthest point
+	// along the plane's normal (the center plus the extents
+	// projected onto the normal) is behind it
+	// --------------------------------------------------------
+	bool IsOutside(const XMFLOAT3& center, const XMFLOAT3& extents, const XMFLOAT4& plane)
+	{
+		float distance = center.x * plane.x + center.y * plane.y + center.z * plane.z + plane.w;
+		float radius = extents.x * fabsf(plane.x) + extents.y * fabsf(plane.y) + extents.z * fabsf(plane.z);
+		return distance + radius < 0.0f;
+	}
+}
+
+VisibilityCuller::VisibilityCuller() :
+	stats()
+{
+}
+
+
+void VisibilityCuller::SetBounds(const std::vector<std::shared_ptr<Entity>>& scene)
+{
+	bounds.resize(scene.size());
+	for (unsigned int i = 0; i < scene.size(); i++)
+		bounds[i] = Bounds::Transform(scene[i]->GetMesh()->GetLocalBounds(), scene[i]->GetTransform()->GetWorldMatrix());
+}
+
+void VisibilityCuller::SetBounds(const SceneSnapshot& snapshot)
+{
+	bounds.resize(snapshot.instances.size());
+	for (unsigned int i = 0; i < snapshot.instances.size(); i++)
+	{
+		const SnapshotInstance& instance = snapshot.instances[i];
+		bounds[i] = instance.mesh ? Bounds::Transform(instance.mesh->GetLocalBounds(), instance.worldMatrix) : Bounds::Empty();
+	}
+}
+
+void VisibilityCuller::SetBounds(const AABB* worldBounds, unsigned int count)
+{
+	bounds.assign(worldBounds, worldBounds + count);
+}
+
+// --------------------------------------------------------
+// Gathers boxes into batches and tests each batch against
+// all six planes at once
+// --------------------------------------------------------
+void VisibilityCuller::Cull(const XMFLOAT4X4& viewProjection, std::vector<unsigned int>& visible)
+{
+	visible.clear();
+	stats = {};
+	stats.tested = (unsigned int)bounds.size();
+
+	// Each plane's values, splatted across every lane
+	Frustum frustum = Bounds::FrustumFromViewProjection(viewProjection);
+	Lanes planeX[6], planeY[6], planeZ[6], planeW[6];
+	Lanes absPlaneX[6], absPlaneY[6], absPlaneZ[6];
+	for (int p = 0; p < 6; p++)
+	{
+		const XMFLOAT4& plane = frustum.planes[p];
+		planeX[p] = Splat(plane.x); planeY[p] = Splat(plane.y); planeZ[p] = Splat(plane.z); planeW[p] = Splat(plane.w);
+		absPlaneX[p] = Splat(fabsf(plane.x)); absPlaneY[p] = Splat(fabsf(plane.y)); absPlaneZ[p] = Splat(fabsf(plane.z));
+	}
+
+	Lanes zero = Splat(0.0f);
+	BoxBatch batch = {};
+	unsigned int count = (unsigned int)bounds.size();
+	for (unsigned int start = 0; start < count; start += LaneCount)
+	{
+		unsigned int lanesUsed = count - start < LaneCount ? count - start : LaneCount;
+		for (unsigned int lane = 0; lane < lanesUsed; lane++)
+			SetLane(batch, lane, bounds[start + lane]);
+
+		Lanes centerX = Load(batch.centerX), centerY = Load(batch.centerY), centerZ = Load(batch.centerZ);
+		Lanes extentX = Load(batch.extentX), extentY = Load(batch.extentY), extentZ = Load(batch.extentZ);
+
+		Lanes outside = zero;
+		for (int p = 0; p < 6; p++)
+		{
+			Lanes distance = Add(Add(Add(Mul(centerX, planeX[p]), Mul(centerY, planeY[p])), Mul(centerZ, planeZ[p])), planeW[p]);
+			Lanes radius = Add(Add(Mul(extentX, absPlaneX[p]), Mul(extentY, absPlaneY[p])), Mul(extentZ, absPlaneZ[p]));
+			outside = Or(outside, Less(Add(distance, radius), zero));
+		}
+
+		// Lanes past the end of the scene hold stale boxes, so only look at the used ones
+		unsigned int outsideMask = Mask(outside);
+		for (unsigned int lane = 0; lane < lanesUsed; lane++)
+		{
+			unsigned int i = start + lane;
+			if (outsideMask & (1u << lane))
+				stats.frustumCulled++;
+			else
+				visible.push_back(i);
+		}
+	}
+
+	stats.visible = (unsigned int)visible.size();
+}
+
+void VisibilityCuller::CullFrustumReference(const XMFLOAT4X4& viewProjection, std::vector<unsigned int>& visible)
+{
+	visible.clear();
+	Frustum frustum = Bounds::FrustumFromViewProjection(viewProjection);
+	for (unsigned int i = 0; i < bounds.size(); i++)
+	{
+		XMFLOAT3 center = Bounds::GetCenter(bounds[i]);
+		XMFLOAT3 extents = Bounds::GetHalfExtents(bounds[i]);
+
+		bool outside = false;
+		for (int p = 0; p < 6 && !outside; p++)
+			outside = IsOutside(center, extents, frustum.planes[p]);
+
+		if (!outside)
+			visible.push_back(i);
+	}
+}
+
+const CullingStats& VisibilityCuller::GetStats()
+{
+	return stats;
+}
+
+unsigned int VisibilityCuller::GetCount()
+{
+	return (unsigned int)bounds.size();
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+// Works out which entities are worth drawing before the raster path
+// issues any draws, with a frustum test against the camera.  Produces a
+// compact list of the indices that survive, in their original order.
+//
+// The test runs several boxes at a time, one per SIMD lane (see
+// SimdLanes.h), as center/extents against each plane.
+//
+// Needs nothing from the GPU, so it can be run on synthetic scenes
+// (see CullingBenchmark).
+
+#include <DirectXMath.h>
+#include <memory>
+#include <vector>
+
+#include "Bounds.h"
+#include "Entity.h"
+#include "SceneSnapshot.h"
+
+// What happened during the last Cull()
+struct CullingStats
+{
+	unsigned int tested;
+	unsigned int frustumCulled;
+	unsigned int visible;
+};
+
+class VisibilityCuller
+{
+public:
+	VisibilityCuller();
+
+	/// <summary>
+	/// Takes each entity's world space bounds (from its mesh's bounds and its transform)
+	/// </summary>
+	/// <param name="scene">Entities to cull (must be owned by the calling thread)</param>
+	void SetBounds(const std::vector<std::shared_ptr<Entity>>& scene);
+
+	/// <summary>
+	/// Same as above, from a snapshot of the scene
+	/// </summary>
+	void SetBounds(const SceneSnapshot& snapshot);
+
+	/// <summary>
+	/// Same as above, from boxes that are already in world space
+	/// </summary>
+	void SetBounds(const AABB* worldBounds, unsigned int count);
+
+	/// <summary>
+	/// Finds everything that could be visible
+	/// </summary>
+	/// <param name="viewProjection">The camera's view * projection matrix</param>
+	/// <param name="visible">Cleared, then filled with the index of everything visible</param>
+	void Cull(const DirectX::XMFLOAT4X4& viewProjection, std::vector<unsigned int>& visible);
+
+	/// <summary>
+	/// The frustum test one box at a time, for checking the batched version against
+	/// </summary>
+	void CullFrustumReference(const DirectX::XMFLOAT4X4& viewProjection, std::vector<unsigned int>& visible);
+
+	const CullingStats& GetStats();
+	unsigned int GetCount();
+
+private:
+	std::vector<AABB> bounds;
+	CullingStats stats;
+};
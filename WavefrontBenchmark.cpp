@@ -0,0 +1,92 @@
+#include "WavefrontBenchmark.h"
+#include "BenchmarkUtils.h"
+#include "CpuRaytracer.h"
+
+#include <stdio.h>
+#include <vector>
+
+using namespace DirectX;
+using namespace BenchmarkUtils;
+
+bool WavefrontBenchmark::Run()
+{
+	return Run(320, 180, 8, 4);
+}
+
+// --------------------------------------------------------
+// Renders the same frames path by path, as a wavefront,
+// and path by path again with another seed (for the noise
+// level), timing the first two
+// --------------------------------------------------------
+bool WavefrontBenchmark::Run(unsigned int width, unsigned int height, unsigned int samplesPerPixel, unsigned int frames)
+{
+	printf("Wavefront benchmark: %ux%u, %u samples per pixel per frame, %u frames\n", width, height, samplesPerPixel, frames);
+
+	Scene scene;
+	CreateScene(&scene, (float)width / height);
+
+	CpuRaytracer tracers[3];
+	const char* names[3] = { "path by path", "wavefront", "" };
+	for (unsigned int t = 0; t < 3; t++)
+	{
+		tracers[t].Resize(width, height);
+		tracers[t].SetSamplesPerPixel(samplesPerPixel);
+		tracers[t].SetWavefront(t == 1);
+		tracers[t].SetSeed(t == 2 ? 1 : 0);
+	}
+
+	double times[3] = {};
+	unsigned long long rays[3] = {};
+	WavefrontStats stats = {};
+	for (unsigned int t = 0; t < 3; t++)
+	{
+		for (unsigned int frame = 0; frame < frames; frame++)
+		{
+			Clock::time_point start = Clock::now();
+			tracers[t].Render(scene.snapshot, scene.cameraPosition, scene.view, scene.projection);
+			times[t] += MillisecondsSince(start);
+			rays[t] += tracers[t].GetRaysCast();
+
+			if (t == 1)
+			{
+				WavefrontStats frameStats = tracers[t].GetWavefrontStats();
+				stats.paths += frameStats.paths;
+				stats.bounces = frameStats.bounces > stats.bounces ? frameStats.bounces : stats.bounces;
+				stats.pathRays += frameStats.pathRays;
+				stats.shadowRays += frameStats.shadowRays;
+				stats.lanesRun += frameStats.lanesRun;
+			}
+		}
+	}
+
+	for (unsigned int t = 0; t < 2; t++)
+	{
+		printf("  %-14s %8.1f ms   %llu rays cast (%.2f Mrays/s)\n",
+			names[t], times[t], rays[t], times[t] > 0 ? rays[t] / (times[t] * 1000.0) : 0.0);
+	}
+
+	printf("  %.2f bounces per path (up to %u), %.2f shadow rays per path\n",
+		stats.paths > 0 ? (double)stats.pathRays / stats.paths : 0.0,
+		stats.bounces,
+		stats.paths > 0 ? (double)stats.shadowRays / stats.paths : 0.0);
+	// Without compaction, paths that ended would keep holding their lanes
+	double compacted = stats.lanesRun > 0 ? (double)stats.pathRays / stats.lanesRun : 0.0;
+	double uncompacted = stats.paths > 0 && stats.bounces > 0 ? (double)stats.pathRays / ((double)stats.paths * stats.bounces) : 0.0;
+	printf("  shading lanes holding a path: %.1f%% compacted, %.1f%% if every lane waited for the longest path   %s\n",
+		100.0 * compacted, 100.0 * uncompacted, Verdict(compacted > uncompacted));
+
+	// Same samples, so any difference should be far below the noise
+	std::vector<XMFLOAT3> images[3];
+	for (unsigned int t = 0; t < 3; t++)
+		GetImage(tracers[t], &images[t]);
+	double difference = MeanSquaredError(images[1], images[0]);
+	double noise = MeanSquaredError(images[2], images[0]);
+	printf("  wavefront vs path by path MSE %.8f, vs another seed %.8f   %s\n",
+		difference, noise, Verdict(difference < noise * 0.01));
+
+	bool passed = true;
+	passed &= Expect(stats.paths == width * height * samplesPerPixel * frames, "the wavefront to trace every sample");
+	passed &= Expect(compacted > uncompacted, "compaction to keep more lanes busy");
+	passed &= Expect(difference < noise * 0.01, "the wavefront's image to match path by path far below the noise");
+	return passed;
+}
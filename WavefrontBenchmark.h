@@ -0,0 +1,31 @@
+#pragma once
+
+// Measures the CPU tracer's wavefront mode against tracing each path start
+// to finish, without the GPU: renders the benchmark scene (BenchmarkUtils.h)
+// both ways with the same samples, reporting time and rays per second, how
+// full the SIMD lanes of the shading math stay (and how full they'd be if
+// paths weren't compacted between bounces), and how far apart the two
+// images are compared to the noise between two differently seeded renders
+// - they should differ by rounding, not by noise.  Start the program with
+// -benchmark to run it (see HeadlessTests.h); it fails if the wavefront
+// misses samples, if compaction doesn't keep more lanes busy, or if the
+// images differ by more than a hundredth of the noise.
+
+namespace WavefrontBenchmark
+{
+	/// <summary>
+	/// Runs the benchmark at 320x180 with 8 samples per pixel, 4 frames each way
+	/// </summary>
+	/// <returns>Whether the wavefront traced the same image, with its lanes kept fuller</returns>
+	bool Run();
+
+	/// <summary>
+	/// Runs the benchmark with a specific image size, samples per pixel and frames
+	/// </summary>
+	/// <param name="width">Image width in pixels</param>
+	/// <param name="height">Image height in pixels</param>
+	/// <param name="samplesPerPixel">Samples each pixel gets per frame</param>
+	/// <param name="frames">How many frames to render each way (accumulating)</param>
+	/// <returns>Whether the wavefront traced the same image, with its lanes kept fuller</returns>
+	bool Run(unsigned int width, unsigned int height, unsigned int samplesPerPixel, unsigned int frames);
+}
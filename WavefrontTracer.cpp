@@ -0,0 +1,555 @@
+#include "WavefrontTracer.h"
+#include "CpuRaytracer.h"
+#include "JobSystem.h"
+#include "Material.h"
+#include "Mesh.h"
+#include "Sampler.h"
+#include "SimdLanes.h"
+
+#include <math.h>
+
+using namespace DirectX;
+using namespace SimdLanes;
+
+namespace
+{
+	const unsigned int MissedInstance = 0xFFFFFFFF;
+
+	// What the shading math needs that has to be looked up one lane at
+	// a time, and what it works out for the scatter afterwards
+	struct alignas(32) ShadeBatch
+	{
+		// Gathered: 1 or 0 for whether the lane's ray missed, or hit
+		// something it should shade (past the last bounce, hits just end)
+		float miss[LaneCount];
+		float hit[LaneCount];
+		float normalX[LaneCount], normalY[LaneCount], normalZ[LaneCount];	// World space, not yet normalized or flipped
+		float tintR[LaneCount], tintG[LaneCount], tintB[LaneCount];
+		float roughness[LaneCount];											// 1 for diffuse, 0 for a mirror
+		float diffuseX[LaneCount], diffuseY[LaneCount], diffuseZ[LaneCount];	// Random offset from the normal, for a cosine weighted bounce
+		float roulette[LaneCount];											// Roulette's random number (negative if it doesn't apply)
+
+		// Worked out
+		float skyR[LaneCount], skyG[LaneCount], skyB[LaneCount];			// What a miss adds
+		float throughputR[LaneCount], throughputG[LaneCount], throughputB[LaneCount];	// Tinted, before roulette
+		float alive[LaneCount];
+	};
+
+	// Same as CpuRaytracer's SkyColor(), a lane per direction
+	void SkyColor(Lanes x, Lanes y, Lanes z, Lanes* r, Lanes* g, Lanes* b)
+	{
+		Lanes length = Sqrt(Add(Add(Mul(x, x), Mul(y, y)), Mul(z, z)));
+		Lanes t = Add(Mul(Div(y, length), Splat(0.5f)), Splat(0.5f));
+		*r = Add(Splat(1.0f), Mul(Splat(0.3f - 1.0f), t));
+		*g = Add(Splat(1.0f), Mul(Splat(0.5f - 1.0f), t));
+		*b = Add(Splat(1.0f), Mul(Splat(0.95f - 1.0f), t));
+	}
+
+	void Normalize(Lanes* x, Lanes* y, Lanes* z)
+	{
+		Lanes inverseLength = Div(Splat(1.0f), Sqrt(Add(Add(Mul(*x, *x), Mul(*y, *y)), Mul(*z, *z))));
+		*x = Mul(*x, inverseLength);
+		*y = Mul(*y, inverseLength);
+		*z = Mul(*z, inverseLength);
+	}
+
+	Lanes Dot(Lanes ax, Lanes ay, Lanes az, Lanes bx, Lanes by, Lanes bz)
+	{
+		return Add(Add(Mul(ax, bx), Mul(ay, by)), Mul(az, bz));
+	}
+}
+
+WavefrontTracer::WavefrontTracer() :
+	pathCount(0),
+	shadowCount(0),
+	frame(0),
+	samples(0),
+	stats{}
+{
+}
+
+
+// --------------------------------------------------------
+// Generates every sample's camera ray, then extends, shades
+// and compacts them a bounce at a time until none are left
+// (each stage over every path before the next begins)
+// --------------------------------------------------------
+void WavefrontTracer::Trace(const WavefrontFrame& newFrame, const WavefrontSample* newSamples, unsigned int sampleCount)
+{
+	frame = &newFrame;
+	samples = newSamples;
+	stats = {};
+	stats.paths = sampleCount;
+	Reserve(sampleCount);
+
+	JobSystem& jobs = JobSystem::GetInstance();
+	jobs.ParallelFor(sampleCount, WAVEFRONT_CHUNK_SIZE, [&](unsigned int start, unsigned int end) { Generate(start, end); });
+
+	pathCount = sampleCount;
+	for (unsigned int depth = 0; pathCount > 0; depth++)
+	{
+		jobs.ParallelFor(pathCount, WAVEFRONT_CHUNK_SIZE, [&](unsigned int start, unsigned int end) { Extend(start, end); });
+		jobs.ParallelFor(pathCount, WAVEFRONT_CHUNK_SIZE, [&](unsigned int start, unsigned int end) { Shade(start, end, depth); });
+		stats.bounces++;
+		stats.pathRays += pathCount;
+		stats.lanesRun += (pathCount + LaneCount - 1) / LaneCount * LaneCount;
+
+		Compact(pathCount);
+		jobs.ParallelFor(shadowCount, WAVEFRONT_CHUNK_SIZE, [&](unsigned int start, unsigned int end) { Shadow(start, end); });
+		stats.shadowRays += shadowCount;
+	}
+
+	frame = 0;
+	samples = 0;
+}
+
+const std::vector<XMFLOAT3>& WavefrontTracer::GetRadiance() const
+{
+	return radiance;
+}
+
+const std::vector<GBufferPixel>& WavefrontTracer::GetPrimaryHits() const
+{
+	return primaryHits;
+}
+
+WavefrontStats WavefrontTracer::GetStats() const
+{
+	return stats;
+}
+
+
+// --------------------------------------------------------
+// Grows every queue to hold a batch (rounded up to a whole
+// group of lanes, so the last group can load and store a
+// full set)
+// --------------------------------------------------------
+void WavefrontTracer::Reserve(unsigned int sampleCount)
+{
+	size_t size = (sampleCount + LaneCount - 1) / LaneCount * LaneCount;
+	if (radiance.size() >= size)
+		return;
+
+	for (PathQueue& queue : paths)
+	{
+		for (std::vector<float>* array : { &queue.originX, &queue.originY, &queue.originZ, &queue.directionX, &queue.directionY, &queue.directionZ, &queue.throughputR, &queue.throughputG, &queue.throughputB, &queue.bouncePdf })
+			array->resize(size);
+		queue.sample.resize(size);
+	}
+
+	for (ShadowQueue* queue : { &shadowSetup, &shadows })
+	{
+		for (std::vector<float>* array : { &queue->originX, &queue->originY, &queue->originZ, &queue->directionX, &queue->directionY, &queue->directionZ, &queue->maxDistance, &queue->lightR, &queue->lightG, &queue->lightB })
+			array->resize(size);
+		queue->sample.resize(size);
+	}
+
+	hits.instance.resize(size);
+	hits.triangle.resize(size);
+	for (std::vector<float>* array : { &hits.barycentricU, &hits.barycentricV, &hits.distance, &hits.positionX, &hits.positionY, &hits.positionZ })
+		array->resize(size);
+
+	pathAlive.resize(size);
+	shadowAlive.resize(size);
+	chunkPaths.resize((size + WAVEFRONT_CHUNK_SIZE - 1) / WAVEFRONT_CHUNK_SIZE);
+	chunkShadows.resize(chunkPaths.size());
+	radiance.resize(size);
+	primaryHits.resize(size);
+}
+
+// --------------------------------------------------------
+// RayGen: a jittered ray through each sample's pixel (as
+// CalcRayFromCamera), starting with nothing gathered yet
+// --------------------------------------------------------
+void WavefrontTracer::Generate(unsigned int start, unsigned int end)
+{
+	PathQueue& queue = paths[0];
+	const XMFLOAT4X4& m = frame->inverseViewProjection;
+	Lanes cameraX = Splat(frame->cameraPosition.x);
+	Lanes cameraY = Splat(frame->cameraPosition.y);
+	Lanes cameraZ = Splat(frame->cameraPosition.z);
+
+	alignas(32) float screenX[LaneCount];
+	alignas(32) float screenY[LaneCount];
+	for (unsigned int group = start; group < end; group += LaneCount)
+	{
+		for (unsigned int lane = 0; lane < LaneCount; lane++)
+		{
+			unsigned int i = group + lane;
+			if (i >= end)
+			{
+				screenX[lane] = screenY[lane] = 0.0f;
+				continue;
+			}
+
+			const WavefrontSample& sample = samples[i];
+			unsigned int pixelSeed = Sampler::PixelSeed(sample.x, sample.y) ^ frame->seed;
+			XMFLOAT2 jitter = Sampler::Sample2D(pixelSeed, sample.sampleIndex, SAMPLER_DIMENSION_JITTER);
+			screenX[lane] = (sample.x + jitter.x) / frame->width * 2.0f - 1.0f;
+			screenY[lane] = -((sample.y + jitter.y) / frame->height * 2.0f - 1.0f);
+
+			queue.sample[i] = i;
+			radiance[i] = XMFLOAT3(0, 0, 0);
+		}
+
+		// (x, y, 0, 1) through the inverse view-projection, back to world space
+		Lanes x = Load(screenX);
+		Lanes y = Load(screenY);
+		Lanes worldX = Add(Add(Mul(x, Splat(m._11)), Mul(y, Splat(m._21))), Splat(m._41));
+		Lanes worldY = Add(Add(Mul(x, Splat(m._12)), Mul(y, Splat(m._22))), Splat(m._42));
+		Lanes worldZ = Add(Add(Mul(x, Splat(m._13)), Mul(y, Splat(m._23))), Splat(m._43));
+		Lanes inverseW = Div(Splat(1.0f), Add(Add(Mul(x, Splat(m._14)), Mul(y, Splat(m._24))), Splat(m._44)));
+
+		Lanes directionX = Sub(Mul(worldX, inverseW), cameraX);
+		Lanes directionY = Sub(Mul(worldY, inverseW), cameraY);
+		Lanes directionZ = Sub(Mul(worldZ, inverseW), cameraZ);
+		Normalize(&directionX, &directionY, &directionZ);
+
+		StoreUnaligned(&queue.originX[group], cameraX);
+		StoreUnaligned(&queue.originY[group], cameraY);
+		StoreUnaligned(&queue.originZ[group], cameraZ);
+		StoreUnaligned(&queue.directionX[group], directionX);
+		StoreUnaligned(&queue.directionY[group], directionY);
+		StoreUnaligned(&queue.directionZ[group], directionZ);
+		StoreUnaligned(&queue.throughputR[group], Splat(1.0f));
+		StoreUnaligned(&queue.throughputG[group], Splat(1.0f));
+		StoreUnaligned(&queue.throughputB[group], Splat(1.0f));
+		StoreUnaligned(&queue.bouncePdf[group], Splat(0.0f));
+	}
+}
+
+// --------------------------------------------------------
+// Closest hit of every path's ray
+// --------------------------------------------------------
+void WavefrontTracer::Extend(unsigned int start, unsigned int end)
+{
+	const PathQueue& queue = paths[0];
+	for (unsigned int i = start; i < end; i++)
+	{
+		Ray ray = {};
+		ray.origin = XMFLOAT3(queue.originX[i], queue.originY[i], queue.originZ[i]);
+		ray.direction = XMFLOAT3(queue.directionX[i], queue.directionY[i], queue.directionZ[i]);
+		ray.maxDistance = PICK_MAX_DISTANCE;
+
+		PickResult hit = frame->sceneBVH->Pick(ray);
+		hits.instance[i] = hit.hit ? hit.instance : MissedInstance;
+		if (!hit.hit)
+			continue;
+
+		hits.triangle[i] = hit.triangle;
+		hits.barycentricU[i] = hit.barycentrics.x;
+		hits.barycentricV[i] = hit.barycentrics.y;
+		hits.distance[i] = hit.distance;
+		hits.positionX[i] = hit.position.x;
+		hits.positionY[i] = hit.position.y;
+		hits.positionZ[i] = hit.position.z;
+	}
+}
+
+// --------------------------------------------------------
+// Closest hit and miss, as TraceSample()'s loop body, a
+// group of lanes at a time: gathers each lane's lookups,
+// runs the math on every lane at once, then scatters
+// results - the sky to each missed sample, each path's
+// next ray to the other path queue and shadow rays to
+// shadowSetup (both in place, for compaction to pack)
+// --------------------------------------------------------
+void WavefrontTracer::Shade(unsigned int start, unsigned int end, unsigned int depth)
+{
+	const PathQueue& queue = paths[0];
+	PathQueue& next = paths[1];
+	bool lastBounce = depth >= CPU_RAYTRACER_MAX_PATH_DEPTH;
+	bool roulette = frame->russianRoulette && depth >= CPU_RAYTRACER_ROULETTE_MIN_DEPTH;
+	float skyPdf = 1.0f / (2.0f * XM_PI * (frame->lightCount + 1));
+
+	Lanes zero = Splat(0.0f);
+	Lanes one = Splat(1.0f);
+	unsigned int survivors = 0;
+	unsigned int shadowRays = 0;
+	ShadeBatch batch;
+	for (unsigned int group = start; group < end; group += LaneCount)
+	{
+		for (unsigned int lane = 0; lane < LaneCount; lane++)
+		{
+			unsigned int i = group + lane;
+			batch.miss[lane] = i < end && hits.instance[i] == MissedInstance ? 1.0f : 0.0f;
+			batch.hit[lane] = i < end && hits.instance[i] != MissedInstance && !lastBounce ? 1.0f : 0.0f;
+			if (batch.hit[lane] == 0.0f)
+			{
+				// Anything will do, as long as the math doesn't divide by zero
+				batch.normalX[lane] = batch.normalY[lane] = 0.0f;
+				batch.normalZ[lane] = 1.0f;
+				batch.tintR[lane] = batch.tintG[lane] = batch.tintB[lane] = 1.0f;
+				batch.roughness[lane] = 0.0f;
+				batch.diffuseX[lane] = batch.diffuseY[lane] = batch.diffuseZ[lane] = 0.0f;
+				batch.roulette[lane] = -1.0f;
+				continue;
+			}
+
+			// Tint by the material, with the same "roughness" TlasInstancePacker gives each instance
+			unsigned int instanceIndex = hits.instance[i];
+			const SnapshotInstance& instance = frame->scene->instances[instanceIndex];
+			XMFLOAT3 tint = instance.material ? instance.material->GetColorTint() : XMFLOAT3(1, 1, 1);
+			batch.tintR[lane] = tint.x;
+			batch.tintG[lane] = tint.y;
+			batch.tintB[lane] = tint.z;
+			batch.roughness[lane] = (float)((instanceIndex + 1) % 2);
+
+			XMFLOAT3 localNormal = instance.mesh->GetCpuBVH().InterpolateNormal(hits.triangle[i], XMFLOAT2(hits.barycentricU[i], hits.barycentricV[i]));
+			XMFLOAT3 normal;
+			XMStoreFloat3(&normal, XMVector3TransformNormal(XMLoadFloat3(&localNormal), XMLoadFloat4x4(&instance.worldInverseTransposeMatrix)));
+			batch.normalX[lane] = normal.x;
+			batch.normalY[lane] = normal.y;
+			batch.normalZ[lane] = normal.z;
+
+			// As RandomCosineWeightedHemisphere(), less the normal
+			const WavefrontSample& sample = samples[queue.sample[i]];
+			unsigned int pixelSeed = Sampler::PixelSeed(sample.x, sample.y) ^ frame->seed;
+			XMFLOAT2 bounce = Sampler::Sample2D(pixelSeed, sample.sampleIndex, SAMPLER_DIMENSION_BOUNCE_DIRECTION(depth));
+			float a = bounce.x * 2 - 1;
+			float b = sqrtf(1 - a * a);
+			float phi = 2.0f * XM_PI * bounce.y;
+			batch.diffuseX[lane] = b * cosf(phi);
+			batch.diffuseY[lane] = b * sinf(phi);
+			batch.diffuseZ[lane] = a;
+
+			batch.roulette[lane] = roulette ? Sampler::Sample1D(pixelSeed, sample.sampleIndex, SAMPLER_DIMENSION_ROULETTE(depth)) : -1.0f;
+		}
+
+		Lanes directionX = LoadUnaligned(&queue.directionX[group]);
+		Lanes directionY = LoadUnaligned(&queue.directionY[group]);
+		Lanes directionZ = LoadUnaligned(&queue.directionZ[group]);
+		Lanes throughputR = LoadUnaligned(&queue.throughputR[group]);
+		Lanes throughputG = LoadUnaligned(&queue.throughputG[group]);
+		Lanes throughputB = LoadUnaligned(&queue.throughputB[group]);
+
+		// Misses: the sky, weighed against the light sample that could have found it
+		Lanes bouncePdf = LoadUnaligned(&queue.bouncePdf[group]);
+		Lanes bouncePdf2 = Mul(bouncePdf, bouncePdf);
+		Lanes weight = Select(one, Div(bouncePdf2, Add(bouncePdf2, Splat(skyPdf * skyPdf))), Less(zero, bouncePdf));
+		Lanes skyR, skyG, skyB;
+		SkyColor(directionX, directionY, directionZ, &skyR, &skyG, &skyB);
+		Lanes miss = Load(batch.miss);
+		weight = Mul(weight, miss);
+		Store(batch.skyR, Mul(Mul(throughputR, skyR), weight));
+		Store(batch.skyG, Mul(Mul(throughputG, skyG), weight));
+		Store(batch.skyB, Mul(Mul(throughputB, skyB), weight));
+
+		// Hits: the normal facing back along the ray, and the tint
+		Lanes normalX = Load(batch.normalX);
+		Lanes normalY = Load(batch.normalY);
+		Lanes normalZ = Load(batch.normalZ);
+		Normalize(&normalX, &normalY, &normalZ);
+		Lanes backFacing = Less(zero, Dot(normalX, normalY, normalZ, directionX, directionY, directionZ));
+		normalX = Select(normalX, Sub(zero, normalX), backFacing);
+		normalY = Select(normalY, Sub(zero, normalY), backFacing);
+		normalZ = Select(normalZ, Sub(zero, normalZ), backFacing);
+		Store(batch.normalX, normalX);
+		Store(batch.normalY, normalY);
+		Store(batch.normalZ, normalZ);
+
+		throughputR = Mul(throughputR, Load(batch.tintR));
+		throughputG = Mul(throughputG, Load(batch.tintG));
+		throughputB = Mul(throughputB, Load(batch.tintB));
+		Store(batch.throughputR, throughputR);
+		Store(batch.throughputG, throughputG);
+		Store(batch.throughputB, throughputB);
+
+		// Next direction: between the mirror reflection and a diffuse bounce, by roughness
+		Lanes twiceCosine = Mul(Splat(2.0f), Dot(directionX, directionY, directionZ, normalX, normalY, normalZ));
+		Lanes reflectionX = Sub(directionX, Mul(twiceCosine, normalX));
+		Lanes reflectionY = Sub(directionY, Mul(twiceCosine, normalY));
+		Lanes reflectionZ = Sub(directionZ, Mul(twiceCosine, normalZ));
+		Lanes roughness = Load(batch.roughness);
+		Lanes nextX = Add(reflectionX, Mul(Sub(Add(normalX, Load(batch.diffuseX)), reflectionX), roughness));
+		Lanes nextY = Add(reflectionY, Mul(Sub(Add(normalY, Load(batch.diffuseY)), reflectionY), roughness));
+		Lanes nextZ = Add(reflectionZ, Mul(Sub(Add(normalZ, Load(batch.diffuseZ)), reflectionZ), roughness));
+		Normalize(&nextX, &nextY, &nextZ);
+		Lanes nextPdf = Mul(Mul(Max(Dot(normalX, normalY, normalZ, nextX, nextY, nextZ), zero), Splat(1.0f / XM_PI)), roughness);
+
+		// Russian roulette - dim paths probably end here, and the
+		// survivors are brightened to make up for those that did
+		Lanes survival = Min(Max(throughputR, Max(throughputG, throughputB)), Splat(CPU_RAYTRACER_ROULETTE_MAX_SURVIVAL));
+		Lanes rouletteU = Load(batch.roulette);
+		Lanes survived = Less(rouletteU, survival);
+		Lanes rolled = Less(zero, Add(rouletteU, one)); // Lanes that rolled at all (the rest hold -1)
+		Lanes brighten = Div(one, Select(one, survival, And(rolled, survived)));
+		Store(batch.alive, And(Load(batch.hit), Select(zero, one, survived)));
+
+		StoreUnaligned(&next.originX[group], LoadUnaligned(&hits.positionX[group]));
+		StoreUnaligned(&next.originY[group], LoadUnaligned(&hits.positionY[group]));
+		StoreUnaligned(&next.originZ[group], LoadUnaligned(&hits.positionZ[group]));
+		StoreUnaligned(&next.directionX[group], nextX);
+		StoreUnaligned(&next.directionY[group], nextY);
+		StoreUnaligned(&next.directionZ[group], nextZ);
+		StoreUnaligned(&next.throughputR[group], Mul(throughputR, brighten));
+		StoreUnaligned(&next.throughputG[group], Mul(throughputG, brighten));
+		StoreUnaligned(&next.throughputB[group], Mul(throughputB, brighten));
+		StoreUnaligned(&next.bouncePdf[group], nextPdf);
+
+		// What only makes sense per lane: results to each sample, and
+		// light sampling (each lane may pick a different light)
+		for (unsigned int lane = 0; lane < LaneCount && group + lane < end; lane++)
+		{
+			unsigned int i = group + lane;
+			unsigned int sampleIndex = queue.sample[i];
+			next.sample[i] = sampleIndex;
+			pathAlive[i] = batch.alive[lane] > 0.0f ? 1 : 0;
+			shadowAlive[i] = 0;
+			survivors += pathAlive[i];
+
+			XMFLOAT3& sampleRadiance = radiance[sampleIndex];
+			if (batch.miss[lane] > 0.0f)
+			{
+				sampleRadiance.x += batch.skyR[lane];
+				sampleRadiance.y += batch.skyG[lane];
+				sampleRadiance.z += batch.skyB[lane];
+				if (depth == 0)
+				{
+					GBufferPixel& primaryHit = primaryHits[sampleIndex];
+					primaryHit = {};
+					primaryHit.distance = -1.0f;
+					primaryHit.albedo = XMFLOAT3(1, 1, 1);
+				}
+				continue;
+			}
+
+			if (batch.hit[lane] == 0.0f)
+				continue;
+
+			XMFLOAT3 normal(batch.normalX[lane], batch.normalY[lane], batch.normalZ[lane]);
+			if (depth == 0)
+			{
+				GBufferPixel& primaryHit = primaryHits[sampleIndex];
+				primaryHit.normal = normal;
+				primaryHit.distance = hits.distance[i];
+				primaryHit.albedo = XMFLOAT3(batch.tintR[lane], batch.tintG[lane], batch.tintB[lane]);
+				primaryHit.padding = 0;
+			}
+
+			if (batch.roughness[lane] < 1.0f)
+				continue;
+
+			const WavefrontSample& sample = samples[sampleIndex];
+			Ray shadowRay;
+			XMVECTOR light;
+			if (!CpuRaytracer::SampleDirectLight(
+				frame->lights,
+				frame->lightCount,
+				XMFLOAT3(hits.positionX[i], hits.positionY[i], hits.positionZ[i]),
+				XMLoadFloat3(&normal),
+				Sampler::PixelSeed(sample.x, sample.y) ^ frame->seed,
+				sample.sampleIndex,
+				depth,
+				&shadowRay,
+				&light))
+				continue;
+
+			XMFLOAT3 lightColor;
+			XMStoreFloat3(&lightColor, light * XMVectorSet(batch.throughputR[lane], batch.throughputG[lane], batch.throughputB[lane], 0));
+			shadowSetup.originX[i] = shadowRay.origin.x;
+			shadowSetup.originY[i] = shadowRay.origin.y;
+			shadowSetup.originZ[i] = shadowRay.origin.z;
+			shadowSetup.directionX[i] = shadowRay.direction.x;
+			shadowSetup.directionY[i] = shadowRay.direction.y;
+			shadowSetup.directionZ[i] = shadowRay.direction.z;
+			shadowSetup.maxDistance[i] = shadowRay.maxDistance;
+			shadowSetup.lightR[i] = lightColor.x;
+			shadowSetup.lightG[i] = lightColor.y;
+			shadowSetup.lightB[i] = lightColor.z;
+			shadowSetup.sample[i] = sampleIndex;
+			shadowAlive[i] = 1;
+			shadowRays++;
+		}
+	}
+
+	chunkPaths[start / WAVEFRONT_CHUNK_SIZE] = survivors;
+	chunkShadows[start / WAVEFRONT_CHUNK_SIZE] = shadowRays;
+}
+
+// --------------------------------------------------------
+// Adds each shadow ray's light to its sample, unless
+// something's in the way
+// --------------------------------------------------------
+void WavefrontTracer::Shadow(unsigned int start, unsigned int end)
+{
+	for (unsigned int i = start; i < end; i++)
+	{
+		Ray ray = {};
+		ray.origin = XMFLOAT3(shadows.originX[i], shadows.originY[i], shadows.originZ[i]);
+		ray.direction = XMFLOAT3(shadows.directionX[i], shadows.directionY[i], shadows.directionZ[i]);
+		ray.maxDistance = shadows.maxDistance[i];
+		if (frame->sceneBVH->IsOccluded(ray))
+			continue;
+
+		XMFLOAT3& sampleRadiance = radiance[shadows.sample[i]];
+		sampleRadiance.x += shadows.lightR[i];
+		sampleRadiance.y += shadows.lightG[i];
+		sampleRadiance.z += shadows.lightB[i];
+	}
+}
+
+// --------------------------------------------------------
+// Packs the paths that survived shading back into the path
+// queue, and the shadow rays it set up into theirs: each
+// chunk's count (from Shade()) becomes where its first one
+// goes, then every chunk copies its own over in order
+// --------------------------------------------------------
+void WavefrontTracer::Compact(unsigned int count)
+{
+	unsigned int chunks = (count + WAVEFRONT_CHUNK_SIZE - 1) / WAVEFRONT_CHUNK_SIZE;
+	pathCount = 0;
+	shadowCount = 0;
+	for (unsigned int c = 0; c < chunks; c++)
+	{
+		unsigned int chunkPathCount = chunkPaths[c];
+		unsigned int chunkShadowCount = chunkShadows[c];
+		chunkPaths[c] = pathCount;
+		chunkShadows[c] = shadowCount;
+		pathCount += chunkPathCount;
+		shadowCount += chunkShadowCount;
+	}
+
+	JobSystem::GetInstance().ParallelFor(count, WAVEFRONT_CHUNK_SIZE,
+		[&](unsigned int start, unsigned int end)
+		{
+			const PathQueue& source = paths[1];
+			PathQueue& destination = paths[0];
+			unsigned int p = chunkPaths[start / WAVEFRONT_CHUNK_SIZE];
+			unsigned int s = chunkShadows[start / WAVEFRONT_CHUNK_SIZE];
+			for (unsigned int i = start; i < end; i++)
+			{
+				if (pathAlive[i])
+				{
+					destination.originX[p] = source.originX[i];
+					destination.originY[p] = source.originY[i];
+					destination.originZ[p] = source.originZ[i];
+					destination.directionX[p] = source.directionX[i];
+					destination.directionY[p] = source.directionY[i];
+					destination.directionZ[p] = source.directionZ[i];
+					destination.throughputR[p] = source.throughputR[i];
+					destination.throughputG[p] = source.throughputG[i];
+					destination.throughputB[p] = source.throughputB[i];
+					destination.bouncePdf[p] = source.bouncePdf[i];
+					destination.sample[p] = source.sample[i];
+					p++;
+				}
+
+				if (shadowAlive[i])
+				{
+					shadows.originX[s] = shadowSetup.originX[i];
+					shadows.originY[s] = shadowSetup.originY[i];
+					shadows.originZ[s] = shadowSetup.originZ[i];
+					shadows.directionX[s] = shadowSetup.directionX[i];
+					shadows.directionY[s] = shadowSetup.directionY[i];
+					shadows.directionZ[s] = shadowSetup.directionZ[i];
+					shadows.maxDistance[s] = shadowSetup.maxDistance[i];
+					shadows.lightR[s] = shadowSetup.lightR[i];
+					shadows.lightG[s] = shadowSetup.lightG[i];
+					shadows.lightB[s] = shadowSetup.lightB[i];
+					shadows.sample[s] = shadowSetup.sample[i];
+					s++;
+				}
+			}
+		});
+}
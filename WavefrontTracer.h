@@ -0,0 +1,153 @@
+#pragma once
+
+// Traces CpuRaytracer's paths a bounce at a time (a wavefront, after Laine
+// et al., "Megakernels considered harmful: wavefront path tracing on
+// GPUs", 2013) instead of each path start to finish, so the SIMD lanes of
+// the shading math are always full however the paths diverge.
+//
+// Paths live in structure-of-arrays queues, and each bounce is a few
+// stages, each run over the whole queue (spread across the job system):
+//  - generate: a camera ray for every sample (RayGen's jittered ray)
+//  - extend: every path's ray traced to its closest hit (through the
+//    ScenePicker, which walks its hierarchies a ray at a time)
+//  - shade: misses add the sky; hits are tinted, pick their next
+//    direction and roll Russian roulette, and diffuse ones set up a
+//    shadow ray toward a light or the sky - the math runs on a pixel per
+//    SIMD lane (see SimdLanes.h), with the per-lane lookups (materials,
+//    normals, random numbers, lights) gathered before and scattered after
+//  - shadow: every shadow ray traced, adding its light if nothing's in the way
+//  - compaction: paths still going, and shadow rays set up, are packed to
+//    the front of their queues for the next stage
+// Each sample is still traced exactly as TraceSample() does, random
+// numbers included, so the image matches the one-path-at-a-time version
+// (up to floating point rounding).  Compaction only ever moves paths
+// within fixed chunks' ranges in order, so it doesn't depend on the
+// thread count either.
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "BufferStructs.h"
+#include "Lights.h"
+#include "SceneSnapshot.h"
+#include "ScenePicker.h"
+
+// Most samples a CpuRaytracer hands over at once (so the queues stay
+// around 30 MB at any resolution)
+#define WAVEFRONT_MAX_SAMPLES (1u << 17)
+
+// Paths each job handles per stage (a whole number of SIMD lane groups)
+#define WAVEFRONT_CHUNK_SIZE 512
+
+// Everything about the frame that's the same for every path (owned by the caller, unchanged while tracing)
+struct WavefrontFrame
+{
+	const SceneSnapshot* scene;
+	const ScenePicker* sceneBVH;
+	const Light* lights;
+	unsigned int lightCount;
+	DirectX::XMFLOAT3 cameraPosition;
+	DirectX::XMFLOAT4X4 inverseViewProjection;
+	unsigned int width;
+	unsigned int height;
+	unsigned int seed;
+	bool russianRoulette;
+};
+
+// One sample to trace: a pixel, and which of its samples
+struct WavefrontSample
+{
+	unsigned int x;
+	unsigned int y;
+	unsigned int sampleIndex;
+};
+
+// How the queues were used by the last Trace()
+struct WavefrontStats
+{
+	unsigned int paths;					// Samples traced
+	unsigned int bounces;				// Extend stages until every path had ended
+	unsigned long long pathRays;		// Rays traced by the extend stage, over every bounce
+	unsigned long long shadowRays;		// Rays traced by the shadow stage
+	unsigned long long lanesRun;		// SIMD lanes the shading math ran, over every bounce (pathRays of them held a path)
+};
+
+class WavefrontTracer
+{
+public:
+	WavefrontTracer();
+
+	/// <summary>
+	/// Traces a batch of samples through every bounce
+	/// </summary>
+	/// <param name="frame">Scene and camera to trace</param>
+	/// <param name="samples">Which samples to trace</param>
+	/// <param name="sampleCount">How many there are (WAVEFRONT_MAX_SAMPLES or fewer keeps memory in check)</param>
+	void Trace(const WavefrontFrame& frame, const WavefrontSample* samples, unsigned int sampleCount);
+
+	// Linear color of each sample of the last Trace(), in the order they were given
+	const std::vector<DirectX::XMFLOAT3>& GetRadiance() const;
+
+	// What each sample's camera ray hit (albedo is white and distance negative on a miss)
+	const std::vector<GBufferPixel>& GetPrimaryHits() const;
+
+	WavefrontStats GetStats() const;
+
+private:
+	// Paths still going, one per element of each array
+	struct PathQueue
+	{
+		std::vector<float> originX, originY, originZ;
+		std::vector<float> directionX, directionY, directionZ;
+		std::vector<float> throughputR, throughputG, throughputB;
+		std::vector<float> bouncePdf;		// Of the last bounce's direction (0 after a mirror)
+		std::vector<unsigned int> sample;	// Index into the samples (and the results)
+	};
+
+	// Shadow rays, with what they add if nothing's in the way
+	struct ShadowQueue
+	{
+		std::vector<float> originX, originY, originZ;
+		std::vector<float> directionX, directionY, directionZ;
+		std::vector<float> maxDistance;
+		std::vector<float> lightR, lightG, lightB;
+		std::vector<unsigned int> sample;
+	};
+
+	// Where each path's ray ended up, indexed like the path queue
+	struct HitQueue
+	{
+		std::vector<unsigned int> instance;	// All bits set if nothing was hit
+		std::vector<unsigned int> triangle;
+		std::vector<float> barycentricU, barycentricV;
+		std::vector<float> distance;
+		std::vector<float> positionX, positionY, positionZ;
+	};
+
+	// paths[0] is traced and shaded into paths[1], which
+	// compaction then packs back into paths[0]
+	PathQueue paths[2];
+	HitQueue hits;
+	ShadowQueue shadowSetup;	// Indexed like the paths, before compaction
+	ShadowQueue shadows;
+	std::vector<unsigned char> pathAlive;
+	std::vector<unsigned char> shadowAlive;
+	std::vector<unsigned int> chunkPaths;		// Survivors per chunk, then where each chunk's go
+	std::vector<unsigned int> chunkShadows;	// Same, for shadow rays
+	unsigned int pathCount;
+	unsigned int shadowCount;
+
+	std::vector<DirectX::XMFLOAT3> radiance;
+	std::vector<GBufferPixel> primaryHits;
+
+	const WavefrontFrame* frame;
+	const WavefrontSample* samples;
+	WavefrontStats stats;
+
+	void Reserve(unsigned int sampleCount);
+	void Generate(unsigned int start, unsigned int end);
+	void Extend(unsigned int start, unsigned int end);
+	void Shade(unsigned int start, unsigned int end, unsigned int depth);
+	void Shadow(unsigned int start, unsigned int end);
+	void Compact(unsigned int count);
+};